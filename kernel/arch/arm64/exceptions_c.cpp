@@ -23,6 +23,7 @@
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
+#include <vm/vm_aspace.h>
 
 #include <lib/counters.h>
 
@@ -32,6 +33,7 @@
 #define LOCAL_TRACE 0
 
 #define DFSC_ALIGNMENT_FAULT 0b100001
+#define DFSC_ACCESS_FLAG_FAULT 0b001000 // low two bits are the level
 
 static void dump_iframe(const struct arm64_iframe_long* iframe) {
     printf("iframe %p:\n", iframe);
@@ -135,6 +137,18 @@ static void arm64_fpu_handler(struct arm64_iframe_long* iframe, uint exception_f
     arm64_fpu_exception(iframe, exception_flags);
 }
 
+// Access flag faults are only taken on user pages whose flag was cleared by
+// HarvestAccessed(), and setting the flag again is all they need. Anything
+// else, including a page that was unmapped in the meantime, is left to the
+// page fault handler.
+static bool arm64_handle_access_flag_fault(uint64_t far, uint32_t fsc) {
+    if ((fsc & 0b111100) != DFSC_ACCESS_FLAG_FAULT || !is_user_address(far))
+        return false;
+
+    VmAspace* aspace = VmAspace::vaddr_to_aspace(far);
+    return aspace && aspace->arch_aspace().MarkAccessed(far) == ZX_OK;
+}
+
 static void arm64_instruction_abort_handler(struct arm64_iframe_long* iframe, uint exception_flags,
                                             uint32_t esr) {
     /* read the FAR register */
@@ -156,7 +170,9 @@ static void arm64_instruction_abort_handler(struct arm64_iframe_long* iframe, ui
 
     arch_enable_ints();
     kcounter_add(exceptions_page, 1);
-    zx_status_t err = vmm_page_fault_handler(far, pf_flags);
+    zx_status_t err = ZX_OK;
+    if (!arm64_handle_access_flag_fault(far, BITS(iss, 5, 0)))
+        err = vmm_page_fault_handler(far, pf_flags);
     arch_disable_ints();
     if (err >= 0)
         return;
@@ -201,7 +217,9 @@ static void arm64_data_abort_handler(struct arm64_iframe_long* iframe, uint exce
     if (likely(dfsc != DFSC_ALIGNMENT_FAULT)) {
         arch_enable_ints();
         kcounter_add(exceptions_page, 1);
-        zx_status_t err = vmm_page_fault_handler(far, pf_flags);
+        zx_status_t err = ZX_OK;
+        if (!arm64_handle_access_flag_fault(far, dfsc))
+            err = vmm_page_fault_handler(far, pf_flags);
         arch_disable_ints();
         if (err >= 0) {
             return;
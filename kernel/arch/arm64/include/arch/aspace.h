@@ -34,6 +34,12 @@ public:
     zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) override;
 
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                harvest_accessed_fn_t accessed_fn, void* context) override;
+
+    // Set the access flag of the page mapped at |vaddr| after an access flag
+    // fault. Returns ZX_ERR_NOT_FOUND if nothing is mapped there.
+    zx_status_t MarkAccessed(vaddr_t vaddr);
 
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
@@ -58,6 +64,9 @@ private:
 
     void FreePageTable(void* vaddr, paddr_t paddr, uint page_size_shift) TA_REQ(lock_);
 
+    zx_status_t SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                               uint page_size_shift, volatile pte_t* page_table) TA_REQ(lock_);
+
     ssize_t MapPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                          paddr_t paddr_in, size_t size_in, pte_t attrs,
                          uint index_shift, uint page_size_shift,
@@ -71,6 +80,11 @@ private:
                          pte_t attrs, uint index_shift, uint page_size_shift,
                          volatile pte_t* page_table) TA_REQ(lock_);
 
+    void HarvestAccessedPageTable(vaddr_t vaddr, vaddr_t vaddr_rel, size_t size,
+                                  uint index_shift, uint page_size_shift,
+                                  volatile pte_t* page_table,
+                                  harvest_accessed_fn_t accessed_fn, void* context) TA_REQ(lock_);
+
     void MmuParamsFromFlags(uint mmu_flags,
                             pte_t* attrs, vaddr_t* vaddr_base,
                             uint* top_size_shift, uint* top_index_shift,
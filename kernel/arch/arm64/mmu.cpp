@@ -271,6 +271,98 @@ zx_status_t ArmArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return QueryLocked(vaddr, paddr, mmu_flags);
 }
 
+// The access flag is managed in software: it is set when a page is mapped,
+// HarvestAccessed() clears it, and the next access takes an access flag fault
+// that MarkAccessed() resolves by setting it again. Kernel mappings can be
+// touched where that fault cannot be handled, and guest mappings fault through
+// the hypervisor instead, so only user aspaces are tracked.
+zx_status_t ArmArchVmAspace::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                             harvest_accessed_fn_t accessed_fn, void* context) {
+    canary_.Assert();
+    LTRACEF("vaddr %#" PRIxPTR " count %zu\n", vaddr, count);
+
+    if (flags_ & (ARCH_ASPACE_FLAG_KERNEL | ARCH_ASPACE_FLAG_GUEST))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    DEBUG_ASSERT(tt_virt_);
+
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_OUT_OF_RANGE;
+    if (!IS_PAGE_ALIGNED(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+    if (count == 0)
+        return ZX_OK;
+
+    fbl::AutoLock a(&lock_);
+
+    vaddr_t vaddr_base;
+    uint top_size_shift, top_index_shift, page_size_shift;
+    MmuParamsFromFlags(0, nullptr, &vaddr_base, &top_size_shift, &top_index_shift,
+                       &page_size_shift);
+
+    const vaddr_t vaddr_rel = vaddr - vaddr_base;
+    const vaddr_t vaddr_rel_max = 1UL << top_size_shift;
+    const size_t size = count * PAGE_SIZE;
+    if (vaddr_rel > vaddr_rel_max - size || size > vaddr_rel_max)
+        return ZX_ERR_INVALID_ARGS;
+
+    HarvestAccessedPageTable(vaddr, vaddr_rel, size, top_index_shift, page_size_shift,
+                             tt_virt_, accessed_fn, context);
+    DSB;
+    return ZX_OK;
+}
+
+zx_status_t ArmArchVmAspace::MarkAccessed(vaddr_t vaddr) {
+    canary_.Assert();
+    LTRACEF("vaddr %#" PRIxPTR "\n", vaddr);
+
+    if (flags_ & (ARCH_ASPACE_FLAG_KERNEL | ARCH_ASPACE_FLAG_GUEST))
+        return ZX_ERR_NOT_SUPPORTED;
+
+    DEBUG_ASSERT(tt_virt_);
+
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    fbl::AutoLock a(&lock_);
+
+    vaddr_t vaddr_base;
+    uint top_size_shift, index_shift, page_size_shift;
+    MmuParamsFromFlags(0, nullptr, &vaddr_base, &top_size_shift, &index_shift,
+                       &page_size_shift);
+
+    vaddr_t vaddr_rem = vaddr - vaddr_base;
+    volatile pte_t* page_table = tt_virt_;
+    while (true) {
+        const vaddr_t index = vaddr_rem >> index_shift;
+        vaddr_rem -= index << index_shift;
+        const pte_t pte = page_table[index];
+        const uint descriptor_type = pte & MMU_PTE_DESCRIPTOR_MASK;
+
+        if (descriptor_type == ((index_shift > page_size_shift) ? MMU_PTE_L012_DESCRIPTOR_BLOCK
+                                                                  : MMU_PTE_L3_DESCRIPTOR_PAGE)) {
+            // another thread may have gotten here first
+            if (!(pte & MMU_PTE_ATTR_AF)) {
+                page_table[index] = pte | MMU_PTE_ATTR_AF;
+
+                // entries that take access flag faults are never cached in
+                // the TLB, so there is nothing to flush
+                DSB;
+            }
+            return ZX_OK;
+        }
+
+        if (index_shift <= page_size_shift ||
+            descriptor_type != MMU_PTE_L012_DESCRIPTOR_TABLE) {
+            return ZX_ERR_NOT_FOUND;
+        }
+
+        page_table = static_cast<volatile pte_t*>(
+            paddr_to_physmap(pte & MMU_PTE_OUTPUT_ADDR_MASK));
+        index_shift -= page_size_shift - 3;
+    }
+}
+
 zx_status_t ArmArchVmAspace::QueryLocked(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
     ulong index;
     uint index_shift;
@@ -442,6 +534,54 @@ volatile pte_t* ArmArchVmAspace::GetPageTable(vaddr_t index, uint page_size_shif
     }
 }
 
+// Replace the block mapping at page_table[index], which maps the block at
+// |vaddr|, with a table of next level entries that map the same memory with
+// the same attributes, so that part of the block can be changed on its own.
+zx_status_t ArmArchVmAspace::SplitLargePage(vaddr_t vaddr, vaddr_t index, uint index_shift,
+                                            uint page_size_shift, volatile pte_t* page_table) {
+    DEBUG_ASSERT(index_shift > page_size_shift);
+
+    const pte_t pte = page_table[index];
+    DEBUG_ASSERT((pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK);
+
+    paddr_t paddr;
+    zx_status_t ret = AllocPageTable(&paddr, page_size_shift);
+    if (ret) {
+        TRACEF("failed to allocate page table\n");
+        return ZX_ERR_NO_MEMORY;
+    }
+
+    const uint next_shift = index_shift - (page_size_shift - 3);
+    const paddr_t block_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
+    pte_t attrs = pte & ~(MMU_PTE_OUTPUT_ADDR_MASK | MMU_PTE_DESCRIPTOR_MASK);
+    if (next_shift > page_size_shift)
+        attrs |= MMU_PTE_L012_DESCRIPTOR_BLOCK;
+    else
+        attrs |= MMU_PTE_L3_DESCRIPTOR_PAGE;
+
+    volatile pte_t* new_page_table = static_cast<volatile pte_t*>(paddr_to_physmap(paddr));
+    const size_t count = 1U << (page_size_shift - 3);
+    for (size_t i = 0; i < count; i++) {
+        new_page_table[i] = (block_paddr + (i << next_shift)) | attrs;
+    }
+
+    // ensure that the new table is observable from hardware page table walkers
+    DMB_ISHST;
+
+    // break before make: the block has to be gone from every TLB before the
+    // table replaces it, or the two could be cached side by side
+    page_table[index] = MMU_PTE_DESCRIPTOR_INVALID;
+    DMB_ISHST;
+    FlushTLBEntry(vaddr, true);
+    DSB;
+
+    page_table[index] = paddr | MMU_PTE_L012_DESCRIPTOR_TABLE;
+    DMB_ISHST;
+
+    LTRACEF("split block at %#" PRIxPTR " into page table %#" PRIxPTR "\n", vaddr, paddr);
+    return ZX_OK;
+}
+
 static bool page_table_is_clear(volatile pte_t* page_table, uint page_size_shift) {
     int i;
     int count = 1U << (page_size_shift - 3);
@@ -512,13 +652,27 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
 
         pte = page_table[index];
 
+        // a block that is only partly unmapped has to be split first. the
+        // caller may free the pages once they are unmapped, so if there is no
+        // memory to split with, unmap the whole block rather than none of it.
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            if (SplitLargePage(vaddr - vaddr_rem, index, index_shift,
+                               page_size_shift, page_table) != ZX_OK) {
+                TRACEF("unmapping all of the block at %#" PRIxPTR "\n", vaddr - vaddr_rem);
+            }
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
             next_page_table = static_cast<volatile pte_t*>(paddr_to_physmap(page_table_paddr));
-            UnmapPageTable(vaddr, vaddr_rem, chunk_size,
-                           index_shift - (page_size_shift - 3),
-                           page_size_shift, next_page_table);
+            ssize_t ret = UnmapPageTable(vaddr, vaddr_rem, chunk_size,
+                                         index_shift - (page_size_shift - 3),
+                                         page_size_shift, next_page_table);
+            if (ret < 0)
+                return ret;
             if (chunk_size == block_size ||
                 page_table_is_clear(next_page_table, page_size_shift)) {
                 LTRACEF("pte %p[0x%lx] = 0 (was page table)\n", page_table, index);
@@ -554,6 +708,52 @@ ssize_t ArmArchVmAspace::UnmapPageTable(vaddr_t vaddr, vaddr_t vaddr_rel,
     return unmap_size;
 }
 
+// NOTE: caller must DSB afterwards to ensure TLB entries are flushed
+void ArmArchVmAspace::HarvestAccessedPageTable(vaddr_t vaddr, vaddr_t vaddr_rel, size_t size,
+                                               uint index_shift, uint page_size_shift,
+                                               volatile pte_t* page_table,
+                                               harvest_accessed_fn_t accessed_fn,
+                                               void* context) {
+    while (size) {
+        const vaddr_t block_size = 1UL << index_shift;
+        const vaddr_t vaddr_rem = vaddr_rel & (block_size - 1);
+        const size_t chunk_size = MIN(size, block_size - vaddr_rem);
+        const vaddr_t index = vaddr_rel >> index_shift;
+        const pte_t pte = page_table[index];
+        const uint descriptor_type = pte & MMU_PTE_DESCRIPTOR_MASK;
+
+        if (index_shift > page_size_shift &&
+            descriptor_type == MMU_PTE_L012_DESCRIPTOR_TABLE) {
+            volatile pte_t* next_page_table = static_cast<volatile pte_t*>(
+                paddr_to_physmap(pte & MMU_PTE_OUTPUT_ADDR_MASK));
+            HarvestAccessedPageTable(vaddr, vaddr_rem, chunk_size,
+                                     index_shift - (page_size_shift - 3),
+                                     page_size_shift, next_page_table, accessed_fn, context);
+        } else if (descriptor_type == ((index_shift > page_size_shift)
+                                           ? MMU_PTE_L012_DESCRIPTOR_BLOCK
+                                           : MMU_PTE_L3_DESCRIPTOR_PAGE) &&
+                   (pte & MMU_PTE_ATTR_AF)) {
+            // a block is harvested as a whole, so every page of it in the
+            // range is reported
+            page_table[index] = pte & ~MMU_PTE_ATTR_AF;
+
+            // ensure that the update is observable from hardware page table walkers
+            DMB_ISHST;
+
+            // drop the cached entry, which would hide further accesses
+            FlushTLBEntry(vaddr, true);
+
+            const paddr_t paddr = (pte & MMU_PTE_OUTPUT_ADDR_MASK) + vaddr_rem;
+            for (size_t offset = 0; offset < chunk_size; offset += PAGE_SIZE)
+                accessed_fn(context, vaddr + offset, paddr + offset);
+        }
+
+        vaddr += chunk_size;
+        vaddr_rel += chunk_size;
+        size -= chunk_size;
+    }
+}
+
 // NOTE: caller must DSB afterwards to ensure TLB entries are flushed
 ssize_t ArmArchVmAspace::MapPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
                                       paddr_t paddr_in, size_t size_in,
@@ -676,6 +876,16 @@ int ArmArchVmAspace::ProtectPageTable(vaddr_t vaddr_in, vaddr_t vaddr_rel_in,
         index = vaddr_rel >> index_shift;
         pte = page_table[index];
 
+        // a block that only partly changes permissions has to be split first
+        if (index_shift > page_size_shift && chunk_size != block_size &&
+            (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_BLOCK) {
+            ret = SplitLargePage(vaddr - vaddr_rem, index, index_shift,
+                                 page_size_shift, page_table);
+            if (ret != ZX_OK)
+                return ret;
+            pte = page_table[index];
+        }
+
         if (index_shift > page_size_shift &&
             (pte & MMU_PTE_DESCRIPTOR_MASK) == MMU_PTE_L012_DESCRIPTOR_TABLE) {
             page_table_paddr = pte & MMU_PTE_OUTPUT_ADDR_MASK;
@@ -11,6 +11,7 @@
 #include <assert.h>
 #include <dev/interrupt.h>
 #include <err.h>
+#include <kernel/cpu_topology.h>
 #include <trace.h>
 #include <zircon/types.h>
 
@@ -49,6 +50,16 @@ void arch_init_cpu_map(uint cluster_count, const uint* cluster_cpus) {
             // set the per cpu structure's cpu id
             arm64_percpu_array[cpu_id].cpu_num = cpu_id;
 
+            // Each cluster (AFF1) has its own shared L2, which is the last
+            // level of cache on the cores we support. None of them implement
+            // SMT, and we do not yet know about multiple NUMA nodes.
+            struct cpu_topology_ids ids;
+            ids.core = cpu_id;
+            ids.llc = cluster;
+            ids.cluster = cluster;
+            ids.node = 0;
+            cpu_topology_register_cpu(cpu_id, &ids);
+
             cpu_id++;
         }
     }
@@ -8,6 +8,7 @@
 #include <arch/x86/cpu_topology.h>
 #include <arch/x86/feature.h>
 #include <bits.h>
+#include <kernel/cpu_topology.h>
 #include <pow2.h>
 #include <stdio.h>
 #include <string.h>
@@ -33,9 +34,15 @@ static uint32_t core_shift = 0;
 
 static uint32_t smt_mask = 0;
 
+// Apic ids that are equal after shifting right by this many bits share the
+// last level cache. Defaults to sharing it with the whole package.
+static uint32_t llc_shift = 0;
+static bool llc_shift_valid = false;
+
 static void legacy_topology_init();
 static void modern_intel_topology_init();
 static void extended_amd_topology_init();
+static void llc_topology_init();
 
 void x86_cpu_topology_init() {
     static int initialized;
@@ -51,6 +58,49 @@ void x86_cpu_topology_init() {
     } else {
         legacy_topology_init();
     }
+
+    llc_topology_init();
+}
+
+// Walk the deterministic cache parameters leaf to find how many apic ids
+// share the highest level cache.
+static void llc_topology_init() {
+    enum x86_cpuid_leaf_num leaf_num;
+    if (x86_vendor == X86_VENDOR_INTEL) {
+        leaf_num = X86_CPUID_CACHE_V2;
+    } else if (x86_vendor == X86_VENDOR_AMD && x86_feature_test(X86_FEATURE_AMD_TOPO)) {
+        leaf_num = X86_CPUID_AMD_CACHE;
+    } else {
+        return;
+    }
+
+    uint32_t highest_level = 0;
+    uint32_t sharing = 0;
+    for (uint32_t index = 0; index < 16; index++) {
+        struct cpuid_leaf leaf;
+        if (!x86_get_cpuid_subleaf(leaf_num, index, &leaf)) {
+            break;
+        }
+
+        // a cache type of 0 terminates the list
+        if (BITS(leaf.a, 4, 0) == 0) {
+            break;
+        }
+
+        uint32_t level = BITS_SHIFT(leaf.a, 7, 5);
+        if (level > highest_level) {
+            highest_level = level;
+            sharing = BITS_SHIFT(leaf.a, 25, 14) + 1;
+        }
+    }
+
+    if (highest_level == 0) {
+        return;
+    }
+
+    llc_shift = log2_uint_ceil(sharing);
+    llc_shift_valid = true;
+    LTRACEF("L%u is the last level cache, shared by %u apic ids\n", highest_level, sharing);
 }
 
 static void modern_intel_topology_init() {
@@ -179,3 +229,22 @@ void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t* topo) {
     topo->core_id = (apic_id & core_mask) >> core_shift;
     topo->smt_id = apic_id & smt_mask;
 }
+
+void x86_cpu_topology_register(cpu_num_t cpu_num, uint32_t apic_id) {
+    struct cpu_topology_ids ids;
+
+    // everything above the smt id identifies the core
+    ids.core = apic_id & ~smt_mask;
+    if (llc_shift_valid) {
+        ids.llc = apic_id >> llc_shift;
+    } else {
+        ids.llc = apic_id & package_mask;
+    }
+    ids.cluster = apic_id & package_mask;
+
+    // Without parsing the ACPI SRAT, treat each node within a package (or the
+    // package itself) as a NUMA node.
+    ids.node = apic_id & (package_mask | node_mask);
+
+    cpu_topology_register_cpu(cpu_num, &ids);
+}
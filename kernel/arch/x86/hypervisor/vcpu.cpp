@@ -738,6 +738,9 @@ zx_status_t Vcpu::Resume(zx_port_packet_t* packet) {
         // Updates guest system time if the guest subscribed to updates.
         pvclock_update_system_time(&pvclock_state_, guest_->AddressSpace());
 
+        // The PCID of our address space may have changed since the last exit.
+        vmcs.Write(VmcsFieldXX::HOST_CR3, x86_get_cr3());
+
         ktrace(TAG_VCPU_ENTER, 0, 0, 0, 0);
         running_.store(true);
         status = vmx_enter(&vmx_state_);
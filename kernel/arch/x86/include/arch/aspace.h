@@ -44,6 +44,7 @@ private:
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
+    PtFlags accessed_flag() final;
 
     // If true, all mappings will have the global bit set.
     bool use_global_mappings_ = false;
@@ -66,6 +67,8 @@ private:
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return false; }
+    // Accessed flags are not enabled in the EPTP.
+    PtFlags accessed_flag() final { return 0; }
 };
 
 class X86ArchVmAspace final : public ArchVmAspaceInterface {
@@ -85,6 +88,8 @@ public:
     zx_status_t Unmap(vaddr_t vaddr, size_t count, size_t* unmapped) override;
     zx_status_t Protect(vaddr_t vaddr, size_t count, uint mmu_flags) override;
     zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) override;
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                harvest_accessed_fn_t accessed_fn, void* context) override;
 
     vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                      vaddr_t end, uint next_region_mmu_flags,
@@ -95,6 +100,19 @@ public:
     size_t pt_pages() const { return pt_->pages(); }
 
     int active_cpus() { return active_cpus_.load(); }
+    int lazy_cpus() { return lazy_cpus_.load(); }
+
+    // Called before invalidating TLB entries of this aspace, so that CPUs
+    // that may still cache them without running in it, either under its PCID
+    // or because they left it lazily, flush them before running in it again.
+    // CPUs in |targeted|, which the invalidation interrupts, are left out.
+    void MarkStale(int targeted) {
+        stale_cpus_.fetch_or((pcid_cpus_.load() | lazy_cpus_.load()) & ~targeted);
+    }
+
+    // Called by a CPU that was targeted by an invalidation but had already
+    // left the aspace by the time it got there.
+    void MarkCpuStale(int cpu_bit) { stale_cpus_.fetch_or(cpu_bit); }
 
     IoBitmap& io_bitmap() { return io_bitmap_; }
 
@@ -106,6 +124,10 @@ private:
         return (vaddr >= base_ && vaddr <= base_ + size_ - 1);
     }
 
+    // Returns the CR3 value that switches the current CPU to |aspace| under
+    // its PCID, handing it a new one first if needed.
+    static ulong PcidCr3(X86ArchVmAspace* aspace, uint cpu);
+
     fbl::Canary<fbl::magic("VAAS")> canary_;
     IoBitmap io_bitmap_;
 
@@ -129,6 +151,25 @@ private:
     // CPUs that are currently executing in this aspace.
     // Actually an mp_cpu_mask_t, but header dependencies.
     fbl::atomic_int active_cpus_{0};
+
+    // CPUs that are running kernel threads with this aspace's page tables
+    // still loaded, see ContextSwitch().
+    fbl::atomic_int lazy_cpus_{0};
+
+    // Process-context ID tagging this aspace's TLB entries, and the PCID
+    // generation it was handed out in. Both are written with the PCID
+    // allocator's lock held, the PCID first, and are 0 for aspaces that do not
+    // have one yet. They are read without the lock, see PcidCr3().
+    fbl::atomic<uint16_t> pcid_{0};
+    fbl::atomic<uint64_t> pcid_generation_{0};
+
+    // CPUs that have run in this aspace under its current PCID.
+    fbl::atomic_int pcid_cpus_{0};
+
+    // CPUs that have to flush this aspace's TLB entries the next time they
+    // switch to it, because the page tables changed while they were not
+    // running in it.
+    fbl::atomic_int stale_cpus_{0};
 };
 
 using ArchVmAspace = X86ArchVmAspace;
@@ -7,6 +7,7 @@
 #pragma once
 
 #include <arch/x86/feature.h>
+#include <kernel/cpu.h>
 #include <zircon/compiler.h>
 #include <stdint.h>
 
@@ -22,4 +23,7 @@ typedef struct {
 void x86_cpu_topology_init(void);
 void x86_cpu_topology_decode(uint32_t apic_id, x86_cpu_topology_t *topo);
 
+// Describe the cpu with the given apic id to the generic topology model.
+void x86_cpu_topology_register(cpu_num_t cpu_num, uint32_t apic_id);
+
 __END_CDECLS
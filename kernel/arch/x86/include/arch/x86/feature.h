@@ -45,6 +45,7 @@ enum x86_cpuid_leaf_num {
     X86_CPUID_EXT_BASE = 0x80000000,
     X86_CPUID_BRAND = 0x80000002,
     X86_CPUID_ADDR_WIDTH = 0x80000008,
+    X86_CPUID_AMD_CACHE = 0x8000001d,
     X86_CPUID_AMD_TOPOLOGY = 0x8000001e,
 };
 
@@ -16,6 +16,9 @@
 #define X86_CR0_NW                      0x20000000 /* not write-through */
 #define X86_CR0_CD                      0x40000000 /* cache disable */
 #define X86_CR0_PG                      0x80000000 /* enable paging */
+#define X86_CR3_PCID_MASK               0x00000fffUL /* process-context ID */
+#define X86_CR3_BASE_MASK               0x7ffffffffffff000UL /* page table base */
+#define X86_CR3_NOFLUSH                 (1UL << 63) /* keep the PCID's TLB entries */
 #define X86_CR4_PAE                     0x00000020 /* PAE paging */
 #define X86_CR4_PGE                     0x00000080 /* page global enable */
 #define X86_CR4_OSFXSR                  0x00000200 /* os supports fxsave */
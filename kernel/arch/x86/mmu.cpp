@@ -16,7 +16,11 @@
 #include <arch/x86/feature.h>
 #include <arch/x86/mmu.h>
 #include <arch/x86/mmu_mem_types.h>
+#include <kernel/auto_lock.h>
+#include <kernel/cmdline.h>
 #include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
 #include <vm/arch_vm_aspace.h>
 #include <vm/physmap.h>
 #include <vm/pmm.h>
@@ -34,6 +38,32 @@ uint8_t g_paddr_width = 32;
 /* True if the system supports 1GB pages */
 static bool supports_huge_pages = false;
 
+/* True if user address spaces are tagged with process-context IDs */
+static bool use_pcid = false;
+
+/* True if the INVPCID instruction is used for TLB invalidations */
+static bool use_invpcid = false;
+
+/* PCIDs are handed out in generations. Once all of them have been used a new
+ * generation starts, and each CPU flushes the TLB entries of every PCID
+ * before it next switches to a user aspace. PCID 0 is left to the kernel
+ * aspace. */
+static constexpr uint16_t kMaxPcid = X86_CR3_PCID_MASK;
+static SpinLock pcid_lock;
+static fbl::atomic<uint64_t> pcid_generation(1); /* written with pcid_lock held */
+static uint16_t next_pcid TA_GUARDED(pcid_lock) = 1;
+
+/* generation each CPU last flushed its TLB for, only touched by that CPU */
+static uint64_t cpu_pcid_generation[SMP_MAX_CPUS];
+
+/* user aspace each CPU kept loaded while running kernel threads, only
+ * touched by that CPU with interrupts disabled */
+static X86ArchVmAspace* lazy_aspace[SMP_MAX_CPUS];
+
+KCOUNTER(tlb_shootdowns, "kernel.mmu.tlb.shootdowns");
+KCOUNTER(tlb_lazy_returns, "kernel.mmu.tlb.lazy_returns");
+KCOUNTER(tlb_lazy_flushes, "kernel.mmu.tlb.lazy_flushes");
+
 /* top level kernel page tables, initialized in start.S */
 volatile pt_entry_t pml4[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE);
 volatile pt_entry_t pdp[NO_OF_PT_ENTRIES] __ALIGNED(PAGE_SIZE); /* temporary */
@@ -116,10 +146,31 @@ bool x86_mmu_check_paddr(paddr_t paddr) {
     return paddr <= max_paddr;
 }
 
+/* INVPCID invalidation types, see Intel 3A section 4.10.4.1 */
+enum : uint64_t {
+    INVPCID_ADDRESS = 0,
+    INVPCID_SINGLE_CONTEXT = 1,
+    INVPCID_ALL_CONTEXTS_GLOBAL = 2,
+    INVPCID_ALL_CONTEXTS = 3,
+};
+
+static void x86_invpcid(uint64_t type, uint16_t pcid, vaddr_t addr) {
+    struct {
+        uint64_t pcid;
+        uint64_t addr;
+    } desc = {pcid, addr};
+    __asm__ volatile("invpcid %0, %1" ::"m"(desc), "r"(type) : "memory");
+}
+
 /**
  * @brief  invalidate all TLB entries, including global entries
  */
 static void x86_tlb_global_invalidate() {
+    if (use_invpcid) {
+        x86_invpcid(INVPCID_ALL_CONTEXTS_GLOBAL, 0, 0);
+        return;
+    }
+
     /* See Intel 3A section 4.10.4.1 */
     ulong cr4 = x86_get_cr4();
     if (likely(cr4 & X86_CR4_PGE)) {
@@ -131,24 +182,48 @@ static void x86_tlb_global_invalidate() {
 }
 
 /**
- * @brief  invalidate all TLB entries, excluding global entries
+ * @brief  invalidate all TLB entries of the current PCID, excluding global entries
  */
 static void x86_tlb_nonglobal_invalidate() {
+    if (use_invpcid) {
+        x86_invpcid(INVPCID_SINGLE_CONTEXT, x86_get_cr3() & X86_CR3_PCID_MASK, 0);
+        return;
+    }
+
+    /* without X86_CR3_NOFLUSH this drops the current PCID's entries */
     x86_set_cr3(x86_get_cr3());
 }
 
+/**
+ * @brief  invalidate all TLB entries of all PCIDs, excluding global entries
+ */
+static void x86_tlb_all_pcids_invalidate() {
+    if (use_invpcid) {
+        x86_invpcid(INVPCID_ALL_CONTEXTS, 0, 0);
+    } else {
+        x86_tlb_global_invalidate();
+    }
+}
+
 /* Task used for invalidating a TLB entry on each CPU */
 struct TlbInvalidatePage_context {
     ulong target_cr3;
     const PendingTlbInvalidation* pending;
+    X86ArchVmAspace* aspace; // nullptr unless only its CPUs are targeted
 };
 static void TlbInvalidatePage_task(void* raw_context) {
     DEBUG_ASSERT(arch_ints_disabled());
     TlbInvalidatePage_context* context = (TlbInvalidatePage_context*)raw_context;
 
-    ulong cr3 = x86_get_cr3();
+    ulong cr3 = x86_get_cr3() & X86_CR3_BASE_MASK;
     if (context->target_cr3 != cr3 && !context->pending->contains_global) {
-        /* This invalidation doesn't apply to this CPU, ignore it */
+        /* This invalidation doesn't apply to this CPU, ignore it. If the CPU
+         * was targeted because it was running in the aspace, it may have
+         * switched away with entries still cached under the aspace's PCID,
+         * and was not marked stale for that, so mark it now. */
+        if (context->aspace != nullptr) {
+            context->aspace->MarkCpuStale(cpu_num_to_mask(arch_curr_cpu_num()));
+        }
         return;
     }
 
@@ -186,9 +261,9 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
         return;
     }
 
-    ulong cr3 = pt ? pt->phys() : x86_get_cr3();
+    ulong cr3 = pt ? pt->phys() : x86_get_cr3() & X86_CR3_BASE_MASK;
     struct TlbInvalidatePage_context task_context = {
-        .target_cr3 = cr3, .pending = pending,
+        .target_cr3 = cr3, .pending = pending, .aspace = nullptr,
     };
 
     /* Target only CPUs this aspace is active on.  It may be the case that some
@@ -201,10 +276,33 @@ static void x86_tlb_invalidate_page(const X86PageTableBase* pt, PendingTlbInvali
     if (pending->contains_global || pt == nullptr) {
         target = MP_IPI_TARGET_ALL;
     } else {
+        auto aspace = static_cast<X86ArchVmAspace*>(pt->ctx());
+        /* CPUs that ran in the aspace earlier may still hold its entries,
+         * under its PCID or because they left it lazily. Rather than
+         * interrupting them, mark them so they flush when they switch back.
+         * The CPUs active in it are interrupted instead, and are not marked,
+         * so that they don't flush again the next time they switch in. One
+         * that leaves before the interrupt reaches it marks itself. The
+         * active set is loaded again after marking, so that a CPU switching
+         * in concurrently is either targeted or sees the mark. */
         target = MP_IPI_TARGET_MASK;
-        target_mask = static_cast<X86ArchVmAspace*>(pt->ctx())->active_cpus();
+        target_mask = aspace->active_cpus();
+        aspace->MarkStale(target_mask);
+        target_mask |= aspace->active_cpus();
+        task_context.aspace = aspace;
+
+        /* Lazy CPUs still have the page tables loaded, and could walk
+         * through tables about to be freed speculatively. */
+        if (pending->frees_page_tables) {
+            target_mask |= aspace->lazy_cpus();
+        }
+        if (target_mask == 0) {
+            pending->clear();
+            return;
+        }
     }
 
+    kcounter_add(tlb_shootdowns, 1);
     mp_sync_exec(target, target_mask, TlbInvalidatePage_task, &task_context);
     pending->clear();
 }
@@ -310,6 +408,10 @@ void X86PageTableMmu::TlbInvalidate(PendingTlbInvalidation* pending) {
     x86_tlb_invalidate_page(this, pending);
 }
 
+X86PageTableBase::PtFlags X86PageTableMmu::accessed_flag() {
+    return X86_MMU_PG_A;
+}
+
 uint X86PageTableMmu::pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) {
     uint mmu_flags = ARCH_MMU_FLAG_PERM_READ;
 
@@ -465,7 +567,13 @@ void x86_mmu_early_init() {
     LTRACEF("paddr_width %u vaddr_width %u\n", g_paddr_width, g_vaddr_width);
 }
 
-void x86_mmu_init(void) {}
+void x86_mmu_init(void) {
+    use_pcid = x86_feature_test(X86_FEATURE_PCID) &&
+               cmdline_get_bool("kernel.x86.pcid", true);
+    use_invpcid = use_pcid && x86_feature_test(X86_FEATURE_INVPCID);
+
+    LTRACEF("pcid %d invpcid %d\n", use_pcid, use_invpcid);
+}
 
 X86PageTableBase::X86PageTableBase() {
 }
@@ -573,6 +681,23 @@ zx_status_t X86ArchVmAspace::Destroy() {
     canary_.Assert();
     DEBUG_ASSERT(active_cpus_.load() == 0);
 
+    // Make CPUs that left this aspace lazily load the kernel page tables,
+    // before the ones they have loaded are freed.
+    cpu_mask_t lazy_mask = lazy_cpus_.load();
+    if (lazy_mask != 0) {
+        auto leave_lazy = [](void* context) {
+            auto aspace = static_cast<X86ArchVmAspace*>(context);
+            cpu_num_t cpu = arch_curr_cpu_num();
+            if (lazy_aspace[cpu] != aspace) {
+                return;
+            }
+            x86_set_cr3(use_pcid ? kernel_pt_phys | X86_CR3_NOFLUSH : kernel_pt_phys);
+            aspace->lazy_cpus_.fetch_and(~cpu_num_to_mask(cpu));
+            lazy_aspace[cpu] = nullptr;
+        };
+        mp_sync_exec(MP_IPI_TARGET_MASK, lazy_mask, leave_lazy, this);
+    }
+
     if (flags_ & ARCH_ASPACE_FLAG_GUEST) {
         static_cast<X86PageTableEpt*>(pt_)->Destroy(base_, size_);
     } else {
@@ -611,23 +736,105 @@ zx_status_t X86ArchVmAspace::Protect(vaddr_t vaddr, size_t count, uint mmu_flags
     return pt_->ProtectPages(vaddr, count, mmu_flags);
 }
 
+ulong X86ArchVmAspace::PcidCr3(X86ArchVmAspace* aspace, uint cpu) {
+    DEBUG_ASSERT(arch_ints_disabled());
+
+    // Fast path: the aspace already has a PCID from the current generation.
+    // The PCID is published before its generation, so loading the generation
+    // first means the PCID read is at least as new. Reloading both afterwards
+    // catches a rollover that could have handed the aspace a new one in
+    // between.
+    uint64_t generation = pcid_generation.load(fbl::memory_order_acquire);
+    uint64_t aspace_generation = aspace->pcid_generation_.load(fbl::memory_order_acquire);
+    uint16_t pcid = aspace->pcid_.load(fbl::memory_order_relaxed);
+    if (aspace_generation != generation ||
+        aspace->pcid_generation_.load(fbl::memory_order_acquire) != generation ||
+        pcid_generation.load(fbl::memory_order_acquire) != generation) {
+        AutoSpinLockNoIrqSave guard(&pcid_lock);
+
+        generation = pcid_generation.load();
+        if (aspace->pcid_generation_.load() != generation) {
+            if (next_pcid > kMaxPcid) {
+                pcid_generation.store(++generation);
+                next_pcid = 1;
+            }
+            // Nothing is cached under the new PCID on CPUs of this
+            // generation, and the others will flush all PCIDs anyway.
+            aspace->pcid_.store(next_pcid++, fbl::memory_order_relaxed);
+            aspace->pcid_cpus_.store(0);
+            aspace->pcid_generation_.store(generation, fbl::memory_order_release);
+        }
+        pcid = aspace->pcid_.load(fbl::memory_order_relaxed);
+    }
+
+    // The PCIDs this CPU cached entries for may have been handed out again.
+    if (cpu_pcid_generation[cpu] != generation) {
+        x86_tlb_all_pcids_invalidate();
+        cpu_pcid_generation[cpu] = generation;
+    }
+
+    int cpu_bit = cpu_num_to_mask(cpu);
+    aspace->pcid_cpus_.fetch_or(cpu_bit);
+    bool flush = aspace->stale_cpus_.fetch_and(~cpu_bit) & cpu_bit;
+
+    return aspace->pt_phys() | pcid | (flush ? 0 : X86_CR3_NOFLUSH);
+}
+
 void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace* aspace) {
-    cpu_mask_t cpu_bit = cpu_num_to_mask(arch_curr_cpu_num());
-    if (aspace != nullptr) {
-        aspace->canary_.Assert();
-        paddr_t phys = aspace->pt_phys();
-        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
-        x86_set_cr3(phys);
+    cpu_num_t cpu = arch_curr_cpu_num();
+    cpu_mask_t cpu_bit = cpu_num_to_mask(cpu);
+
+    if (aspace == nullptr) {
+        // Kernel threads only use the upper half of the address space, which
+        // all aspaces share, so leave the user aspace's page tables loaded.
+        // Invalidations of it then mark this CPU stale rather than interrupt
+        // it, and switching back to it does not need to load CR3 at all.
+        // Become lazy before becoming inactive, so that invalidations racing
+        // with the switch see this CPU in one of the two sets.
+        DEBUG_ASSERT(old_aspace != nullptr);
+        DEBUG_ASSERT(lazy_aspace[cpu] == nullptr);
+        LTRACEF_LEVEL(3, "leaving aspace %p lazily\n", old_aspace);
+        old_aspace->lazy_cpus_.fetch_or(cpu_bit);
+        old_aspace->active_cpus_.fetch_and(~cpu_bit);
+        lazy_aspace[cpu] = old_aspace;
+
+        // Cleanup io bitmap entries from previous thread.
+        x86_clear_tss_io_bitmap(old_aspace->io_bitmap());
+        return;
+    }
+
+    aspace->canary_.Assert();
+    X86ArchVmAspace* lazy = lazy_aspace[cpu];
+    DEBUG_ASSERT(old_aspace == nullptr || lazy == nullptr);
+    if (old_aspace != nullptr) {
+        old_aspace->active_cpus_.fetch_and(~cpu_bit);
+    }
 
-        if (old_aspace != nullptr) {
-            old_aspace->active_cpus_.fetch_and(~cpu_bit);
+    // Become active before loading CR3 or leaving lazy mode, so that an
+    // invalidation racing with the switch either targets this CPU or marks
+    // it stale before the checks below.
+    aspace->active_cpus_.fetch_or(cpu_bit);
+    if (lazy != nullptr) {
+        lazy->lazy_cpus_.fetch_and(~cpu_bit);
+        lazy_aspace[cpu] = nullptr;
+    }
+
+    if (lazy == aspace) {
+        LTRACEF_LEVEL(3, "returning to aspace %p\n", aspace);
+        kcounter_add(tlb_lazy_returns, 1);
+        if (aspace->stale_cpus_.fetch_and(~cpu_bit) & cpu_bit) {
+            kcounter_add(tlb_lazy_flushes, 1);
+            x86_tlb_nonglobal_invalidate();
         }
-        aspace->active_cpus_.fetch_or(cpu_bit);
     } else {
-        LTRACEF_LEVEL(3, "switching to kernel aspace, pt %#" PRIxPTR "\n", kernel_pt_phys);
-        x86_set_cr3(kernel_pt_phys);
-        if (old_aspace != nullptr) {
-            old_aspace->active_cpus_.fetch_and(~cpu_bit);
+        paddr_t phys = aspace->pt_phys();
+        LTRACEF_LEVEL(3, "switching to aspace %p, pt %#" PRIXPTR "\n", aspace, phys);
+        if (use_pcid) {
+            x86_set_cr3(PcidCr3(aspace, cpu));
+        } else {
+            // Loading CR3 flushes everything the mark asks for.
+            aspace->stale_cpus_.fetch_and(~cpu_bit);
+            x86_set_cr3(phys);
         }
     }
 
@@ -636,8 +843,7 @@ void X86ArchVmAspace::ContextSwitch(X86ArchVmAspace* old_aspace, X86ArchVmAspace
         x86_clear_tss_io_bitmap(old_aspace->io_bitmap());
 
     // Set the io bitmap for this thread.
-    if (aspace)
-        x86_set_tss_io_bitmap(aspace->io_bitmap());
+    x86_set_tss_io_bitmap(aspace->io_bitmap());
 }
 
 zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) {
@@ -647,6 +853,14 @@ zx_status_t X86ArchVmAspace::Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flag
     return pt_->QueryVaddr(vaddr, paddr, mmu_flags);
 }
 
+zx_status_t X86ArchVmAspace::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                             harvest_accessed_fn_t accessed_fn, void* context) {
+    if (!IsValidVaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+
+    return pt_->HarvestAccessed(vaddr, count, accessed_fn, context);
+}
+
 void x86_mmu_percpu_init(void) {
     ulong cr0 = x86_get_cr0();
     /* Set write protect bit in CR0*/
@@ -661,6 +875,9 @@ void x86_mmu_percpu_init(void) {
         cr4 |= X86_CR4_SMEP;
     if (x86_feature_test(X86_FEATURE_SMAP))
         cr4 |= X86_CR4_SMAP;
+    /* CR3 still holds PCID 0 here, as enabling PCIDs requires */
+    if (x86_feature_test(X86_FEATURE_PCID))
+        cr4 |= X86_CR4_PCIDE;
     x86_set_cr4(cr4);
 
     // Set NXE bit in X86_MSR_IA32_EFER.
@@ -87,8 +87,10 @@ zx_status_t x86_allocate_ap_structures(uint32_t* apic_ids, uint8_t cpu_count) {
         ap_percpus[apic_idx].cpu_num = apic_idx + 1;
         ap_percpus[apic_idx].apic_id = apic_ids[i];
         ap_percpus[apic_idx].direct = &ap_percpus[apic_idx];
+        x86_cpu_topology_register(apic_idx + 1, apic_ids[i]);
         apic_idx++;
     }
+    x86_cpu_topology_register(0, bootstrap_ap);
 
     x86_num_cpus = cpu_count;
     return ZX_OK;
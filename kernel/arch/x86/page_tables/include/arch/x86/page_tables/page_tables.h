@@ -41,6 +41,8 @@ struct PendingTlbInvalidation {
     bool full_shootdown = false;
     // If true, at least one enqueued entry was for a global page.
     bool contains_global = false;
+    // If true, paging structures are freed once the invalidation is done.
+    bool frees_page_tables = false;
     // Number of valid elements in |item|
     uint count = 0;
     // List of addresses queued for invalidation
@@ -91,6 +93,11 @@ public:
 
     zx_status_t QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags);
 
+    // Calls |accessed_fn| for each accessed page in the range and clears the
+    // accessed bits, see ArchVmAspaceInterface::HarvestAccessed().
+    zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                harvest_accessed_fn_t accessed_fn, void* context);
+
 protected:
     // Initialize an empty page table, assigning this given context to it.
     zx_status_t Init(void* ctx);
@@ -124,6 +131,9 @@ protected:
     // Returns true if a cache flush is necessary for pagetable changes to be
     // visible.
     virtual bool needs_cache_flushes() = 0;
+    // Returns the flag the processor sets in terminal entries when a page is
+    // accessed, or 0 if accessed flags are not in use.
+    virtual PtFlags accessed_flag() = 0;
 
     // Pointer to the translation table.
     paddr_t phys_ = 0;
@@ -172,6 +182,10 @@ private:
                              enum PageTableLevel* ret_level,
                              volatile pt_entry_t** mapping) TA_REQ(lock_);
 
+    void HarvestAccessedMapping(volatile pt_entry_t* table, PageTableLevel level,
+                                vaddr_t vaddr, vaddr_t end, PtFlags accessed,
+                                harvest_accessed_fn_t accessed_fn, void* context) TA_REQ(lock_);
+
     zx_status_t SplitLargePage(PageTableLevel level, vaddr_t vaddr,
                                volatile pt_entry_t* pte, ConsistencyManager* cm) TA_REQ(lock_);
 
@@ -109,6 +109,7 @@ void PendingTlbInvalidation::clear() {
     count = 0;
     full_shootdown = false;
     contains_global = false;
+    frees_page_tables = false;
 }
 
 PendingTlbInvalidation::~PendingTlbInvalidation() {
@@ -227,6 +228,7 @@ void X86PageTableBase::ConsistencyManager::Finish() {
         // invalidations.
         mb();
     }
+    tlb_.frees_page_tables = !list_is_empty(&to_free_);
     pt_->TlbInvalidate(&tlb_);
     pt_ = nullptr;
 }
@@ -1020,6 +1022,73 @@ zx_status_t X86PageTableBase::QueryVaddr(vaddr_t vaddr, paddr_t* paddr, uint* mm
     return ZX_OK;
 }
 
+/**
+ * @brief Report and clear the accessed bits of the terminal entries in a range
+ *
+ * @param table The paging structure for |level| covering the range
+ * @param vaddr The start of the range
+ * @param end The end of the range, exclusive
+ * @param accessed The accessed bit used by this type of page table
+ */
+void X86PageTableBase::HarvestAccessedMapping(volatile pt_entry_t* table, PageTableLevel level,
+                                              vaddr_t vaddr, vaddr_t end, PtFlags accessed,
+                                              harvest_accessed_fn_t accessed_fn, void* context) {
+    const size_t ps = page_size(level);
+    while (vaddr < end) {
+        // the part of the range covered by the entry for vaddr
+        const size_t len = ps - (vaddr & (ps - 1));
+        const vaddr_t chunk_end = (end - vaddr > len) ? vaddr + len : end;
+
+        volatile pt_entry_t* e = table + vaddr_to_index(level, vaddr);
+        pt_entry_t pt_val = *e;
+        if (!IS_PAGE_PRESENT(pt_val)) {
+            vaddr = chunk_end;
+            continue;
+        }
+
+        if (level != PT_L && !IS_LARGE_PAGE(pt_val)) {
+            HarvestAccessedMapping(get_next_table_from_entry(pt_val), lower_level(level),
+                                   vaddr, chunk_end, accessed, accessed_fn, context);
+            vaddr = chunk_end;
+            continue;
+        }
+
+        if (pt_val & accessed) {
+            // The processor sets the bit without the lock, so clear it
+            // atomically. The TLB is not flushed: a stale entry only hides
+            // accesses until it is evicted, which at worst ages a page early.
+            __atomic_fetch_and(e, ~accessed, __ATOMIC_RELAXED);
+
+            paddr_t pa = paddr_from_pte(level, pt_val) + (vaddr & (ps - 1));
+            for (; vaddr < chunk_end; vaddr += PAGE_SIZE, pa += PAGE_SIZE)
+                accessed_fn(context, vaddr, pa);
+        }
+        vaddr = chunk_end;
+    }
+}
+
+zx_status_t X86PageTableBase::HarvestAccessed(vaddr_t vaddr, size_t count,
+                                              harvest_accessed_fn_t accessed_fn, void* context) {
+    canary_.Assert();
+
+    LTRACEF("aspace %p, vaddr %#" PRIxPTR ", count %#zx\n", this, vaddr, count);
+
+    const PtFlags accessed = accessed_flag();
+    if (accessed == 0)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!check_vaddr(vaddr))
+        return ZX_ERR_INVALID_ARGS;
+    if (count == 0)
+        return ZX_OK;
+
+    fbl::AutoLock a(&lock_);
+
+    HarvestAccessedMapping(virt_, top_level(), vaddr, vaddr + count * PAGE_SIZE, accessed,
+                           accessed_fn, context);
+    return ZX_OK;
+}
+
 void X86PageTableBase::Destroy(vaddr_t base, size_t size) {
     canary_.Assert();
 
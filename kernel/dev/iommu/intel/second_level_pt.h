@@ -34,6 +34,8 @@ private:
     void TlbInvalidate(PendingTlbInvalidation* pending) final;
     uint pt_flags_to_mmu_flags(PtFlags flags, PageTableLevel level) final;
     bool needs_cache_flushes() final { return needs_flushes_; }
+    // Accessed flags are not used for device mappings.
+    PtFlags accessed_flag() final { return 0; }
 
     IommuImpl* iommu_;
     DeviceContext* parent_;
@@ -0,0 +1,38 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <kernel/cpu.h>
+#include <stdint.h>
+#include <zircon/compiler.h>
+
+__BEGIN_CDECLS
+
+// A simple model of how cpus relate to each other, used by the scheduler to
+// keep threads close to their caches.
+//
+// The architecture layer describes each cpu as it is enumerated by handing
+// over a set of ids, one per level of the hierarchy. Two cpus share a level
+// if they have the same id at that level; the values carry no other meaning.
+// Cpus that have not been described only share each level with themselves.
+struct cpu_topology_ids {
+    uint32_t core;    // hardware threads (SMT siblings) of a single core
+    uint32_t llc;     // cpus sharing the last level cache
+    uint32_t cluster; // cluster (arm64) or package (x86)
+    uint32_t node;    // NUMA node
+};
+
+// Describe |cpu|. Must be called during boot before the cpu starts scheduling.
+void cpu_topology_register_cpu(cpu_num_t cpu, const struct cpu_topology_ids* ids);
+
+// Masks of the cpus sharing a given level with |cpu|, including |cpu| itself.
+cpu_mask_t cpu_topology_smt_mask(cpu_num_t cpu);
+cpu_mask_t cpu_topology_llc_mask(cpu_num_t cpu);
+cpu_mask_t cpu_topology_cluster_mask(cpu_num_t cpu);
+cpu_mask_t cpu_topology_node_mask(cpu_num_t cpu);
+
+__END_CDECLS
@@ -18,8 +18,11 @@
 __BEGIN_CDECLS
 
 struct percpu {
-    // per cpu timer queue
+    // per cpu timer queue, sorted by scheduled time, and a search tree over
+    // the same timers, both protected by timer_lock
+    spin_lock_t timer_lock;
     struct list_node timer_queue;
+    struct timer* timer_tree;
 
     // per cpu preemption timer
     timer_t preempt_timer;
@@ -28,14 +31,34 @@ struct percpu {
     struct list_node run_queue[NUM_PRIORITIES];
     uint32_t run_queue_bitmap;
 
+    // number of threads in the run queue. written with thread_lock held,
+    // read without it for statistics
+    volatile uint32_t run_queue_len;
+
+    // queues for the fair and deadline scheduling classes. the fair queue is sorted by virtual runtime and the
+    // deadline queue by absolute deadline. deadline threads that ran out of
+    // budget wait in the throttled queue, sorted by the start of their next
+    // period, until the replenish timer puts them back.
+    struct list_node fair_queue;
+    zx_duration_t fair_min_vruntime;
+    struct list_node deadline_queue;
+    struct list_node deadline_throttled_queue;
+    timer_t deadline_replenish_timer;
+
     // thread/cpu level statistics
     struct cpu_stats stats;
 
+    // written with thread_lock held, by this cpu except for queue_len, which
+    // is written by whichever cpu inserts into the run queue
+    struct sched_stats sched_stats;
+
     // per cpu idle thread
     thread_t idle_thread;
 
     // kernel counters arena
     int64_t* counters;
+    // kernel counter histograms arena, KCOUNTER_HISTOGRAM_BUCKETS per histogram
+    int64_t* counter_histograms;
 
     // dpc context
     list_node_t dpc_list;
@@ -30,10 +30,26 @@ void sched_migrate(thread_t* t) TA_REQ(thread_lock);
 // pri should be <= MAX_PRIORITY, negative values disable priority inheritance.
 void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
 
+// set the priority a thread inherits from user space threads blocked on futexes it owns,
+// raising or lowering it. negative values disable it.
+void sched_inherit_user_priority(thread_t* t, int pri, bool* local_resched) TA_REQ(thread_lock);
+
 // set the priority of a thread and reset the boost value. This function might reschedule.
 // pri should be 0 <= to <= MAX_PRIORITY.
 void sched_change_priority(thread_t* t, int pri) TA_REQ(thread_lock);
 
+// move a thread into the fair class with the given weight. This function might reschedule.
+void sched_set_fair(thread_t* t, uint32_t weight) TA_REQ(thread_lock);
+
+// move a thread into the deadline class, reserving |capacity| of every |period|.
+// returns ZX_ERR_NO_RESOURCES if the reservation would overcommit the cpus.
+// This function might reschedule.
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity,
+                               zx_duration_t period) TA_REQ(thread_lock);
+
+// release the scheduler resources reserved by a thread that is exiting
+void sched_exit_thread(thread_t* t) TA_REQ(thread_lock);
+
 // return true if the thread was placed on the current cpu's run queue
 // this usually means the caller should locally reschedule soon
 bool sched_unblock(thread_t* t) __WARN_UNUSED_RESULT TA_REQ(thread_lock);
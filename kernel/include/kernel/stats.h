@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 #pragma once
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <zircon/compiler.h>
 #include <zircon/types.h>
@@ -32,6 +33,40 @@ struct cpu_stats {
     ulong generic_ipis;
 };
 
+// number of buckets in each of the scheduler's histograms
+#define SCHED_STATS_BUCKETS 16
+
+// per cpu scheduler histograms and counters, kept all the time
+//
+// Entry 0 of a histogram counts values below 1, entry i values in
+// [2^(i-1), 2^i), and the last entry all the larger values.
+struct sched_stats {
+    // time from a thread being woken up to it running, in microseconds
+    ulong wakeup_latency[SCHED_STATS_BUCKETS];
+    // how long a thread ran before it was switched out, in microseconds
+    ulong run_time[SCHED_STATS_BUCKETS];
+    // threads already in the run queue when another is added to it
+    ulong queue_len[SCHED_STATS_BUCKETS];
+
+    // switches away from a thread that was preempted, rather than one that
+    // blocked or yielded
+    ulong involuntary_switches;
+
+    // switches to a thread that last ran on another cpu, and those of them
+    // where the other cpu is under a different last level cache
+    ulong migrations;
+    ulong migrations_cross_llc;
+
+    // when the running thread was switched in, and whether it is yielding
+    zx_time_t switch_time;
+    bool yielding;
+};
+
+static inline uint sched_stats_bucket(uint64_t value) {
+    uint bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return bucket < SCHED_STATS_BUCKETS ? bucket : SCHED_STATS_BUCKETS - 1;
+}
+
 __END_CDECLS
 
 // include after the cpu_stats definition above, since it is part of the percpu structure
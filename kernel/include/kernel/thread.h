@@ -87,6 +87,8 @@ typedef struct thread {
     enum thread_state state;
     zx_time_t last_started_running;
     zx_duration_t remaining_time_slice;
+    // when the thread was last woken up, 0 once it has run since
+    zx_time_t wakeup_time;
     unsigned int flags;
     unsigned int signals;
 
@@ -100,12 +102,36 @@ typedef struct thread {
     // priority_boost is a signed value that is moved around within a range by the scheduler.
     // inherited_priority is temporarily set to >0 when inheriting a priority from another
     // thread blocked on a locking primitive this thread holds. -1 means no inherit.
-    // effective_priority is MAX(base_priority + priority boost, inherited_priority) and is
-    // the working priority for run queue decisions.
+    // user_inherited_priority is the same, but for user space threads blocked on futexes
+    // this thread owns. It is kept apart so that releasing a kernel mutex doesn't drop it.
+    // effective_priority is MAX(base_priority + priority boost, inherited_priority,
+    // user_inherited_priority) and is the working priority for run queue decisions.
     int effec_priority;
     int base_priority;
     int priority_boost;
     int inherited_priority;
+    int user_inherited_priority;
+
+    // scheduling class, one of SCHED_CLASS_*. threads in the fair and deadline
+    // classes are kept in their own per cpu queues instead of the priority run
+    // queues; see sched.cpp for how the classes are ordered.
+    int sched_class;
+
+    // fair class: relative weight and the weighted runtime used to order the
+    // fair queue. the runtime is absolute while the thread is in a fair queue
+    // and relative to the queue's minimum otherwise.
+    uint32_t fair_weight;
+    zx_duration_t fair_vruntime;
+
+    // deadline class: the thread is guaranteed |deadline_capacity| of runtime
+    // in every |deadline_period|. |deadline_abs| is the end of the current
+    // period and |deadline_budget| what is left of the capacity within it. a
+    // thread that exhausts its budget is throttled until the next period.
+    zx_duration_t deadline_capacity;
+    zx_duration_t deadline_period;
+    zx_time_t deadline_abs;
+    zx_duration_t deadline_budget;
+    bool deadline_throttled;
 
     // current cpu the thread is either running on or in the ready queue, undefined otherwise
     cpu_num_t curr_cpu;
@@ -217,6 +243,14 @@ typedef struct thread {
 #define DEFAULT_PRIORITY (NUM_PRIORITIES / 2)
 #define HIGH_PRIORITY ((NUM_PRIORITIES / 4) * 3)
 
+// scheduling classes
+#define SCHED_CLASS_PRIORITY 0 // strict priority round robin, the default
+#define SCHED_CLASS_FAIR 1     // weighted fair queuing
+#define SCHED_CLASS_DEADLINE 2 // earliest deadline first with a bandwidth reservation
+
+// weight of a fair thread that should get the same share as a default one
+#define FAIR_WEIGHT_DEFAULT (1024u)
+
 // stack size
 #ifdef CUSTOM_DEFAULT_STACK_SIZE
 #define DEFAULT_STACK_SIZE CUSTOM_DEFAULT_STACK_SIZE
@@ -234,6 +268,14 @@ void thread_construct_first(thread_t* t, const char* name);
 thread_t* thread_create_idle_thread(uint cpu_num);
 void thread_set_name(const char* name);
 void thread_set_priority(thread_t* t, int priority);
+
+// move the thread into the fair class with the given relative weight
+void thread_set_fair_weight(thread_t* t, uint32_t weight);
+
+// move the thread into the deadline class, reserving |capacity| of runtime in
+// every |period|. fails with ZX_ERR_NO_RESOURCES if the reservation does not
+// fit in the remaining system bandwidth.
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t period);
 void thread_set_user_callback(thread_t* t, thread_user_callback_t cb);
 thread_t* thread_create(const char* name, thread_start_routine entry, void* arg, int priority, size_t stack_size);
 thread_t* thread_create_etc(thread_t* t, const char* name, thread_start_routine entry, void* arg, int priority, void* stack, void* unsafe_stack, size_t stack_size, thread_trampoline_routine alt_trampoline);
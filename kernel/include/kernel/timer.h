@@ -40,6 +40,15 @@ typedef struct timer {
 
     volatile int active_cpu; // <0 if inactive
     volatile bool cancel;    // true if cancel is pending
+
+    // The cpu whose timer_lock guards this timer, <0 if it was never set.
+    volatile int cpu;
+
+    // Links in the search tree over the cpu's timer queue.
+    struct timer* tree_parent;
+    struct timer* tree_left;
+    struct timer* tree_right;
+    uint32_t tree_priority;
 } timer_t;
 
 #define TIMER_INITIAL_VALUE(t)              \
@@ -52,6 +61,11 @@ typedef struct timer {
         .arg = NULL,                        \
         .active_cpu = -1,                   \
         .cancel = false,                    \
+        .cpu = -1,                          \
+        .tree_parent = NULL,                \
+        .tree_left = NULL,                  \
+        .tree_right = NULL,                 \
+        .tree_priority = 0,                 \
     }
 
 // Rules for Timers:
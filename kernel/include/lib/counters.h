@@ -20,8 +20,9 @@ __BEGIN_CDECLS
 //   - after N seconds how many outstanding <x> things are allocated?
 //   - up to this point has <Y> ever happened?
 //
-// Currently the only query interface to the counters is the console
-// k counters command. Issue 'k counters help' to learn what it can do.
+// The counters can be queried with the console k counters command (issue
+// 'k counters help' to learn what it can do), and user space can take a
+// snapshot of all of them with zx_kcounter_snapshot().
 //
 // Kernel counters public API:
 // 1- define a new counter.
@@ -30,12 +31,19 @@ __BEGIN_CDECLS
 // 2- counters start at zero, increment the counter:
 //      kcounter_add(counter_name, 1);
 //
+// 3- or define a histogram, to see how a value is distributed:
+//      KCOUNTER_HISTOGRAM(histogram_name, "<histogram name>");
+//
+// 4- and count a value in it:
+//      kcounter_histogram_add(histogram_name, value);
 //
 // Naming the counters
 // The naming convention is "kernel.subsystem.thing_or_action"
 // for example "kernel.dispatcher.destroy"
 //             "kernel.exceptions.fpu"
 //             "kernel.handles.new"
+// Histograms of times should have the unit at the end of the name,
+// for example "kernel.syscalls.latency_ns".
 //
 //  Reading the counters in code
 //  Don't. The counters are mantained in a per-cpu arena and
@@ -93,4 +101,61 @@ static inline void kcounter_add(const struct k_counter_desc* var,
 #endif
 }
 
+// The number of buckets in each histogram.  Entry 0 counts values below 1,
+// entry i values of at least 2^(i-1) and less than 2^i, and the last entry
+// all the larger values; in nanoseconds, that last one starts at about a
+// second.  kernel.ld knows this number.
+#define KCOUNTER_HISTOGRAM_BUCKETS 32
+
+struct k_counter_histogram_desc {
+    const char* name;
+};
+static_assert(sizeof(struct k_counter_histogram_desc) == sizeof(int64_t),
+              "the kernel.ld ASSERT knows that these sizes match");
+
+// Histograms are laid out just as the counters are, in their own sections:
+// each kcounter_histogram_arena_* array reserves a histogram's worth of
+// slots per CPU, and kernel.ld gathers them into kcounter_histograms_arena.
+#define KCOUNTER_HISTOGRAM(var, name)                                           \
+    __USED int64_t kcounter_histogram_arena_##var                               \
+        [SMP_MAX_CPUS * KCOUNTER_HISTOGRAM_BUCKETS] __asm__("kcounterhist." name); \
+    __USED __SECTION("kcounthistdesc." name)                                    \
+    static const struct k_counter_histogram_desc var[] = { { name } }
+
+extern const struct k_counter_histogram_desc kcounthistdesc_begin[], kcounthistdesc_end[];
+
+static inline size_t kcounter_histogram_index(const struct k_counter_histogram_desc* var) {
+    return var - kcounthistdesc_begin;
+}
+
+static inline uint kcounter_histogram_bucket(uint64_t value) {
+    uint bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    return bucket < KCOUNTER_HISTOGRAM_BUCKETS ? bucket : KCOUNTER_HISTOGRAM_BUCKETS - 1;
+}
+
+// Like kcounter_add(), this is only exact while the caller can't be moved
+// to another cpu.
+static inline void kcounter_histogram_add(const struct k_counter_histogram_desc* var,
+                                          uint64_t value) {
+    int64_t* slot = &get_local_percpu()->counter_histograms[
+        kcounter_histogram_index(var) * KCOUNTER_HISTOGRAM_BUCKETS +
+        kcounter_histogram_bucket(value)];
+#if defined(__aarch64__)
+    atomic_add_64_relaxed(slot, 1);
+#else
+    *slot += 1;
+#endif
+}
+
 __END_CDECLS
+
+#ifdef __cplusplus
+#include <fbl/ref_ptr.h>
+
+class VmObject;
+
+// Creates a VMO holding the current values of all the counters and
+// histograms, summed over the cpus, in the layout described in
+// <zircon/syscalls/kcounter.h>.
+zx_status_t kcounter_snapshot(fbl::RefPtr<VmObject>* vmo);
+#endif // __cplusplus
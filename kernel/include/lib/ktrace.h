@@ -23,13 +23,15 @@ struct ktrace_probe_info {
     uint32_t num;
 } __ALIGNED(16); // align on multiple of 16 to match linker packing of the ktrace_probe section
 
-void* ktrace_open(uint32_t tag);
+// Appends a record with the common header, followed by |len| bytes from
+// |args|, to the current CPU's buffer.  The size of the record comes from
+// |tag|, and whatever |args| does not cover is zeroed.  Returns false if the
+// record was not written.
+bool ktrace_record(uint32_t tag, const void* args, size_t len);
 void ktrace_tiny(uint32_t tag, uint32_t arg);
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {
-    uint32_t* data = (uint32_t*) ktrace_open(tag);
-    if (data) {
-        data[0] = a; data[1] = b; data[2] = c; data[3] = d;
-    }
+    const uint32_t args[4] = { a, b, c, d };
+    ktrace_record(tag, args, sizeof(args));
 }
 
 static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_t d) {
@@ -43,24 +45,19 @@ static inline void ktrace_ptr(uint32_t tag, const void* ptr, uint32_t c, uint32_
 
 #define ktrace_probe0(_name) do {                               \
     _ktrace_probe_prologue(_name);                              \
-    ktrace_open(TAG_PROBE_16(info.num));                        \
+    ktrace_record(TAG_PROBE_16(info.num), NULL, 0);             \
 } while (0)
 
 #define ktrace_probe2(_name,arg0,arg1) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint32_t* args = (uint32_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      args[0] = arg0;                                        \
-      args[1] = arg1;                                        \
-    }                                                        \
+    const uint32_t args[2] = { (uint32_t)(arg0), (uint32_t)(arg1) }; \
+    ktrace_record(TAG_PROBE_24(info.num), args, sizeof(args)); \
 } while (0)
 
 #define ktrace_probe64(_name,arg) do {                  \
     _ktrace_probe_prologue(_name);                           \
-    uint64_t* args = (uint64_t*)ktrace_open(TAG_PROBE_24(info.num));    \
-    if (args) {                                              \
-      *args = arg;                                           \
-    }                                                        \
+    const uint64_t args = (uint64_t)(arg);                   \
+    ktrace_record(TAG_PROBE_24(info.num), &args, sizeof(args)); \
 } while (0)
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always);
@@ -71,7 +68,7 @@ static inline void ktrace_name(uint32_t tag, uint32_t id, uint32_t arg, const ch
 ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len);
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr);
 #else
-static inline void* ktrace_open(uint32_t tag) { return NULL; }
+static inline bool ktrace_record(uint32_t tag, const void* args, size_t len) { return false; }
 static inline void ktrace_tiny(uint32_t tag, uint32_t arg) {}
 static inline void ktrace(uint32_t tag, uint32_t a, uint32_t b, uint32_t c, uint32_t d) {}
 static inline void ktrace_probe0(const char* name) {}
@@ -97,3 +94,22 @@ void ktrace_report_live_threads(void);
 void ktrace_report_live_processes(void);
 
 __END_CDECLS
+
+#ifdef __cplusplus
+#include <fbl/ref_ptr.h>
+
+class Dispatcher;
+
+// Rewinds the trace and starts tracing the groups in |grpmask| in streaming
+// mode.  Returns the VMO holding the trace buffers, and the event that is
+// signaled when they need draining.
+#if WITH_LIB_KTRACE
+zx_status_t ktrace_stream(uint32_t grpmask, fbl::RefPtr<Dispatcher>* vmo,
+                          fbl::RefPtr<Dispatcher>* event);
+#else
+static inline zx_status_t ktrace_stream(uint32_t grpmask, fbl::RefPtr<Dispatcher>* vmo,
+                                        fbl::RefPtr<Dispatcher>* event) {
+    return ZX_ERR_NOT_SUPPORTED;
+}
+#endif
+#endif // __cplusplus
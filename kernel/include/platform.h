@@ -46,6 +46,12 @@ zx_ticks_t ticks_per_second(void);
 /* high-precision timer current_ticks */
 zx_ticks_t current_ticks(void);
 
+/* if current_time() is derived from the same counter that user mode reads
+ * for zx_ticks_get(), set ns_per_tick to the factor that converts one to
+ * the other and return true */
+struct fp_32_64;
+bool platform_usermode_ticks_to_time(struct fp_32_64* ns_per_tick);
+
 /* super early platform initialization, before almost everything */
 void platform_early_init(void);
 
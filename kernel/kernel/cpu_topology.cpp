@@ -0,0 +1,98 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/cpu_topology.h>
+
+#include <debug.h>
+#include <lib/console.h>
+#include <stdio.h>
+
+enum topology_level {
+    LEVEL_SMT,
+    LEVEL_LLC,
+    LEVEL_CLUSTER,
+    LEVEL_NODE,
+    NUM_LEVELS,
+};
+
+static struct cpu_topology_ids cpu_ids[SMP_MAX_CPUS];
+static cpu_mask_t registered_cpus;
+
+// For each level, the other cpus that share it with a given cpu. Written
+// only during boot, so readers do not need any locking.
+static cpu_mask_t level_masks[NUM_LEVELS][SMP_MAX_CPUS];
+
+static uint32_t id_at_level(const struct cpu_topology_ids* ids, int level) {
+    switch (level) {
+    case LEVEL_SMT:
+        return ids->core;
+    case LEVEL_LLC:
+        return ids->llc;
+    case LEVEL_CLUSTER:
+        return ids->cluster;
+    default:
+        return ids->node;
+    }
+}
+
+static cpu_mask_t level_mask(int level, cpu_num_t cpu) {
+    if (!is_valid_cpu_num(cpu))
+        return 0;
+    return level_masks[level][cpu] | cpu_num_to_mask(cpu);
+}
+
+void cpu_topology_register_cpu(cpu_num_t cpu, const struct cpu_topology_ids* ids) {
+    DEBUG_ASSERT(is_valid_cpu_num(cpu));
+    DEBUG_ASSERT(!(registered_cpus & cpu_num_to_mask(cpu)));
+
+    cpu_ids[cpu] = *ids;
+
+    cpu_mask_t others = registered_cpus;
+    while (others) {
+        cpu_num_t other = lowest_cpu_set(others);
+        others &= ~cpu_num_to_mask(other);
+
+        for (int level = 0; level < NUM_LEVELS; level++) {
+            if (id_at_level(&cpu_ids[cpu], level) == id_at_level(&cpu_ids[other], level)) {
+                level_masks[level][cpu] |= cpu_num_to_mask(other);
+                level_masks[level][other] |= cpu_num_to_mask(cpu);
+            }
+        }
+    }
+
+    registered_cpus |= cpu_num_to_mask(cpu);
+}
+
+cpu_mask_t cpu_topology_smt_mask(cpu_num_t cpu) {
+    return level_mask(LEVEL_SMT, cpu);
+}
+
+cpu_mask_t cpu_topology_llc_mask(cpu_num_t cpu) {
+    return level_mask(LEVEL_LLC, cpu);
+}
+
+cpu_mask_t cpu_topology_cluster_mask(cpu_num_t cpu) {
+    return level_mask(LEVEL_CLUSTER, cpu);
+}
+
+cpu_mask_t cpu_topology_node_mask(cpu_num_t cpu) {
+    return level_mask(LEVEL_NODE, cpu);
+}
+
+static int cmd_topology(int argc, const cmd_args* argv, uint32_t flags) {
+    for (cpu_num_t cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
+        if (!(registered_cpus & cpu_num_to_mask(cpu)))
+            continue;
+        printf("cpu %2u: smt %#010x llc %#010x cluster %#010x node %#010x\n", cpu,
+               cpu_topology_smt_mask(cpu), cpu_topology_llc_mask(cpu),
+               cpu_topology_cluster_mask(cpu), cpu_topology_node_mask(cpu));
+    }
+    return 0;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("topology", "dump the cpu topology seen by the scheduler", &cmd_topology)
+STATIC_COMMAND_END(topology);
@@ -20,6 +20,7 @@ MODULE_DEPS := \
 
 MODULE_SRCS := \
 	$(LOCAL_DIR)/cmdline.cpp \
+	$(LOCAL_DIR)/cpu_topology.cpp \
 	$(LOCAL_DIR)/debug.cpp \
 	$(LOCAL_DIR)/dpc.cpp \
 	$(LOCAL_DIR)/event.cpp \
@@ -10,9 +10,11 @@
 #include <debug.h>
 #include <err.h>
 #include <inttypes.h>
+#include <kernel/cpu_topology.h>
 #include <kernel/mp.h>
 #include <kernel/percpu.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <list.h>
 #include <platform.h>
@@ -52,13 +54,46 @@
 // threads get 10ms to run before they use up their time slice and the scheduler is invoked
 #define THREAD_INITIAL_TIME_SLICE ZX_MSEC(10)
 
+// scheduling classes
+//
+// Deadline threads are scheduled earliest deadline first ahead of every other
+// thread, but each may only use its reserved capacity in every period before it
+// is throttled until the next one. Fair threads share a single band that ranks
+// above priority threads at FAIR_PRIORITY and below, and split it by weight, so
+// they never get ahead of threads at the default priority.
+// Everything else is scheduled by priority, round robin within a priority.
+#define FAIR_PRIORITY (DEFAULT_PRIORITY - 1)
+
+// how far behind the queue a waking fair thread may start, so that threads that
+// sleep a lot get some credit without being able to monopolize the cpu
+#define FAIR_SLEEPER_CREDIT THREAD_INITIAL_TIME_SLICE
+
+// the fraction of every cpu that may be reserved by deadline threads, in
+// 1/DEADLINE_BW_ONE units
+#define DEADLINE_BW_ONE (1u << 16)
+#define DEADLINE_BW_LIMIT (DEADLINE_BW_ONE * 3 / 4)
+
 static bool local_migrate_if_needed(thread_t* curr_thread);
+static bool charge_current_thread(thread_t* t);
+
+KCOUNTER(sched_steals, "kernel.sched.steals");
+KCOUNTER(sched_balance_migrations, "kernel.sched.balance_migrations");
+KCOUNTER(sched_migrations, "kernel.sched.migrations");
+KCOUNTER(sched_migrations_cross_llc, "kernel.sched.migrations_cross_llc");
+KCOUNTER(sched_migrations_cross_node, "kernel.sched.migrations_cross_node");
+KCOUNTER(sched_deadline_misses, "kernel.sched.deadline_misses");
+KCOUNTER(sched_deadline_throttles, "kernel.sched.deadline_throttles");
+
+// sum of the bandwidth reserved by all deadline threads, protected by thread_lock
+static uint64_t deadline_reserved_bw;
 
 // compute the effective priority of a thread
 static void compute_effec_priority(thread_t* t) {
     int ep = t->base_priority + t->priority_boost;
     if (t->inherited_priority > ep)
         ep = t->inherited_priority;
+    if (t->user_inherited_priority > ep)
+        ep = t->user_inherited_priority;
 
     DEBUG_ASSERT(ep >= LOWEST_PRIORITY && ep <= HIGHEST_PRIORITY);
 
@@ -73,6 +108,9 @@ static void boost_thread(thread_t* t) {
     if (unlikely(thread_is_real_time_or_idle(t)))
         return;
 
+    if (t->sched_class != SCHED_CLASS_PRIORITY)
+        return;
+
     if (t->priority_boost < MAX_PRIORITY_ADJ &&
         likely((t->base_priority + t->priority_boost) < HIGHEST_PRIORITY)) {
         t->priority_boost++;
@@ -90,6 +128,9 @@ static void deboost_thread(thread_t* t, bool quantum_expiration) {
     if (unlikely(thread_is_real_time_or_idle(t)))
         return;
 
+    if (t->sched_class != SCHED_CLASS_PRIORITY)
+        return;
+
     int boost_floor;
     if (quantum_expiration) {
         // deboost into negative boost
@@ -140,6 +181,23 @@ static cpu_mask_t rand_cpu(cpu_mask_t mask) {
     }
 }
 
+// pick a cpu out of the passed in mask of idle cpus, preferring cpus whose
+// smt siblings are idle as well so the thread gets a whole core to itself
+static cpu_mask_t pick_idle_cpu(cpu_mask_t idle_mask) {
+    const cpu_mask_t all_idle = mp_get_idle_mask();
+
+    cpu_mask_t whole_cores = 0;
+    cpu_mask_t remaining = idle_mask;
+    while (remaining) {
+        cpu_num_t cpu = lowest_cpu_set(remaining);
+        remaining &= ~cpu_num_to_mask(cpu);
+        if ((cpu_topology_smt_mask(cpu) & ~all_idle) == 0)
+            whole_cores |= cpu_num_to_mask(cpu);
+    }
+
+    return rand_cpu(whole_cores ? whole_cores : idle_mask);
+}
+
 // find a cpu to wake up
 static cpu_mask_t find_cpu_mask(thread_t* t) {
     // get the last cpu the thread ran on
@@ -170,9 +228,20 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
             return last_ran_cpu_mask;
         }
 
-        // pick an idle_cpu
         DEBUG_ASSERT((idle_cpu_mask & mp_get_active_mask()) == idle_cpu_mask);
-        return rand_cpu(idle_cpu_mask);
+
+        // prefer an idle cpu that shares a cache with the cpu the thread last ran
+        // on, then one that shares a cache with the waker, then one on the same
+        // node as the last cpu.
+        cpu_mask_t near_mask = idle_cpu_mask & cpu_topology_llc_mask(t->last_cpu);
+        if (near_mask == 0)
+            near_mask = idle_cpu_mask & cpu_topology_llc_mask(arch_curr_cpu_num());
+        if (near_mask == 0)
+            near_mask = idle_cpu_mask & cpu_topology_node_mask(t->last_cpu);
+        if (near_mask == 0)
+            near_mask = idle_cpu_mask;
+
+        return pick_idle_cpu(near_mask);
     }
 
     // no idle cpus in our affinity mask
@@ -191,6 +260,11 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
     if (mask == 0)
         return curr_cpu_mask; // local cpu is the only choice
 
+    // stay within the last cpu's cache domain if it allows any choice
+    cpu_mask_t near_mask = mask & active_cpu_mask & cpu_topology_llc_mask(t->last_cpu);
+    if (near_mask != 0)
+        mask = near_mask;
+
     mask = rand_cpu(mask);
     if (mask == 0)
         return curr_cpu_mask; // local cpu is the only choice
@@ -199,35 +273,99 @@ static cpu_mask_t find_cpu_mask(thread_t* t) {
 }
 
 // run queue manipulation
-static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
-    DEBUG_ASSERT(!list_in_list(&t->queue_node));
 
-    list_add_head(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+// fair threads that inherited a priority above the fair band are queued with
+// the priority threads until the inheritance ends
+static bool in_fair_queue(const thread_t* t, int prio) {
+    return t->sched_class == SCHED_CLASS_FAIR && prio <= FAIR_PRIORITY;
+}
+
+// outside of a fair queue a thread's vruntime is kept relative to the
+// fair_min_vruntime of the last queue it left, and it is rebased onto the
+// queue it is inserted in, so that moving to another cpu neither penalizes nor
+// favors it
+static void insert_in_fair_queue(struct percpu* c, thread_t* t) {
+    t->fair_vruntime += c->fair_min_vruntime;
+
+    zx_duration_t floor = c->fair_min_vruntime - FAIR_SLEEPER_CREDIT;
+    if (t->fair_vruntime < floor)
+        t->fair_vruntime = floor;
+
+    thread_t* entry;
+    list_for_every_entry (&c->fair_queue, entry, thread_t, queue_node) {
+        if (entry->fair_vruntime > t->fair_vruntime) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(&c->fair_queue, &t->queue_node);
+}
 
-    // mark the cpu as busy since the run queue now has at least one item in it
-    mp_set_cpu_busy(cpu);
+// insert a deadline thread into |queue|, which is sorted by deadline_abs
+static void insert_by_deadline(struct list_node* queue, thread_t* t) {
+    thread_t* entry;
+    list_for_every_entry (queue, entry, thread_t, queue_node) {
+        if (entry->deadline_abs > t->deadline_abs) {
+            list_add_before(&entry->queue_node, &t->queue_node);
+            return;
+        }
+    }
+    list_add_tail(queue, &t->queue_node);
 }
 
-static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
+static void insert_in_run_queue(cpu_num_t cpu, thread_t* t, bool head) {
     DEBUG_ASSERT(!list_in_list(&t->queue_node));
+    DEBUG_ASSERT(!t->deadline_throttled);
+
+    struct percpu* c = &percpu[cpu];
 
-    list_add_tail(&percpu[cpu].run_queue[t->effec_priority], &t->queue_node);
-    percpu[cpu].run_queue_bitmap |= (1u << t->effec_priority);
+    c->sched_stats.queue_len[sched_stats_bucket(c->run_queue_len)]++;
+
+    if (t->sched_class == SCHED_CLASS_DEADLINE) {
+        insert_by_deadline(&c->deadline_queue, t);
+    } else if (in_fair_queue(t, t->effec_priority)) {
+        insert_in_fair_queue(c, t);
+    } else {
+        if (head) {
+            list_add_head(&c->run_queue[t->effec_priority], &t->queue_node);
+        } else {
+            list_add_tail(&c->run_queue[t->effec_priority], &t->queue_node);
+        }
+        c->run_queue_bitmap |= (1u << t->effec_priority);
+    }
+    atomic_store_relaxed_u32(&c->run_queue_len, c->run_queue_len + 1);
 
     // mark the cpu as busy since the run queue now has at least one item in it
     mp_set_cpu_busy(cpu);
 }
 
+static void insert_in_run_queue_head(cpu_num_t cpu, thread_t* t) {
+    insert_in_run_queue(cpu, t, true);
+}
+
+static void insert_in_run_queue_tail(cpu_num_t cpu, thread_t* t) {
+    insert_in_run_queue(cpu, t, false);
+}
+
 // remove the thread from the run queue it's in
 static void remove_from_run_queue(thread_t* t, int prio_queue) {
     DEBUG_ASSERT(t->state == THREAD_READY);
     DEBUG_ASSERT(is_valid_cpu_num(t->curr_cpu));
+    DEBUG_ASSERT(!t->deadline_throttled);
+
+    struct percpu* c = &percpu[t->curr_cpu];
 
     list_delete(&t->queue_node);
+    atomic_store_relaxed_u32(&c->run_queue_len, c->run_queue_len - 1);
+
+    if (in_fair_queue(t, prio_queue)) {
+        t->fair_vruntime -= c->fair_min_vruntime;
+        return;
+    }
+    if (t->sched_class == SCHED_CLASS_DEADLINE)
+        return;
 
     // clear the old cpu's queue bitmap if that was the last entry
-    struct percpu* c = &percpu[t->curr_cpu];
     if (list_is_empty(&c->run_queue[prio_queue])) {
         c->run_queue_bitmap &= ~(1u << prio_queue);
     }
@@ -239,24 +377,49 @@ static uint highest_run_queue(const struct percpu* c) {
            (sizeof(c->run_queue_bitmap) * CHAR_BIT - NUM_PRIORITIES);
 }
 
-static thread_t* sched_get_top_thread(cpu_num_t cpu) {
-    // pop the head of the highest priority queue with any threads
-    // queued up on the passed in cpu.
+// pop the next thread to run off of |c|'s queues, or return NULL if they are empty
+static thread_t* pop_top_thread(struct percpu* c) {
+    thread_t* t = list_remove_head_type(&c->deadline_queue, thread_t, queue_node);
+    if (t)
+        return t;
+
+    if (!list_is_empty(&c->fair_queue) &&
+        (c->run_queue_bitmap == 0 || highest_run_queue(c) <= FAIR_PRIORITY)) {
+        t = list_remove_head_type(&c->fair_queue, thread_t, queue_node);
+        if (t->fair_vruntime > c->fair_min_vruntime)
+            c->fair_min_vruntime = t->fair_vruntime;
+        t->fair_vruntime -= c->fair_min_vruntime;
+        return t;
+    }
 
-    struct percpu* c = &percpu[cpu];
     if (likely(c->run_queue_bitmap)) {
         uint highest_queue = highest_run_queue(c);
 
-        thread_t* newthread = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
+        t = list_remove_head_type(&c->run_queue[highest_queue], thread_t, queue_node);
+        DEBUG_ASSERT(t);
+
+        if (list_is_empty(&c->run_queue[highest_queue]))
+            c->run_queue_bitmap &= ~(1u << highest_queue);
+        return t;
+    }
 
-        DEBUG_ASSERT(newthread);
+    return NULL;
+}
+
+static thread_t* sched_get_top_thread(cpu_num_t cpu) {
+    // pop the head of the highest ranked queue with any threads
+    // queued up on the passed in cpu.
+
+    struct percpu* c = &percpu[cpu];
+
+    thread_t* newthread = pop_top_thread(c);
+    if (likely(newthread)) {
         DEBUG_ASSERT_MSG(newthread->cpu_affinity & cpu_num_to_mask(cpu),
                          "thread %p name %s, aff %#x cpu %u\n", newthread, newthread->name,
                          newthread->cpu_affinity, cpu);
         DEBUG_ASSERT(newthread->curr_cpu == cpu);
 
-        if (list_is_empty(&c->run_queue[highest_queue]))
-            c->run_queue_bitmap &= ~(1u << highest_queue);
+        atomic_store_relaxed_u32(&c->run_queue_len, c->run_queue_len - 1);
 
         LOCAL_KTRACE2("sched_get_top", newthread->priority_boost, newthread->base_priority);
 
@@ -267,11 +430,180 @@ static thread_t* sched_get_top_thread(cpu_num_t cpu) {
     return &c->idle_thread;
 }
 
+// load balancing
+//
+// Threads are placed on a cpu when they are woken up, but nothing else moves
+// them afterwards. To keep queues from piling up on a few cpus after a burst,
+// a cpu that is about to go idle tries to steal a ready thread from the cpu
+// with the longest run queue, and a thread that uses up its time slice is
+// pushed to a less loaded cpu if one exists. Both prefer cpus that share the
+// last level cache.
+
+// number of threads that are runnable on |cpu|, including the one running
+static uint32_t cpu_load(cpu_num_t cpu) {
+    uint32_t load = atomic_load_relaxed_u32(&percpu[cpu].run_queue_len);
+    if (!mp_is_cpu_idle(cpu))
+        load++;
+    return load;
+}
+
+// racily find the cpu in |candidates| with the most queued threads. a cpu that
+// is still running its idle thread has been kicked to run its queue and is skipped.
+static cpu_num_t find_busiest_cpu(cpu_mask_t candidates) TA_REQ(thread_lock) {
+    cpu_num_t busiest = INVALID_CPU;
+    uint32_t busiest_len = 0;
+    while (candidates) {
+        cpu_num_t i = lowest_cpu_set(candidates);
+        candidates &= ~cpu_num_to_mask(i);
+
+        uint32_t len = atomic_load_relaxed_u32(&percpu[i].run_queue_len);
+        if (len > busiest_len && percpu[i].idle_thread.state != THREAD_RUNNING) {
+            busiest = i;
+            busiest_len = len;
+        }
+    }
+    return busiest;
+}
+
+// return the first thread in |queue| that may run on the cpus in |cpu_mask|, or NULL
+static thread_t* first_stealable_thread(struct list_node* queue, cpu_mask_t cpu_mask) {
+    thread_t* t;
+    list_for_every_entry (queue, t, thread_t, queue_node) {
+        if ((t->cpu_affinity & cpu_mask) != 0 && !thread_is_idle(t))
+            return t;
+    }
+    return NULL;
+}
+
+// pull a ready thread that may run on |cpu| out of the busiest other cpu's run
+// queue, or return NULL if there is nothing worth stealing.
+static thread_t* steal_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
+    if (unlikely(!mp_is_cpu_active(cpu)))
+        return NULL;
+
+    const cpu_mask_t cpu_mask = cpu_num_to_mask(cpu);
+    const cpu_mask_t candidates = mp_get_active_mask() & ~cpu_mask;
+
+    // prefer victims whose threads are still warm in a cache we share
+    cpu_num_t victim = find_busiest_cpu(candidates & cpu_topology_llc_mask(cpu));
+    if (victim == INVALID_CPU)
+        victim = find_busiest_cpu(candidates & ~cpu_topology_llc_mask(cpu));
+    if (victim == INVALID_CPU)
+        return NULL;
+
+    // take the thread that is allowed to run here that the victim would run
+    // first, looking at its queues in the order pop_top_thread() does
+    struct percpu* c = &percpu[victim];
+
+    int prio = -1; // the priority queue |t| is in, if any
+    thread_t* t = first_stealable_thread(&c->deadline_queue, cpu_mask);
+    bool fair_checked = false;
+    uint32_t bitmap = c->run_queue_bitmap;
+    while (!t && (bitmap || !fair_checked)) {
+        int next = bitmap ? (int)(sizeof(bitmap) * CHAR_BIT - 1 - __builtin_clz(bitmap)) : -1;
+        if (!fair_checked && next <= FAIR_PRIORITY) {
+            fair_checked = true;
+            t = first_stealable_thread(&c->fair_queue, cpu_mask);
+        } else {
+            bitmap &= ~(1u << next);
+            t = first_stealable_thread(&c->run_queue[next], cpu_mask);
+            if (t)
+                prio = next;
+        }
+    }
+    if (!t)
+        return NULL;
+
+    list_delete(&t->queue_node);
+    atomic_store_relaxed_u32(&c->run_queue_len, c->run_queue_len - 1);
+    if (prio >= 0) {
+        if (list_is_empty(&c->run_queue[prio]))
+            c->run_queue_bitmap &= ~(1u << prio);
+    } else if (t->sched_class != SCHED_CLASS_DEADLINE) {
+        // as if it had been popped from the victim's fair queue
+        t->fair_vruntime -= c->fair_min_vruntime;
+    }
+
+    t->curr_cpu = cpu;
+    kcounter_add(sched_steals, 1);
+    LOCAL_KTRACE2("sched_steal", victim, cpu);
+    return t;
+}
+
+// pick the next thread to run on |cpu|, stealing one from another cpu rather
+// than going idle if possible
+static thread_t* sched_pick_next_thread(cpu_num_t cpu) TA_REQ(thread_lock) {
+    thread_t* t = sched_get_top_thread(cpu);
+    if (likely(!thread_is_idle(t)))
+        return t;
+
+    thread_t* stolen = steal_thread(cpu);
+    if (!stolen)
+        return t;
+
+    // the cpu may still be marked idle from when it last ran its idle thread
+    mp_set_cpu_busy(cpu);
+    return stolen;
+}
+
+// called when the current thread has used up its time slice and there are other
+// threads waiting for this cpu. if another cpu in the thread's affinity mask has
+// less work queued, move the thread there instead of the tail of the local queue.
+static bool balance_current_thread(thread_t* curr_thread) TA_REQ(thread_lock) {
+    DEBUG_ASSERT(curr_thread == get_current_thread());
+    DEBUG_ASSERT(curr_thread->state == THREAD_READY);
+
+    const cpu_num_t curr_cpu = arch_curr_cpu_num();
+    uint32_t local_len = atomic_load_relaxed_u32(&percpu[curr_cpu].run_queue_len);
+    if (local_len == 0)
+        return false;
+
+    const cpu_mask_t candidates = curr_thread->cpu_affinity & mp_get_active_mask() &
+                                  ~cpu_num_to_mask(curr_cpu);
+    const cpu_mask_t llc_mask = cpu_topology_llc_mask(curr_cpu);
+
+    // look at the cpus sharing our cache first so they win ties
+    cpu_mask_t search[] = { candidates & llc_mask, candidates & ~llc_mask };
+    cpu_num_t target = INVALID_CPU;
+    uint32_t target_load = local_len;
+    for (cpu_mask_t remaining : search) {
+        while (remaining) {
+            cpu_num_t i = lowest_cpu_set(remaining);
+            remaining &= ~cpu_num_to_mask(i);
+
+            uint32_t load = cpu_load(i);
+            if (load < target_load) {
+                target = i;
+                target_load = load;
+            }
+        }
+    }
+    if (target == INVALID_CPU)
+        return false;
+
+    kcounter_add(sched_balance_migrations, 1);
+    LOCAL_KTRACE2("sched_balance", curr_cpu, target);
+
+    if (charge_current_thread(curr_thread)) {
+        curr_thread->curr_cpu = target;
+        insert_in_run_queue_tail(target, curr_thread);
+        mp_reschedule(cpu_num_to_mask(target), 0);
+    }
+    sched_resched_internal();
+    return true;
+}
+
 void sched_init_thread(thread_t* t, int priority) {
     t->base_priority = priority;
     t->priority_boost = 0;
     t->inherited_priority = -1;
+    t->user_inherited_priority = -1;
     compute_effec_priority(t);
+
+    t->sched_class = SCHED_CLASS_PRIORITY;
+    t->fair_weight = FAIR_WEIGHT_DEFAULT;
+    t->fair_vruntime = 0;
+    t->deadline_throttled = false;
 }
 
 void sched_block(void) {
@@ -312,6 +644,153 @@ static void find_cpu_and_insert(thread_t* t, bool* local_resched, cpu_mask_t* ac
     }
 }
 
+// deadline class
+//
+// Each deadline thread is a constant bandwidth server: it may run for
+// deadline_capacity in every deadline_period. While it runs its time slice is
+// its budget, and once that is used up the thread is parked on its cpu's
+// throttled queue until the end of the period, when the replenish timer hands it
+// a new budget and puts it back in a run queue.
+
+// fraction of a cpu reserved by |capacity| every |period|, in DEADLINE_BW_ONE units
+static uint64_t deadline_bandwidth(zx_duration_t capacity, zx_duration_t period) {
+    return (uint64_t)capacity * DEADLINE_BW_ONE / (uint64_t)period;
+}
+
+static void release_deadline_bandwidth(thread_t* t) TA_REQ(thread_lock) {
+    if (t->sched_class != SCHED_CLASS_DEADLINE)
+        return;
+
+    deadline_reserved_bw -= deadline_bandwidth(t->deadline_capacity, t->deadline_period);
+}
+
+// start a new period for a waking deadline thread if the current one is over, or
+// if using up the rest of its budget before the deadline would take more than
+// its reserved bandwidth.
+static void deadline_wakeup(thread_t* t, zx_time_t now) {
+    if (now < t->deadline_abs &&
+        t->deadline_budget * t->deadline_period <=
+            (t->deadline_abs - now) * t->deadline_capacity)
+        return;
+
+    t->deadline_abs = now + t->deadline_period;
+    t->deadline_budget = t->deadline_capacity;
+}
+
+// set up the time slice of a deadline thread that is about to run
+static void deadline_switch_in(thread_t* t, zx_time_t now) {
+    // if the period ended while the thread was waiting to run with budget left,
+    // it missed its deadline. a thread that ran out of budget is throttled
+    // rather than queued, but either way it starts over in a new period.
+    if (now >= t->deadline_abs || t->deadline_budget <= 0) {
+        if (t->deadline_budget > 0) {
+            kcounter_add(sched_deadline_misses, 1);
+            LOCAL_KTRACE2("sched_deadline_miss", (uint32_t)t->user_tid,
+                          (uint32_t)(now - t->deadline_abs));
+        }
+        t->deadline_abs = now + t->deadline_period;
+        t->deadline_budget = t->deadline_capacity;
+    }
+    t->remaining_time_slice = t->deadline_budget;
+}
+
+// per cpu timer that makes throttled deadline threads whose period has ended
+// runnable again with a new budget
+static void deadline_replenish(timer_t* timer, zx_time_t now, void* arg) {
+    // spin trylocking on the thread lock since the cpu that owns the timer may
+    // be resetting it while holding the thread_lock.
+    if (timer_trylock_or_cancel(timer, &thread_lock))
+        return;
+
+    struct percpu* c = &percpu[(cpu_num_t)(uintptr_t)arg];
+    list_node_t replenished = LIST_INITIAL_VALUE(replenished);
+    thread_t* t;
+    while ((t = list_peek_head_type(&c->deadline_throttled_queue, thread_t, queue_node))) {
+        if (t->deadline_abs > now) {
+            timer_set_oneshot(timer, t->deadline_abs, deadline_replenish, arg);
+            break;
+        }
+        list_delete(&t->queue_node);
+        t->deadline_throttled = false;
+        list_add_tail(&replenished, &t->queue_node);
+    }
+
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+    while ((t = list_remove_head_type(&replenished, thread_t, queue_node))) {
+        t->deadline_abs += t->deadline_period;
+        if (t->deadline_abs <= now)
+            t->deadline_abs = now + t->deadline_period;
+        t->deadline_budget = t->deadline_capacity;
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+    }
+
+    if (accum_cpu_mask)
+        mp_reschedule(accum_cpu_mask, 0);
+    if (local_resched)
+        sched_reschedule();
+
+    spin_unlock(&thread_lock);
+}
+
+// park the current thread, a deadline thread that ran out of budget, until the
+// end of its period
+static void deadline_throttle(cpu_num_t cpu, thread_t* t) TA_REQ(thread_lock) {
+    DEBUG_ASSERT(!list_in_list(&t->queue_node));
+
+    kcounter_add(sched_deadline_throttles, 1);
+    LOCAL_KTRACE2("sched_throttle", (uint32_t)t->user_tid, cpu);
+
+    struct percpu* c = &percpu[cpu];
+    t->deadline_throttled = true;
+    insert_by_deadline(&c->deadline_throttled_queue, t);
+
+    if (list_peek_head_type(&c->deadline_throttled_queue, thread_t, queue_node) == t) {
+        timer_reset_oneshot_local(&c->deadline_replenish_timer, t->deadline_abs,
+                                  deadline_replenish, (void*)(uintptr_t)cpu);
+    }
+}
+
+// charge a thread for the time it ran since last_started_running
+static void account_runtime(thread_t* t, zx_time_t now) {
+    DEBUG_ASSERT(now >= t->last_started_running);
+    zx_duration_t runtime = now - t->last_started_running;
+    t->last_started_running = now;
+
+    t->runtime_ns += runtime;
+    t->remaining_time_slice -= MIN(runtime, t->remaining_time_slice);
+
+    if (t->sched_class == SCHED_CLASS_FAIR) {
+        t->fair_vruntime += runtime * FAIR_WEIGHT_DEFAULT / t->fair_weight;
+    } else if (t->sched_class == SCHED_CLASS_DEADLINE) {
+        t->deadline_budget = MIN(t->remaining_time_slice, t->deadline_capacity);
+    }
+}
+
+// charge the current thread, which is about to be queued on some cpu, for the
+// time it has run so far, so that it is queued by its current vruntime or
+// budget rather than charged once it is already in a queue. returns false if
+// it is a deadline thread that has used up its budget, in which case it has
+// been throttled on the local cpu instead.
+static bool charge_current_thread(thread_t* t) TA_REQ(thread_lock) {
+    if (t->sched_class == SCHED_CLASS_PRIORITY)
+        return true;
+
+    account_runtime(t, current_time());
+    if (t->sched_class == SCHED_CLASS_DEADLINE && t->deadline_budget <= 0) {
+        deadline_throttle(arch_curr_cpu_num(), t);
+        return false;
+    }
+    return true;
+}
+
+// put the current thread back in the local run queue, or throttle it if it is
+// a deadline thread that has used up its budget
+static void requeue_current_thread(thread_t* t, cpu_num_t cpu, bool head) TA_REQ(thread_lock) {
+    if (charge_current_thread(t))
+        insert_in_run_queue(cpu, t, head);
+}
+
 bool sched_unblock(thread_t* t) {
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
@@ -321,6 +800,9 @@ bool sched_unblock(thread_t* t) {
 
     // thread is being woken up, boost its priority
     boost_thread(t);
+    t->wakeup_time = current_time();
+    if (t->sched_class == SCHED_CLASS_DEADLINE)
+        deadline_wakeup(t, t->wakeup_time);
 
     // stuff the new thread in the run queue
     t->state = THREAD_READY;
@@ -343,6 +825,7 @@ bool sched_unblock_list(struct list_node* list) {
     // pop the list of threads and shove into the scheduler
     bool local_resched = false;
     cpu_mask_t accum_cpu_mask = 0;
+    const zx_time_t now = current_time();
     thread_t* t;
     while ((t = list_remove_tail_type(list, thread_t, queue_node))) {
         DEBUG_ASSERT(t->magic == THREAD_MAGIC);
@@ -350,6 +833,9 @@ bool sched_unblock_list(struct list_node* list) {
 
         // thread is being woken up, boost its priority
         boost_thread(t);
+        t->wakeup_time = now;
+        if (t->sched_class == SCHED_CLASS_DEADLINE)
+            deadline_wakeup(t, now);
 
         // stuff the new thread in the run queue
         t->state = THREAD_READY;
@@ -391,11 +877,12 @@ void sched_yield(void) {
     deboost_thread(current_thread, false);
 
     current_thread->state = THREAD_READY;
+    percpu[arch_curr_cpu_num()].sched_stats.yielding = true;
 
     if (local_migrate_if_needed(current_thread))
         return;
 
-    insert_in_run_queue_tail(arch_curr_cpu_num(), current_thread);
+    requeue_current_thread(current_thread, arch_curr_cpu_num(), false);
     sched_resched_internal();
 }
 
@@ -422,11 +909,16 @@ void sched_preempt(void) {
         if (local_migrate_if_needed(current_thread))
             return;
 
-        if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(curr_cpu, current_thread);
-        } else {
-            insert_in_run_queue_tail(curr_cpu, current_thread);
-        }
+        // if we're out of quantum and other threads are waiting here, see if
+        // there is a less loaded cpu to continue on
+        if (current_thread->remaining_time_slice <= 0 &&
+            !thread_is_realtime(current_thread) &&
+            current_thread->sched_class != SCHED_CLASS_DEADLINE &&
+            balance_current_thread(current_thread))
+            return;
+
+        requeue_current_thread(current_thread, curr_cpu,
+                               current_thread->remaining_time_slice > 0);
     }
 
     sched_resched_internal();
@@ -459,11 +951,8 @@ void sched_reschedule(void) {
         if (local_migrate_if_needed(current_thread))
             return;
 
-        if (current_thread->remaining_time_slice > 0) {
-            insert_in_run_queue_head(curr_cpu, current_thread);
-        } else {
-            insert_in_run_queue_tail(curr_cpu, current_thread);
-        }
+        requeue_current_thread(current_thread, curr_cpu,
+                               current_thread->remaining_time_slice > 0);
     }
 
     sched_resched_internal();
@@ -476,9 +965,11 @@ static void migrate_current_thread(thread_t* current_thread) TA_REQ(thread_lock)
 
     // current thread, so just shove ourself into another cpu's queue and reschedule locally
     current_thread->state = THREAD_READY;
-    find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask);
-    if (accum_cpu_mask)
-        mp_reschedule(accum_cpu_mask, 0);
+    if (charge_current_thread(current_thread)) {
+        find_cpu_and_insert(current_thread, &local_resched, &accum_cpu_mask);
+        if (accum_cpu_mask)
+            mp_reschedule(accum_cpu_mask, 0);
+    }
     sched_resched_internal();
 }
 
@@ -494,6 +985,19 @@ void sched_transition_off_cpu(cpu_num_t old_cpu) {
     cpu_mask_t accum_cpu_mask = 0;
     cpu_mask_t pinned_mask = cpu_num_to_mask(old_cpu);
     list_node_t pinned_threads = LIST_INITIAL_VALUE(pinned_threads);
+
+    // Throttled deadline threads start over in a new period on their new cpu.
+    list_node_t throttled_threads = LIST_INITIAL_VALUE(throttled_threads);
+    list_move(&percpu[old_cpu].deadline_throttled_queue, &throttled_threads);
+    timer_cancel(&percpu[old_cpu].deadline_replenish_timer);
+    zx_time_t now = current_time();
+    while ((t = list_remove_head_type(&throttled_threads, thread_t, queue_node)) != NULL) {
+        t->deadline_throttled = false;
+        t->deadline_abs = now + t->deadline_period;
+        t->deadline_budget = t->deadline_capacity;
+        insert_in_run_queue_tail(old_cpu, t);
+    }
+
     while (!thread_is_idle(t = sched_get_top_thread(old_cpu))) {
         // Threads pinned to old_cpu can't run anywhere else, so put them
         // into a temporary list and deal with them later.
@@ -557,6 +1061,10 @@ void sched_migrate(thread_t* t) {
         }
         break;
     case THREAD_READY:
+        // throttled threads find a new home when their budget is replenished
+        if (t->deadline_throttled)
+            return;
+
         if (t->cpu_affinity & cpu_num_to_mask(t->curr_cpu)) {
             // it's ready and the new mask contains the core it's already waiting on, nothing to do.
             //TRACEF("t %p nomigrate\n", t);
@@ -583,6 +1091,110 @@ void sched_migrate(thread_t* t) {
     }
 }
 
+// take a thread that is about to change class out of the queue it is waiting
+// in, and return whether it has to be put back in one afterwards
+static bool dequeue_for_class_change(thread_t* t) TA_REQ(thread_lock) {
+    if (t->state != THREAD_READY)
+        return false;
+
+    if (t->deadline_throttled) {
+        list_delete(&t->queue_node);
+        t->deadline_throttled = false;
+    } else {
+        remove_from_run_queue(t, t->effec_priority);
+    }
+    return true;
+}
+
+// finish moving a thread to a new class: put it back in a run queue or, if it
+// is running, have its cpu reevaluate what to run
+static void finish_class_change(thread_t* t, bool requeue, int old_ep) TA_REQ(thread_lock) {
+    bool local_resched = false;
+    cpu_mask_t accum_cpu_mask = 0;
+
+    if (requeue) {
+        find_cpu_and_insert(t, &local_resched, &accum_cpu_mask);
+    } else if (t->state == THREAD_RUNNING) {
+        if (t == get_current_thread()) {
+            local_resched = true;
+        } else {
+            accum_cpu_mask = cpu_num_to_mask(t->curr_cpu);
+        }
+    } else if (t->state == THREAD_BLOCKED && t->blocking_wait_queue &&
+               t->effec_priority != old_ep) {
+        wait_queue_priority_changed(t, old_ep);
+    }
+
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+    if (local_resched) {
+        sched_reschedule();
+    }
+}
+
+void sched_set_fair(thread_t* t, uint32_t weight) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(weight > 0);
+
+    if (unlikely(t->state == THREAD_DEATH))
+        return;
+
+    int old_ep = t->effec_priority;
+    bool requeue = dequeue_for_class_change(t);
+    release_deadline_bandwidth(t);
+
+    // a thread joining the fair class starts out level with the queue it lands in
+    if (t->sched_class != SCHED_CLASS_FAIR)
+        t->fair_vruntime = 0;
+
+    t->sched_class = SCHED_CLASS_FAIR;
+    t->fair_weight = weight;
+    t->base_priority = FAIR_PRIORITY;
+    t->priority_boost = 0;
+    compute_effec_priority(t);
+
+    finish_class_change(t, requeue, old_ep);
+}
+
+zx_status_t sched_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t period) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+    DEBUG_ASSERT(capacity > 0 && capacity <= period && period <= ZX_SEC(1));
+
+    if (unlikely(t->state == THREAD_DEATH))
+        return ZX_ERR_BAD_STATE;
+
+    // admission control: no single thread may reserve more than DEADLINE_BW_LIMIT
+    // of a cpu, and all of them together no more than that of every active cpu
+    uint64_t bw = deadline_bandwidth(capacity, period);
+    uint64_t old_bw = 0;
+    if (t->sched_class == SCHED_CLASS_DEADLINE)
+        old_bw = deadline_bandwidth(t->deadline_capacity, t->deadline_period);
+    uint64_t limit = (uint64_t)DEADLINE_BW_LIMIT * __builtin_popcount(mp_get_active_mask());
+    if (bw > DEADLINE_BW_LIMIT || deadline_reserved_bw - old_bw + bw > limit)
+        return ZX_ERR_NO_RESOURCES;
+
+    int old_ep = t->effec_priority;
+    bool requeue = dequeue_for_class_change(t);
+    deadline_reserved_bw = deadline_reserved_bw - old_bw + bw;
+
+    t->sched_class = SCHED_CLASS_DEADLINE;
+    t->deadline_capacity = capacity;
+    t->deadline_period = period;
+    t->deadline_abs = current_time() + period;
+    t->deadline_budget = capacity;
+
+    finish_class_change(t, requeue, old_ep);
+    return ZX_OK;
+}
+
+void sched_exit_thread(thread_t* t) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    release_deadline_bandwidth(t);
+    t->sched_class = SCHED_CLASS_PRIORITY;
+}
+
 // the effective priority of a thread has changed, do what is necessary to move the thread
 // from different queues and inform us if we need to reschedule
 static void sched_priority_changed(thread_t* t, int old_prio,
@@ -600,6 +1212,10 @@ static void sched_priority_changed(thread_t* t, int old_prio,
         }
         break;
     case THREAD_READY:
+        // throttled threads are queued by deadline, not priority
+        if (t->deadline_throttled)
+            break;
+
         // it's sitting in a run queue somewhere, remove and add back to the proper queue on that cpu
         DEBUG_ASSERT_MSG(list_in_list(&t->queue_node), "thread %p name %s curr_cpu %u\n", t, t->name, t->curr_cpu);
         remove_from_run_queue(t, old_prio);
@@ -665,6 +1281,39 @@ void sched_inherit_priority(thread_t* t, int pri, bool* local_resched) {
     }
 }
 
+// set the priority inherited from user space threads blocked on futexes the thread owns.
+// unlike sched_inherit_priority, this may lower it, since futex owners are boosted and
+// deboosted one futex at a time. pri < 0 disables it.
+void sched_inherit_user_priority(thread_t* t, int pri, bool* local_resched) {
+    DEBUG_ASSERT(spin_lock_held(&thread_lock));
+
+    if (pri > HIGHEST_PRIORITY)
+        pri = HIGHEST_PRIORITY;
+    if (pri < 0)
+        pri = -1;
+
+    if (pri == t->user_inherited_priority)
+        return;
+
+    // adjust the priority and remember the old value
+    t->user_inherited_priority = pri;
+    int old_ep = t->effec_priority;
+    compute_effec_priority(t);
+    if (old_ep == t->effec_priority) {
+        // same effective priority, nothing to do
+        return;
+    }
+
+    // see if we need to do something based on the state of the thread
+    cpu_mask_t accum_cpu_mask = 0;
+    sched_priority_changed(t, old_ep, local_resched, &accum_cpu_mask);
+
+    // send some ipis based on the previous code
+    if (accum_cpu_mask) {
+        mp_reschedule(accum_cpu_mask, 0);
+    }
+}
+
 // changes the thread's base priority and if the re-computed effective priority changed
 //  then the thread is moved to the proper queue on the same processor and a re-schedule
 //  might be issued.
@@ -678,6 +1327,19 @@ void sched_change_priority(thread_t* t, int pri) {
         pri = HIGHEST_PRIORITY;
 
     int old_ep = t->effec_priority;
+
+    // an explicit priority puts the thread back in the priority class
+    if (t->sched_class != SCHED_CLASS_PRIORITY) {
+        bool requeue = dequeue_for_class_change(t);
+        release_deadline_bandwidth(t);
+        t->sched_class = SCHED_CLASS_PRIORITY;
+        t->base_priority = pri;
+        t->priority_boost = 0;
+        compute_effec_priority(t);
+        finish_class_change(t, requeue, old_ep);
+        return;
+    }
+
     t->base_priority = pri;
     t->priority_boost = 0;
 
@@ -731,6 +1393,23 @@ static void sched_timer_tick(timer_t* t, zx_time_t now, void* arg) {
     }
 }
 
+// keep track of threads leaving the caches they last ran with
+static void account_migration(cpu_num_t from, cpu_num_t to) {
+    struct sched_stats* stats = &percpu[to].sched_stats;
+    kcounter_add(sched_migrations, 1);
+    stats->migrations++;
+
+    if (cpu_topology_llc_mask(from) & cpu_num_to_mask(to))
+        return;
+    kcounter_add(sched_migrations_cross_llc, 1);
+    stats->migrations_cross_llc++;
+    ktrace_probe2("sched_migrate_cross_llc", from, to);
+
+    if (cpu_topology_node_mask(from) & cpu_num_to_mask(to))
+        return;
+    kcounter_add(sched_migrations_cross_node, 1);
+}
+
 // On ARM64 with safe-stack, it's no longer possible to use the unsafe-sp
 // after set_current_thread (we'd now see newthread's unsafe-sp instead!).
 // Hence this function and everything it calls between this point and the
@@ -755,8 +1434,12 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(reschedules);
 
+    struct sched_stats* stats = &percpu[cpu].sched_stats;
+    const bool yielding = stats->yielding;
+    stats->yielding = false;
+
     // pick a new thread to run
-    thread_t* newthread = sched_get_top_thread(cpu);
+    thread_t* newthread = sched_pick_next_thread(cpu);
 
     DEBUG_ASSERT(newthread);
 
@@ -778,14 +1461,26 @@ void sched_resched_internal(void) {
 
     zx_time_t now = current_time();
 
+    if (thread_is_idle(oldthread)) {
+        percpu[cpu].stats.idle_time += now - oldthread->last_started_running;
+    } else if (stats->switch_time != 0) {
+        stats->run_time[sched_stats_bucket((now - stats->switch_time) / ZX_USEC(1))]++;
+        if (oldthread->state == THREAD_READY && !yielding)
+            stats->involuntary_switches++;
+    }
+    if (newthread->wakeup_time != 0) {
+        stats->wakeup_latency[sched_stats_bucket((now - newthread->wakeup_time) / ZX_USEC(1))]++;
+        newthread->wakeup_time = 0;
+    }
+    stats->switch_time = now;
+
     // account for time used on the old thread
-    DEBUG_ASSERT(now >= oldthread->last_started_running);
-    zx_duration_t old_runtime = now - oldthread->last_started_running;
-    oldthread->runtime_ns += old_runtime;
-    oldthread->remaining_time_slice -= MIN(old_runtime, oldthread->remaining_time_slice);
+    account_runtime(oldthread, now);
 
     // set up quantum for the new thread if it was consumed
-    if (newthread->remaining_time_slice == 0) {
+    if (newthread->sched_class == SCHED_CLASS_DEADLINE) {
+        deadline_switch_in(newthread, now);
+    } else if (newthread->remaining_time_slice == 0) {
         newthread->remaining_time_slice = THREAD_INITIAL_TIME_SLICE;
     }
 
@@ -794,6 +1489,8 @@ void sched_resched_internal(void) {
     // mark the cpu ownership of the threads
     if (oldthread->state != THREAD_READY)
         oldthread->curr_cpu = INVALID_CPU;
+    if (newthread->last_cpu != cpu && is_valid_cpu_num(newthread->last_cpu))
+        account_migration(newthread->last_cpu, cpu);
     newthread->last_cpu = cpu;
     newthread->curr_cpu = cpu;
 
@@ -811,10 +1508,6 @@ void sched_resched_internal(void) {
 
     CPU_STATS_INC(context_switches);
 
-    if (thread_is_idle(oldthread)) {
-        percpu[cpu].stats.idle_time += now - oldthread->last_started_running;
-    }
-
     LOCAL_KTRACE2("CS timeslice old", (uint32_t)oldthread->user_tid, oldthread->remaining_time_slice);
     LOCAL_KTRACE2("CS timeslice new", (uint32_t)newthread->user_tid, newthread->remaining_time_slice);
 
@@ -890,7 +1583,12 @@ void sched_resched_internal(void) {
 
 void sched_init_early(void) {
     // initialize the run queues
-    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++)
+    for (unsigned int cpu = 0; cpu < SMP_MAX_CPUS; cpu++) {
         for (unsigned int i = 0; i < NUM_PRIORITIES; i++)
             list_initialize(&percpu[cpu].run_queue[i]);
+        list_initialize(&percpu[cpu].fair_queue);
+        list_initialize(&percpu[cpu].deadline_queue);
+        list_initialize(&percpu[cpu].deadline_throttled_queue);
+        timer_init(&percpu[cpu].deadline_replenish_timer);
+    }
 }
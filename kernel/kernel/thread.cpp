@@ -500,6 +500,9 @@ __NO_RETURN static void thread_exit_locked(thread_t* current_thread,
     current_thread->state = THREAD_DEATH;
     current_thread->retcode = retcode;
 
+    // give back any bandwidth reserved by the scheduler
+    sched_exit_thread(current_thread);
+
     // if we're detached, then do our teardown here
     if (current_thread->flags & THREAD_FLAG_DETACHED) {
         // remove it from the master thread list
@@ -1058,6 +1061,43 @@ void thread_set_priority(thread_t* t, int priority) {
     THREAD_UNLOCK(state);
 }
 
+/**
+ * @brief Move a thread into the fair scheduling class
+ *
+ * Fair threads share the cpu time of their band in proportion to their weight,
+ * with FAIR_WEIGHT_DEFAULT being the weight of an average thread.
+ */
+void thread_set_fair_weight(thread_t* t, uint32_t weight) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+    DEBUG_ASSERT(weight > 0);
+
+    THREAD_LOCK(state);
+    sched_set_fair(t, weight);
+    THREAD_UNLOCK(state);
+}
+
+/**
+ * @brief Move a thread into the deadline scheduling class
+ *
+ * The thread is guaranteed |capacity| of cpu time in every |period|, and is
+ * throttled if it tries to use more than that. |period| may be at most one
+ * second.
+ *
+ * @return ZX_ERR_NO_RESOURCES if the cpus cannot accommodate the reservation.
+ */
+zx_status_t thread_set_deadline(thread_t* t, zx_duration_t capacity, zx_duration_t period) {
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    if (capacity <= 0 || capacity > period || period > ZX_SEC(1))
+        return ZX_ERR_INVALID_ARGS;
+
+    THREAD_LOCK(state);
+    zx_status_t status = sched_set_deadline(t, capacity, period);
+    THREAD_UNLOCK(state);
+
+    return status;
+}
+
 /**
  * @brief  Become an idle thread
  *
@@ -1198,11 +1238,12 @@ void dump_thread(thread_t* t, bool full_dump) {
 
     if (full_dump) {
         dprintf(INFO, "dump_thread: t %p (%s:%s)\n", t, oname, t->name);
-        dprintf(INFO, "\tstate %s, curr/last cpu %d/%d, cpu_affinity %#x, priority %d [%d:%d,%d], "
+        dprintf(INFO, "\tstate %s, curr/last cpu %d/%d, cpu_affinity %#x, priority %d [%d:%d,%d,%d], "
                       "remaining time slice %" PRIu64 "\n",
                 thread_state_to_str(t->state), (int)t->curr_cpu, (int)t->last_cpu, t->cpu_affinity,
                 t->effec_priority, t->base_priority,
-                t->priority_boost, t->inherited_priority, t->remaining_time_slice);
+                t->priority_boost, t->inherited_priority, t->user_inherited_priority,
+                t->remaining_time_slice);
         dprintf(INFO, "\truntime_ns %" PRIu64 ", runtime_s %" PRIu64 "\n",
                 runtime, runtime / 1000000000);
         dprintf(INFO, "\tstack %p, stack_size %zu\n", t->stack, t->stack_size);
@@ -1220,9 +1261,9 @@ void dump_thread(thread_t* t, bool full_dump) {
                 t->user_thread, t->user_pid, t->user_tid);
         arch_dump_thread(t);
     } else {
-        printf("thr %p st %4s m %d pri %2d [%d:%d,%d] pid %" PRIu64 " tid %" PRIu64 " (%s:%s)\n",
+        printf("thr %p st %4s m %d pri %2d [%d:%d,%d,%d] pid %" PRIu64 " tid %" PRIu64 " (%s:%s)\n",
                t, thread_state_to_str(t->state), t->mutexes_held, t->effec_priority, t->base_priority,
-               t->priority_boost, t->inherited_priority, t->user_pid,
+               t->priority_boost, t->inherited_priority, t->user_inherited_priority, t->user_pid,
                t->user_tid, oname, t->name);
     }
 }
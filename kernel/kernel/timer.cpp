@@ -38,14 +38,141 @@
 
 #define LOCAL_TRACE 0
 
-static spin_lock_t timer_lock __CPU_ALIGN_EXCLUSIVE = SPIN_LOCK_INITIAL_VALUE;
+// Each cpu keeps its timers twice, under its own timer_lock: as a list in the
+// order they fire, which timer_tick() and most of the code below walk, and as
+// a treap over the same timers, which lets timer_set() find where a new timer
+// goes without walking the list. Timers with equal scheduled times go to the
+// right in the tree, so they fire in the order they were set.
+//
+// A timer is guarded by the lock of the cpu it was last set on, recorded in
+// timer->cpu, until it is set again.
 
 void timer_init(timer_t* timer) {
     *timer = (timer_t)TIMER_INITIAL_VALUE(*timer);
 }
 
+static uint32_t tree_priority(const timer_t* timer) {
+    // Any well mixed value will do to keep the tree balanced on average.
+    uint64_t x = reinterpret_cast<uintptr_t>(timer) ^ timer->scheduled_time;
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    return static_cast<uint32_t>(x);
+}
+
+static void tree_replace_child(timer_t** root, timer_t* parent, timer_t* old, timer_t* node) {
+    if (parent == NULL) {
+        *root = node;
+    } else if (parent->tree_left == old) {
+        parent->tree_left = node;
+    } else {
+        parent->tree_right = node;
+    }
+    if (node)
+        node->tree_parent = parent;
+}
+
+// Moves |node| above its parent, keeping the order.
+static void tree_rotate_up(timer_t** root, timer_t* node) {
+    timer_t* parent = node->tree_parent;
+    timer_t* grandparent = parent->tree_parent;
+
+    if (parent->tree_left == node) {
+        parent->tree_left = node->tree_right;
+        if (node->tree_right)
+            node->tree_right->tree_parent = parent;
+        node->tree_right = parent;
+    } else {
+        parent->tree_right = node->tree_left;
+        if (node->tree_left)
+            node->tree_left->tree_parent = parent;
+        node->tree_left = parent;
+    }
+    parent->tree_parent = node;
+    tree_replace_child(root, grandparent, parent, node);
+}
+
+static void tree_insert(timer_t** root, timer_t* timer) {
+    timer->tree_left = NULL;
+    timer->tree_right = NULL;
+    timer->tree_priority = tree_priority(timer);
+
+    timer_t* parent = NULL;
+    timer_t** link = root;
+    while (*link) {
+        parent = *link;
+        link = (timer->scheduled_time < parent->scheduled_time) ? &parent->tree_left
+                                                                  : &parent->tree_right;
+    }
+    *link = timer;
+    timer->tree_parent = parent;
+
+    while (timer->tree_parent && timer->tree_parent->tree_priority < timer->tree_priority)
+        tree_rotate_up(root, timer);
+}
+
+static void tree_remove(timer_t** root, timer_t* timer) {
+    // Rotate it down until it has at most one child, then splice it out.
+    while (timer->tree_left && timer->tree_right) {
+        timer_t* child = (timer->tree_left->tree_priority > timer->tree_right->tree_priority)
+                             ? timer->tree_left
+                             : timer->tree_right;
+        tree_rotate_up(root, child);
+    }
+    tree_replace_child(root, timer->tree_parent, timer,
+                       timer->tree_left ? timer->tree_left : timer->tree_right);
+    timer->tree_parent = NULL;
+    timer->tree_left = NULL;
+    timer->tree_right = NULL;
+}
+
+// Returns the first timer scheduled at or after |time|, or NULL.
+static timer_t* tree_lower_bound(timer_t* node, zx_time_t time) {
+    timer_t* result = NULL;
+    while (node) {
+        if (node->scheduled_time >= time) {
+            result = node;
+            node = node->tree_left;
+        } else {
+            node = node->tree_right;
+        }
+    }
+    return result;
+}
+
+static timer_t* tree_prev(timer_t* node) {
+    if (node->tree_left) {
+        node = node->tree_left;
+        while (node->tree_right)
+            node = node->tree_right;
+        return node;
+    }
+    while (node->tree_parent && node->tree_parent->tree_left == node)
+        node = node->tree_parent;
+    return node->tree_parent;
+}
+
+// Adds |timer| to the queue of |cpu| at its scheduled time.
+static void queue_add(uint cpu, timer_t* timer) TA_REQ(percpu[cpu].timer_lock) {
+    tree_insert(&percpu[cpu].timer_tree, timer);
+    timer_t* prev = tree_prev(timer);
+    if (prev) {
+        list_add_after(&prev->node, &timer->node);
+    } else {
+        list_add_head(&percpu[cpu].timer_queue, &timer->node);
+    }
+    timer->cpu = cpu;
+}
+
+static void queue_remove(uint cpu, timer_t* timer) TA_REQ(percpu[cpu].timer_lock) {
+    DEBUG_ASSERT(timer->cpu == (int)cpu);
+    list_delete(&timer->node);
+    tree_remove(&percpu[cpu].timer_tree, timer);
+}
+
 static void insert_timer_in_queue(uint cpu, timer_t* timer,
-                                  uint64_t early_slack, uint64_t late_slack) {
+                                  uint64_t early_slack, uint64_t late_slack)
+    TA_REQ(percpu[cpu].timer_lock) {
 
     DEBUG_ASSERT(arch_ints_disabled());
     LTRACEF("timer %p, cpu %u, scheduled %" PRIu64 "\n", timer, cpu, timer->scheduled_time);
@@ -54,108 +181,82 @@ static void insert_timer_in_queue(uint cpu, timer_t* timer,
     zx_time_t latest_deadline = timer->scheduled_time + late_slack;
 
     // For inserting the timer we consider several cases. In general we
-    // want to coalesce with the current timer unless we can prove that
+    // want to coalesce with an existing timer unless we can prove that
     // either that:
-    //  1- there is no slack overlap with current timer OR
-    //  2- the next timer is a better fit.
+    //  1- there is no slack overlap with it OR
+    //  2- another timer is a better fit.
+    //
+    // Only the timers on either side of the new one can be candidates, so
+    // we look those up instead of walking the queue.
     //
     // In diagrams that follow
-    // - Let |e| be the current (existing) timer deadline
     // - Let |t| be the deadline of the timer we are inserting
-    // - Let |n| be the next timer deadline if any
-    // - Let |x| be the end of the list (not a timer)
+    // - Let |p| be the previous timer deadline if any, the last one before |t|
+    // - Let |n| be the next timer deadline if any, the first one at or after |t|
     // - Let |(| and |)| the earliest_deadline and latest_deadline.
     //
-    timer_t* entry;
+    timer_t* next = tree_lower_bound(percpu[cpu].timer_tree, timer->scheduled_time);
+    timer_t* prev = next ? list_prev_type(&percpu[cpu].timer_queue, &next->node, timer_t, node)
+                         : list_peek_tail_type(&percpu[cpu].timer_queue, timer_t, node);
 
-    list_for_every_entry (&percpu[cpu].timer_queue, entry, timer_t, node) {
-        if (entry->scheduled_time > latest_deadline) {
-            // New timer latest is earlier than the current timer.
-            // Just add upfront as is, without slack.
-            //
-            //   ---------t---)--e-------------------------------> time
-            //
-            timer->slack = 0ull;
-            list_add_before(&entry->node, &timer->node);
-            return;
-        }
+    if (prev != NULL && prev->scheduled_time < earliest_deadline) {
+        // No overlap with the previous timer, so it is out of the running.
+        //
+        //   ----------------p--(---t-----------------------> time
+        //
+        prev = NULL;
+    }
 
-        if (entry->scheduled_time >= timer->scheduled_time) {
-            //  New timer slack overlaps and is to the left (or equal). We
-            //  coalesce with current by scheduling late.
+    timer_t* target;
+    if (prev == NULL) {
+        if (next == NULL || next->scheduled_time > latest_deadline) {
+            // New timer latest is earlier than the next timer, or there is
+            // none. Just add it as is, without slack.
             //
-            //  --------(----t---e-)----------------------------> time
+            //   ---------t---)--n-------------------------------> time
             //
-            timer->slack = entry->scheduled_time - timer->scheduled_time;
-            timer->scheduled_time = entry->scheduled_time;
-            list_add_after(&entry->node, &timer->node);
+            timer->slack = 0ull;
+            queue_add(cpu, timer);
             return;
         }
 
-        if (entry->scheduled_time < earliest_deadline) {
-            // new timer earliest is later than the current timer. This case
-            // is handled in a future iteration.
-            //
-            //   ----------------e--(---t-----------------------> time
-            //
-            continue;
-        }
-
-        // New timer is to the right of current timer and there is overlap
-        // with the current timer, but could the next timer (if any) be
-        // a better fit?
+        //  New timer slack overlaps with the next timer. We coalesce with it
+        //  by scheduling late.
         //
-        //  -------------(--e---t-----?-------------------> time
+        //  --------(----t---n-)----------------------------> time
         //
-
-        const timer_t* next =
-            list_next_type(&percpu[cpu].timer_queue, &entry->node, timer_t, node);
-
-        if (next != NULL) {
-            if (next->scheduled_time <= timer->scheduled_time) {
-                // The new timer is to the right of the next timer. There is no
-                // chance the current timer is a better fit.
-                //
-                //  -------------(--e---n---t----------------------> time
-                //
-                continue;
-            }
-
-            if (next->scheduled_time < latest_deadline) {
-                // There is slack overlap with the next timer, and also with the
-                // current timer. Which coalescing is a better match?
-                //
-                //  --------------(-e---t---n-)-----------------------> time
-                //
-                zx_duration_t delta_entry = timer->scheduled_time - entry->scheduled_time;
-                zx_duration_t delta_next = next->scheduled_time - timer->scheduled_time;
-                if (delta_next < delta_entry) {
-                    // New timer is closer to the next timer, handle it in the
-                    // next iteration.
-                    continue;
-                }
-            }
-        }
-
+        target = next;
+    } else if (next != NULL && (next->scheduled_time == timer->scheduled_time ||
+                                (next->scheduled_time < latest_deadline &&
+                                 next->scheduled_time - timer->scheduled_time <
+                                     timer->scheduled_time - prev->scheduled_time))) {
+        // There is slack overlap with both timers, but the next one is a
+        // better match. Schedule late.
+        //
+        //  --------------(-p-----t-n-)-----------------------> time
+        //
+        // A next timer at exactly |t| is taken even with no late slack, when
+        // |n| and |)| coincide, as the walk over the whole queue used to:
+        // it moved past |p| to any timer at or before |t| and coalesced with
+        // the first one at or after it.
+        target = next;
+    } else {
         // Handles the remaining cases, note that there is overlap with
-        // the current timer.
+        // the previous timer.
         //
-        //  1- this is the last timer (next == NULL) or
+        //  1- there is no next timer or
         //  2- there is no overlap with the next timer, or
-        //  3- there is overlap with both current and next but
-        //     current is closer.
+        //  3- there is overlap with both previous and next but
+        //     previous is closer.
         //
         //  So we coalesce by scheduling early.
         //
-        timer->slack = entry->scheduled_time - timer->scheduled_time;
-        timer->scheduled_time = entry->scheduled_time;
-        list_add_after(&entry->node, &timer->node);
-        return;
+        target = prev;
     }
 
-    // Walked off the end of the list and there was no overlap.
-    timer->slack = 0ull;
-    list_add_tail(&percpu[cpu].timer_queue, &timer->node);
+    timer->slack = target->scheduled_time - timer->scheduled_time;
+    timer->scheduled_time = target->scheduled_time;
+    queue_add(cpu, timer);
 }
 
 void timer_set(timer_t* timer, zx_time_t deadline,
@@ -197,9 +298,10 @@ void timer_set(timer_t* timer, zx_time_t deadline,
     }
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&timer_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     uint cpu = arch_curr_cpu_num();
+    spin_lock(&percpu[cpu].timer_lock);
 
     bool currently_active = (timer->active_cpu == (int)cpu);
     if (unlikely(currently_active)) {
@@ -228,7 +330,8 @@ void timer_set(timer_t* timer, zx_time_t deadline,
     }
 
 out:
-    spin_unlock_irqrestore(&timer_lock, state);
+    spin_unlock(&percpu[cpu].timer_lock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 }
 
 // similar to timer_set_oneshot, with additional features/constraints:
@@ -245,7 +348,7 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
     uint cpu = arch_curr_cpu_num();
 
     // no need to disable interrupts when acquiring this lock
-    spin_lock(&timer_lock);
+    spin_lock(&percpu[cpu].timer_lock);
 
     if (unlikely(timer->active_cpu >= 0)) {
         panic("timer %p currently active\n", timer);
@@ -253,7 +356,7 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
 
     // remove it from the queue if it was present
     if (list_in_list(&timer->node))
-        list_delete(&timer->node);
+        queue_remove(cpu, timer);
 
     // set up the structure
     timer->scheduled_time = deadline;
@@ -273,17 +376,29 @@ void timer_reset_oneshot_local(timer_t* timer, zx_time_t deadline, timer_callbac
         platform_set_oneshot_timer(deadline);
     }
 
-    spin_unlock(&timer_lock);
+    spin_unlock(&percpu[cpu].timer_lock);
 }
 
 bool timer_cancel(timer_t* timer) {
     DEBUG_ASSERT(timer->magic == TIMER_MAGIC);
 
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&timer_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     uint cpu = arch_curr_cpu_num();
 
+    // lock the cpu guarding the timer, which can change while we wait if
+    // that cpu goes offline and hands its timers over
+    uint timer_cpu;
+    for (;;) {
+        int last_cpu = timer->cpu;
+        timer_cpu = (last_cpu >= 0) ? last_cpu : cpu;
+        spin_lock(&percpu[timer_cpu].timer_lock);
+        if (timer->cpu == last_cpu)
+            break;
+        spin_unlock(&percpu[timer_cpu].timer_lock);
+    }
+
     // mark the timer as canceled
     timer->cancel = true;
     smp_mb();
@@ -298,7 +413,8 @@ bool timer_cancel(timer_t* timer) {
         timer->arg = NULL;
 
         // we're done, so return back to the callback
-        spin_unlock_irqrestore(&timer_lock, state);
+        spin_unlock(&percpu[timer_cpu].timer_lock);
+        arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
         return false;
     }
 
@@ -309,10 +425,10 @@ bool timer_cancel(timer_t* timer) {
         callback_not_running = true;
 
         // save a copy of the old head of the queue
-        timer_t* oldhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
+        timer_t* oldhead = list_peek_head_type(&percpu[timer_cpu].timer_queue, timer_t, node);
 
         // remove our timer from the queue
-        list_delete(&timer->node);
+        queue_remove(timer_cpu, timer);
 
         // TODO(cpu): if  after removing |timer| there is one other single timer with
         // the same scheduled_time and slack non-zero then it is possible to return
@@ -320,7 +436,7 @@ bool timer_cancel(timer_t* timer) {
 
         // see if we've just modified the head of this cpu's timer queue.
         // if we modified another cpu's queue, we'll just let it fire and sort itself out
-        if (unlikely(oldhead == timer)) {
+        if (unlikely(oldhead == timer && timer_cpu == cpu)) {
             timer_t* newhead = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
             if (newhead) {
                 LTRACEF("setting new timer to %" PRIu64 "\n", newhead->scheduled_time);
@@ -334,7 +450,8 @@ bool timer_cancel(timer_t* timer) {
         callback_not_running = false;
     }
 
-    spin_unlock_irqrestore(&timer_lock, state);
+    spin_unlock(&percpu[timer_cpu].timer_lock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 
     // wait for the timer to become un-busy in case a callback is currently active on another cpu
     while (timer->active_cpu >= 0) {
@@ -360,7 +477,7 @@ void timer_tick(zx_time_t now) {
 
     LTRACEF("cpu %u now %" PRIu64 ", sp %p\n", cpu, now, __GET_FRAME());
 
-    spin_lock(&timer_lock);
+    spin_lock(&percpu[cpu].timer_lock);
 
     for (;;) {
         // see if there's an event to process
@@ -377,14 +494,14 @@ void timer_tick(zx_time_t now) {
         DEBUG_ASSERT_MSG(timer && timer->magic == TIMER_MAGIC,
                          "ASSERT: timer failed magic check: timer %p, magic 0x%x\n",
                          timer, (uint)timer->magic);
-        list_delete(&timer->node);
+        queue_remove(cpu, timer);
 
         // mark the timer busy
         timer->active_cpu = cpu;
         // spinlock below acts as a memory barrier
 
         // we pulled it off the list, release the list lock to handle it
-        spin_unlock(&timer_lock);
+        spin_unlock(&percpu[cpu].timer_lock);
 
         LTRACEF("dequeued timer %p, scheduled %" PRIu64 "\n", timer, timer->scheduled_time);
 
@@ -395,7 +512,7 @@ void timer_tick(zx_time_t now) {
 
         DEBUG_ASSERT(arch_ints_disabled());
         // it may have been requeued, grab the lock so we can safely inspect it
-        spin_lock(&timer_lock);
+        spin_lock(&percpu[cpu].timer_lock);
 
         // mark it not busy
         timer->active_cpu = -1;
@@ -417,7 +534,7 @@ void timer_tick(zx_time_t now) {
     }
 
     // we're done manipulating the timer queue
-    spin_unlock(&timer_lock);
+    spin_unlock(&percpu[cpu].timer_lock);
 }
 
 zx_status_t timer_trylock_or_cancel(timer_t* t, spin_lock_t* lock) {
@@ -438,15 +555,20 @@ zx_status_t timer_trylock_or_cancel(timer_t* t, spin_lock_t* lock) {
 
 void timer_transition_off_cpu(uint old_cpu) {
     spin_lock_saved_state_t state;
-    spin_lock_irqsave(&timer_lock, state);
+    arch_interrupt_save(&state, SPIN_LOCK_FLAG_INTERRUPTS);
     uint cpu = arch_curr_cpu_num();
 
+    // this is the only place two timer locks are held at once, and old_cpu is
+    // offline, so there is no other order to worry about
+    spin_lock(&percpu[cpu].timer_lock);
+    spin_lock(&percpu[old_cpu].timer_lock);
+
     timer_t* old_head = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
 
     timer_t *entry = NULL, *tmp_entry = NULL;
     // Move all timers from old_cpu to this cpu
     list_for_every_entry_safe (&percpu[old_cpu].timer_queue, entry, tmp_entry, timer_t, node) {
-        list_delete(&entry->node);
+        queue_remove(old_cpu, entry);
         // We lost the original asymmetric slack information so when we combine them
         // with the other timer queue they are not coalesced again.
         // TODO(cpu): figure how important this case is.
@@ -460,27 +582,31 @@ void timer_transition_off_cpu(uint old_cpu) {
         platform_set_oneshot_timer(new_head->scheduled_time);
     }
 
-    spin_unlock_irqrestore(&timer_lock, state);
+    spin_unlock(&percpu[old_cpu].timer_lock);
+    spin_unlock(&percpu[cpu].timer_lock);
+    arch_interrupt_restore(state, SPIN_LOCK_FLAG_INTERRUPTS);
 }
 
 void timer_thaw_percpu(void) {
     DEBUG_ASSERT(arch_ints_disabled());
-    spin_lock(&timer_lock);
-
     uint cpu = arch_curr_cpu_num();
 
+    spin_lock(&percpu[cpu].timer_lock);
+
     timer_t* t = list_peek_head_type(&percpu[cpu].timer_queue, timer_t, node);
     if (t) {
         LTRACEF("rescheduling timer for %" PRIu64 " nsecs\n", t->scheduled_time);
         platform_set_oneshot_timer(t->scheduled_time);
     }
 
-    spin_unlock(&timer_lock);
+    spin_unlock(&percpu[cpu].timer_lock);
 }
 
 void timer_queue_init(void) {
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        spin_lock_init(&percpu[i].timer_lock);
         list_initialize(&percpu[i].timer_queue);
+        percpu[i].timer_tree = NULL;
     }
 }
 
@@ -489,11 +615,11 @@ static void dump_timer_queues(char* buf, size_t len) {
     size_t ptr = 0;
     zx_time_t now = current_time();
 
-    spin_lock_saved_state_t state;
-    spin_lock_irqsave(&timer_lock, state);
-
     for (uint i = 0; i < SMP_MAX_CPUS; i++) {
         if (mp_is_cpu_online(i)) {
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&percpu[i].timer_lock, state);
+
             ptr += snprintf(buf + ptr, len - ptr, "cpu %u:\n", i);
 
             timer_t* t;
@@ -506,10 +632,10 @@ static void dump_timer_queues(char* buf, size_t len) {
                                 t->scheduled_time, delta_now, delta_last, t->callback, t->arg);
                 last = t->scheduled_time;
             }
+
+            spin_unlock_irqrestore(&percpu[i].timer_lock, state);
         }
     }
-
-    spin_unlock_irqrestore(&timer_lock, state);
 }
 
 #if WITH_LIB_CONSOLE
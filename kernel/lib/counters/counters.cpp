@@ -24,8 +24,18 @@
 
 #include <lib/console.h>
 
-// The arena is allocated in kernel.ld linker script.
+#include <vm/vm.h>
+#include <vm/vm_object.h>
+#include <vm/vm_object_paged.h>
+
+#include <zircon/syscalls/kcounter.h>
+
+static_assert(KCOUNTER_HISTOGRAM_BUCKETS == ZX_KCOUNTER_HISTOGRAM_BUCKETS,
+              "kernel and user space histograms must match");
+
+// The arenas are allocated in kernel.ld linker script.
 extern int64_t kcounters_arena[];
+extern int64_t kcounter_histograms_arena[];
 
 struct watched_counter_t {
     list_node node;
@@ -41,18 +51,22 @@ static size_t get_num_counters() {
     return kcountdesc_end - kcountdesc_begin;
 }
 
+static size_t get_num_histograms() {
+    return kcounthistdesc_end - kcounthistdesc_begin;
+}
+
 static bool prefix_match(const char *pre, const char *str) {
     return strncmp(pre, str, strlen(pre)) == 0;
 }
 
 // Binary search the sorted counter descriptors.
 // We rely on SORT_BY_NAME() in the linker script for this to work.
-static const k_counter_desc* upper_bound(
-    const char* val, const k_counter_desc* first, const k_counter_desc* last) {
+template <typename Desc>
+static const Desc* upper_bound(const char* val, const Desc* first, const Desc* last) {
     if (first >= last)
         return last;
 
-    const k_counter_desc* it;
+    const Desc* it;
     size_t step;
     auto count = last - first;
 
@@ -74,6 +88,28 @@ static void counters_init(unsigned level) {
     // Wire the memory defined in the .bss section to the counters.
     for (size_t ix = 0; ix != SMP_MAX_CPUS; ++ix) {
         percpu[ix].counters = &kcounters_arena[ix * get_num_counters()];
+        percpu[ix].counter_histograms = &kcounter_histograms_arena[
+            ix * get_num_histograms() * KCOUNTER_HISTOGRAM_BUCKETS];
+    }
+}
+
+static int64_t sum_counter(size_t counter_index) {
+    int64_t sum = 0;
+    for (size_t ix = 0; ix != SMP_MAX_CPUS; ++ix)
+        sum += percpu[ix].counters[counter_index];
+    return sum;
+}
+
+// Sums the buckets of a histogram over all the cpus, with the same caveat
+// as for the counters.
+static void sum_histogram(size_t histogram_index, int64_t* buckets) {
+    for (size_t b = 0; b != KCOUNTER_HISTOGRAM_BUCKETS; ++b)
+        buckets[b] = 0;
+    for (size_t ix = 0; ix != SMP_MAX_CPUS; ++ix) {
+        const int64_t* h =
+            &percpu[ix].counter_histograms[histogram_index * KCOUNTER_HISTOGRAM_BUCKETS];
+        for (size_t b = 0; b != KCOUNTER_HISTOGRAM_BUCKETS; ++b)
+            buckets[b] += h[b];
     }
 }
 
@@ -102,11 +138,32 @@ static void dump_counter(const k_counter_desc* desc) {
     printf("\n");
 }
 
+static void dump_histogram(const k_counter_histogram_desc* desc) {
+    int64_t buckets[KCOUNTER_HISTOGRAM_BUCKETS];
+    sum_histogram(kcounter_histogram_index(desc), buckets);
+
+    printf("[h%.2zu] %s =", kcounter_histogram_index(desc), desc->name);
+    for (size_t b = 0; b != KCOUNTER_HISTOGRAM_BUCKETS; ++b) {
+        if (buckets[b] == 0)
+            continue;
+        if (b == KCOUNTER_HISTOGRAM_BUCKETS - 1) {
+            printf(" >=%lu:%ld", 1ul << (b - 1), buckets[b]);
+        } else {
+            printf(" <%lu:%ld", 1ul << b, buckets[b]);
+        }
+    }
+    printf("\n");
+}
+
 static void dump_all_counters() {
     printf("%zu counters available:\n", get_num_counters());
     for (auto it = kcountdesc_begin; it != kcountdesc_end; ++it) {
         dump_counter(it);
     }
+    printf("%zu histograms available:\n", get_num_histograms());
+    for (auto it = kcounthistdesc_begin; it != kcounthistdesc_end; ++it) {
+        dump_histogram(it);
+    }
 }
 
 static int watcher_thread_fn(void* arg) {
@@ -143,6 +200,14 @@ static int view_counter(int argc, const cmd_args* argv) {
                 ++num_results;
                 ++desc;
             }
+            auto hdesc = upper_bound(name, kcounthistdesc_begin, kcounthistdesc_end);
+            while (hdesc != kcounthistdesc_end) {
+                if (!prefix_match(name, hdesc->name))
+                    break;
+                dump_histogram(hdesc);
+                ++num_results;
+                ++hdesc;
+            }
             if (num_results == 0) {
                 printf("counter '%s' not found, try --all\n", name);
             } else {
@@ -235,6 +300,53 @@ static int cmd_counters(int argc, const cmd_args* argv, uint32_t flags) {
     return 0;
 }
 
+zx_status_t kcounter_snapshot(fbl::RefPtr<VmObject>* out) {
+    const size_t num_counters = get_num_counters();
+    const size_t num_histograms = get_num_histograms();
+    const size_t size = sizeof(zx_kcounter_snapshot_header_t) +
+                        num_counters * sizeof(zx_kcounter_t) +
+                        num_histograms * sizeof(zx_kcounter_histogram_t);
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, ROUNDUP_PAGE_SIZE(size), &vmo);
+    if (status != ZX_OK)
+        return status;
+    vmo->set_name("kcounters", sizeof("kcounters") - 1);
+
+    zx_kcounter_snapshot_header_t header = {};
+    header.magic = ZX_KCOUNTER_SNAPSHOT_MAGIC;
+    header.version = ZX_KCOUNTER_SNAPSHOT_VERSION;
+    header.timestamp = current_time();
+    header.counter_count = static_cast<uint32_t>(num_counters);
+    header.histogram_count = static_cast<uint32_t>(num_histograms);
+    header.histogram_buckets = ZX_KCOUNTER_HISTOGRAM_BUCKETS;
+    uint64_t offset = 0;
+    if ((status = vmo->Write(&header, offset, sizeof(header))) != ZX_OK)
+        return status;
+    offset += sizeof(header);
+
+    for (auto it = kcountdesc_begin; it != kcountdesc_end; ++it) {
+        zx_kcounter_t counter = {};
+        strlcpy(counter.name, it->name, sizeof(counter.name));
+        counter.value = sum_counter(kcounter_index(it));
+        if ((status = vmo->Write(&counter, offset, sizeof(counter))) != ZX_OK)
+            return status;
+        offset += sizeof(counter);
+    }
+
+    for (auto it = kcounthistdesc_begin; it != kcounthistdesc_end; ++it) {
+        zx_kcounter_histogram_t histogram = {};
+        strlcpy(histogram.name, it->name, sizeof(histogram.name));
+        sum_histogram(kcounter_histogram_index(it), histogram.buckets);
+        if ((status = vmo->Write(&histogram, offset, sizeof(histogram))) != ZX_OK)
+            return status;
+        offset += sizeof(histogram);
+    }
+
+    *out = fbl::move(vmo);
+    return ZX_OK;
+}
+
 LK_INIT_HOOK(kcounters, counters_init, LK_INIT_LEVEL_PLATFORM_EARLY);
 
 STATIC_COMMAND_START
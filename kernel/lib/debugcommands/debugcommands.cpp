@@ -8,6 +8,7 @@
 
 #include <ctype.h>
 #include <debug.h>
+#include <inttypes.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <list.h>
@@ -16,6 +17,9 @@
 #include <platform.h>
 #include <platform/debug.h>
 #include <kernel/cmdline.h>
+#include <kernel/mp.h>
+#include <kernel/percpu.h>
+#include <kernel/stats.h>
 #include <kernel/thread.h>
 #include <vm/pmm.h>
 #include <arch.h>
@@ -34,6 +38,7 @@ static int cmd_sleep(int argc, const cmd_args *argv, uint32_t flags);
 static int cmd_crash(int argc, const cmd_args *argv, uint32_t flags);
 static int cmd_stackstomp(int argc, const cmd_args *argv, uint32_t flags);
 static int cmd_cmdline(int argc, const cmd_args *argv, uint32_t flags);
+static int cmd_sched(int argc, const cmd_args *argv, uint32_t flags);
 
 STATIC_COMMAND_START
 #if LK_DEBUGLEVEL > 0
@@ -54,6 +59,7 @@ STATIC_COMMAND("stackstomp", "intentionally overrun the stack", &cmd_stackstomp)
 STATIC_COMMAND("mtest", "simple memory test", &cmd_memtest)
 #endif
 STATIC_COMMAND("cmdline", "display kernel commandline", &cmd_cmdline)
+STATIC_COMMAND("sched", "display scheduler statistics", &cmd_sched)
 STATIC_COMMAND("sleep", "sleep number of seconds", &cmd_sleep)
 STATIC_COMMAND("sleepm", "sleep number of milliseconds", &cmd_sleep)
 STATIC_COMMAND_END(mem);
@@ -374,3 +380,48 @@ static int cmd_cmdline(int argc, const cmd_args *argv, uint32_t flags)
 
     return 0;
 }
+
+static void print_sched_histogram(const char *name, const ulong *hist, const char *unit)
+{
+    printf("\t%-15s", name);
+    for (uint i = 0; i < SCHED_STATS_BUCKETS; i++) {
+        if (hist[i] == 0)
+            continue;
+        if (i == SCHED_STATS_BUCKETS - 1) {
+            printf(" >=%" PRIu64 "%s:%lu", uint64_t{1} << (i - 1), unit, hist[i]);
+        } else {
+            printf(" <%" PRIu64 "%s:%lu", uint64_t{1} << i, unit, hist[i]);
+        }
+    }
+    printf("\n");
+}
+
+static int cmd_sched(int argc, const cmd_args *argv, uint32_t flags)
+{
+    cpu_num_t first = 0;
+    cpu_num_t last = arch_max_num_cpus() - 1;
+    if (argc > 1) {
+        if (argv[1].u >= arch_max_num_cpus()) {
+            printf("usage: %s [cpu]\n", argv[0].str);
+            return -1;
+        }
+        first = last = static_cast<cpu_num_t>(argv[1].u);
+    }
+
+    // the counters are read without the locks that guard them, so a cpu
+    // that is busy may show a slightly inconsistent set of them
+    for (cpu_num_t i = first; i <= last; i++) {
+        if (!mp_is_cpu_active(i))
+            continue;
+
+        const struct sched_stats *stats = &percpu[i].sched_stats;
+        printf("cpu %u: run queue %u, involuntary switches %lu, migrations %lu (%lu cross llc)\n",
+               i, percpu[i].run_queue_len, stats->involuntary_switches,
+               stats->migrations, stats->migrations_cross_llc);
+        print_sched_histogram("wakeup latency", stats->wakeup_latency, "us");
+        print_sched_histogram("run time", stats->run_time, "us");
+        print_sched_histogram("queue length", stats->queue_len, "");
+    }
+
+    return 0;
+}
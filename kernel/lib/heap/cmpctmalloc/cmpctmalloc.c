@@ -1050,6 +1050,12 @@ void* cmpct_realloc(void* payload, size_t size) {
     return new_payload;
 }
 
+size_t cmpct_usable_size(void* payload) {
+    const header_t* header = (header_t*)payload - 1;
+    DEBUG_ASSERT(!is_tagged_as_free(header));
+    return header->size - sizeof(header_t);
+}
+
 static void add_to_heap(void* new_area, size_t size) {
     void* top = (char*)new_area + size;
     // Set up the left sentinel. Its |left| field will not have FREE_BIT set,
@@ -0,0 +1,166 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include "heap_cache.h"
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <inttypes.h>
+#include <kernel/align.h>
+#include <kernel/spinlock.h>
+#include <lib/cmpctmalloc.h>
+#include <stdio.h>
+#include <string.h>
+#include <zircon/compiler.h>
+
+namespace {
+
+// 16 byte steps up to 128 bytes, then 64 byte steps.
+constexpr size_t kClassSizes[] = {
+    16, 32, 48, 64, 80, 96, 112, 128,
+    192, 256, 320, 384, 448, 512,
+};
+constexpr size_t kNumClasses = countof(kClassSizes);
+static_assert(kClassSizes[kNumClasses - 1] == kHeapCacheMaxSize, "");
+
+// Blocks kept per size class per CPU. When a bin overflows, half of it goes
+// back to cmpctmalloc.
+constexpr size_t kBinSize = 16;
+
+// The smallest class that holds |size| bytes.
+size_t ClassForAlloc(size_t size) {
+    DEBUG_ASSERT(size > 0 && size <= kHeapCacheMaxSize);
+    if (size <= 128)
+        return (size - 1) / 16;
+    return 8 + (size - 129) / 64;
+}
+
+// The largest class that a block of |usable| bytes can serve, or kNumClasses
+// if it is too small or too big to cache. realloc can shrink a block below
+// the smallest class.
+size_t ClassForFree(size_t usable) {
+    if (usable < kClassSizes[0] || usable > kHeapCacheMaxSize)
+        return kNumClasses;
+    if (usable < 192)
+        return (usable >= 128 ? 128 : usable) / 16 - 1;
+    return 8 + (usable - 192) / 64;
+}
+
+struct Bin {
+    size_t count;
+    void* blocks[kBinSize];
+};
+
+// Zero initialized, which is an unlocked spinlock, since malloc is used
+// before global constructors run.
+struct __CPU_ALIGN CpuCache {
+    spin_lock_t lock;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t flushes;
+    Bin bins[kNumClasses];
+};
+
+CpuCache cpu_caches[SMP_MAX_CPUS];
+
+} // namespace
+
+void* heap_cache_alloc(size_t size) {
+    const size_t index = ClassForAlloc(size);
+
+    spin_lock_saved_state_t state;
+    CpuCache& cache = cpu_caches[arch_curr_cpu_num()];
+    spin_lock_irqsave(&cache.lock, state);
+    Bin& bin = cache.bins[index];
+    if (likely(bin.count > 0)) {
+        void* ptr = bin.blocks[--bin.count];
+        cache.hits++;
+        spin_unlock_irqrestore(&cache.lock, state);
+        return ptr;
+    }
+    cache.misses++;
+    spin_unlock_irqrestore(&cache.lock, state);
+
+    // Allocate the whole class size, so the block can serve any request of
+    // this class once freed.
+    return cmpct_alloc(kClassSizes[index]);
+}
+
+bool heap_cache_free(void* ptr) {
+    const size_t index = ClassForFree(cmpct_usable_size(ptr));
+    if (index == kNumClasses)
+        return false;
+
+    void* flush[kBinSize / 2];
+    spin_lock_saved_state_t state;
+    CpuCache& cache = cpu_caches[arch_curr_cpu_num()];
+    spin_lock_irqsave(&cache.lock, state);
+    Bin& bin = cache.bins[index];
+    if (likely(bin.count < kBinSize)) {
+        bin.blocks[bin.count++] = ptr;
+        spin_unlock_irqrestore(&cache.lock, state);
+        return true;
+    }
+    // Send the oldest half back and keep the ones most likely still in cache.
+    memcpy(flush, bin.blocks, sizeof(flush));
+    memmove(bin.blocks, bin.blocks + countof(flush), (kBinSize - countof(flush)) * sizeof(void*));
+    bin.count -= countof(flush);
+    bin.blocks[bin.count++] = ptr;
+    cache.flushes++;
+    spin_unlock_irqrestore(&cache.lock, state);
+
+    for (void* block : flush)
+        cmpct_free(block);
+    return true;
+}
+
+void heap_cache_drain() {
+    for (auto& cache : cpu_caches) {
+        for (size_t i = 0; i < kNumClasses; i++) {
+            void* blocks[kBinSize];
+            size_t count;
+
+            spin_lock_saved_state_t state;
+            spin_lock_irqsave(&cache.lock, state);
+            count = cache.bins[i].count;
+            memcpy(blocks, cache.bins[i].blocks, count * sizeof(void*));
+            cache.bins[i].count = 0;
+            spin_unlock_irqrestore(&cache.lock, state);
+
+            for (size_t j = 0; j < count; j++)
+                cmpct_free(blocks[j]);
+        }
+    }
+}
+
+void heap_cache_dump(bool panic_time) {
+    // At panic time the other CPUs may have been stopped holding their locks,
+    // so just read what is there.
+    uint64_t hits = 0, misses = 0, flushes = 0;
+    size_t blocks[kNumClasses] = {};
+    for (auto& cache : cpu_caches) {
+        spin_lock_saved_state_t state{};
+        if (!panic_time)
+            spin_lock_irqsave(&cache.lock, state);
+        hits += cache.hits;
+        misses += cache.misses;
+        flushes += cache.flushes;
+        for (size_t i = 0; i < kNumClasses; i++)
+            blocks[i] += cache.bins[i].count;
+        if (!panic_time)
+            spin_unlock_irqrestore(&cache.lock, state);
+    }
+
+    size_t bytes = 0;
+    printf("\tper-cpu cache: %" PRIu64 " hits, %" PRIu64 " misses, %" PRIu64 " flushes\n",
+           hits, misses, flushes);
+    printf("\tcached blocks:");
+    for (size_t i = 0; i < kNumClasses; i++) {
+        printf(" %zu:%zu", kClassSizes[i], blocks[i]);
+        bytes += blocks[i] * kClassSizes[i];
+    }
+    printf("\n\tcached bytes: %zu\n", bytes);
+}
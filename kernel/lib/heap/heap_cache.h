@@ -0,0 +1,32 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stddef.h>
+
+// A per-CPU cache of small heap blocks in front of cmpctmalloc.
+//
+// Small requests are rounded up to one of a few size classes, and each CPU
+// keeps a short stack of free blocks of each class. Blocks in the cache are
+// still allocated as far as cmpctmalloc is concerned, so they can be handed
+// back to it at any time.
+
+// Requests larger than this go straight to cmpctmalloc.
+constexpr size_t kHeapCacheMaxSize = 512;
+
+// Returns a block of at least |size| bytes, where 0 < |size| <=
+// kHeapCacheMaxSize, from this CPU's cache or else from cmpctmalloc.
+void* heap_cache_alloc(size_t size);
+
+// Keeps |ptr|, which came from cmpctmalloc, in this CPU's cache. Returns false
+// if it is too big to be cached, in which case the caller must free it.
+bool heap_cache_free(void* ptr);
+
+// Gives every cached block back to cmpctmalloc.
+void heap_cache_drain();
+
+void heap_cache_dump(bool panic_time);
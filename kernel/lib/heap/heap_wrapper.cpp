@@ -22,8 +22,14 @@
 #include <vm/pmm.h>
 #include <vm/vm.h>
 
+#include "heap_cache.h"
+
 #define LOCAL_TRACE 0
 
+#ifndef HEAP_PERCPU_CACHE
+#define HEAP_PERCPU_CACHE 1
+#endif
+
 #ifndef HEAP_PANIC_ON_ALLOC_FAIL
 #if LK_DEBUGLEVEL > 2
 #define HEAP_PANIC_ON_ALLOC_FAIL 1
@@ -44,15 +50,26 @@ void heap_init() {
 }
 
 void heap_trim() {
+#if HEAP_PERCPU_CACHE
+    heap_cache_drain();
+#endif
     cmpct_trim();
 }
 
+static inline void* heap_alloc(size_t size) {
+#if HEAP_PERCPU_CACHE
+    if (size > 0 && size <= kHeapCacheMaxSize)
+        return heap_cache_alloc(size);
+#endif
+    return cmpct_alloc(size);
+}
+
 void* malloc(size_t size) {
     DEBUG_ASSERT(!arch_in_int_handler());
 
     LTRACEF("size %zu\n", size);
 
-    void* ptr = cmpct_alloc(size);
+    void* ptr = heap_alloc(size);
     if (unlikely(heap_trace))
         printf("caller %p malloc %zu -> %p\n", __GET_CALLER(), size, ptr);
 
@@ -86,7 +103,7 @@ void* calloc(size_t count, size_t size) {
 
     size_t realsize = count * size;
 
-    void* ptr = cmpct_alloc(realsize);
+    void* ptr = heap_alloc(realsize);
     if (likely(ptr))
         memset(ptr, 0, realsize);
     if (unlikely(heap_trace))
@@ -117,11 +134,18 @@ void free(void* ptr) {
     if (unlikely(heap_trace))
         printf("caller %p free %p\n", __GET_CALLER(), ptr);
 
+#if HEAP_PERCPU_CACHE
+    if (ptr && heap_cache_free(ptr))
+        return;
+#endif
     cmpct_free(ptr);
 }
 
 static void heap_dump(bool panic_time) {
     cmpct_dump(panic_time);
+#if HEAP_PERCPU_CACHE
+    heap_cache_dump(panic_time);
+#endif
 }
 
 void heap_get_info(size_t* size_bytes, size_t* free_bytes) {
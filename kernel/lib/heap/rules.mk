@@ -14,6 +14,18 @@ MODULE := $(LOCAL_DIR)
 MODULE_SRCS += \
 	$(LOCAL_DIR)/heap_wrapper.cpp
 
+# Put a per-CPU cache of small blocks in front of the heap. Set to 0 to send
+# every allocation straight to cmpctmalloc, e.g. to find use-after-frees with
+# its fill patterns.
+HEAP_PERCPU_CACHE ?= 1
+
+ifeq ($(HEAP_PERCPU_CACHE),1)
+MODULE_SRCS += \
+	$(LOCAL_DIR)/heap_cache.cpp
+endif
+
+MODULE_DEFINES += HEAP_PERCPU_CACHE=$(HEAP_PERCPU_CACHE)
+
 # use the cmpctmalloc heap implementation
 MODULE_DEPS := kernel/lib/heap/cmpctmalloc
 
@@ -6,17 +6,31 @@
 
 #include <debug.h>
 #include <err.h>
+#include <inttypes.h>
 #include <platform.h>
 #include <string.h>
 
 #include <arch/ops.h>
 #include <arch/user_copy.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <hypervisor/ktrace.h>
+#include <kernel/align.h>
+#include <kernel/auto_lock.h>
 #include <kernel/cmdline.h>
+#include <kernel/event.h>
+#include <kernel/mp.h>
+#include <kernel/spinlock.h>
+#include <kernel/thread.h>
 #include <lib/ktrace.h>
 #include <lk/init.h>
+#include <object/event_dispatcher.h>
 #include <object/thread_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+#include <vm/vm_address_region.h>
 #include <vm/vm_aspace.h>
+#include <vm/vm_object_paged.h>
 #include <zircon/thread_annotations.h>
 
 #define ktrace_timestamp() current_ticks();
@@ -75,88 +89,411 @@ static void ktrace_report_probes(void) {
     }
 }
 
-typedef struct ktrace_state {
-    // where the next record will be written
-    int offset;
+// Each CPU writes its records to a ring buffer of its own, with interrupts
+// disabled, so that writers never contend with each other or share cache
+// lines.  Name records are written to a separate buffer that all CPUs share
+// under a lock; there are few of them, and a trace is of little use without
+// them.
+typedef struct ktrace_buffer {
+    uint8_t* data;
+    uint64_t size;
+
+    // Positions in the buffer's stream of records, as in
+    // ktrace_buffer_info_t.  Only changed by the buffer's writer: its CPU,
+    // with interrupts disabled, or the holder of meta_lock for the name
+    // buffer.
+    uint64_t head;
+    uint64_t tail;
+    uint64_t dropped;
+
+    // How far the reader has got, in streaming mode.
+    volatile uint64_t consumed;
+
+    // What user space sees of this buffer.  Updated once each record is
+    // complete.
+    ktrace_buffer_info_t* info;
+} __CPU_ALIGN ktrace_buffer_t;
+
+enum {
+    // Tracing stops when a buffer fills up.
+    KTRACE_MODE_ONESHOT,
+    // The oldest records are overwritten when a buffer fills up.
+    KTRACE_MODE_CIRCULAR,
+    // User space drains the buffers while tracing runs, and records that
+    // find their buffer full are dropped.
+    KTRACE_MODE_STREAMING,
+};
 
+typedef struct ktrace_state {
     // mask of groups we allow, 0 == tracing disabled
     int grpmask;
 
-    // total size of the trace buffer
-    uint32_t bufsize;
+    // one of KTRACE_MODE_*, only changed while tracing is disabled
+    int mode;
+
+    // A stopped trace stays readable until tracing starts again, so a
+    // rewind is put off until then.
+    bool rewind_pending;
+
+    // the name records, and each CPU's records
+    ktrace_buffer_t meta;
+    ktrace_buffer_t cpus[SMP_MAX_CPUS];
+    uint32_t num_buffers;
 
-    // offset where tracing was stopped, 0 if tracing active
-    uint32_t marker;
+    // TAG_VERSION and TAG_TICKS_PER_MS, which start what zx_ktrace_read()
+    // returns
+    ktrace_rec_32b_t info_recs[2];
 
-    // raw trace buffer
-    uint8_t* buffer;
+    // the vmo the buffers live in, with the shared header at its start
+    fbl::RefPtr<VmObject> vmo;
+    fbl::RefPtr<VmMapping> mapping;
+    ktrace_stream_header_t* header;
+
+    // handed out by zx_ktrace_stream(), created the first time it's called
+    fbl::RefPtr<Dispatcher> vmo_dispatcher;
+    fbl::RefPtr<Dispatcher> event;
+    thread_t* stream_thread;
 } ktrace_state_t;
 
 static ktrace_state_t KTRACE_STATE;
 
-ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len) {
+// Serializes control, reads and streaming setup.
+static fbl::Mutex ktrace_lock;
+
+// Serializes writers of the name buffer, which all CPUs share.
+static SpinLock meta_lock;
+
+// Signaled while the stream thread should keep watching the buffers.
+static event_t stream_poll_event = EVENT_INITIAL_VALUE(stream_poll_event, false, 0);
+
+// How often the stream thread checks how full the buffers are.
+static constexpr zx_duration_t kStreamPollInterval = ZX_MSEC(10);
+
+// The largest pad record.
+static constexpr uint32_t kMaxPadSize = 0xF << 3;
+
+static ktrace_buffer_t* ktrace_buffer(ktrace_state_t* ks, uint32_t index) {
+    return index == 0 ? &ks->meta : &ks->cpus[index - 1];
+}
+
+static uint64_t ktrace_load_acquire(const uint64_t* ptr) {
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+}
+
+static void ktrace_store_release(uint64_t* ptr, uint64_t value) {
+    __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+}
+
+// Lets user space see the records written so far.  The head goes last, so
+// that everything before it is there by the time it is seen.
+static void ktrace_publish(ktrace_buffer_t* buf) {
+    ktrace_store_release(&buf->info->tail, buf->tail);
+    ktrace_store_release(&buf->info->dropped, buf->dropped);
+    ktrace_store_release(&buf->info->head, buf->head);
+}
+
+static void ktrace_buffer_reset(ktrace_buffer_t* buf) {
+    buf->head = 0;
+    buf->tail = 0;
+    buf->dropped = 0;
+    atomic_store_u64(&buf->consumed, 0);
+    ktrace_publish(buf);
+}
+
+// Makes room for a record of |size| bytes at the head of |buf| and returns
+// where to write it, or null if the record has to be dropped.
+static void* ktrace_reserve(ktrace_state_t* ks, ktrace_buffer_t* buf, uint32_t size) {
+    if (buf->data == nullptr) {
+        return nullptr;
+    }
+
+    // Records don't wrap around the end of the buffer, so a record that
+    // doesn't fit before it starts over at the beginning, and the space
+    // left is padded out.
+    uint64_t offset = buf->head % buf->size;
+    uint64_t pad = (offset + size > buf->size) ? buf->size - offset : 0;
+    uint64_t needed = pad + size;
+
+    if (ks->mode == KTRACE_MODE_STREAMING) {
+        // The reader can't be trusted to report a sensible position.
+        uint64_t consumed = atomic_load_u64(&buf->consumed);
+        buf->tail = fbl::clamp(consumed, buf->tail, buf->head);
+    }
+    if (buf->head + needed - buf->tail > buf->size) {
+        if (ks->mode != KTRACE_MODE_CIRCULAR || buf == &ks->meta) {
+            buf->dropped++;
+            return nullptr;
+        }
+        // Evict the oldest records, pads included, until there's room.
+        while (buf->head + needed - buf->tail > buf->size) {
+            uint32_t tag = *reinterpret_cast<uint32_t*>(buf->data + buf->tail % buf->size);
+            buf->tail += KTRACE_LEN(tag);
+        }
+    }
+
+    for (uint32_t n; pad > 0; pad -= n, offset += n) {
+        n = static_cast<uint32_t>(fbl::min<uint64_t>(pad, kMaxPadSize));
+        *reinterpret_cast<uint32_t*>(buf->data + offset) = TAG_PAD(n);
+    }
+    buf->head += needed;
+    return buf->data + offset % buf->size;
+}
+
+static bool ktrace_append(uint32_t tag, uint32_t tid, const void* args, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    const uint32_t size = KTRACE_LEN(tag);
+    DEBUG_ASSERT(len <= size - KTRACE_HDRSIZE);
 
-    // Buffer size is limited by the marker if set,
-    // otherwise limited by offset (last written point).
-    // Offset can end up pointing past the end, so clip
-    // it to the actual buffer size to be safe.
-    uint32_t max;
-    if (ks->marker) {
-        max = ks->marker;
-    } else {
-        max = ks->offset;
-        if (max > ks->bufsize) {
-            max = ks->bufsize;
+    spin_lock_saved_state_t state;
+    arch_interrupt_save(&state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+
+    // Checked again with interrupts disabled, so that once tracing has been
+    // disabled and every CPU has taken an interrupt, no record is still
+    // being written.
+    bool written = false;
+    if (tag & atomic_load(&ks->grpmask)) {
+        ktrace_buffer_t* buf = &ks->cpus[arch_curr_cpu_num()];
+        ktrace_header_t* hdr = static_cast<ktrace_header_t*>(ktrace_reserve(ks, buf, size));
+        if (hdr != nullptr) {
+            hdr->ts = ktrace_timestamp();
+            hdr->tag = tag;
+            hdr->tid = tid;
+            uint8_t* payload = reinterpret_cast<uint8_t*>(hdr + 1);
+            if (len > 0) {
+                memcpy(payload, args, len);
+            }
+            memset(payload + len, 0, size - KTRACE_HDRSIZE - len);
+            written = true;
+        } else if (ks->mode == KTRACE_MODE_ONESHOT) {
+            // if we arrive at the end, stop
+            atomic_store(&ks->grpmask, 0);
         }
+        ktrace_publish(buf);
     }
 
-    // null read is a query for trace buffer size
-    if (ptr == nullptr) {
-        return max;
+    arch_interrupt_restore(state, ARCH_DEFAULT_SPIN_LOCK_FLAG_INTERRUPTS);
+    return written;
+}
+
+// Stops new records from being written, and waits for the ones being
+// written to be finished.
+static void ktrace_disable_locked(ktrace_state_t* ks) TA_REQ(ktrace_lock) {
+    atomic_store(&ks->grpmask, 0);
+    mp_sync_exec(MP_IPI_TARGET_ALL, 0, [](void*) {}, nullptr);
+}
+
+// Empties all the buffers, and writes the names that are always there.
+// Tracing must be disabled.
+static void ktrace_rewind_locked(ktrace_state_t* ks) TA_REQ(ktrace_lock) {
+    ks->rewind_pending = false;
+    {
+        AutoSpinLock guard(&meta_lock);
+        ktrace_buffer_reset(&ks->meta);
+    }
+    for (uint32_t i = 1; i < ks->num_buffers; i++) {
+        ktrace_buffer_reset(ktrace_buffer(ks, i));
+    }
+    if (ks->header != nullptr) {
+        atomic_store_relaxed_u32(&ks->header->stopped, 0);
+    }
+
+    ktrace_report_syscalls(kt_syscall_info);
+    ktrace_report_probes();
+    ktrace_report_vcpu_meta();
+}
+
+// Signals the stream's event if there's something for the reader to do.
+static void ktrace_stream_update_locked(ktrace_state_t* ks) TA_REQ(ktrace_lock) {
+    if (ks->mode != KTRACE_MODE_STREAMING) {
+        event_unsignal(&stream_poll_event);
+        return;
+    }
+
+    const bool stopped = atomic_load_u32(&ks->header->stopped) != 0;
+    bool full = false;
+    for (uint32_t i = 0; i < ks->num_buffers; i++) {
+        ktrace_buffer_t* buf = ktrace_buffer(ks, i);
+        uint64_t head = ktrace_load_acquire(&buf->info->head);
+        uint64_t consumed = fbl::min(atomic_load_u64(&buf->consumed), head);
+        if ((head - consumed) * 100 >= buf->size * KTRACE_STREAM_WATERMARK_PERCENT) {
+            full = true;
+        }
+    }
+
+    if (stopped || full) {
+        ks->event->user_signal(0, ZX_EVENT_SIGNALED, false);
+    } else {
+        ks->event->user_signal(ZX_EVENT_SIGNALED, 0, false);
+    }
+    if (stopped) {
+        // The reader drains the buffers one last time, and that's it.
+        event_unsignal(&stream_poll_event);
+    }
+}
+
+static int ktrace_stream_thread(void* arg) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    for (;;) {
+        event_wait(&stream_poll_event);
+        thread_sleep_relative(kStreamPollInterval);
+
+        fbl::AutoLock lock(&ktrace_lock);
+        ktrace_stream_update_locked(ks);
+    }
+    return 0;
+}
+
+// Lays out the trace as zx_ktrace_read() returns it, one piece at a time,
+// copying out the part of it that was asked for.
+typedef struct ktrace_reader {
+    uint8_t* ptr;
+    uint64_t off;
+    uint64_t len;
+    // how much of the trace has been laid out so far
+    uint64_t pos;
+    uint64_t actual;
+    zx_status_t status;
+} ktrace_reader_t;
+
+static void ktrace_read_piece(ktrace_reader_t* r, const void* data, uint64_t size) {
+    const uint64_t start = r->pos;
+    r->pos += size;
+    if (r->ptr == nullptr || r->status != ZX_OK) {
+        return;
+    }
+
+    const uint64_t from = fbl::max(start, r->off);
+    const uint64_t to = fbl::min(r->pos, r->off + r->len);
+    if (from >= to) {
+        return;
+    }
+    if (arch_copy_to_user(r->ptr + (from - r->off),
+                          static_cast<const uint8_t*>(data) + (from - start),
+                          to - from) != ZX_OK) {
+        r->status = ZX_ERR_INVALID_ARGS;
+        return;
+    }
+    r->actual += to - from;
+}
+
+// The records between |tail| and |head|, in one or two pieces.
+static void ktrace_read_buffer(ktrace_reader_t* r, const ktrace_buffer_t* buf,
+                               uint64_t tail, uint64_t head) {
+    while (tail < head) {
+        const uint64_t offset = tail % buf->size;
+        const uint64_t size = fbl::min(head - tail, buf->size - offset);
+        ktrace_read_piece(r, buf->data + offset, size);
+        tail += size;
     }
+}
+
+ssize_t ktrace_read_user(void* ptr, uint32_t off, size_t len) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    fbl::AutoLock lock(&ktrace_lock);
 
-    // constrain read to available buffer
-    if (off >= max) {
+    // the reader has the buffers to itself
+    if (ks->mode == KTRACE_MODE_STREAMING) {
+        return ZX_ERR_BAD_STATE;
+    }
+    if (ks->vmo == nullptr) {
         return 0;
     }
-    if (len > (max - off)) {
-        len = max - off;
+
+    ktrace_reader_t r = {static_cast<uint8_t*>(ptr), off, len, 0, 0, ZX_OK};
+    ktrace_read_piece(&r, ks->info_recs, sizeof(ks->info_recs));
+
+    // Only what has been published is read, so records still being written
+    // are left out.  While tracing runs in circular mode, records can be
+    // overwritten as they are read.  The writers publish the tail before the
+    // head, so loading the tail first keeps it at or behind the head.  If the
+    // head lapped it in between, the tail is no longer a record boundary
+    // within the buffer, so both are loaded again.
+    for (uint32_t i = 0; i < ks->num_buffers; i++) {
+        const ktrace_buffer_t* buf = ktrace_buffer(ks, i);
+        uint64_t tail;
+        uint64_t head;
+        do {
+            tail = ktrace_load_acquire(&buf->info->tail);
+            head = ktrace_load_acquire(&buf->info->head);
+        } while (head - tail > buf->size);
+        if (i > 0) {
+            if (head == tail) {
+                continue;
+            }
+            ktrace_rec_32b_t rec = {};
+            rec.tag = TAG_CPU_BUFFER;
+            rec.a = i - 1;
+            rec.b = static_cast<uint32_t>(head - tail);
+            rec.c = static_cast<uint32_t>(ktrace_load_acquire(&buf->info->dropped));
+            ktrace_read_piece(&r, &rec, sizeof(rec));
+        }
+        ktrace_read_buffer(&r, buf, tail, head);
     }
 
-    if (arch_copy_to_user(ptr, ks->buffer + off, len) != ZX_OK) {
-        return ZX_ERR_INVALID_ARGS;
+    if (r.status != ZX_OK) {
+        return r.status;
     }
-    return len;
+
+    // null read is a query for trace buffer size
+    return ptr == nullptr ? static_cast<ssize_t>(r.pos) : static_cast<ssize_t>(r.actual);
 }
 
 zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
     ktrace_state_t* ks = &KTRACE_STATE;
+    // there are no buffers if tracing was disabled at boot
+    if (ks->vmo == nullptr && action != KTRACE_ACTION_NEW_PROBE) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
     switch (action) {
     case KTRACE_ACTION_START:
+    case KTRACE_ACTION_START_CIRCULAR: {
+        fbl::AutoLock lock(&ktrace_lock);
+        const int mode = action == KTRACE_ACTION_START ? KTRACE_MODE_ONESHOT
+                                                       : KTRACE_MODE_CIRCULAR;
+        if (ks->mode != mode) {
+            // a stream belongs to its reader
+            if (ks->mode == KTRACE_MODE_STREAMING && atomic_load(&ks->grpmask)) {
+                return ZX_ERR_BAD_STATE;
+            }
+            ktrace_disable_locked(ks);
+            if (ks->mode == KTRACE_MODE_STREAMING) {
+                ks->rewind_pending = true;
+            }
+            ks->mode = mode;
+        }
+        if (ks->rewind_pending) {
+            ktrace_rewind_locked(ks);
+        }
         options = KTRACE_GRP_TO_MASK(options);
-        ks->marker = 0;
         atomic_store(&ks->grpmask, options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL));
         ktrace_report_live_processes();
         ktrace_report_live_threads();
         break;
+    }
     case KTRACE_ACTION_STOP: {
-        atomic_store(&ks->grpmask, 0);
-        uint32_t n = ks->offset;
-        if (n > ks->bufsize) {
-            ks->marker = ks->bufsize;
-        } else {
-            ks->marker = n;
+        fbl::AutoLock lock(&ktrace_lock);
+        ktrace_disable_locked(ks);
+        if (ks->mode == KTRACE_MODE_STREAMING) {
+            atomic_store_relaxed_u32(&ks->header->stopped, 1);
+            ktrace_stream_update_locked(ks);
         }
         break;
     }
-    case KTRACE_ACTION_REWIND:
-        // roll back to just after the metadata
-        atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
-        ktrace_report_syscalls(kt_syscall_info);
-        ktrace_report_probes();
-        ktrace_report_vcpu_meta();
+    case KTRACE_ACTION_REWIND: {
+        fbl::AutoLock lock(&ktrace_lock);
+        const int grpmask = atomic_load(&ks->grpmask);
+        if (grpmask == 0) {
+            ks->rewind_pending = true;
+            break;
+        }
+        if (ks->mode == KTRACE_MODE_STREAMING) {
+            return ZX_ERR_BAD_STATE;
+        }
+        ktrace_disable_locked(ks);
+        ktrace_rewind_locked(ks);
+        atomic_store(&ks->grpmask, grpmask);
         break;
+    }
     case KTRACE_ACTION_NEW_PROBE: {
         fbl::AutoLock lock(&probe_list_lock);
         ktrace_probe_info_t* probe;
@@ -172,40 +509,151 @@ zx_status_t ktrace_control(uint32_t action, uint32_t options, void* ptr) {
         ktrace_add_probe(probe);
         return probe->num;
     }
+    case KTRACE_ACTION_CONSUME: {
+        fbl::AutoLock lock(&ktrace_lock);
+        if (ks->mode != KTRACE_MODE_STREAMING) {
+            return ZX_ERR_BAD_STATE;
+        }
+        // The writers make sure these stay between their tail and head.
+        const uint64_t* consumed = static_cast<const uint64_t*>(ptr);
+        const uint32_t count = fbl::min(options, ks->num_buffers);
+        for (uint32_t i = 0; i < count; i++) {
+            atomic_store_u64(&ktrace_buffer(ks, i)->consumed, consumed[i]);
+        }
+        ktrace_stream_update_locked(ks);
+        break;
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
     return ZX_OK;
 }
 
+zx_status_t ktrace_stream(uint32_t grpmask, fbl::RefPtr<Dispatcher>* vmo,
+                          fbl::RefPtr<Dispatcher>* event) {
+    ktrace_state_t* ks = &KTRACE_STATE;
+    if (ks->vmo == nullptr) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    fbl::AutoLock lock(&ktrace_lock);
+    if (ks->mode == KTRACE_MODE_STREAMING && atomic_load(&ks->grpmask)) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // A vmo can only have one dispatcher, so every stream gets the same one.
+    zx_status_t status;
+    zx_rights_t rights;
+    if (ks->vmo_dispatcher == nullptr) {
+        if ((status = VmObjectDispatcher::Create(ks->vmo, &ks->vmo_dispatcher, &rights)) != ZX_OK) {
+            return status;
+        }
+    }
+    if (ks->event == nullptr) {
+        if ((status = EventDispatcher::Create(0, &ks->event, &rights)) != ZX_OK) {
+            return status;
+        }
+    }
+    if (ks->stream_thread == nullptr) {
+        ks->stream_thread = thread_create("ktrace-stream", ktrace_stream_thread, nullptr,
+                                          DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        if (ks->stream_thread == nullptr) {
+            return ZX_ERR_NO_RESOURCES;
+        }
+        thread_detach_and_resume(ks->stream_thread);
+    }
+
+    ktrace_disable_locked(ks);
+    ks->mode = KTRACE_MODE_STREAMING;
+    ktrace_rewind_locked(ks);
+    ks->event->user_signal(ZX_EVENT_SIGNALED, 0, false);
+    atomic_store(&ks->grpmask, grpmask);
+    ktrace_report_live_processes();
+    ktrace_report_live_threads();
+    event_signal(&stream_poll_event, true);
+
+    *vmo = ks->vmo_dispatcher;
+    *event = ks->event;
+    return ZX_OK;
+}
+
 int trace_not_ready = 0;
 
+static void ktrace_buffer_init(ktrace_state_t* ks, ktrace_buffer_t* buf,
+                               ktrace_buffer_info_t* info, uint64_t offset, uint64_t size) {
+    buf->data = reinterpret_cast<uint8_t*>(ks->mapping->base()) + offset;
+    buf->size = size;
+    buf->info = info;
+    info->offset = offset;
+    info->size = size;
+    ktrace_buffer_reset(buf);
+}
+
 void ktrace_init(unsigned level) {
     ktrace_state_t* ks = &KTRACE_STATE;
 
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
     uint32_t mb = cmdline_get_uint32("ktrace.bufsize", KTRACE_DEFAULT_BUFSIZE);
     uint32_t grpmask = cmdline_get_uint32("ktrace.grpmask", KTRACE_DEFAULT_GRPMASK);
+    bool circular = cmdline_get_bool("ktrace.circular", false);
 
     if (mb == 0) {
         dprintf(INFO, "ktrace: disabled\n");
         return;
     }
 
-    mb *= (1024*1024);
+    // The buffers share a vmo, which user space maps in streaming mode.  It
+    // starts with the shared header, then the name buffer, which gets a
+    // sixteenth of the space, and then each CPU's buffer.
+    const uint32_t num_cpus = arch_max_num_cpus();
+    const uint64_t total = static_cast<uint64_t>(mb) * 1024 * 1024;
+    const uint64_t header_size = ROUNDUP(sizeof(ktrace_stream_header_t) +
+                                         (1 + num_cpus) * sizeof(ktrace_buffer_info_t),
+                                         PAGE_SIZE);
+    const uint64_t meta_size = ROUNDUP(total / 16, PAGE_SIZE);
+    const uint64_t cpu_size = ROUNDDOWN((total - meta_size) / num_cpus, PAGE_SIZE);
+    if (cpu_size == 0) {
+        dprintf(INFO, "ktrace: %u MB is too small for %u cpus\n", mb, num_cpus);
+        return;
+    }
+    const uint64_t size = header_size + meta_size + num_cpus * cpu_size;
 
     zx_status_t status;
-    VmAspace* aspace = VmAspace::kernel_aspace();
-    if ((status = aspace->Alloc("ktrace", mb, (void**)&ks->buffer, 0, VmAspace::VMM_FLAG_COMMIT,
-                                ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE)) < 0) {
+    if ((status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, size, &ks->vmo)) != ZX_OK) {
         dprintf(INFO, "ktrace: cannot alloc buffer %d\n", status);
         return;
     }
+    ks->vmo->set_name("ktrace", sizeof("ktrace") - 1);
+    if ((status = VmAspace::kernel_aspace()->RootVmar()->CreateVmMapping(
+             0 /* ignored */, size, 0 /* align pow2 */, 0 /* vmar flags */, ks->vmo, 0,
+             ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE, "ktrace", &ks->mapping)) != ZX_OK ||
+        (status = ks->mapping->MapRange(0, size, true)) != ZX_OK) {
+        dprintf(INFO, "ktrace: cannot map buffer %d\n", status);
+        if (ks->mapping != nullptr) {
+            ks->mapping->Destroy();
+            ks->mapping.reset();
+        }
+        ks->vmo.reset();
+        return;
+    }
 
-    // The last packet written can overhang the end of the buffer,
-    // so we reduce the reported size by the max size of a record
-    ks->bufsize = mb - 256;
+    uint64_t n = ktrace_ticks_per_ms();
+    ks->header = reinterpret_cast<ktrace_stream_header_t*>(ks->mapping->base());
+    ks->header->version = KTRACE_VERSION;
+    ks->header->num_buffers = 1 + num_cpus;
+    ks->header->ticks_per_ms = n;
+
+    ktrace_buffer_info_t* info = reinterpret_cast<ktrace_buffer_info_t*>(ks->header + 1);
+    ks->num_buffers = 1 + num_cpus;
+    ktrace_buffer_init(ks, &ks->meta, &info[0], header_size, meta_size);
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        ktrace_buffer_init(ks, &ks->cpus[cpu], &info[1 + cpu],
+                           header_size + meta_size + cpu * cpu_size, cpu_size);
+    }
+    ks->mode = circular ? KTRACE_MODE_CIRCULAR : KTRACE_MODE_ONESHOT;
 
-    dprintf(INFO, "ktrace: buffer at %p (%u bytes)\n", ks->buffer, mb);
+    dprintf(INFO, "ktrace: buffers at %p (%" PRIu64 " bytes per cpu)\n",
+            ks->cpus[0].data, cpu_size);
 
     // register all static probes
     {
@@ -217,17 +665,14 @@ void ktrace_init(unsigned level) {
         }
     }
 
-    // write metadata to the first two event slots
-    uint64_t n = ktrace_ticks_per_ms();
-    ktrace_rec_32b_t* rec = (ktrace_rec_32b_t*) ks->buffer;
-    rec[0].tag = TAG_VERSION;
-    rec[0].a = KTRACE_VERSION;
-    rec[1].tag = TAG_TICKS_PER_MS;
-    rec[1].a = (uint32_t)n;
-    rec[1].b = (uint32_t)(n >> 32);
+    // the metadata that starts what zx_ktrace_read() returns
+    ks->info_recs[0].tag = TAG_VERSION;
+    ks->info_recs[0].a = KTRACE_VERSION;
+    ks->info_recs[1].tag = TAG_TICKS_PER_MS;
+    ks->info_recs[1].a = (uint32_t)n;
+    ks->info_recs[1].b = (uint32_t)(n >> 32);
 
     // enable tracing
-    atomic_store(&ks->offset, KTRACE_RECSIZE * 2);
     ktrace_report_syscalls(kt_syscall_info);
     ktrace_report_probes();
     atomic_store(&ks->grpmask, KTRACE_GRP_TO_MASK(grpmask));
@@ -248,38 +693,16 @@ void ktrace_init(unsigned level) {
 void ktrace_tiny(uint32_t tag, uint32_t arg) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (tag & atomic_load(&ks->grpmask)) {
-        tag = (tag & 0xFFFFFFF0) | 2;
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_HDRSIZE)) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-            hdr->ts = ktrace_timestamp();
-            hdr->tag = tag;
-            hdr->tid = arg;
-        }
+        ktrace_append((tag & 0xFFFFFFF0) | 2, arg, nullptr, 0);
     }
 }
 
-void* ktrace_open(uint32_t tag) {
+bool ktrace_record(uint32_t tag, const void* args, size_t len) {
     ktrace_state_t* ks = &KTRACE_STATE;
     if (!(tag & atomic_load(&ks->grpmask))) {
-        return nullptr;
-    }
-
-    int off;
-    if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-        // if we arrive at the end, stop
-        atomic_store(&ks->grpmask, 0);
-        return nullptr;
+        return false;
     }
-
-    ktrace_header_t* hdr = (ktrace_header_t*) (ks->buffer + off);
-    hdr->ts = ktrace_timestamp();
-    hdr->tag = tag;
-    hdr->tid = (uint32_t)get_current_thread()->user_tid;
-    return hdr + 1;
+    return ktrace_append(tag, (uint32_t)get_current_thread()->user_tid, args, len);
 }
 
 void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name, bool always) {
@@ -290,17 +713,19 @@ void ktrace_name_etc(uint32_t tag, uint32_t id, uint32_t arg, const char* name,
         // set size to: sizeof(hdr) + len + 1, round up to multiple of 8
         tag = (tag & 0xFFFFFFF0) | ((KTRACE_NAMESIZE + len + 1 + 7) >> 3);
 
-        int off;
-        if ((off = atomic_add(&ks->offset, KTRACE_LEN(tag))) >= (int)ks->bufsize) {
-            // if we arrive at the end, stop
-            atomic_store(&ks->grpmask, 0);
-        } else {
-            ktrace_rec_name_t* rec = (ktrace_rec_name_t*) (ks->buffer + off);
+        // Names are not timestamped, and don't belong to any one CPU.
+        AutoSpinLock guard(&meta_lock);
+        ktrace_rec_name_t* rec =
+            static_cast<ktrace_rec_name_t*>(ktrace_reserve(ks, &ks->meta, KTRACE_LEN(tag)));
+        if (rec != nullptr) {
+            memset(rec, 0, KTRACE_LEN(tag));
             rec->tag = tag;
             rec->id = id;
             rec->arg = arg;
             memcpy(rec->name, name, len);
-            rec->name[len] = 0;
+        }
+        if (ks->meta.info != nullptr) {
+            ktrace_publish(&ks->meta);
         }
     }
 }
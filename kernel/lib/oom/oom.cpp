@@ -8,6 +8,7 @@
 
 #include <kernel/thread.h>
 #include <vm/pmm.h>
+#include <vm/reclaim.h>
 #include <lib/console.h>
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
@@ -106,7 +107,15 @@ static int oom_loop(void* arg) {
         last_free_bytes = free_bytes;
 
         if (lowmem) {
-            lowmem_callback(shortfall_bytes);
+            // Free what can be brought back before killing anything.
+            const uint64_t shortfall_pages = ROUNDUP(shortfall_bytes, PAGE_SIZE) / PAGE_SIZE;
+            const uint64_t evicted_pages = reclaim_evict_pages(shortfall_pages);
+            if (evicted_pages > 0) {
+                printf("OOM: evicted %" PRIu64 " pages\n", evicted_pages);
+            }
+            if (evicted_pages < shortfall_pages) {
+                lowmem_callback(shortfall_bytes - evicted_pages * PAGE_SIZE);
+            }
         }
 
         thread_sleep_relative(sleep_duration_ns);
@@ -0,0 +1,41 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+// This file is used both in the kernel and in the vDSO implementation.
+// So it must be compatible with both the kernel and userland header
+// environments.  It must use only the basic types so that struct
+// layouts match exactly in both contexts.
+
+// The clock data gets a page of its own in the vDSO image, so that the
+// kernel can keep updating it while nothing else on that page changes.
+// This is the page size on every supported machine.
+#define VDSO_CLOCK_ALIGN 4096
+#define VDSO_CLOCK_SIZE (2 * 4 + 8)
+
+#ifndef __ASSEMBLER__
+
+#include <stdint.h>
+
+// Unlike vdso_constants, this struct is updated by the kernel while the
+// system runs, whenever the UTC clock is adjusted.  The vDSO reads it
+// with a sequence lock: the kernel makes |generation| odd before it
+// changes anything else and even again afterwards, so a reader that sees
+// the same even generation before and after reading the other members
+// has seen a consistent set of values.
+struct vdso_clock {
+    uint32_t generation;
+    uint32_t reserved;
+
+    // Offset of ZX_CLOCK_UTC from ZX_CLOCK_MONOTONIC, in nanoseconds.
+    int64_t utc_offset;
+};
+
+static_assert(VDSO_CLOCK_SIZE == sizeof(vdso_clock),
+              "Need to adjust VDSO_CLOCK_SIZE");
+
+#endif // __ASSEMBLER__
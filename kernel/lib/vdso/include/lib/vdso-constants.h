@@ -16,7 +16,7 @@
 // hash. There is also a 4 byte 'git-' prefix, and possibly a 6 byte
 // '-dirty' suffix. Let's be generous and use 64 bytes.
 #define MAX_BUILDID_SIZE 64
-#define VDSO_CONSTANTS_SIZE (4 * 4 + 2 * 8 + MAX_BUILDID_SIZE)
+#define VDSO_CONSTANTS_SIZE (8 * 4 + 2 * 8 + MAX_BUILDID_SIZE)
 
 #ifndef __ASSEMBLER__
 
@@ -47,6 +47,19 @@ struct vdso_constants {
     // Number of bytes in an instruction cache line.
     uint32_t icache_line_size;
 
+    // Conversion factor from zx_ticks_get return values to
+    // ZX_CLOCK_MONOTONIC nanoseconds, as a struct fp_32_64
+    // (see <lib/fixed_point.h>).
+    struct {
+        uint32_t l0;
+        uint32_t l32;
+        uint32_t l64;
+    } ns_per_tick;
+
+    // Nonzero if ZX_CLOCK_MONOTONIC and ZX_CLOCK_UTC cannot be computed
+    // from ns_per_tick, so zx_clock_get must ask the kernel for them.
+    uint32_t clock_via_kernel;
+
     // Conversion factor for zx_ticks_get return values to seconds.
     zx_ticks_t ticks_per_second;
 
@@ -24,6 +24,10 @@ public:
         return instance_->RoDso::valid_code_mapping(vmo_offset, size);
     }
 
+    // Publish a new UTC offset to the vDSO's zx_clock_get(ZX_CLOCK_UTC).
+    // Callers must serialize calls to this.
+    static void SetUtcOffset(int64_t offset);
+
     // Given VmAspace::vdso_code_mapping_, return the vDSO base address or 0.
     static uintptr_t base_address(const fbl::RefPtr<VmMapping>& code_mapping);
 
@@ -5,11 +5,14 @@
 // https://opensource.org/licenses/MIT
 
 #include <lib/vdso.h>
+#include <lib/vdso-clock.h>
 #include <lib/vdso-constants.h>
 
 #include <fbl/alloc_checker.h>
 #include <fbl/type_support.h>
+#include <kernel/atomic.h>
 #include <kernel/cmdline.h>
+#include <lib/fixed_point.h>
 #include <object/handle.h>
 #include <platform.h>
 #include <vm/pmm.h>
@@ -200,6 +203,10 @@ void blacklist_##category##_syscalls(VDsoDynSymWindow& dynsym_window, \
 #undef SYSCALL_IN_CATEGORY_END
 #undef SYSCALL_CATEGORY_END
 
+// This window stays mapped for the life of the system, so that changes to
+// the UTC offset can be published to every process's vDSO.
+KernelVmoWindow<vdso_clock>* clock_window;
+
 } // anonymous namespace
 
 const VDso* VDso::instance_ = NULL;
@@ -223,6 +230,13 @@ const VDso* VDso::Create() {
         "vDSO constants", vdso->vmo()->vmo(), VDSO_DATA_CONSTANTS);
     zx_ticks_t per_second = ticks_per_second();
 
+    // The vDSO computes ZX_CLOCK_MONOTONIC and ZX_CLOCK_UTC by itself when
+    // the ticks it can read are what the kernel's clock is made of.
+    struct fp_32_64 ns_per_tick = {};
+    bool clock_via_kernel =
+        per_second == 0 || !platform_usermode_ticks_to_time(&ns_per_tick) ||
+        cmdline_get_bool("vdso.clock_get_via_kernel", false);
+
     // Initialize the constants that should be visible to the vDSO.
     // Rather than assigning each member individually, do this with
     // struct assignment and a compound literal so that the compiler
@@ -232,6 +246,8 @@ const VDso* VDso::Create() {
         {arch_cpu_features()},
         arch_dcache_line_size(),
         arch_icache_line_size(),
+        {ns_per_tick.l0, ns_per_tick.l32, ns_per_tick.l64},
+        clock_via_kernel,
         per_second,
         pmm_count_total_bytes(),
         BUILDID,
@@ -248,6 +264,15 @@ const VDso* VDso::Create() {
         REDIRECT_SYSCALL(dynsym_window, zx_ticks_get, soft_ticks_get);
     }
 
+    static_assert(sizeof(vdso_clock) == VDSO_DATA_CLOCK_SIZE,
+                  "gen-rodso-code.sh is suspect");
+    static_assert(VDSO_DATA_CLOCK % PAGE_SIZE == 0 &&
+                  VDSO_CLOCK_ALIGN == PAGE_SIZE,
+                  "vDSO clock data must have a page to itself");
+    clock_window = new (&ac) KernelVmoWindow<vdso_clock>(
+        "vDSO clock", vdso->vmo()->vmo(), VDSO_DATA_CLOCK);
+    ASSERT(ac.check());
+
     for (size_t v = static_cast<size_t>(Variant::FULL) + 1;
          v < static_cast<size_t>(Variant::COUNT);
          ++v)
@@ -257,6 +282,16 @@ const VDso* VDso::Create() {
     return instance_;
 }
 
+void VDso::SetUtcOffset(int64_t offset) {
+    vdso_clock* clock = clock_window->data();
+    uint32_t generation = clock->generation;
+    atomic_store_relaxed_u32(&clock->generation, generation + 1);
+    atomic_fence();
+    atomic_store_64(&clock->utc_offset, offset);
+    atomic_fence();
+    atomic_store_relaxed_u32(&clock->generation, generation + 2);
+}
+
 uintptr_t VDso::base_address(const fbl::RefPtr<VmMapping>& code_mapping) {
     return code_mapping ? code_mapping->base() - VDSO_CODE_START : 0;
 }
@@ -60,7 +60,7 @@ static void DumpProcessListKeyMap() {
 }
 
 static const char* ObjectTypeToString(zx_obj_type_t type) {
-    static_assert(ZX_OBJ_TYPE_LAST == 28, "need to update switch below");
+    static_assert(ZX_OBJ_TYPE_LAST == 29, "need to update switch below");
 
     switch (type) {
         case ZX_OBJ_TYPE_PROCESS: return "process";
@@ -86,6 +86,7 @@ static const char* ObjectTypeToString(zx_obj_type_t type) {
         case ZX_OBJ_TYPE_PROFILE: return "profile";
         case ZX_OBJ_TYPE_PMT: return "pmt";
         case ZX_OBJ_TYPE_SUSPEND_TOKEN: return "suspend-token";
+        case ZX_OBJ_TYPE_PAGER: return "pager";
         default: return "???";
     }
 }
@@ -114,7 +115,7 @@ static uint32_t BuildHandleStats(const ProcessDispatcher& pd,
 // buffer as strings.
 static void FormatHandleTypeCount(const ProcessDispatcher& pd,
                                   char *buf, size_t buf_len) {
-    static_assert(ZX_OBJ_TYPE_LAST == 28, "need to update table below");
+    static_assert(ZX_OBJ_TYPE_LAST == 29, "need to update table below");
 
     uint32_t types[ZX_OBJ_TYPE_LAST] = {0};
     uint32_t handle_count = BuildHandleStats(pd, types, sizeof(types));
@@ -137,7 +138,7 @@ static void FormatHandleTypeCount(const ProcessDispatcher& pd,
              types[ZX_OBJ_TYPE_GUEST] + types[ZX_OBJ_TYPE_VCPU] +
              types[ZX_OBJ_TYPE_IOMMU] + types[ZX_OBJ_TYPE_BTI] +
              types[ZX_OBJ_TYPE_PROFILE] + types[ZX_OBJ_TYPE_PMT] +
-             types[ZX_OBJ_TYPE_SUSPEND_TOKEN]
+             types[ZX_OBJ_TYPE_SUSPEND_TOKEN] + types[ZX_OBJ_TYPE_PAGER]
              );
 }
 
@@ -8,6 +8,8 @@
 
 #include <assert.h>
 #include <lib/user_copy/user_ptr.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <object/thread_dispatcher.h>
 #include <trace.h>
@@ -17,6 +19,10 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE 0
 
+// How many owners a waiter's priority is passed along to, when each of them
+// is waiting on a futex owned by the next.
+static constexpr int kMaxOwnerChainLength = 16;
+
 FutexContext::FutexContext() {
     LTRACE_ENTRY;
 }
@@ -26,43 +32,93 @@ FutexContext::~FutexContext() {
 
     // All of the threads should have removed themselves from wait queues
     // by the time the process has exited.
-    DEBUG_ASSERT(futex_table_.is_empty());
+    for (const Shard& shard : shards_) {
+        DEBUG_ASSERT(shard.table.is_empty());
+    }
 }
 
 zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline) {
+    return WaitInternal(value_ptr, current_value, false, nullptr, deadline);
+}
+
+zx_status_t FutexContext::FutexWaitOwned(user_in_ptr<const int> value_ptr, int current_value,
+                                         fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline) {
+    return WaitInternal(value_ptr, current_value, true, fbl::move(owner), deadline);
+}
+
+zx_status_t FutexContext::WaitInternal(user_in_ptr<const int> value_ptr, int current_value,
+                                       bool set_owner, fbl::RefPtr<ThreadDispatcher> owner,
+                                       zx_time_t deadline) {
     LTRACE_ENTRY;
 
     uintptr_t futex_key = reinterpret_cast<uintptr_t>(value_ptr.get());
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    ThreadDispatcher* current_thread = ThreadDispatcher::GetCurrent();
+    if (owner.get() == current_thread)
+        return ZX_ERR_INVALID_ARGS;
+
+    // References to owners that lose their futexes, which must outlive the
+    // shard locks.
+    fbl::RefPtr<ThreadDispatcher> released;
+    fbl::RefPtr<ThreadDispatcher> unqueue_released;
+
     // FutexWait() checks that the address value_ptr still contains
     // current_value, and if so it sleeps awaiting a FutexWake() on value_ptr.
     // Those two steps must together be atomic with respect to FutexWake().
     // If a FutexWake() operation could occur between them, a userland mutex
     // operation built on top of futexes would have a race condition that
     // could miss wakeups.
-    lock_.Acquire();
+    Shard* shard = ShardFor(futex_key);
+    shard->lock.Acquire();
 
     int value;
     zx_status_t result = value_ptr.copy_from_user(&value);
     if (result != ZX_OK) {
-        lock_.Release();
+        shard->lock.Release();
         return result;
     }
     if (value != current_value) {
-        lock_.Release();
+        shard->lock.Release();
         return ZX_ERR_BAD_STATE;
     }
 
+    if (owner) {
+        // A thread waiting on the futex can't be holding it.
+        FutexNode::HashTable::iterator iter = shard->table.find(futex_key);
+        if (iter.IsValid()) {
+            bool owner_waiting = false;
+            FutexNode::ForEachWaiter(&*iter, [&owner, &owner_waiting](ThreadDispatcher* waiter) {
+                owner_waiting |= (waiter == owner.get());
+            });
+            if (owner_waiting) {
+                shard->lock.Release();
+                return ZX_ERR_INVALID_ARGS;
+            }
+        }
+    }
+
     FutexNode node;
     node.set_hash_key(futex_key);
+    node.set_waiter(current_thread);
     node.SetAsSingletonList();
 
-    QueueNodesLocked(&node);
+    FutexNode* head = QueueNodesLocked(shard, &node);
+    if (owner || head->owner()) {
+        AutoLock owner_lock(&owner_lock_);
+        current_thread->futex_state()->blocking_owner = head->owner().get();
+        if (set_owner)
+            SetOwnerLocked(head, fbl::move(owner), &released);
 
-    // Block current thread.  This releases lock_ and does not reacquire it.
-    result = node.BlockThread(&lock_, deadline);
+        ThreadDispatcher* futex_owner = head->owner().get();
+        if (futex_owner && futex_owner != current_thread)
+            PropagatePriorityLocked(futex_owner, current_thread->effective_priority());
+    }
+
+    // Block current thread.  This releases the shard's lock and does not
+    // reacquire it.
+    result = node.BlockThread(&shard->lock, deadline);
     if (result == ZX_OK) {
         DEBUG_ASSERT(!node.IsInQueue());
         // All the work necessary for removing us from the hash table was done by FutexWake()
@@ -75,9 +131,20 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
     //
     // We need to ensure that the thread's node is removed from the wait
     // queue, because FutexWake() probably didn't do that.
-    AutoLock lock(&lock_);
-    if (UnqueueNodeLocked(&node)) {
-        return result;
+    //
+    // FutexRequeue() may have moved the node to a futex in another shard,
+    // changing its key while holding both shards' locks, so the key is
+    // checked again once we have the lock it led us to.
+    for (;;) {
+        shard = ShardFor(node.GetKey());
+        AutoLock lock(&shard->lock);
+        if (ShardFor(node.GetKey()) != shard)
+            continue;
+
+        if (UnqueueNodeLocked(shard, &node, &unqueue_released)) {
+            return result;
+        }
+        break;
     }
     // The current thread was not found on the wait queue.  This means
     // that, although we hit the deadline (or were suspended/killed), we
@@ -103,6 +170,15 @@ zx_status_t FutexContext::FutexWait(user_in_ptr<const int> value_ptr, int curren
 
 zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
                                     uint32_t count) {
+    return WakeInternal(value_ptr, count, false);
+}
+
+zx_status_t FutexContext::FutexWakeSingleOwner(user_in_ptr<const int> value_ptr) {
+    return WakeInternal(value_ptr, 1, true);
+}
+
+zx_status_t FutexContext::WakeInternal(user_in_ptr<const int> value_ptr,
+                                       uint32_t count, bool set_owner) {
     LTRACE_ENTRY;
 
     if (count == 0) return ZX_OK;
@@ -111,53 +187,95 @@ zx_status_t FutexContext::FutexWake(user_in_ptr<const int> value_ptr,
     if (futex_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
+    // These must outlive the AutoLock.
+    fbl::RefPtr<ThreadDispatcher> released;
+    fbl::RefPtr<ThreadDispatcher> new_owner;
+
     AutoReschedDisable resched_disable; // Must come before the AutoLock.
     resched_disable.Disable();
-    AutoLock lock(&lock_);
+    Shard* shard = ShardFor(futex_key);
+    AutoLock lock(&shard->lock);
 
-    FutexNode* node = futex_table_.erase(futex_key);
+    FutexNode* node = shard->table.erase(futex_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
     }
     DEBUG_ASSERT(node->GetKey() == futex_key);
 
+    // The owner has to come off the head before its thread wakes up and
+    // frees the node.
+    if (node->owner()) {
+        AutoLock owner_lock(&owner_lock_);
+        FutexNode::ForEachWaiter(node, [](ThreadDispatcher* waiter) {
+            waiter->futex_state()->blocking_owner = nullptr;
+        });
+        ReleaseOwnerLocked(node, &released);
+    }
+    if (set_owner)
+        new_owner = fbl::WrapRefPtr(node->waiter());
+
     FutexNode* remaining_waiters =
         FutexNode::WakeThreads(node, count, futex_key);
 
     if (remaining_waiters) {
         DEBUG_ASSERT(remaining_waiters->GetKey() == futex_key);
-        futex_table_.insert(remaining_waiters);
+        shard->table.insert(remaining_waiters);
+        if (new_owner) {
+            AutoLock owner_lock(&owner_lock_);
+            SetOwnerLocked(remaining_waiters, fbl::move(new_owner), &released);
+        }
     }
 
     return ZX_OK;
 }
 
+// The two shards' locks are taken in an order analysis can't follow.
 zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
-                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count) {
+                                       user_in_ptr<const int> requeue_ptr, uint32_t requeue_count)
+    TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACE_ENTRY;
 
     if ((requeue_ptr.get() == nullptr) && requeue_count)
         return ZX_ERR_INVALID_ARGS;
 
-    AutoReschedDisable resched_disable; // Must come before the AutoLock.
-    AutoLock lock(&lock_);
+    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
+    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
+    Shard* wake_shard = ShardFor(wake_key);
+    Shard* requeue_shard = ShardFor(requeue_key);
+
+    // This must outlive the shard locks.
+    fbl::RefPtr<ThreadDispatcher> released;
+
+    AutoReschedDisable resched_disable; // Must come before the shard locks.
+
+    // Both futexes' shards stay locked throughout, so that the threads
+    // are never seen between the two. The locks are taken in address order
+    // so that requeues going opposite ways can't deadlock.
+    Shard* first = fbl::min(wake_shard, requeue_shard);
+    Shard* second = fbl::max(wake_shard, requeue_shard);
+    first->lock.Acquire();
+    if (second != first)
+        second->lock.Acquire();
+    auto unlock = fbl::MakeAutoCall([first, second]() TA_NO_THREAD_SAFETY_ANALYSIS {
+        if (second != first)
+            second->lock.Release();
+        first->lock.Release();
+    });
 
     int value;
     zx_status_t result = wake_ptr.copy_from_user(&value);
     if (result != ZX_OK) return result;
     if (value != current_value) return ZX_ERR_BAD_STATE;
 
-    uintptr_t wake_key = reinterpret_cast<uintptr_t>(wake_ptr.get());
-    uintptr_t requeue_key = reinterpret_cast<uintptr_t>(requeue_ptr.get());
     if (wake_key == requeue_key) return ZX_ERR_INVALID_ARGS;
     if (wake_key % sizeof(int) || requeue_key % sizeof(int))
         return ZX_ERR_INVALID_ARGS;
 
     // This must happen before RemoveFromHead() calls set_hash_key() on
-    // nodes below, because operations on futex_table_ look at the GetKey
+    // nodes below, because operations on the hash tables look at the GetKey
     // field of the list head nodes for wake_key and requeue_key.
-    FutexNode* node = futex_table_.erase(wake_key);
+    FutexNode* node = wake_shard->table.erase(wake_key);
     if (!node) {
         // nothing blocked on this futex if we can't find it
         return ZX_OK;
@@ -168,6 +286,15 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
     resched_disable.Disable();
 
     if (wake_count > 0) {
+        // As with FutexWake(), waking threads leaves the futex without an
+        // owner, which must come off the head before its thread wakes up.
+        if (node->owner()) {
+            AutoLock owner_lock(&owner_lock_);
+            FutexNode::ForEachWaiter(node, [](ThreadDispatcher* waiter) {
+                waiter->futex_state()->blocking_owner = nullptr;
+            });
+            ReleaseOwnerLocked(node, &released);
+        }
         node = FutexNode::WakeThreads(node, wake_count, wake_key);
     }
 
@@ -179,23 +306,46 @@ zx_status_t FutexContext::FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t
             node = FutexNode::RemoveFromHead(node, requeue_count,
                                              wake_key, requeue_key);
 
+            FutexNode::HashTable::iterator requeue_iter = requeue_shard->table.find(requeue_key);
+            ThreadDispatcher* requeue_owner =
+                requeue_iter.IsValid() ? requeue_iter->owner().get() : nullptr;
+            if (requeue_head->owner() || requeue_owner) {
+                AutoLock owner_lock(&owner_lock_);
+
+                // any owner of wake_ptr stays with the threads left waiting on it
+                if (node != nullptr) {
+                    node->owner() = fbl::move(requeue_head->owner());
+                } else {
+                    ReleaseOwnerLocked(requeue_head, &released);
+                }
+
+                // while the owner of requeue_ptr now holds up the requeued threads
+                FutexNode::ForEachWaiter(requeue_head, [requeue_owner](ThreadDispatcher* waiter) {
+                    waiter->futex_state()->blocking_owner = requeue_owner;
+                });
+                if (requeue_owner) {
+                    PropagatePriorityLocked(requeue_owner,
+                                            FutexNode::MaxWaiterPriority(requeue_head));
+                }
+            }
+
             // now requeue our nodes to requeue_ptr mutex
             DEBUG_ASSERT(requeue_head->GetKey() == requeue_key);
-            QueueNodesLocked(requeue_head);
+            QueueNodesLocked(requeue_shard, requeue_head);
         }
     }
 
     // add any remaining nodes back to wake_key futex
     if (node != nullptr) {
         DEBUG_ASSERT(node->GetKey() == wake_key);
-        futex_table_.insert(node);
+        wake_shard->table.insert(node);
     }
 
     return ZX_OK;
 }
 
-void FutexContext::QueueNodesLocked(FutexNode* head) {
-    DEBUG_ASSERT(lock_.IsHeld());
+FutexNode* FutexContext::QueueNodesLocked(Shard* shard, FutexNode* head) {
+    DEBUG_ASSERT(shard->lock.IsHeld());
 
     FutexNode::HashTable::iterator iter;
 
@@ -203,15 +353,19 @@ void FutexContext::QueueNodesLocked(FutexNode* head) {
     // succeeds, then the current thread is first to block on this futex and we
     // are finished.  If the insert fails, then there is already a thread
     // waiting on this futex.  Add ourselves to that thread's list.
-    if (!futex_table_.insert_or_find(head, &iter))
+    if (!shard->table.insert_or_find(head, &iter)) {
         iter->AppendList(head);
+        return &*iter;
+    }
+    return head;
 }
 
 // This attempts to unqueue a thread (which may or may not be waiting on a
 // futex), given its FutexNode.  This returns whether the FutexNode was
 // found and removed from a futex wait queue.
-bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
-    DEBUG_ASSERT(lock_.IsHeld());
+bool FutexContext::UnqueueNodeLocked(Shard* shard, FutexNode* node,
+                                     fbl::RefPtr<ThreadDispatcher>* released) {
+    DEBUG_ASSERT(shard->lock.IsHeld());
 
     if (!node->IsInQueue())
         return false;
@@ -221,11 +375,73 @@ bool FutexContext::UnqueueNodeLocked(FutexNode* node) {
     // However, that could be out of date if the thread was requeued by
     // FutexRequeue(), so we need to re-get the hash table key here.
     uintptr_t futex_key = node->GetKey();
+    DEBUG_ASSERT(ShardFor(futex_key) == shard);
 
-    FutexNode* old_head = futex_table_.erase(futex_key);
+    FutexNode* old_head = shard->table.erase(futex_key);
     DEBUG_ASSERT(old_head);
     FutexNode* new_head = FutexNode::RemoveNodeFromList(old_head, node);
+    if (old_head->owner()) {
+        AutoLock owner_lock(&owner_lock_);
+        node->waiter()->futex_state()->blocking_owner = nullptr;
+        if (new_head == nullptr) {
+            ReleaseOwnerLocked(old_head, released);
+        } else if (new_head != old_head) {
+            new_head->owner() = fbl::move(old_head->owner());
+        }
+    }
     if (new_head)
-        futex_table_.insert(new_head);
+        shard->table.insert(new_head);
     return true;
 }
+
+void FutexContext::SetOwnerLocked(FutexNode* head, fbl::RefPtr<ThreadDispatcher> owner,
+                                  fbl::RefPtr<ThreadDispatcher>* released) {
+    DEBUG_ASSERT(owner_lock_.IsHeld());
+
+    if (head->owner() == owner)
+        return;
+
+    ReleaseOwnerLocked(head, released);
+
+    ThreadDispatcher* new_owner = owner.get();
+    FutexNode::ForEachWaiter(head, [new_owner](ThreadDispatcher* waiter) {
+        waiter->futex_state()->blocking_owner = new_owner;
+    });
+    if (!new_owner)
+        return;
+
+    new_owner->futex_state()->owned_count++;
+    head->owner() = fbl::move(owner);
+    PropagatePriorityLocked(new_owner, FutexNode::MaxWaiterPriority(head));
+}
+
+void FutexContext::ReleaseOwnerLocked(FutexNode* head, fbl::RefPtr<ThreadDispatcher>* released) {
+    DEBUG_ASSERT(owner_lock_.IsHeld());
+
+    if (!head->owner())
+        return;
+
+    // Like a thread holding kernel mutexes, the owner keeps the priority it
+    // inherited until it has given up all of its futexes, since it can't
+    // tell which of them the priority came from.
+    ThreadDispatcher::FutexState* state = head->owner()->futex_state();
+    DEBUG_ASSERT(state->owned_count > 0);
+    if (--state->owned_count == 0)
+        head->owner()->ResetFutexPriority();
+
+    DEBUG_ASSERT(!*released);
+    *released = fbl::move(head->owner());
+}
+
+void FutexContext::PropagatePriorityLocked(ThreadDispatcher* owner, int priority) {
+    DEBUG_ASSERT(owner_lock_.IsHeld());
+
+    // Stop at the first owner that already has the priority. The walk is
+    // bounded, since a cycle of owners (a deadlock in user space) would
+    // otherwise never end.
+    for (int i = 0; owner && i < kMaxOwnerChainLength; i++) {
+        if (!owner->RaiseFutexPriority(priority))
+            return;
+        owner = owner->futex_state()->blocking_owner;
+    }
+}
@@ -26,6 +26,7 @@ FutexNode::~FutexNode() {
     LTRACE_ENTRY;
 
     DEBUG_ASSERT(!IsInQueue());
+    DEBUG_ASSERT(!owner_);
 
     wait_queue_destroy(&wait_queue_);
 }
@@ -86,8 +87,8 @@ FutexNode* FutexNode::WakeThreads(FutexNode* node, uint32_t count,
     FutexNode* const list_end = node->queue_prev_;
     for (uint32_t i = 0; i < count; i++) {
         DEBUG_ASSERT(node->GetKey() == old_hash_key);
-        // Clear this field to avoid any possible confusion.
-        node->set_hash_key(0);
+        // The key is left alone: if the thread's wait also timed out,
+        // FutexWait() uses it to find the shard lock we are holding.
 
         const bool is_last_node = (node == list_end);
         FutexNode* next = node->queue_next_;
@@ -146,6 +147,20 @@ FutexNode* FutexNode::RemoveFromHead(FutexNode* list_head, uint32_t count,
     return node;
 }
 
+int FutexNode::MaxWaiterPriority(FutexNode* list_head) {
+    int priority = -1;
+    FutexNode* node = list_head;
+    do {
+        if (node->waiter_) {
+            int waiter_priority = node->waiter_->effective_priority();
+            if (waiter_priority > priority)
+                priority = waiter_priority;
+        }
+        node = node->queue_next_;
+    } while (node != list_head);
+    return priority;
+}
+
 // This blocks the current thread.  This releases the given mutex (which
 // must be held when BlockThread() is called).  To reduce contention, it
 // does not reclaim the mutex on return.
@@ -173,10 +188,10 @@ void FutexNode::WakeThread() {
     // cases to consider:
     //  1) The thread's wait times out, or the thread is killed or
     //     suspended.  In those cases, FutexWait() will reacquire the
-    //     FutexContext lock.  We are currently holding that lock, so
-    //     FutexWait() will not race with us.
+    //     lock of the FutexContext shard for the futex.  We are currently
+    //     holding that lock, so FutexWait() will not race with us.
     //  2) The thread is woken by our wait_queue_wake_one() call.  In
-    //     this case, FutexWait() will *not* reacquire the FutexContext
+    //     this case, FutexWait() will *not* reacquire the shard's
     //     lock.  To handle this correctly, we must not access |this|
     //     after wait_queue_wake_one().
 
@@ -22,14 +22,19 @@
 #include <lib/oom.h>
 
 #include <object/diagnostics.h>
+#include <object/event_dispatcher.h>
 #include <object/excp_port.h>
 #include <object/job_dispatcher.h>
 #include <object/policy_manager.h>
 #include <object/port_dispatcher.h>
 #include <object/process_dispatcher.h>
 
+#include <vm/reclaim.h>
+
+#include <fbl/algorithm.h>
 #include <fbl/function.h>
 
+#include <zircon/syscalls/system.h>
 #include <zircon/types.h>
 
 #define LOCAL_TRACE 0
@@ -49,6 +54,34 @@ PolicyManager* GetSystemPolicyManager() {
     return policy_manager;
 }
 
+// The events handed out by zx_system_get_event() for each memory pressure
+// level, indexed by MemoryPressure. Only the current level's is signaled.
+static fbl::RefPtr<EventDispatcher> mem_pressure_events[3];
+
+fbl::RefPtr<EventDispatcher> GetMemPressureEvent(uint32_t kind) {
+    switch (kind) {
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL:
+        return mem_pressure_events[static_cast<size_t>(MemoryPressure::Normal)];
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING:
+        return mem_pressure_events[static_cast<size_t>(MemoryPressure::Warning)];
+    case ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL:
+        return mem_pressure_events[static_cast<size_t>(MemoryPressure::Critical)];
+    default:
+        return nullptr;
+    }
+}
+
+static void mem_pressure_signal(MemoryPressure level) {
+    const size_t current = static_cast<size_t>(level);
+    for (size_t i = 0; i < fbl::count_of(mem_pressure_events); i++) {
+        if (i == current) {
+            mem_pressure_events[i]->user_signal(0, ZX_EVENT_SIGNALED, false);
+        } else {
+            mem_pressure_events[i]->user_signal(ZX_EVENT_SIGNALED, 0, false);
+        }
+    }
+}
+
 // Counts and optionally prints all job/process descendants of a job.
 namespace {
 class OomJobEnumerator final : public JobEnumerator {
@@ -175,7 +208,14 @@ static void object_glue_init(uint level) TA_NO_THREAD_SAFETY_ANALYSIS {
     Handle::Init();
     root_job = JobDispatcher::CreateRootJob();
     policy_manager = PolicyManager::Create();
-    PortDispatcher::Init();
+    for (auto& event : mem_pressure_events) {
+        fbl::RefPtr<Dispatcher> dispatcher;
+        zx_rights_t rights;
+        zx_status_t status = EventDispatcher::Create(0, &dispatcher, &rights);
+        ASSERT(status == ZX_OK);
+        event = DownCastDispatcher<EventDispatcher>(&dispatcher);
+    }
+    reclaim_set_pressure_callback(mem_pressure_signal);
     // Be sure to update kernel_cmdline.md if any of these defaults change.
     oom_init(cmdline_get_bool("kernel.oom.enable", true),
              ZX_SEC(cmdline_get_uint64("kernel.oom.sleep-sec", 1)),
@@ -10,6 +10,7 @@
 #include <fbl/arena.h>
 #include <fbl/auto_lock.h>
 #include <fbl/mutex.h>
+#include <kernel/thread.h>
 #include <lib/counters.h>
 #include <pow2.h>
 
@@ -51,6 +52,20 @@ static_assert(((3 << 30) ^ kHandleGenerationMask ^ kHandleIndexMask) ==
                   0xffffffffu,
               "Masks do not agree");
 
+// Handle::lookup_state_ bit fields:
+//   [63..32]: base_value, whose top bit is used as kLookupStateDead
+//   [31..0]: The number of callers that have the Handle pinned
+//
+// Pin() only increments the count while the upper half matches the value it
+// was given, which never has kLookupStateDead set. TearDown() sets
+// kLookupStateDead and then waits for the count to drop to zero, so once it
+// goes on to destroy the Handle nobody can be reading it through Pin(). A
+// freed slot keeps the dead state, with the stale base_value in it, until
+// the slot's next Handle is fully constructed.
+constexpr uint64_t kLookupStateDead = 1ull << 63;
+constexpr uint64_t kLookupStatePinMask = 0xffffffffu;
+constexpr uint32_t kLookupStateShift = 32;
+
 }  // namespace
 
 fbl::Mutex Handle::mutex_;
@@ -69,7 +84,8 @@ uint32_t Handle::GetNewBaseValue(void* addr) TA_REQ(mutex_) {
     DEBUG_ASSERT((handle_index & ~kHandleIndexMask) == 0);
 
     // Check the free memory for a stashed base_value.
-    uint32_t v = *reinterpret_cast<uint32_t*>(addr);
+    uint64_t state = reinterpret_cast<Handle*>(addr)->lookup_state_.load();
+    uint32_t v = static_cast<uint32_t>((state & ~kLookupStateDead) >> kLookupStateShift);
     uint32_t old_gen = 0;
     if (v != 0) {
         // This slot has been used before.
@@ -128,6 +144,9 @@ Handle::Handle(fbl::RefPtr<Dispatcher> dispatcher, zx_rights_t rights,
       dispatcher_(fbl::move(dispatcher)),
       rights_(rights),
       base_value_(base_value) {
+    // Only now can Pin() find this Handle.
+    lookup_state_.store(static_cast<uint64_t>(base_value) << kLookupStateShift,
+                        fbl::memory_order_release);
 }
 
 HandleOwner Handle::Dup(Handle* source, zx_rights_t rights) {
@@ -145,13 +164,22 @@ Handle::Handle(Handle* rhs, zx_rights_t rights, uint32_t base_value)
       dispatcher_(rhs->dispatcher_),
       rights_(rights),
       base_value_(base_value) {
+    lookup_state_.store(static_cast<uint64_t>(base_value) << kLookupStateShift,
+                        fbl::memory_order_release);
 }
 
 // Destroys, but does not free, the Handle, and fixes up its memory to protect
-// against stale pointers to it. Also stashes the Handle's base_value for reuse
-// the next time this slot is allocated.
+// against stale pointers to it. The Handle's base_value stays behind in
+// |lookup_state_| for reuse the next time this slot is allocated.
 void Handle::TearDown() TA_EXCL(mutex_) {
-    uint32_t old_base_value = base_value();
+    // Keep Pin() from finding the Handle, and wait for those that already
+    // have. They only copy a RefPtr or two with preemption disabled, so this
+    // doesn't take long.
+    uint64_t state = lookup_state_.fetch_or(kLookupStateDead);
+    while (state & kLookupStatePinMask) {
+        arch_spinloop_pause();
+        state = lookup_state_.load(fbl::memory_order_acquire);
+    }
 
     // Calling the handle dtor can cause many things to happen, so it is
     // important to call it outside the lock.
@@ -159,12 +187,13 @@ void Handle::TearDown() TA_EXCL(mutex_) {
 
     // There may be stale pointers to this slot. Zero out most of its fields
     // to ensure that the Handle does not appear to belong to any process
-    // or point to any Dispatcher.
-    memset(this, 0, sizeof(*this));
-
-    // Hold onto the base_value for the next user of this slot, stashing
-    // it at the beginning of the free slot.
-    *reinterpret_cast<uint32_t*>(this) = old_base_value;
+    // or point to any Dispatcher. |lookup_state_| is skipped, since a stale
+    // Pin() may be looking at it.
+    char* start = reinterpret_cast<char*>(this);
+    char* state_start = reinterpret_cast<char*>(&lookup_state_);
+    char* state_end = state_start + sizeof(lookup_state_);
+    memset(start, 0, state_start - start);
+    memset(state_end, 0, start + sizeof(*this) - state_end);
 
     // Double-check that the process_id field is zero, ensuring that
     // no process can refer to this slot while it's free. This isn't
@@ -196,17 +225,46 @@ void Handle::Delete() {
     kcounter_add(handle_count_freed, 1);
 }
 
+// The arena never gives back the pages of its data pool, so the range check
+// can be done without |mutex_|: a slot that was ever in range stays mapped.
 Handle* Handle::FromU32(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
     uintptr_t handle_addr = IndexToHandle(value & kHandleIndexMask);
-    {
-        AutoLock lock(&mutex_);
-        if (unlikely(!arena_.in_range(handle_addr)))
-            return nullptr;
-    }
+    if (unlikely(!arena_.in_range(handle_addr)))
+        return nullptr;
     auto handle = reinterpret_cast<Handle*>(handle_addr);
     return likely(handle->base_value() == value) ? handle : nullptr;
 }
 
+Handle* Handle::Pin(uint32_t value) TA_NO_THREAD_SAFETY_ANALYSIS {
+    // A value with the top bits set could match a dead slot.
+    if (unlikely((value & ~(kHandleGenerationMask | kHandleIndexMask)) != 0))
+        return nullptr;
+    uintptr_t handle_addr = IndexToHandle(value & kHandleIndexMask);
+    if (unlikely(!arena_.in_range(handle_addr)))
+        return nullptr;
+    auto handle = reinterpret_cast<Handle*>(handle_addr);
+
+    thread_preempt_disable();
+    const uint64_t live_state = static_cast<uint64_t>(value) << kLookupStateShift;
+    uint64_t state = handle->lookup_state_.load(fbl::memory_order_relaxed);
+    do {
+        if (unlikely((state & ~kLookupStatePinMask) != live_state)) {
+            // The slot is free, is being torn down, or holds another Handle.
+            thread_preempt_reenable();
+            return nullptr;
+        }
+    } while (!handle->lookup_state_.compare_exchange_weak(&state, state + 1,
+                                                          fbl::memory_order_acquire,
+                                                          fbl::memory_order_relaxed));
+    return handle;
+}
+
+void Handle::Unpin() {
+    DEBUG_ASSERT((lookup_state_.load(fbl::memory_order_relaxed) & kLookupStatePinMask) != 0);
+    lookup_state_.fetch_sub(1, fbl::memory_order_release);
+    thread_preempt_reenable();
+}
+
 uint32_t Handle::Count(const fbl::RefPtr<const Dispatcher>& dispatcher) {
     // Handle::mutex_ also guards Dispatcher::handle_count_.
     AutoLock lock(&mutex_);
@@ -29,3 +29,7 @@ private:
     fbl::Canary<fbl::magic("EVTD")> canary_;
     CookieJar cookie_jar_;
 };
+
+// Returns the event for the ZX_SYSTEM_EVENT_* |kind|, or nullptr if there is
+// no such kind.
+fbl::RefPtr<EventDispatcher> GetMemPressureEvent(uint32_t kind);
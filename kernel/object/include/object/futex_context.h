@@ -9,20 +9,28 @@
 #include <lib/user_copy/user_ptr.h>
 #include <zircon/types.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
 #include <object/futex_node.h>
 
 // FutexContext is a class that encapsulates support for futex operations.
-// FutexContext uses a hash table keyed on the futex address (a pointer to integer in userspace)
-// to contain all active futexes.
+// FutexContext uses hash tables keyed on the futex address (a pointer to integer in userspace)
+// to contain all active futexes, sharded by address.
 // A futex is considered active if there is one or more threads blocked on the futex.
 // After no threads are left blocked on a futex it is removed from the hash table.
 // The value in the futex hash table is the FutexNode object associated with the head
 // of the list of threads blocked on the futex.
-// To avoid memory allocation at futex operation time, a FutexNode is embedded in each
-// ThreadDispatcher object.
+// To avoid memory allocation at futex operation time, the FutexNode of a waiting thread
+// lives on its kernel stack.
 // When the thread at the head of the futex's blocked thread list is resumed,
 // The FutexNode for the new head of the blocked thread list is set as the hash table value
 // for the futex.
+//
+// A futex with waiters may also have an owner, a thread of the same process that user space
+// says is holding the lock the futex implements. The owner inherits the priority of the
+// threads waiting on the futex, and of threads waiting on futexes they own in turn, so that
+// a low priority thread holding a contended lock doesn't hold up higher priority waiters.
+// The owner is kept in the head FutexNode, so a futex without waiters has no owner. Like
+// kernel mutexes, an owner keeps what it inherited until it has no futexes left.
 class FutexContext {
 public:
     FutexContext();
@@ -35,15 +43,28 @@ public:
     // on the same |value_ptr| futex.
     zx_status_t FutexWait(user_in_ptr<const int> value_ptr, int current_value, zx_time_t deadline);
 
+    // FutexWaitOwned is FutexWait that also makes |owner| the owner of the futex, or
+    // leaves it without one if |owner| is null. The owner can't be the current thread,
+    // or a thread waiting on the futex.
+    zx_status_t FutexWaitOwned(user_in_ptr<const int> value_ptr, int current_value,
+                               fbl::RefPtr<ThreadDispatcher> owner, zx_time_t deadline);
+
     // FutexWake will wake up to |count| number of threads blocked on the |value_ptr| futex.
+    // The futex is left without an owner.
     zx_status_t FutexWake(user_in_ptr<const int> value_ptr, uint32_t count);
 
+    // FutexWakeSingleOwner wakes up the first thread blocked on the |value_ptr| futex and
+    // makes it the owner of the futex, if other threads are left waiting on it.
+    zx_status_t FutexWakeSingleOwner(user_in_ptr<const int> value_ptr);
+
     // FutexWait first verifies that the integer pointed to by |wake_ptr|
     // still equals |current_value|. If the test fails, FutexWait returns FAILED_PRECONDITION.
     // Otherwise it will wake up to |wake_count| number of threads blocked on the |wake_ptr| futex.
     // If any other threads remain blocked on on the |wake_ptr| futex, up to |requeue_count|
     // of them will then be requeued to the tail of the list of threads
     // blocked on the |requeue_ptr| futex.
+    // Waking threads leaves |wake_ptr| without an owner, as FutexWake does. The owner of
+    // |requeue_ptr| keeps its ownership, and inherits the requeued threads' priority.
     zx_status_t FutexRequeue(user_in_ptr<const int> wake_ptr, uint32_t wake_count, int current_value,
                              user_in_ptr<const int> requeue_ptr, uint32_t requeue_count);
 
@@ -51,14 +72,60 @@ private:
     FutexContext(const FutexContext&) = delete;
     FutexContext& operator=(const FutexContext&) = delete;
 
-    void QueueNodesLocked(FutexNode* head) TA_REQ(lock_);
+    // The futexes are spread over a number of shards by address, each with
+    // its own lock and hash table, so that threads using unrelated futexes
+    // don't contend with each other.
+    static constexpr size_t kShardBits = 4;
+    static constexpr size_t kNumShards = 1u << kShardBits;
+
+    struct Shard {
+        // protects table
+        fbl::Mutex lock;
+
+        // Hash table for the futexes of this shard.
+        // Key is futex address, value is the FutexNode for the head of futex's blocked
+        // thread list.
+        FutexNode::HashTable table TA_GUARDED(lock);
+    };
+
+    Shard* ShardFor(uintptr_t futex_key) {
+        // Futexes are often a cache line or more apart, so the top bits of a
+        // multiplicative hash are used rather than the low bits of the address.
+        uint64_t hash = static_cast<uint64_t>(futex_key >> 2) * 0x9e3779b97f4a7c15ull;
+        return &shards_[hash >> (64 - kShardBits)];
+    }
+
+    zx_status_t WaitInternal(user_in_ptr<const int> value_ptr, int current_value,
+                             bool set_owner, fbl::RefPtr<ThreadDispatcher> owner,
+                             zx_time_t deadline);
+    zx_status_t WakeInternal(user_in_ptr<const int> value_ptr, uint32_t count, bool set_owner);
+
+    // Returns the head of the list |head| was added to.
+    FutexNode* QueueNodesLocked(Shard* shard, FutexNode* head) TA_REQ(shard->lock);
+
+    bool UnqueueNodeLocked(Shard* shard, FutexNode* node,
+                           fbl::RefPtr<ThreadDispatcher>* released) TA_REQ(shard->lock);
+
+    // Changes the owner of the futex whose list of waiters starts at |head|.
+    // The reference to the old owner is handed back through |released|, to
+    // be dropped once no locks are held.
+    void SetOwnerLocked(FutexNode* head, fbl::RefPtr<ThreadDispatcher> owner,
+                        fbl::RefPtr<ThreadDispatcher>* released) TA_REQ(owner_lock_);
+    // The same, for just giving up the ownership. The waiters' blocking_owner
+    // is left for the caller to update.
+    void ReleaseOwnerLocked(FutexNode* head, fbl::RefPtr<ThreadDispatcher>* released)
+        TA_REQ(owner_lock_);
 
-    bool UnqueueNodeLocked(FutexNode* node) TA_REQ(lock_);
+    // Raises |owner| to at least |priority|, and then the owners of the
+    // futexes it is waiting on in turn.
+    void PropagatePriorityLocked(ThreadDispatcher* owner, int priority) TA_REQ(owner_lock_);
 
-    // protects futex_table_
-    fbl::Mutex lock_;
+    Shard shards_[kNumShards];
 
-    // Hash table for futexes in this context.
-    // Key is futex address, value is the FutexNode for the head of futex's blocked thread list.
-    FutexNode::HashTable futex_table_ TA_GUARDED(lock_);
+    // Protects the owners of the futexes and the FutexState of the threads
+    // of the process, which priority inheritance follows from one futex to
+    // the next regardless of their shards. It is taken after the shard
+    // locks, and only when a futex has or gets an owner, so futexes used
+    // without owners never contend on it.
+    fbl::Mutex owner_lock_;
 };
@@ -12,6 +12,9 @@
 #include <zircon/types.h>
 #include <fbl/intrusive_hash_table.h>
 #include <fbl/mutex.h>
+#include <fbl/ref_ptr.h>
+
+class ThreadDispatcher;
 
 // Node for linked list of threads blocked on a futex
 // Intended to be embedded within a ThreadDispatcher Instance
@@ -41,6 +44,21 @@ public:
                                      uintptr_t old_hash_key,
                                      uintptr_t new_hash_key);
 
+    // Returns the highest effective priority of the threads waiting in the
+    // list starting at |list_head|.
+    static int MaxWaiterPriority(FutexNode* list_head);
+
+    // Calls |func| with the thread waiting in each node of the list starting
+    // at |list_head|.
+    template <typename Func>
+    static void ForEachWaiter(FutexNode* list_head, Func func) {
+        FutexNode* node = list_head;
+        do {
+            func(node->waiter_);
+            node = node->queue_next_;
+        } while (node != list_head);
+    }
+
     // This must be called with |mutex| held and returns without |mutex| held.
     zx_status_t BlockThread(fbl::Mutex* mutex, zx_time_t deadline) TA_REL(mutex);
 
@@ -48,6 +66,16 @@ public:
         hash_key_ = key;
     }
 
+    // The thread blocked on this node.
+    void set_waiter(ThreadDispatcher* waiter) {
+        waiter_ = waiter;
+    }
+    ThreadDispatcher* waiter() const { return waiter_; }
+
+    // When this node is the head of a futex's list of waiters, the thread
+    // that owns the futex, if it has one.
+    fbl::RefPtr<ThreadDispatcher>& owner() { return owner_; }
+
     // Trait implementation for fbl::HashTable
     uintptr_t GetKey() const { return hash_key_; }
     static size_t GetHash(uintptr_t key) { return (key >> 3); }
@@ -78,4 +106,11 @@ private:
     //  * When the thread is not waiting on a futex, queue_next_ is null.
     FutexNode* queue_prev_ = nullptr;
     FutexNode* queue_next_ = nullptr;
+
+    // The thread blocked on this node.
+    ThreadDispatcher* waiter_ = nullptr;
+
+    // Only set on list heads. It moves along with the head when the head
+    // thread stops waiting; see FutexContext.
+    fbl::RefPtr<ThreadDispatcher> owner_;
 };
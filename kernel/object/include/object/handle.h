@@ -116,6 +116,14 @@ public:
     // Maps an integer obtained by Handle::base_value() back to a Handle.
     static Handle* FromU32(uint32_t value);
 
+    // Maps |value| like FromU32(), but only to a Handle that is not being
+    // torn down, and keeps it from being torn down until Unpin() is called.
+    // This lets the dispatcher and rights of a Handle be read without holding
+    // its process' handle table lock. Preemption is disabled while a Handle is
+    // pinned, so the caller must not block before unpinning it.
+    static Handle* Pin(uint32_t value);
+    void Unpin();
+
     // Get the number of outstanding handles for a given dispatcher.
     static uint32_t Count(const fbl::RefPtr<const Dispatcher>&);
 
@@ -164,6 +172,12 @@ private:
     const zx_rights_t rights_;
     const uint32_t base_value_;
 
+    // The base_value in the upper 32 bits, and the number of Pin() callers
+    // in the lower ones. Outlives the Handle: it is left alone by TearDown(),
+    // which sets a dead bit in it, and by the constructors until they are
+    // done. See handle.cpp.
+    fbl::atomic<uint64_t> lookup_state_;
+
     // The handle arena and its mutex; also guards Dispatcher::handle_count_.
     static fbl::Mutex mutex_;
     static fbl::Arena TA_GUARDED(mutex_) arena_;
@@ -73,10 +73,9 @@ private:
     static zx_status_t NewPacket(uint32_t data_size, uint32_t num_handles,
                                  fbl::unique_ptr<MessagePacket>* msg);
 
-    // Create() uses malloc(), so we must delete using free().
-    static void operator delete(void* ptr) {
-        free(ptr);
-    }
+    // Create() takes the storage from a slab cache or the heap, so it
+    // must be given back the same way.
+    static void operator delete(void* ptr);
     friend class fbl::unique_ptr<MessagePacket>;
 
     // Handles and data are stored in the same buffer: num_handles_ Handle*
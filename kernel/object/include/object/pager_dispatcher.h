@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/ref_ptr.h>
+#include <object/dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <vm/page_source.h>
+#include <vm/vm_object.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+class PagerDispatcher;
+
+// The page source of a vmo created by a pager, which asks for pages by
+// queueing page request packets on a port.
+class PagerSource final : public PageSource,
+                          public fbl::DoublyLinkedListable<PagerSource*> {
+public:
+    PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                uint64_t key);
+
+protected:
+    zx_status_t SendRequest(uint64_t offset, uint64_t len) final;
+    void OnClose() final;
+
+private:
+    ~PagerSource() final;
+    friend fbl::RefPtr<PagerSource>;
+
+    zx_status_t QueuePacket(uint16_t command, uint64_t offset, uint64_t len);
+
+    // Only used by OnClose(), which runs once.
+    fbl::RefPtr<PagerDispatcher> pager_;
+    const fbl::RefPtr<PortDispatcher> port_;
+    const uint64_t key_;
+};
+
+class PagerDispatcher final : public SoloDispatcher {
+public:
+    static zx_status_t Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights);
+
+    ~PagerDispatcher() final;
+    zx_obj_type_t get_type() const final { return ZX_OBJ_TYPE_PAGER; }
+    bool has_state_tracker() const final { return false; }
+    void on_zero_handles() final;
+
+    // Creates a vmo of |size| bytes whose page requests are queued on |port|
+    // with |key|.
+    zx_status_t CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key, uint64_t size,
+                          fbl::RefPtr<VmObject>* vmo);
+
+    // Returns the page source of |vmo| if it was created by this pager, or
+    // nullptr if it was not.
+    fbl::RefPtr<PageSource> GetSource(const VmObject& vmo);
+
+    void RemoveSource(PagerSource* src);
+
+private:
+    PagerDispatcher();
+
+    fbl::Canary<fbl::magic("PGRD")> canary_;
+
+    fbl::DoublyLinkedList<PagerSource*> sources_ TA_GUARDED(get_lock());
+    bool closed_ TA_GUARDED(get_lock()) = false;
+};
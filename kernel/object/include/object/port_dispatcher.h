@@ -151,8 +151,9 @@ private:
 // |packets_| linked list and case 4 uses |interrupt_packets_| linked list.
 //
 // The threads that wish to receive notifications block on Dequeue() (which
-// maps to zx_port_wait()) and will receive packets from any of the four sources
-// depending on what kind of object the port has been 'bound' to.
+// maps to zx_port_wait()) or DequeueMany() (zx_port_wait_many()) and will
+// receive packets from any of the four sources depending on what kind of object
+// the port has been 'bound' to.
 //
 // When a packet from any of the sources arrives to the port, one waiting
 // thread unblocks and gets the packet. In all cases |sema_| is used to signal
@@ -160,7 +161,6 @@ private:
 
 class PortDispatcher final : public SoloDispatcher {
 public:
-    static void Init();
     static PortAllocator* DefaultPortAllocator();
     static zx_status_t Create(uint32_t options, fbl::RefPtr<Dispatcher>* dispatcher,
                               zx_rights_t* rights);
@@ -173,8 +173,15 @@ public:
 
     zx_status_t Queue(PortPacket* port_packet, zx_signals_t observed, uint64_t count);
     zx_status_t QueueUser(const zx_port_packet_t& packet);
+    // Queues a copy of a packet generated by the kernel, such as a page
+    // request, keeping its type.
+    zx_status_t QueuePacket(const zx_port_packet_t& packet);
     bool QueueInterruptPacket(PortInterruptPacket* port_packet, zx_time_t timestamp);
     zx_status_t Dequeue(zx_time_t deadline, zx_port_packet_t* packet);
+    // Like Dequeue(), but dequeues up to |max_packets| packets, and only
+    // blocks if there are none. The number dequeued is returned in |*count|.
+    zx_status_t DequeueMany(zx_time_t deadline, zx_port_packet_t* packets, size_t max_packets,
+                            size_t* count);
     bool RemoveInterruptPacket(PortInterruptPacket* port_packet);
 
     // Decides who is going to destroy the observer. If it returns |true| it
@@ -196,6 +203,7 @@ private:
 
     explicit PortDispatcher(uint32_t options);
 
+    zx_status_t QueueCopy(const zx_port_packet_t& packet, uint32_t type);
     void FreePacket(PortPacket* port_packet) TA_REQ(get_lock());
 
     // Adopts a RefPtr to |eport|, and adds it to |eports_|.
@@ -267,6 +267,10 @@ private:
     ProcessDispatcher& operator=(const ProcessDispatcher&) = delete;
 
 
+    // Like GetHandleLocked(), but without the handle table lock: the Handle
+    // is pinned instead, and must be passed to Handle::Unpin() when done.
+    Handle* PinHandle(zx_handle_t handle_value);
+
     zx_status_t GetDispatcherInternal(zx_handle_t handle_value, fbl::RefPtr<Dispatcher>* dispatcher,
                                       zx_rights_t* rights);
 
@@ -307,7 +311,9 @@ private:
     // our address space
     fbl::RefPtr<VmAspace> aspace_;
 
-    // our list of handles
+    // our list of handles. Adding and removing handles is serialized by
+    // |handle_table_lock_|, but looking up a dispatcher and its rights is
+    // lock-free; see PinHandle().
     mutable fbl::Mutex handle_table_lock_; // protects |handles_|.
     fbl::DoublyLinkedList<Handle*> handles_ TA_GUARDED(handle_table_lock_);
 
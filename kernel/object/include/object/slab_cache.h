@@ -0,0 +1,96 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/defines.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <kernel/align.h>
+#include <kernel/spinlock.h>
+#include <lib/counters.h>
+#include <stddef.h>
+#include <zircon/thread_annotations.h>
+
+// A cache of objects of a single size, for the objects that are allocated
+// and freed on the hot paths of IPC.
+//
+// Objects are carved out of whole pages, each starting with a small header
+// that keeps track of its free objects. In front of that, every CPU keeps a
+// short stack of free objects, which Alloc() and Free() work on without
+// touching any state shared with other CPUs. Only when a CPU's stack runs dry
+// or overflows does it take the cache-wide lock, to move a batch of objects
+// from or to their pages.
+//
+// A few pages whose objects are all free are kept for reuse, and the rest are
+// given back to the PMM.
+class SlabCache {
+public:
+    // |hits| counts the allocations served from a CPU's stack, and |misses|
+    // those that had to take the cache-wide lock.
+    SlabCache(const char* name, size_t object_size,
+              const k_counter_desc* hits, const k_counter_desc* misses);
+    // All objects must have been freed.
+    ~SlabCache();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(SlabCache);
+
+    // The largest object size that fits |count| objects in a page.
+    static constexpr size_t MaxObjectSize(size_t count) {
+        return ((PAGE_SIZE - sizeof(Slab)) / count) & ~(kObjectAlign - 1);
+    }
+
+    // Returns null if no page could be allocated.
+    void* Alloc();
+    void Free(void* object);
+
+    const char* name() const { return name_; }
+    size_t object_size() const { return object_size_; }
+    size_t objects_per_slab() const { return objects_per_slab_; }
+
+private:
+    static constexpr size_t kObjectAlign = 16;
+    static constexpr size_t kCpuCacheSize = 16;
+    static constexpr size_t kBatchSize = kCpuCacheSize / 2;
+    static constexpr size_t kMaxEmptySlabs = 4;
+
+    // The header at the start of each page.
+    struct Slab : public fbl::DoublyLinkedListable<Slab*> {
+        // Threaded through the first word of each free object.
+        void* free_list;
+        size_t free_count;
+    };
+    static_assert(sizeof(Slab) % kObjectAlign == 0, "objects must stay aligned");
+
+    struct __CPU_ALIGN CpuCache {
+        SpinLock lock;
+        size_t count TA_GUARDED(lock) = 0;
+        void* objects[kCpuCacheSize] TA_GUARDED(lock);
+    };
+
+    static Slab* SlabOf(void* object);
+
+    // Takes up to |count| objects from the pages, allocating new pages as
+    // needed, and returns how many it took.
+    size_t TakeLocked(void** objects, size_t count) TA_REQ(lock_);
+    // Puts objects back into their pages.
+    void ReturnLocked(void* const* objects, size_t count) TA_REQ(lock_);
+
+    const char* const name_;
+    const size_t object_size_;
+    const size_t objects_per_slab_;
+    const k_counter_desc* const hits_;
+    const k_counter_desc* const misses_;
+
+    CpuCache cpu_caches_[SMP_MAX_CPUS];
+
+    fbl::Mutex lock_;
+    // Pages with some objects free. Pages with none free are on no list.
+    fbl::DoublyLinkedList<Slab*> partial_slabs_ TA_GUARDED(lock_);
+    // Pages with all objects free.
+    fbl::DoublyLinkedList<Slab*> empty_slabs_ TA_GUARDED(lock_);
+};
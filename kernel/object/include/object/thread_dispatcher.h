@@ -190,10 +190,29 @@ public:
                            size_t buffer_len);
     // Profile support
     zx_status_t SetPriority(int32_t priority);
+    zx_status_t SetFairWeight(uint32_t weight);
+    zx_status_t SetDeadline(zx_duration_t capacity, zx_duration_t period);
 
     // For ChannelDispatcher use.
     ChannelDispatcher::MessageWaiter* GetMessageWaiter() { return &channel_waiter_; }
 
+    // For FutexContext use. The state is guarded by the owner lock of the
+    // process' FutexContext.
+    struct FutexState {
+        // The number of futexes with waiters that this thread owns.
+        uint32_t owned_count = 0;
+        // The owner of the futex this thread is blocked on, if it has one.
+        ThreadDispatcher* blocking_owner = nullptr;
+    };
+    FutexState* futex_state() { return &futex_state_; }
+
+    // Futex priority inheritance. RaiseFutexPriority() makes this thread
+    // inherit at least |priority| and returns whether it did not already.
+    // ResetFutexPriority() stops it inheriting anything from futex waiters.
+    bool RaiseFutexPriority(int priority);
+    void ResetFutexPriority();
+    int effective_priority() const;
+
     // Blocking syscalls, once they commit to a path that will likely block the
     // thread, use this helper class to properly set/restore |blocked_reason_|.
     class AutoBlocked final {
@@ -295,6 +314,9 @@ private:
     // in order to suspend a thread.
     ChannelDispatcher::MessageWaiter channel_waiter_;
 
+    // Per-thread state of the process' FutexContext.
+    FutexState futex_state_;
+
     // LK thread structure
     // put last to ease debugging since this is a pretty large structure
     // (~1.5K on x86_64).
@@ -10,8 +10,39 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <fbl/algorithm.h>
+#include <lib/counters.h>
 #include <zxcpp/new.h>
 #include <object/handle.h>
+#include <object/slab_cache.h>
+
+KCOUNTER(channel_msg_slab_hits, "kernel.channel.msg.slab.hits");
+KCOUNTER(channel_msg_slab_misses, "kernel.channel.msg.slab.misses");
+KCOUNTER(channel_msg_heap_count, "kernel.channel.msg.heap");
+
+namespace {
+
+// Packets are served from one of these by size, in front of the heap. Most
+// channel messages are small, and allocating and freeing them on every write
+// and read is where the heap lock is hottest. Packets too big for a page-sized
+// object come from the heap.
+SlabCache msg_caches[] = {
+    {"msg-small", SlabCache::MaxObjectSize(16), channel_msg_slab_hits, channel_msg_slab_misses},
+    {"msg-medium", SlabCache::MaxObjectSize(4), channel_msg_slab_hits, channel_msg_slab_misses},
+    {"msg-large", SlabCache::MaxObjectSize(1), channel_msg_slab_hits, channel_msg_slab_misses},
+};
+
+// Each buffer starts with a header recording where it came from, so that
+// operator delete can give it back.
+struct alignas(16) BufferHeader {
+    SlabCache* cache;
+};
+
+BufferHeader* HeaderOf(void* packet) {
+    return reinterpret_cast<BufferHeader*>(packet) - 1;
+}
+
+} // namespace
 
 // static
 zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
@@ -25,15 +56,28 @@ zx_status_t MessagePacket::NewPacket(uint32_t data_size, uint32_t num_handles,
 
     // Allocate space for the MessagePacket object followed by num_handles
     // Handle*s followed by data_size bytes.
-    // TODO(dbort): Use mbuf-style memory for data_size, ideally allocating from
-    // somewhere other than the heap. Lets us better track and isolate channel
-    // memory usage.
-    char* ptr = static_cast<char*>(malloc(sizeof(MessagePacket) +
-                                          num_handles * sizeof(Handle*) +
-                                          data_size));
-    if (ptr == nullptr) {
+    const size_t size = sizeof(BufferHeader) + sizeof(MessagePacket) +
+                        num_handles * sizeof(Handle*) + data_size;
+    SlabCache* cache = nullptr;
+    for (auto& c : msg_caches) {
+        if (size <= c.object_size()) {
+            cache = &c;
+            break;
+        }
+    }
+
+    BufferHeader* header;
+    if (cache != nullptr) {
+        header = static_cast<BufferHeader*>(cache->Alloc());
+    } else {
+        header = static_cast<BufferHeader*>(malloc(size));
+        kcounter_add(channel_msg_heap_count, 1);
+    }
+    if (header == nullptr) {
         return ZX_ERR_NO_MEMORY;
     }
+    header->cache = cache;
+    char* ptr = reinterpret_cast<char*>(header + 1);
 
     // The storage space for the Handle*s is not initialized because
     // the only creators of MessagePackets (sys_channel_write and
@@ -85,6 +129,16 @@ MessagePacket::~MessagePacket() {
     }
 }
 
+// static
+void MessagePacket::operator delete(void* ptr) {
+    BufferHeader* header = HeaderOf(ptr);
+    if (header->cache != nullptr) {
+        header->cache->Free(header);
+    } else {
+        free(header);
+    }
+}
+
 MessagePacket::MessagePacket(uint32_t data_size,
                              uint32_t num_handles, Handle** handles)
     : handles_(handles), data_size_(data_size),
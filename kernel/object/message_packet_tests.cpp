@@ -90,6 +90,29 @@ static bool create_zero() {
     END_TEST;
 }
 
+// Create MessagePackets on either side of each slab size class, and at the
+// largest size, which comes from the heap.
+static bool create_sizes() {
+    BEGIN_TEST;
+    static const uint32_t kSizes[] = {
+        1, 150, 250, 900, 1000, 3900, 4100, kMaxMessageSize,
+    };
+    fbl::AllocChecker ac;
+    auto buf = fbl::unique_ptr<char[]>(new (&ac) char[kMaxMessageSize]);
+    ASSERT_TRUE(ac.check(), "");
+
+    for (uint32_t size : kSizes) {
+        memset(buf.get(), static_cast<int>(size), size);
+        fbl::unique_ptr<MessagePacket> mp;
+        ASSERT_EQ(ZX_OK, MessagePacket::Create(buf.get(), size, 2, &mp), "");
+        ASSERT_EQ(size, mp->data_size(), "");
+        EXPECT_EQ(2u, mp->num_handles(), "");
+        mp->mutable_handles()[0] = nullptr;
+        mp->mutable_handles()[1] = nullptr;
+    }
+    END_TEST;
+}
+
 // Attempt to create a MessagePacket with too many handles.
 static bool create_too_many_handles() {
     BEGIN_TEST;
@@ -107,5 +130,6 @@ UNITTEST_START_TESTCASE(message_packet_tests)
 UNITTEST("create", create)
 UNITTEST("create_void_star", create_void_star)
 UNITTEST("create_zero", create_zero)
+UNITTEST("create_sizes", create_sizes)
 UNITTEST("create_too_many_handles", create_too_many_handles)
 UNITTEST_END_TESTCASE(message_packet_tests, "message_packet", "MessagePacket tests");
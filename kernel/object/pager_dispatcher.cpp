@@ -0,0 +1,157 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/pager_dispatcher.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <lib/counters.h>
+#include <trace.h>
+#include <vm/vm_object_paged.h>
+#include <zircon/rights.h>
+#include <zircon/syscalls/port.h>
+
+#define LOCAL_TRACE 0
+
+KCOUNTER(pager_create_count, "kernel.pager.create");
+KCOUNTER(pager_vmo_count, "kernel.pager.vmo.create");
+
+PagerSource::PagerSource(fbl::RefPtr<PagerDispatcher> pager, fbl::RefPtr<PortDispatcher> port,
+                         uint64_t key)
+    : pager_(fbl::move(pager)), port_(fbl::move(port)), key_(key) {
+    LTRACEF("%p key %#" PRIx64 "\n", this, key_);
+}
+
+PagerSource::~PagerSource() {
+    LTRACEF("%p\n", this);
+    DEBUG_ASSERT(!InContainer());
+}
+
+zx_status_t PagerSource::QueuePacket(uint16_t command, uint64_t offset, uint64_t len) {
+    zx_port_packet_t packet = {};
+    packet.key = key_;
+    packet.type = ZX_PKT_TYPE_PAGE_REQUEST;
+    packet.status = ZX_OK;
+    packet.page_request.command = command;
+    packet.page_request.offset = offset;
+    packet.page_request.length = len;
+    return port_->QueuePacket(packet);
+}
+
+zx_status_t PagerSource::SendRequest(uint64_t offset, uint64_t len) {
+    zx_status_t status = QueuePacket(ZX_PAGER_VMO_READ, offset, len);
+    // A full port is not something a faulting thread can wait out, and
+    // ZX_ERR_SHOULD_WAIT means something else to our caller.
+    if (status == ZX_ERR_SHOULD_WAIT)
+        return ZX_ERR_NO_RESOURCES;
+    return status;
+}
+
+void PagerSource::OnClose() {
+    // Nobody may be listening on the port any more, which is fine.
+    QueuePacket(ZX_PAGER_VMO_COMPLETE, 0, 0);
+
+    pager_->RemoveSource(this);
+    pager_.reset();
+}
+
+zx_status_t PagerDispatcher::Create(fbl::RefPtr<Dispatcher>* dispatcher, zx_rights_t* rights) {
+    fbl::AllocChecker ac;
+    auto disp = new (&ac) PagerDispatcher();
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    kcounter_add(pager_create_count, 1);
+
+    *rights = ZX_DEFAULT_PAGER_RIGHTS;
+    *dispatcher = fbl::AdoptRef<Dispatcher>(disp);
+    return ZX_OK;
+}
+
+PagerDispatcher::PagerDispatcher() {}
+
+PagerDispatcher::~PagerDispatcher() {
+    DEBUG_ASSERT(sources_.is_empty());
+}
+
+zx_status_t PagerDispatcher::CreateVmo(fbl::RefPtr<PortDispatcher> port, uint64_t key,
+                                       uint64_t size, fbl::RefPtr<VmObject>* vmo_out) {
+    canary_.Assert();
+
+    fbl::AllocChecker ac;
+    auto src = fbl::AdoptRef(new (&ac) PagerSource(fbl::WrapRefPtr(this), fbl::move(port), key));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    bool closed;
+    {
+        fbl::AutoLock lock(get_lock());
+        closed = closed_;
+        if (!closed)
+            sources_.push_back(src.get());
+    }
+    if (closed) {
+        // Our last handle went away while this was being set up.
+        src->Close();
+        return ZX_ERR_BAD_STATE;
+    }
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::CreateExternal(src, size, &vmo);
+    if (status != ZX_OK) {
+        src->Close();
+        return status;
+    }
+
+    kcounter_add(pager_vmo_count, 1);
+
+    *vmo_out = fbl::move(vmo);
+    return ZX_OK;
+}
+
+fbl::RefPtr<PageSource> PagerDispatcher::GetSource(const VmObject& vmo) {
+    canary_.Assert();
+
+    const PageSource* vmo_src = vmo.page_source();
+    if (!vmo_src)
+        return nullptr;
+
+    // A source is removed from the list before its vmo lets go of it, so
+    // anything we find still has a reference.
+    fbl::AutoLock lock(get_lock());
+    for (auto& src : sources_) {
+        if (&src == vmo_src)
+            return fbl::WrapRefPtr<PageSource>(&src);
+    }
+    return nullptr;
+}
+
+void PagerDispatcher::RemoveSource(PagerSource* src) {
+    fbl::AutoLock lock(get_lock());
+    if (src->InContainer())
+        sources_.erase(*src);
+}
+
+void PagerDispatcher::on_zero_handles() {
+    canary_.Assert();
+
+    // Fail the requests of all of our vmos, and any they make from now on.
+    // Close() calls back into RemoveSource(), so it can't be called with the
+    // lock held, and a vmo may be closing its source at the same time, so
+    // hold a reference while doing so.
+    for (;;) {
+        fbl::RefPtr<PagerSource> src;
+        {
+            fbl::AutoLock lock(get_lock());
+            closed_ = true;
+            if (sources_.is_empty())
+                break;
+            src = fbl::WrapRefPtr(sources_.pop_front());
+        }
+        src->Close();
+    }
+}
@@ -29,18 +29,13 @@ zx_status_t PinnedMemoryTokenDispatcher::Create(fbl::RefPtr<BusTransactionInitia
     DEBUG_ASSERT(IS_PAGE_ALIGNED(offset) && IS_PAGE_ALIGNED(size));
 
     if (vmo->is_paged()) {
-        // Commit the VMO range, in case it's not already committed.
-        zx_status_t status = vmo->CommitRange(offset, size, nullptr);
+        // Commit the VMO range, in case it's not already committed, and pin
+        // the memory to make sure it doesn't change from underneath us for the
+        // lifetime of the created PMT. This has to be one step, or the
+        // reclaimer could free the freshly committed pages before the pin.
+        zx_status_t status = vmo->CommitRangePinned(offset, size);
         if (status != ZX_OK) {
-            LTRACEF("vmo->CommitRange failed: %d\n", status);
-            return status;
-        }
-
-        // Pin the memory to make sure it doesn't change from underneath us for the
-        // lifetime of the created PMT.
-        status = vmo->Pin(offset, size);
-        if (status != ZX_OK) {
-            LTRACEF("vmo->Pin failed: %d\n", status);
+            LTRACEF("vmo->CommitRangePinned failed: %d\n", status);
             return status;
         }
     }
@@ -12,16 +12,18 @@
 #include <pow2.h>
 
 #include <fbl/alloc_checker.h>
-#include <fbl/arena.h>
+#include <fbl/atomic.h>
 #include <fbl/auto_lock.h>
 #include <lib/counters.h>
 #include <object/excp_port.h>
 #include <object/handle.h>
+#include <object/slab_cache.h>
 #include <object/thread_dispatcher.h>
 #include <zircon/compiler.h>
 #include <zircon/rights.h>
 #include <zircon/syscalls/port.h>
 #include <zircon/types.h>
+#include <zxcpp/new.h>
 
 using fbl::AutoLock;
 
@@ -36,19 +38,23 @@ static_assert(sizeof(zx_packet_guest_io_t) == sizeof(zx_packet_user_t),
 static_assert(sizeof(zx_packet_guest_vcpu_t) == sizeof(zx_packet_user_t),
               "size of zx_packet_guest_vcpu_t must match zx_packet_user_t");
 
-KCOUNTER(port_arena_count, "kernel.port.arena.count");
+KCOUNTER(port_packet_count, "kernel.port.packet.count");
 KCOUNTER(port_full_count, "kernel.port.full.count");
+KCOUNTER(port_slab_hits, "kernel.port.slab.hits");
+KCOUNTER(port_slab_misses, "kernel.port.slab.misses");
 
-class ArenaPortAllocator final : public PortAllocator {
+class SlabPortAllocator final : public PortAllocator {
 public:
-    zx_status_t Init();
-    virtual ~ArenaPortAllocator() = default;
+    SlabPortAllocator()
+        : cache_("port packets", sizeof(PortPacket), port_slab_hits, port_slab_misses) {}
+    virtual ~SlabPortAllocator() = default;
 
     virtual PortPacket* Alloc();
     virtual void Free(PortPacket* port_packet);
 
 private:
-    fbl::TypedArena<PortPacket, fbl::Mutex> arena_;
+    SlabCache cache_;
+    fbl::atomic<size_t> count_{0};
 };
 
 namespace {
@@ -56,26 +62,32 @@ constexpr size_t kMaxPendingPacketCount = 16 * 1024u;
 
 // TODO(maniscalco): Enforce this limit per process via the job policy.
 constexpr size_t kMaxPendingPacketCountPerPort = kMaxPendingPacketCount / 8;
-ArenaPortAllocator port_allocator;
+SlabPortAllocator port_allocator;
 } // namespace.
 
-zx_status_t ArenaPortAllocator::Init() {
-    return arena_.Init("packets", kMaxPendingPacketCount);
-}
-
-PortPacket* ArenaPortAllocator::Alloc() {
-    PortPacket* packet = arena_.New(nullptr, this);
-    if (packet == nullptr) {
+PortPacket* SlabPortAllocator::Alloc() {
+    // The slab cache grows without bound, so keep the cap the fixed-size
+    // arena used to impose.
+    if (count_.fetch_add(1, fbl::memory_order_relaxed) >= kMaxPendingPacketCount) {
+        count_.fetch_sub(1, fbl::memory_order_relaxed);
+        printf("WARNING: Could not allocate new port packet\n");
+        return nullptr;
+    }
+    void* ptr = cache_.Alloc();
+    if (ptr == nullptr) {
+        count_.fetch_sub(1, fbl::memory_order_relaxed);
         printf("WARNING: Could not allocate new port packet\n");
         return nullptr;
     }
-    kcounter_add(port_arena_count, 1);
-    return packet;
+    kcounter_add(port_packet_count, 1);
+    return new (ptr) PortPacket(nullptr, this);
 }
 
-void ArenaPortAllocator::Free(PortPacket* port_packet) {
-    arena_.Delete(port_packet);
-    kcounter_add(port_arena_count, -1);
+void SlabPortAllocator::Free(PortPacket* port_packet) {
+    port_packet->~PortPacket();
+    cache_.Free(port_packet);
+    count_.fetch_sub(1, fbl::memory_order_relaxed);
+    kcounter_add(port_packet_count, -1);
 }
 
 PortPacket::PortPacket(const void* handle, PortAllocator* allocator)
@@ -160,10 +172,6 @@ StateObserver::Flags PortObserver::MaybeQueue(zx_signals_t new_state, uint64_t c
 
 /////////////////////////////////////////////////////////////////////////////////////////
 
-void PortDispatcher::Init() {
-    port_allocator.Init();
-}
-
 PortAllocator* PortDispatcher::DefaultPortAllocator() {
     return &port_allocator;
 }
@@ -218,6 +226,14 @@ void PortDispatcher::on_zero_handles() {
 }
 
 zx_status_t PortDispatcher::QueueUser(const zx_port_packet_t& packet) {
+    return QueueCopy(packet, ZX_PKT_TYPE_USER);
+}
+
+zx_status_t PortDispatcher::QueuePacket(const zx_port_packet_t& packet) {
+    return QueueCopy(packet, packet.type);
+}
+
+zx_status_t PortDispatcher::QueueCopy(const zx_port_packet_t& packet, uint32_t type) {
     canary_.Assert();
 
     auto port_packet = port_allocator.Alloc();
@@ -225,7 +241,7 @@ zx_status_t PortDispatcher::QueueUser(const zx_port_packet_t& packet) {
         return ZX_ERR_NO_MEMORY;
 
     port_packet->packet = packet;
-    port_packet->packet.type = ZX_PKT_TYPE_USER;
+    port_packet->packet.type = type;
 
     auto status = Queue(port_packet, 0u, 0u);
     if (status < 0)
@@ -287,31 +303,50 @@ zx_status_t PortDispatcher::Queue(PortPacket* port_packet, zx_signals_t observed
 }
 
 zx_status_t PortDispatcher::Dequeue(zx_time_t deadline, zx_port_packet_t* out_packet) {
+    size_t count;
+    return DequeueMany(deadline, out_packet, 1u, &count);
+}
+
+zx_status_t PortDispatcher::DequeueMany(zx_time_t deadline, zx_port_packet_t* out_packets,
+                                        size_t max_packets, size_t* out_count) {
     canary_.Assert();
+    DEBUG_ASSERT(max_packets > 0);
 
     while (true) {
+        size_t count = 0;
         if (options_ == PORT_BIND_TO_INTERRUPT) {
             AutoSpinLock al(&spinlock_);
-            PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
-            if (port_interrupt_packet != nullptr) {
+            while (count < max_packets) {
+                PortInterruptPacket* port_interrupt_packet = interrupt_packets_.pop_front();
+                if (port_interrupt_packet == nullptr)
+                    break;
+                zx_port_packet_t* out_packet = &out_packets[count++];
                 *out_packet = {};
                 out_packet->key = port_interrupt_packet->key;
                 out_packet->type = ZX_PKT_TYPE_INTERRUPT;
                 out_packet->status = ZX_OK;
                 out_packet->interrupt.timestamp = port_interrupt_packet->timestamp;
-                return ZX_OK;
             }
         }
-        {
+        if (count < max_packets) {
             AutoLock al(get_lock());
-            PortPacket* port_packet = packets_.pop_front();
-            if (port_packet != nullptr) {
+            while (count < max_packets) {
+                PortPacket* port_packet = packets_.pop_front();
+                if (port_packet == nullptr)
+                    break;
                 --num_packets_;
-                *out_packet = port_packet->packet;
+                out_packets[count++] = port_packet->packet;
                 FreePacket(port_packet);
-                return ZX_OK;
             }
         }
+        // Each packet was posted to |sema_|, but only one wait, if any, is
+        // taken here. The surplus counts show up as spurious wakeups that
+        // find the lists empty and go back to waiting, as with Dequeue()
+        // taking a packet without waiting.
+        if (count > 0) {
+            *out_count = count;
+            return ZX_OK;
+        }
 
         {
             ThreadDispatcher::AutoBlocked by(ThreadDispatcher::Blocked::PORT);
@@ -51,9 +51,12 @@ static zx_handle_t map_handle_to_value(const Handle* handle, uint32_t mixer) {
     return static_cast<zx_handle_t>(mixer ^ handle_id);
 }
 
+static uint32_t map_value_to_handle_id(zx_handle_t value, uint32_t mixer) {
+    return (static_cast<uint32_t>(value) ^ mixer) >> 1;
+}
+
 static Handle* map_value_to_handle(zx_handle_t value, uint32_t mixer) {
-    auto handle_id = (static_cast<uint32_t>(value) ^ mixer) >> 1;
-    return Handle::FromU32(handle_id);
+    return Handle::FromU32(map_value_to_handle_id(value, mixer));
 }
 
 zx_status_t ProcessDispatcher::Create(
@@ -407,6 +410,22 @@ Handle* ProcessDispatcher::GetHandleLocked(zx_handle_t handle_value) {
     return nullptr;
 }
 
+Handle* ProcessDispatcher::PinHandle(zx_handle_t handle_value) {
+    Handle* handle = Handle::Pin(map_value_to_handle_id(handle_value, handle_rand_));
+    if (handle) {
+        // The handle may be on its way out of this process, but as long as
+        // it is pinned it can't be torn down; a lookup that races with its
+        // removal simply wins the race.
+        if (likely(handle->process_id() == get_koid()))
+            return handle;
+        handle->Unpin();
+    }
+
+    // Same as GetHandleLocked().
+    QueryPolicy(ZX_POL_BAD_HANDLE);
+    return nullptr;
+}
+
 void ProcessDispatcher::AddHandle(HandleOwner handle) {
     AutoLock lock(&handle_table_lock_);
     AddHandleLocked(fbl::move(handle));
@@ -439,24 +458,30 @@ void ProcessDispatcher::UndoRemoveHandleLocked(zx_handle_t handle_value) {
 }
 
 zx_koid_t ProcessDispatcher::GetKoidForHandle(zx_handle_t handle_value) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
+    Handle* handle = PinHandle(handle_value);
     if (!handle)
         return ZX_KOID_INVALID;
-    return handle->dispatcher()->get_koid();
+    zx_koid_t koid = handle->dispatcher()->get_koid();
+    handle->Unpin();
+    return koid;
 }
 
 zx_status_t ProcessDispatcher::GetDispatcherInternal(zx_handle_t handle_value,
                                                      fbl::RefPtr<Dispatcher>* dispatcher,
                                                      zx_rights_t* rights) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
+    Handle* handle = PinHandle(handle_value);
     if (!handle)
         return ZX_ERR_BAD_HANDLE;
 
-    *dispatcher = handle->dispatcher();
+    // Copy out only after unpinning, in case |*dispatcher| held the last
+    // reference to something.
+    fbl::RefPtr<Dispatcher> disp = handle->dispatcher();
+    zx_rights_t handle_rights = handle->rights();
+    handle->Unpin();
+
+    *dispatcher = fbl::move(disp);
     if (rights)
-        *rights = handle->rights();
+        *rights = handle_rights;
     return ZX_OK;
 }
 
@@ -464,17 +489,22 @@ zx_status_t ProcessDispatcher::GetDispatcherWithRightsInternal(zx_handle_t handl
                                                                zx_rights_t desired_rights,
                                                                fbl::RefPtr<Dispatcher>* dispatcher_out,
                                                                zx_rights_t* out_rights) {
-    AutoLock lock(&handle_table_lock_);
-    Handle* handle = GetHandleLocked(handle_value);
+    Handle* handle = PinHandle(handle_value);
     if (!handle)
         return ZX_ERR_BAD_HANDLE;
 
-    if (!handle->HasRights(desired_rights))
+    if (!handle->HasRights(desired_rights)) {
+        handle->Unpin();
         return ZX_ERR_ACCESS_DENIED;
+    }
 
-    *dispatcher_out = handle->dispatcher();
+    fbl::RefPtr<Dispatcher> disp = handle->dispatcher();
+    zx_rights_t handle_rights = handle->rights();
+    handle->Unpin();
+
+    *dispatcher_out = fbl::move(disp);
     if (out_rights)
-        *out_rights = handle->rights();
+        *out_rights = handle_rights;
     return ZX_OK;
 }
 
@@ -777,6 +807,9 @@ const char* StateToString(ProcessDispatcher::State state) {
 }
 
 bool ProcessDispatcher::IsHandleValid(zx_handle_t handle_value) {
-    AutoLock lock(&handle_table_lock_);
-    return (GetHandleLocked(handle_value) != nullptr);
+    Handle* handle = PinHandle(handle_value);
+    if (!handle)
+        return false;
+    handle->Unpin();
+    return true;
 }
@@ -15,13 +15,28 @@
 
 #include <zircon/rights.h>
 
+static_assert(ZX_FAIR_WEIGHT_DEFAULT == FAIR_WEIGHT_DEFAULT, "");
+
 zx_status_t validate_profile(const zx_profile_info_t& info) {
-    if (info.type != ZX_PROFILE_INFO_SCHEDULER)
+    switch (info.type) {
+    case ZX_PROFILE_INFO_SCHEDULER:
+        if ((info.scheduler.priority < LOWEST_PRIORITY) ||
+            (info.scheduler.priority  > HIGHEST_PRIORITY))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_DEADLINE:
+        if ((info.deadline.capacity <= 0) ||
+            (info.deadline.capacity > info.deadline.period) ||
+            (info.deadline.period > ZX_SEC(1)))
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    case ZX_PROFILE_INFO_FAIR:
+        if (info.fair.weight == 0)
+            return ZX_ERR_INVALID_ARGS;
+        return ZX_OK;
+    default:
         return ZX_ERR_NOT_SUPPORTED;
-    if ((info.scheduler.priority < LOWEST_PRIORITY) ||
-        (info.scheduler.priority  > HIGHEST_PRIORITY))
-        return ZX_ERR_INVALID_ARGS;
-    return ZX_OK;
+    }
 }
 
 zx_status_t ProfileDispatcher::Create(const zx_profile_info_t& info,
@@ -48,6 +63,12 @@ ProfileDispatcher::~ProfileDispatcher() {
 }
 
 zx_status_t ProfileDispatcher::ApplyProfile(fbl::RefPtr<ThreadDispatcher> thread) {
-    // At the moment, the only thing we support is the priority.
-    return thread->SetPriority(info_.scheduler.priority);
+    switch (info_.type) {
+    case ZX_PROFILE_INFO_DEADLINE:
+        return thread->SetDeadline(info_.deadline.capacity, info_.deadline.period);
+    case ZX_PROFILE_INFO_FAIR:
+        return thread->SetFairWeight(info_.fair.weight);
+    default:
+        return thread->SetPriority(info_.scheduler.priority);
+    }
 }
@@ -31,6 +31,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/log_dispatcher.cpp \
     $(LOCAL_DIR)/mbuf.cpp \
     $(LOCAL_DIR)/message_packet.cpp \
+    $(LOCAL_DIR)/pager_dispatcher.cpp \
     $(LOCAL_DIR)/pci_device_dispatcher.cpp \
     $(LOCAL_DIR)/pci_interrupt_dispatcher.cpp \
     $(LOCAL_DIR)/pinned_memory_token_dispatcher.cpp \
@@ -41,6 +42,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/resource_dispatcher.cpp \
     $(LOCAL_DIR)/resources.cpp \
     $(LOCAL_DIR)/semaphore.cpp \
+    $(LOCAL_DIR)/slab_cache.cpp \
     $(LOCAL_DIR)/socket_dispatcher.cpp \
     $(LOCAL_DIR)/suspend_token_dispatcher.cpp \
     $(LOCAL_DIR)/thread_dispatcher.cpp \
@@ -55,6 +57,7 @@ MODULE_SRCS := \
 MODULE_SRCS += \
     $(LOCAL_DIR)/mbuf_tests.cpp \
     $(LOCAL_DIR)/message_packet_tests.cpp \
+    $(LOCAL_DIR)/slab_cache_tests.cpp \
     $(LOCAL_DIR)/state_tracker_tests.cpp \
 
 MODULE_DEPS := \
@@ -0,0 +1,173 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/slab_cache.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <kernel/auto_lock.h>
+#include <lib/heap.h>
+#include <string.h>
+#include <zxcpp/new.h>
+
+using fbl::AutoLock;
+
+SlabCache::SlabCache(const char* name, size_t object_size,
+                     const k_counter_desc* hits, const k_counter_desc* misses)
+    : name_(name),
+      object_size_(ROUNDUP(object_size, kObjectAlign)),
+      objects_per_slab_((PAGE_SIZE - sizeof(Slab)) / object_size_),
+      hits_(hits), misses_(misses) {
+    DEBUG_ASSERT(objects_per_slab_ >= 1);
+}
+
+SlabCache::~SlabCache() {
+    for (auto& cache : cpu_caches_) {
+        void* objects[kCpuCacheSize];
+        size_t count;
+        {
+            AutoSpinLock guard(&cache.lock);
+            count = cache.count;
+            memcpy(objects, cache.objects, count * sizeof(void*));
+            cache.count = 0;
+        }
+        AutoLock guard(&lock_);
+        ReturnLocked(objects, count);
+    }
+
+    AutoLock guard(&lock_);
+    DEBUG_ASSERT(partial_slabs_.is_empty());
+    while (!empty_slabs_.is_empty()) {
+        Slab* slab = empty_slabs_.pop_front();
+        slab->~Slab();
+        heap_page_free(slab, 1);
+    }
+}
+
+SlabCache::Slab* SlabCache::SlabOf(void* object) {
+    return reinterpret_cast<Slab*>(ROUNDDOWN(reinterpret_cast<uintptr_t>(object), PAGE_SIZE));
+}
+
+void* SlabCache::Alloc() {
+    {
+        CpuCache& cache = cpu_caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+        if (likely(cache.count > 0)) {
+            kcounter_add(hits_, 1);
+            return cache.objects[--cache.count];
+        }
+    }
+
+    kcounter_add(misses_, 1);
+    void* batch[kBatchSize];
+    size_t count;
+    {
+        AutoLock guard(&lock_);
+        count = TakeLocked(batch, kBatchSize);
+    }
+    if (count == 0)
+        return nullptr;
+
+    // Keep the rest of the batch for the next allocations on this CPU. We may
+    // have moved to another one since, whose stack may already be full.
+    size_t stashed;
+    {
+        CpuCache& cache = cpu_caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+        stashed = fbl::min(count - 1, kCpuCacheSize - cache.count);
+        for (size_t i = 0; i < stashed; i++)
+            cache.objects[cache.count++] = batch[count - 1 - i];
+    }
+    if (stashed < count - 1) {
+        AutoLock guard(&lock_);
+        ReturnLocked(batch + 1, count - 1 - stashed);
+    }
+    return batch[0];
+}
+
+void SlabCache::Free(void* object) {
+    DEBUG_ASSERT(object);
+
+    void* batch[kBatchSize];
+    {
+        CpuCache& cache = cpu_caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+        if (likely(cache.count < kCpuCacheSize)) {
+            cache.objects[cache.count++] = object;
+            return;
+        }
+        // Make room for this object and the next few by sending the oldest
+        // ones back to their pages.
+        for (size_t i = 0; i < kBatchSize; i++)
+            batch[i] = cache.objects[i];
+        for (size_t i = kBatchSize; i < kCpuCacheSize; i++)
+            cache.objects[i - kBatchSize] = cache.objects[i];
+        cache.count -= kBatchSize;
+        cache.objects[cache.count++] = object;
+    }
+
+    AutoLock guard(&lock_);
+    ReturnLocked(batch, kBatchSize);
+}
+
+size_t SlabCache::TakeLocked(void** objects, size_t count) {
+    size_t taken = 0;
+    while (taken < count) {
+        Slab* slab;
+        if (!partial_slabs_.is_empty()) {
+            slab = &partial_slabs_.front();
+        } else if (!empty_slabs_.is_empty()) {
+            slab = empty_slabs_.pop_front();
+            partial_slabs_.push_front(slab);
+        } else {
+            void* page = heap_page_alloc(1);
+            if (page == nullptr)
+                break;
+            slab = new (page) Slab{};
+            char* first = reinterpret_cast<char*>(slab + 1);
+            for (size_t i = objects_per_slab_; i > 0; i--) {
+                void* obj = first + (i - 1) * object_size_;
+                *reinterpret_cast<void**>(obj) = slab->free_list;
+                slab->free_list = obj;
+            }
+            slab->free_count = objects_per_slab_;
+            partial_slabs_.push_front(slab);
+        }
+
+        while (taken < count && slab->free_count > 0) {
+            void* obj = slab->free_list;
+            slab->free_list = *reinterpret_cast<void**>(obj);
+            slab->free_count--;
+            objects[taken++] = obj;
+        }
+        if (slab->free_count == 0)
+            partial_slabs_.erase(*slab);
+    }
+    return taken;
+}
+
+void SlabCache::ReturnLocked(void* const* objects, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        Slab* slab = SlabOf(objects[i]);
+        if (slab->free_count == 0)
+            partial_slabs_.push_front(slab);
+        *reinterpret_cast<void**>(objects[i]) = slab->free_list;
+        slab->free_list = objects[i];
+        slab->free_count++;
+
+        if (slab->free_count == objects_per_slab_) {
+            partial_slabs_.erase(*slab);
+            if (empty_slabs_.size_slow() < kMaxEmptySlabs) {
+                empty_slabs_.push_front(slab);
+            } else {
+                slab->~Slab();
+                heap_page_free(slab, 1);
+            }
+        }
+    }
+}
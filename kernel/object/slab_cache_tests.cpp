@@ -0,0 +1,113 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <object/slab_cache.h>
+
+#include <fbl/alloc_checker.h>
+#include <fbl/unique_ptr.h>
+#include <lib/counters.h>
+#include <lib/unittest/unittest.h>
+#include <string.h>
+
+KCOUNTER(slab_test_hits, "kernel.slab_test.hits");
+KCOUNTER(slab_test_misses, "kernel.slab_test.misses");
+
+namespace {
+
+fbl::unique_ptr<SlabCache> MakeCache(size_t object_size) {
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<SlabCache> cache(
+        new (&ac) SlabCache("test", object_size, slab_test_hits, slab_test_misses));
+    if (!ac.check())
+        return nullptr;
+    return cache;
+}
+
+// Objects are rounded up to and aligned on 16 bytes.
+static bool alloc_free() {
+    BEGIN_TEST;
+    auto cache = MakeCache(40);
+    ASSERT_NONNULL(cache.get(), "");
+    EXPECT_EQ(48u, cache->object_size(), "");
+
+    void* a = cache->Alloc();
+    ASSERT_NONNULL(a, "");
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(a) % 16, "");
+    memset(a, 0xa5, cache->object_size());
+
+    void* b = cache->Alloc();
+    ASSERT_NONNULL(b, "");
+    EXPECT_NE(a, b, "");
+    cache->Free(a);
+    cache->Free(b);
+    END_TEST;
+}
+
+// Allocate enough objects to fill several pages and overflow the per-CPU
+// stacks on the way back, checking that no object is handed out twice.
+static bool many_objects() {
+    BEGIN_TEST;
+    auto cache = MakeCache(SlabCache::MaxObjectSize(16));
+    ASSERT_NONNULL(cache.get(), "");
+    EXPECT_EQ(16u, cache->objects_per_slab(), "");
+
+    constexpr size_t kCount = 200;
+    void* objects[kCount];
+    for (size_t i = 0; i < kCount; i++) {
+        objects[i] = cache->Alloc();
+        ASSERT_NONNULL(objects[i], "");
+        memset(objects[i], static_cast<int>(i), cache->object_size());
+    }
+    for (size_t i = 0; i < kCount; i++) {
+        auto bytes = static_cast<const uint8_t*>(objects[i]);
+        for (size_t j = 0; j < cache->object_size(); j++) {
+            ASSERT_EQ(static_cast<uint8_t>(i), bytes[j], "object overlaps another");
+        }
+    }
+    // Free every other object first, so that pages go from full to partial to
+    // empty.
+    for (size_t i = 0; i < kCount; i += 2)
+        cache->Free(objects[i]);
+    for (size_t i = 1; i < kCount; i += 2)
+        cache->Free(objects[i]);
+
+    // Everything comes back from a mix of per-CPU stacks and pages.
+    for (size_t i = 0; i < kCount; i++) {
+        objects[i] = cache->Alloc();
+        ASSERT_NONNULL(objects[i], "");
+    }
+    for (size_t i = 0; i < kCount; i++)
+        cache->Free(objects[i]);
+    END_TEST;
+}
+
+// The largest object size for one object per page still fits in a page.
+static bool one_per_page() {
+    BEGIN_TEST;
+    auto cache = MakeCache(SlabCache::MaxObjectSize(1));
+    ASSERT_NONNULL(cache.get(), "");
+    EXPECT_EQ(1u, cache->objects_per_slab(), "");
+
+    void* a = cache->Alloc();
+    void* b = cache->Alloc();
+    ASSERT_NONNULL(a, "");
+    ASSERT_NONNULL(b, "");
+    EXPECT_NE(ROUNDDOWN(reinterpret_cast<uintptr_t>(a), PAGE_SIZE),
+              ROUNDDOWN(reinterpret_cast<uintptr_t>(b), PAGE_SIZE), "");
+    memset(a, 0, cache->object_size());
+    memset(b, 0, cache->object_size());
+    cache->Free(a);
+    cache->Free(b);
+    END_TEST;
+}
+
+}  // namespace
+
+UNITTEST_START_TESTCASE(slab_cache_tests)
+UNITTEST("alloc_free", alloc_free)
+UNITTEST("many_objects", many_objects)
+UNITTEST("one_per_page", one_per_page)
+UNITTEST_END_TESTCASE(slab_cache_tests, "slab_cache", "SlabCache tests");
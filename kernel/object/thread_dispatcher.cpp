@@ -16,6 +16,7 @@
 #include <arch/debugger.h>
 #include <arch/exception.h>
 
+#include <kernel/sched.h>
 #include <kernel/thread.h>
 #include <vm/kstack.h>
 #include <vm/vm.h>
@@ -980,6 +981,56 @@ zx_status_t ThreadDispatcher::SetPriority(int32_t priority) {
     return ZX_OK;
 }
 
+bool ThreadDispatcher::RaiseFutexPriority(int priority) {
+    AutoThreadLock lock;
+    if (priority <= thread_.user_inherited_priority)
+        return false;
+
+    bool local_resched = false;
+    sched_inherit_user_priority(&thread_, priority, &local_resched);
+    if (local_resched)
+        sched_reschedule();
+    return true;
+}
+
+void ThreadDispatcher::ResetFutexPriority() {
+    AutoThreadLock lock;
+    bool local_resched = false;
+    sched_inherit_user_priority(&thread_, -1, &local_resched);
+    if (local_resched)
+        sched_reschedule();
+}
+
+int ThreadDispatcher::effective_priority() const {
+    AutoThreadLock lock;
+    return thread_.effec_priority;
+}
+
+zx_status_t ThreadDispatcher::SetFairWeight(uint32_t weight) {
+    AutoLock state_lock(get_lock());
+    if ((state_ == State::INITIAL) ||
+        (state_ == State::DYING) ||
+        (state_ == State::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    // The weight was already validated by the Profile dispatcher.
+    thread_set_fair_weight(&thread_, weight);
+    return ZX_OK;
+}
+
+zx_status_t ThreadDispatcher::SetDeadline(zx_duration_t capacity, zx_duration_t period) {
+    AutoLock state_lock(get_lock());
+    // The reservation is released when the thread exits, so it can only be
+    // made once the thread has started.
+    if ((state_ == State::INITIAL) ||
+        (state_ == State::INITIALIZED) ||
+        (state_ == State::DYING) ||
+        (state_ == State::DEAD)) {
+        return ZX_ERR_BAD_STATE;
+    }
+    return thread_set_deadline(&thread_, capacity, period);
+}
+
 void get_user_thread_process_name(const void* user_thread,
                                   char out_name[ZX_MAX_NAME_LEN]) {
     const ThreadDispatcher* ut =
@@ -126,6 +126,10 @@ zx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t s
             return vmo_->CleanCache(offset, size);
         case ZX_VMO_OP_CACHE_CLEAN_INVALIDATE:
             return vmo_->CleanInvalidateCache(offset, size);
+        case ZX_VMO_OP_MERGEABLE:
+            return vmo_->SetMergeable(true);
+        case ZX_VMO_OP_UNMERGEABLE:
+            return vmo_->SetMergeable(false);
         default:
             return ZX_ERR_INVALID_ARGS;
     }
@@ -12,7 +12,9 @@
 #include <string.h>
 #include <trace.h>
 
+#include <fbl/algorithm.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/debuglog.h>
 #include <lib/user_copy/user_ptr.h>
 #include <lib/ktrace.h>
@@ -21,6 +23,7 @@
 #include <object/handle.h>
 #include <object/process_dispatcher.h>
 #include <object/resources.h>
+#include <object/vm_object_dispatcher.h>
 
 #include <platform/debug.h>
 
@@ -140,6 +143,14 @@ zx_status_t sys_ktrace_control(
         name[sizeof(name) - 1] = 0;
         return ktrace_control(action, options, name);
     }
+    case KTRACE_ACTION_CONSUME: {
+        // one position for the name buffer, and one for each cpu
+        uint64_t consumed[1 + SMP_MAX_CPUS];
+        options = fbl::min<uint32_t>(options, fbl::count_of(consumed));
+        if (_ptr.reinterpret<uint64_t>().copy_array_from_user(consumed, options) != ZX_OK)
+            return ZX_ERR_INVALID_ARGS;
+        return ktrace_control(action, options, consumed);
+    }
     default:
         return ktrace_control(action, options, nullptr);
     }
@@ -156,17 +167,41 @@ zx_status_t sys_ktrace_write(zx_handle_t handle, uint32_t event_id, uint32_t arg
         return ZX_ERR_INVALID_ARGS;
     }
 
-    uint32_t* args = static_cast<uint32_t*>(ktrace_open(TAG_PROBE_24(event_id)));
-    if (!args) {
+    const uint32_t args[2] = { arg0, arg1 };
+    if (!ktrace_record(TAG_PROBE_24(event_id), args, sizeof(args))) {
         //  There is not a single reason for failure. Assume it reached the end.
         return ZX_ERR_UNAVAILABLE;
     }
-
-    args[0] = arg0;
-    args[1] = arg1;
     return ZX_OK;
 }
 
+zx_status_t sys_ktrace_stream(zx_handle_t handle, uint32_t options,
+                              user_out_handle* vmo, user_out_handle* event) {
+    // TODO(ZX-971): finer grained validation
+    zx_status_t status;
+    if ((status = validate_resource(handle, ZX_RSRC_KIND_ROOT)) < 0) {
+        return status;
+    }
+
+    options = KTRACE_GRP_TO_MASK(options);
+    fbl::RefPtr<Dispatcher> vmo_dispatcher, event_dispatcher;
+    status = ktrace_stream(options ? options : KTRACE_GRP_TO_MASK(KTRACE_GRP_ALL),
+                           &vmo_dispatcher, &event_dispatcher);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    // The kernel writes the buffers and signals the event; user space can
+    // only read and wait.
+    status = vmo->make(fbl::move(vmo_dispatcher),
+                       ZX_RIGHT_READ | ZX_RIGHT_MAP | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER);
+    if (status == ZX_OK) {
+        status = event->make(fbl::move(event_dispatcher),
+                             ZX_RIGHT_WAIT | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER);
+    }
+    return status;
+}
+
 zx_status_t sys_mtrace_control(zx_handle_t handle,
                                uint32_t kind, uint32_t action, uint32_t options,
                                user_inout_ptr<void> ptr, size_t size) {
@@ -178,3 +213,28 @@ zx_status_t sys_mtrace_control(zx_handle_t handle,
 
     return mtrace_control(kind, action, options, ptr, size);
 }
+
+zx_status_t sys_kcounter_snapshot(zx_handle_t handle, uint32_t options,
+                                  user_out_handle* out) {
+    // TODO(ZX-971): finer grained validation
+    zx_status_t status;
+    if ((status = validate_resource(handle, ZX_RSRC_KIND_ROOT)) < 0) {
+        return status;
+    }
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<VmObject> vmo;
+    if ((status = kcounter_snapshot(&vmo)) != ZX_OK) {
+        return status;
+    }
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    if ((status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights)) != ZX_OK) {
+        return status;
+    }
+
+    return out->make(fbl::move(dispatcher), rights);
+}
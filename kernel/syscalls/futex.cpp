@@ -9,6 +9,7 @@
 #include <trace.h>
 
 #include <object/process_dispatcher.h>
+#include <object/thread_dispatcher.h>
 #include <zircon/types.h>
 
 #include "priv.h"
@@ -22,6 +23,26 @@ zx_status_t sys_futex_wait(user_in_ptr<const zx_futex_t> value_ptr, int32_t curr
         value_ptr, current_value, deadline);
 }
 
+zx_status_t sys_futex_wait_owned(user_in_ptr<const zx_futex_t> value_ptr, int32_t current_value,
+                                 zx_handle_t new_owner, zx_time_t deadline) {
+    LTRACEF("futex %p current %d owner %x\n", value_ptr.get(), current_value, new_owner);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<ThreadDispatcher> owner;
+    if (new_owner != ZX_HANDLE_INVALID) {
+        zx_status_t status = up->GetDispatcher(new_owner, &owner);
+        if (status != ZX_OK)
+            return status;
+        // Futexes are private to a process, and so are their owners.
+        if (owner->process() != up)
+            return ZX_ERR_INVALID_ARGS;
+    }
+
+    return up->futex_context()->FutexWaitOwned(
+        value_ptr, current_value, fbl::move(owner), deadline);
+}
+
 zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t count) {
     LTRACEF("futex %p count %" PRIu32 "\n", value_ptr.get(), count);
 
@@ -29,6 +50,12 @@ zx_status_t sys_futex_wake(user_in_ptr<const zx_futex_t> value_ptr, uint32_t cou
         value_ptr, count);
 }
 
+zx_status_t sys_futex_wake_single_owner(user_in_ptr<const zx_futex_t> value_ptr) {
+    LTRACEF("futex %p\n", value_ptr.get());
+
+    return ProcessDispatcher::GetCurrent()->futex_context()->FutexWakeSingleOwner(value_ptr);
+}
+
 zx_status_t sys_futex_requeue(user_in_ptr<const zx_futex_t> wake_ptr, uint32_t wake_count, int32_t current_value,
                               user_in_ptr<const zx_futex_t> requeue_ptr, uint32_t requeue_count) {
     LTRACEF("futex %p wake_count %" PRIu32 "current_value %d "
@@ -10,10 +10,13 @@
 
 #include <kernel/mp.h>
 #include <kernel/stats.h>
+#include <vm/compression.h>
 #include <vm/pmm.h>
+#include <vm/reclaim.h>
 #include <vm/vm.h>
 #include <lib/heap.h>
 #include <platform.h>
+#include <zircon/syscalls/system.h>
 #include <zircon/types.h>
 
 #include <object/diagnostics.h>
@@ -467,6 +470,51 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             }
             return ZX_OK;
         }
+        case ZX_INFO_CPU_SCHED_STATS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            size_t num_cpus = arch_max_num_cpus();
+            size_t num_to_copy = MIN(num_cpus, buffer_size / sizeof(zx_info_cpu_sched_stats_t));
+            user_out_ptr<zx_info_cpu_sched_stats_t> cpu_buf =
+                _buffer.reinterpret<zx_info_cpu_sched_stats_t>();
+
+            static_assert(ZX_INFO_CPU_SCHED_STATS_BUCKETS == SCHED_STATS_BUCKETS,
+                          "mismatched histograms");
+            for (unsigned int i = 0; i < static_cast<unsigned int>(num_to_copy); i++) {
+                const auto& sched = percpu[i].sched_stats;
+
+                // racy, as for ZX_INFO_CPU_STATS, but each field is read whole
+                zx_info_cpu_sched_stats_t stats = {};
+                stats.cpu_number = i;
+                stats.flags = mp_is_cpu_online(i) ? ZX_INFO_CPU_STATS_FLAG_ONLINE : 0;
+                for (uint b = 0; b < SCHED_STATS_BUCKETS; b++) {
+                    stats.wakeup_latency[b] = sched.wakeup_latency[b];
+                    stats.run_time[b] = sched.run_time[b];
+                    stats.queue_len[b] = sched.queue_len[b];
+                }
+                stats.run_queue_len = percpu[i].run_queue_len;
+                stats.involuntary_switches = sched.involuntary_switches;
+                stats.migrations = sched.migrations;
+                stats.migrations_cross_llc = sched.migrations_cross_llc;
+
+                if (cpu_buf.copy_array_to_user(&stats, 1, i) != ZX_OK)
+                    return ZX_ERR_INVALID_ARGS;
+            }
+
+            if (_actual) {
+                zx_status_t status = _actual.copy_to_user(num_to_copy);
+                if (status != ZX_OK)
+                    return status;
+            }
+            if (_avail) {
+                zx_status_t status = _avail.copy_to_user(num_cpus);
+                if (status != ZX_OK)
+                    return status;
+            }
+            return ZX_OK;
+        }
         case ZX_INFO_KMEM_STATS: {
             auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
             if (status != ZX_OK)
@@ -516,6 +564,56 @@ zx_status_t sys_object_get_info(zx_handle_t handle, uint32_t topic,
             return single_record_result(
                 _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
         }
+        case ZX_INFO_KMEM_RECLAIM_STATS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            reclaim_stats rstats;
+            reclaim_get_stats(&rstats);
+
+            zx_info_kmem_reclaim_stats_t stats = {};
+            stats.active_bytes = rstats.active_pages * PAGE_SIZE;
+            stats.inactive_bytes = rstats.inactive_pages * PAGE_SIZE;
+            stats.evicted_bytes = rstats.evicted_pages * PAGE_SIZE;
+            stats.scans = rstats.scans;
+            switch (rstats.pressure) {
+            case MemoryPressure::Normal:
+                stats.pressure_level = ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL;
+                break;
+            case MemoryPressure::Warning:
+                stats.pressure_level = ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING;
+                break;
+            case MemoryPressure::Critical:
+                stats.pressure_level = ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL;
+                break;
+            }
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
+        }
+        case ZX_INFO_KMEM_COMPRESSION_STATS: {
+            auto status = validate_resource(handle, ZX_RSRC_KIND_ROOT);
+            if (status != ZX_OK)
+                return status;
+
+            vm_compression_stats cstats;
+            vm_compression_get_stats(&cstats);
+
+            zx_info_kmem_compression_stats_t stats = {};
+            stats.compressed_bytes = cstats.compressed_bytes;
+            stats.uncompressed_bytes = cstats.stored_pages * PAGE_SIZE;
+            stats.compressions = cstats.compressions;
+            stats.failed_compressions = cstats.failed_compressions;
+            stats.decompressions = cstats.decompressions;
+            static_assert(ZX_INFO_KMEM_COMPRESSION_LATENCY_BUCKETS ==
+                              VM_COMPRESSION_LATENCY_BUCKETS, "mismatched histograms");
+            for (uint i = 0; i < VM_COMPRESSION_LATENCY_BUCKETS; i++)
+                stats.decompress_latency[i] = cstats.decompress_latency[i];
+
+            return single_record_result(
+                _buffer, buffer_size, _actual, _avail, &stats, sizeof(stats));
+        }
         case ZX_INFO_RESOURCE: {
             // grab a reference to the dispatcher
             fbl::RefPtr<ResourceDispatcher> resource;
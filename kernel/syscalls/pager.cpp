@@ -0,0 +1,180 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <err.h>
+#include <inttypes.h>
+#include <trace.h>
+
+#include <object/handle.h>
+#include <object/pager_dispatcher.h>
+#include <object/port_dispatcher.h>
+#include <object/process_dispatcher.h>
+#include <object/vm_object_dispatcher.h>
+#include <vm/pmm.h>
+#include <vm/vm_object.h>
+
+#include <fbl/ref_ptr.h>
+
+#include <zircon/syscalls/policy.h>
+#include <zircon/types.h>
+
+#include "priv.h"
+
+#define LOCAL_TRACE 0
+
+zx_status_t sys_pager_create(uint32_t options, user_out_handle* out) {
+    LTRACEF("options %#x\n", options);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    zx_status_t status = PagerDispatcher::Create(&dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+zx_status_t sys_pager_create_vmo(zx_handle_t pager, zx_handle_t port, uint64_t key,
+                                 uint64_t size, uint32_t options, user_out_handle* out) {
+    LTRACEF("pager %x port %x key %#" PRIx64 " size %#" PRIx64 "\n", pager, port, key, size);
+
+    if (options != 0u)
+        return ZX_ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+    zx_status_t status = up->QueryPolicy(ZX_POL_NEW_VMO);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<PortDispatcher> port_dispatcher;
+    status = up->GetDispatcherWithRights(port, ZX_RIGHT_WRITE, &port_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObject> vmo;
+    status = pager_dispatcher->CreateVmo(fbl::move(port_dispatcher), key, size, &vmo);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<Dispatcher> dispatcher;
+    zx_rights_t rights;
+    status = VmObjectDispatcher::Create(fbl::move(vmo), &dispatcher, &rights);
+    if (status != ZX_OK)
+        return status;
+
+    return out->make(fbl::move(dispatcher), rights);
+}
+
+// Looks up |pager| and |pager_vmo|, checking that the vmo was created by the
+// pager and that [offset, offset + length) is a page aligned range within it.
+static zx_status_t get_pager_vmo(ProcessDispatcher* up, zx_handle_t pager,
+                                 zx_handle_t pager_vmo, uint64_t offset, uint64_t length,
+                                 fbl::RefPtr<VmObject>* vmo_out,
+                                 fbl::RefPtr<PageSource>* src_out) {
+    fbl::RefPtr<PagerDispatcher> pager_dispatcher;
+    zx_status_t status = up->GetDispatcherWithRights(pager, ZX_RIGHT_WRITE, &pager_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> vmo_dispatcher;
+    status = up->GetDispatcher(pager_vmo, &vmo_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    const fbl::RefPtr<VmObject>& vmo = vmo_dispatcher->vmo();
+    fbl::RefPtr<PageSource> src = pager_dispatcher->GetSource(*vmo);
+    if (!src)
+        return ZX_ERR_INVALID_ARGS;
+
+    if (!IS_PAGE_ALIGNED(offset) || !IS_PAGE_ALIGNED(length))
+        return ZX_ERR_INVALID_ARGS;
+
+    uint64_t end;
+    if (add_overflow(offset, length, &end) || end > vmo->size())
+        return ZX_ERR_OUT_OF_RANGE;
+
+    *vmo_out = vmo;
+    *src_out = fbl::move(src);
+    return ZX_OK;
+}
+
+zx_status_t sys_pager_supply_pages(zx_handle_t pager, zx_handle_t pager_vmo, uint64_t offset,
+                                   uint64_t length, zx_handle_t aux_vmo, uint64_t aux_offset) {
+    LTRACEF("pager %x vmo %x offset %#" PRIx64 " length %#" PRIx64 " aux %x aux offset %#" PRIx64
+            "\n", pager, pager_vmo, offset, length, aux_vmo, aux_offset);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<VmObject> vmo;
+    fbl::RefPtr<PageSource> src;
+    zx_status_t status = get_pager_vmo(up, pager, pager_vmo, offset, length, &vmo, &src);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::RefPtr<VmObjectDispatcher> aux_dispatcher;
+    status = up->GetDispatcherWithRights(aux_vmo, ZX_RIGHT_READ | ZX_RIGHT_WRITE,
+                                         &aux_dispatcher);
+    if (status != ZX_OK)
+        return status;
+
+    if (!IS_PAGE_ALIGNED(aux_offset))
+        return ZX_ERR_INVALID_ARGS;
+    if (length == 0)
+        return ZX_OK;
+
+    // Move the pages over rather than copying them.  Any that the pager vmo
+    // turns out to have already are freed along with the aux vmo's pages.
+    // get_pager_vmo() checked that the pager vmo has a page source, which
+    // is all SupplyPages() can fail on, so the pages can't be taken out of
+    // the aux vmo for nothing.
+    list_node pages;
+    list_initialize(&pages);
+    status = aux_dispatcher->vmo()->TakePages(aux_offset, length, &pages);
+    if (status != ZX_OK)
+        return status;
+
+    status = vmo->SupplyPages(offset, length, &pages);
+    DEBUG_ASSERT(status == ZX_OK);
+    pmm_free(&pages);
+    return status;
+}
+
+zx_status_t sys_pager_fail_pages(zx_handle_t pager, zx_handle_t pager_vmo, uint64_t offset,
+                                 uint64_t length, zx_status_t error) {
+    LTRACEF("pager %x vmo %x offset %#" PRIx64 " length %#" PRIx64 " error %d\n",
+            pager, pager_vmo, offset, length, error);
+
+    // Only pass on errors that make sense for a failed read, which keeps the
+    // kernel's internal errors away from the faulting thread.
+    switch (error) {
+    case ZX_ERR_IO:
+    case ZX_ERR_IO_DATA_INTEGRITY:
+    case ZX_ERR_BAD_STATE:
+    case ZX_ERR_NO_SPACE:
+        break;
+    default:
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    fbl::RefPtr<VmObject> vmo;
+    fbl::RefPtr<PageSource> src;
+    zx_status_t status = get_pager_vmo(up, pager, pager_vmo, offset, length, &vmo, &src);
+    if (status != ZX_OK)
+        return status;
+
+    src->OnPagesFailed(offset, length, error);
+    return ZX_OK;
+}
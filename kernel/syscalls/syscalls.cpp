@@ -7,6 +7,7 @@
 #include <err.h>
 #include <kernel/stats.h>
 #include <kernel/thread.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <lib/vdso.h>
 #include <object/process_dispatcher.h>
@@ -23,6 +24,20 @@
 
 #define LOCAL_TRACE 0
 
+KCOUNTER_HISTOGRAM(syscall_latency, "kernel.syscalls.latency_ns");
+
+// Syscalls are timed with current_ticks(), which unlike current_time() is
+// cheap on every platform. This converts without overflowing even for calls
+// that blocked for a long time. A call that migrated may see the counter of
+// its new cpu slightly behind, so that counts as no time.
+static zx_duration_t ticks_between(zx_ticks_t start, zx_ticks_t end) {
+    if (end <= start)
+        return 0;
+    const zx_ticks_t ticks = end - start;
+    const zx_ticks_t per_second = ticks_per_second();
+    return (ticks / per_second) * ZX_SEC(1) + (ticks % per_second) * ZX_SEC(1) / per_second;
+}
+
 int sys_invalid_syscall(uint64_t num, uint64_t pc,
                         uintptr_t vdso_code_address) {
     LTRACEF("invalid syscall %lu from PC %#lx vDSO code %#lx\n",
@@ -50,6 +65,8 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
     LTRACEF_LEVEL(2, "t %p syscall num %" PRIu64 " ip/pc %#" PRIx64 "\n",
                   get_current_thread(), syscall_num, pc);
 
+    const zx_ticks_t start = current_ticks();
+
     ProcessDispatcher* current_process = ProcessDispatcher::GetCurrent();
     const uintptr_t vdso_code_address = current_process->vdso_code_address();
 
@@ -66,6 +83,9 @@ inline syscall_result do_syscall(uint64_t syscall_num, uint64_t pc,
        This must be done before the below ktrace_tiny call. */
     arch_disable_ints();
 
+    // This includes any time spent blocked in the call.
+    kcounter_histogram_add(syscall_latency, ticks_between(start, current_ticks()));
+
     ktrace_tiny(TAG_SYSCALL_EXIT, (static_cast<uint32_t>(syscall_num << 8)) | arch_curr_cpu_num());
 
     // The assembler caller will re-disable interrupts at the appropriate time.
@@ -22,6 +22,7 @@
 #include <zircon/syscalls/system.h>
 #include <zircon/types.h>
 #include <mexec.h>
+#include <object/event_dispatcher.h>
 #include <object/resources.h>
 #include <object/process_dispatcher.h>
 #include <object/vm_object_dispatcher.h>
@@ -29,6 +30,7 @@
 #include <string.h>
 #include <trace.h>
 
+#include "priv.h"
 #include "system_priv.h"
 
 #define LOCAL_TRACE 0
@@ -402,3 +404,18 @@ zx_status_t sys_system_powerctl(zx_handle_t root_rsrc, uint32_t cmd,
     }
     return ZX_OK;
 }
+
+zx_status_t sys_system_get_event(zx_handle_t root_rsrc, uint32_t kind, user_out_handle* out) {
+    zx_status_t status;
+    if ((status = validate_resource(root_rsrc, ZX_RSRC_KIND_ROOT)) < 0) {
+        return status;
+    }
+
+    fbl::RefPtr<EventDispatcher> event = GetMemPressureEvent(kind);
+    if (!event) {
+        return ZX_ERR_INVALID_ARGS;
+    }
+
+    // The event is the kernel's to signal, so it can only be waited on.
+    return out->make(fbl::move(event), ZX_RIGHT_WAIT | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER);
+}
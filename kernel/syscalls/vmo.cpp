@@ -186,10 +186,17 @@ zx_status_t sys_vmo_op_range(zx_handle_t handle, uint32_t op, uint64_t offset, u
     // lookup the dispatcher from handle
     // TODO(ZX-967): test rights on the handle
     fbl::RefPtr<VmObjectDispatcher> vmo;
-    zx_status_t status = up->GetDispatcher(handle, &vmo);
+    zx_rights_t rights;
+    zx_status_t status = up->GetDispatcherAndRights(handle, &vmo, &rights);
     if (status != ZX_OK)
         return status;
 
+    // merging lets the kernel replace the vmo's pages, which only a writer
+    // may allow
+    if ((op == ZX_VMO_OP_MERGEABLE || op == ZX_VMO_OP_UNMERGEABLE) &&
+        (rights & ZX_RIGHT_WRITE) == 0)
+        return ZX_ERR_ACCESS_DENIED;
+
     return vmo->RangeOp(op, offset, size, _buffer, buffer_size);
 }
 
@@ -18,6 +18,7 @@
 #include <kernel/thread.h>
 #include <lib/crypto/global_prng.h>
 #include <lib/user_copy/user_ptr.h>
+#include <lib/vdso.h>
 #include <object/event_dispatcher.h>
 #include <object/event_pair_dispatcher.h>
 #include <object/handle.h>
@@ -28,6 +29,8 @@
 
 #include <fbl/alloc_checker.h>
 #include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
 #include <fbl/ref_ptr.h>
 
 #include <zircon/syscalls/log.h>
@@ -62,21 +65,12 @@ zx_status_t sys_nanosleep(zx_time_t deadline) {
 // update pvclock too.
 fbl::atomic<int64_t> utc_offset;
 
-zx_time_t sys_clock_get(zx_clock_t clock_id) {
-    switch (clock_id) {
-    case ZX_CLOCK_MONOTONIC:
-        return current_time();
-    case ZX_CLOCK_UTC:
-        return current_time() + utc_offset.load();
-    case ZX_CLOCK_THREAD:
-        return ThreadDispatcher::GetCurrent()->runtime_ns();
-    default:
-        //TODO: figure out the best option here
-        return 0u;
-    }
-}
+// Keeps the vDSO's copy of utc_offset in step with it.
+static fbl::Mutex utc_offset_lock;
 
-zx_status_t sys_clock_get_new(zx_clock_t clock_id, user_out_ptr<zx_time_t> out_time) {
+// The vDSO computes ZX_CLOCK_MONOTONIC and ZX_CLOCK_UTC by itself when it
+// can, and comes here for everything else.
+zx_status_t sys_clock_get_via_kernel(zx_clock_t clock_id, user_out_ptr<zx_time_t> out_time) {
     zx_time_t time;
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
@@ -105,9 +99,12 @@ zx_status_t sys_clock_adjust(zx_handle_t hrsrc, zx_clock_t clock_id, int64_t off
     switch (clock_id) {
     case ZX_CLOCK_MONOTONIC:
         return ZX_ERR_ACCESS_DENIED;
-    case ZX_CLOCK_UTC:
+    case ZX_CLOCK_UTC: {
+        fbl::AutoLock lock(&utc_offset_lock);
         utc_offset.store(offset);
+        VDso::SetUtcOffset(offset);
         return ZX_OK;
+    }
     default:
         return ZX_ERR_INVALID_ARGS;
     }
@@ -0,0 +1,142 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <arch/ops.h>
+#include <fbl/atomic.h>
+#include <inttypes.h>
+#include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/unittest/unittest.h>
+#include <platform.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zircon/compiler.h>
+
+// Allocations of every small size are usable and distinct, including ones
+// served again from the per-CPU caches after being freed.
+static bool heap_small_sizes() {
+    BEGIN_TEST;
+
+    constexpr size_t kMaxSize = 1024;
+    for (int pass = 0; pass < 2; pass++) {
+        static uint8_t* blocks[kMaxSize + 1];
+        for (size_t size = 1; size <= kMaxSize; size++) {
+            blocks[size] = static_cast<uint8_t*>(malloc(size));
+            ASSERT_NONNULL(blocks[size], "");
+            memset(blocks[size], static_cast<int>(size), size);
+        }
+        for (size_t size = 1; size <= kMaxSize; size++) {
+            for (size_t i = 0; i < size; i++) {
+                ASSERT_EQ(static_cast<uint8_t>(size), blocks[size][i], "block overlaps another");
+            }
+            free(blocks[size]);
+        }
+    }
+
+    END_TEST;
+}
+
+// Blocks that went through the cache can be grown and shrunk.
+static bool heap_realloc() {
+    BEGIN_TEST;
+
+    char* ptr = static_cast<char*>(malloc(40));
+    ASSERT_NONNULL(ptr, "");
+    free(ptr);
+
+    ptr = static_cast<char*>(malloc(40));
+    ASSERT_NONNULL(ptr, "");
+    memset(ptr, 'a', 40);
+    ptr = static_cast<char*>(realloc(ptr, 2000));
+    ASSERT_NONNULL(ptr, "");
+    for (size_t i = 0; i < 40; i++) {
+        ASSERT_EQ('a', ptr[i], "");
+    }
+    ptr = static_cast<char*>(realloc(ptr, 20));
+    ASSERT_NONNULL(ptr, "");
+    for (size_t i = 0; i < 20; i++) {
+        ASSERT_EQ('a', ptr[i], "");
+    }
+    free(ptr);
+
+    // shrinking can leave a block smaller than any cache class
+    for (size_t size = 1; size <= 8; size++) {
+        ptr = static_cast<char*>(malloc(40));
+        ASSERT_NONNULL(ptr, "");
+        memset(ptr, 'b', 40);
+        ptr = static_cast<char*>(realloc(ptr, size));
+        ASSERT_NONNULL(ptr, "");
+        for (size_t i = 0; i < size; i++) {
+            ASSERT_EQ('b', ptr[i], "");
+        }
+        free(ptr);
+    }
+
+    END_TEST;
+}
+
+namespace {
+
+struct ThroughputArgs {
+    uint64_t iterations;
+    fbl::atomic<bool> failed;
+};
+
+int throughput_thread(void* arg) {
+    auto args = static_cast<ThroughputArgs*>(arg);
+
+    // Sizes typical of dispatchers, handles and small messages.
+    constexpr size_t kSizes[] = {24, 48, 64, 120, 200, 256, 480, 32};
+    void* ptrs[countof(kSizes)];
+    for (uint64_t i = 0; i < args->iterations; i++) {
+        for (size_t j = 0; j < countof(kSizes); j++) {
+            ptrs[j] = malloc(kSizes[j]);
+            if (ptrs[j] == nullptr)
+                args->failed.store(true);
+        }
+        for (size_t j = 0; j < countof(kSizes); j++)
+            free(ptrs[j]);
+    }
+    return 0;
+}
+
+} // namespace
+
+// Alloc/free throughput with a thread on every CPU hammering the heap.
+static bool heap_threaded_throughput() {
+    BEGIN_TEST;
+
+    const uint num_threads = arch_max_num_cpus();
+    constexpr uint64_t kIterations = 100000;
+    ThroughputArgs args = {kIterations, {false}};
+
+    thread_t* threads[SMP_MAX_CPUS];
+    zx_time_t start = current_time();
+    for (uint i = 0; i < num_threads; i++) {
+        threads[i] = thread_create("heap throughput", throughput_thread, &args,
+                                   DEFAULT_PRIORITY, DEFAULT_STACK_SIZE);
+        ASSERT_NONNULL(threads[i], "");
+        thread_resume(threads[i]);
+    }
+    for (uint i = 0; i < num_threads; i++)
+        thread_join(threads[i], nullptr, ZX_TIME_INFINITE);
+    zx_duration_t elapsed = current_time() - start;
+
+    EXPECT_FALSE(args.failed.load(), "allocation failed");
+
+    const uint64_t ops = 2 * 8 * kIterations * num_threads;
+    printf("\n%u threads: %" PRIu64 " malloc/free in %" PRIu64 " us, %" PRIu64 " ns per op\n",
+           num_threads, ops, elapsed / ZX_USEC(1), elapsed / ops);
+
+    END_TEST;
+}
+
+UNITTEST_START_TESTCASE(heap_tests)
+UNITTEST("small sizes", heap_small_sizes)
+UNITTEST("realloc", heap_realloc)
+UNITTEST("threaded throughput", heap_threaded_throughput)
+UNITTEST_END_TESTCASE(heap_tests, "heap", "Kernel heap tests");
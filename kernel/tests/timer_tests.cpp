@@ -10,11 +10,17 @@
 #include <inttypes.h>
 #include <malloc.h>
 #include <platform.h>
+#include <rand.h>
 #include <stdio.h>
 
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
 #include <kernel/event.h>
+#include <kernel/percpu.h>
 #include <kernel/thread.h>
 #include <kernel/timer.h>
+#include <lib/unittest/unittest.h>
 
 #include <zircon/types.h>
 
@@ -195,3 +201,124 @@ void timer_tests(void) {
     timer_test_all_cpus();
     timer_far_deadline();
 }
+
+namespace {
+
+constexpr size_t kManyTimers = 16384;
+
+void noop_timer_cb(timer_t*, zx_time_t, void*) {}
+
+// Checks that every cpu's queue is in firing order.
+bool timer_queues_sorted() {
+    bool sorted = true;
+    for (uint i = 0; i < SMP_MAX_CPUS; i++) {
+        spin_lock_saved_state_t state;
+        spin_lock_irqsave(&percpu[i].timer_lock, state);
+        zx_time_t last = 0;
+        timer_t* t;
+        list_for_every_entry (&percpu[i].timer_queue, t, timer_t, node) {
+            if (t->scheduled_time < last)
+                sorted = false;
+            last = t->scheduled_time;
+        }
+        spin_unlock_irqrestore(&percpu[i].timer_lock, state);
+    }
+    return sorted;
+}
+
+} // namespace
+
+// Set and cancel lots of timers that never fire, timing both.
+static bool timer_set_cancel_many() {
+    BEGIN_TEST;
+
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<timer_t[]> timers(new (&ac) timer_t[kManyTimers]);
+    ASSERT_TRUE(ac.check(), "");
+
+    // Far enough out that none fire during the test, spread out so that some
+    // coalesce and some do not.
+    const zx_time_t base = current_time() + ZX_SEC(3600);
+    const enum slack_mode modes[] = {TIMER_SLACK_CENTER, TIMER_SLACK_LATE, TIMER_SLACK_EARLY};
+
+    zx_time_t start = current_time();
+    for (size_t i = 0; i < kManyTimers; i++) {
+        timer_init(&timers[i]);
+        zx_time_t deadline = base + (rand() % ZX_MSEC(100));
+        timer_set(&timers[i], deadline, modes[i % countof(modes)], ZX_USEC(rand() % 20),
+                  noop_timer_cb, nullptr);
+    }
+    zx_duration_t set_time = current_time() - start;
+
+    EXPECT_TRUE(timer_queues_sorted(), "timer queue out of order");
+
+    // Cancel in a different order than they were set.
+    start = current_time();
+    size_t canceled = 0;
+    for (size_t i = 0; i < kManyTimers; i += 2) {
+        canceled += timer_cancel(&timers[i]);
+    }
+    for (size_t i = 1; i < kManyTimers; i += 2) {
+        canceled += timer_cancel(&timers[i]);
+    }
+    zx_duration_t cancel_time = current_time() - start;
+
+    EXPECT_EQ(kManyTimers, canceled, "");
+    EXPECT_TRUE(timer_queues_sorted(), "timer queue out of order");
+
+    printf("\n%zu timers: %" PRIu64 " ns per set, %" PRIu64 " ns per cancel\n",
+           kManyTimers, set_time / kManyTimers, cancel_time / kManyTimers);
+
+    END_TEST;
+}
+
+namespace {
+
+struct FireState {
+    fbl::atomic<size_t> fired;
+    fbl::atomic<size_t> early;
+};
+
+void fire_timer_cb(timer_t* timer, zx_time_t now, void* arg) {
+    auto state = static_cast<FireState*>(arg);
+    if (now < timer->scheduled_time)
+        state->early.fetch_add(1);
+    state->fired.fetch_add(1);
+}
+
+} // namespace
+
+// Lots of timers with nearby deadlines all fire, and none early.
+static bool timer_fire_many() {
+    BEGIN_TEST;
+
+    constexpr size_t kCount = 2048;
+    fbl::AllocChecker ac;
+    fbl::unique_ptr<timer_t[]> timers(new (&ac) timer_t[kCount]);
+    ASSERT_TRUE(ac.check(), "");
+
+    FireState state = {{0}, {0}};
+    const zx_time_t base = current_time() + ZX_MSEC(1);
+    for (size_t i = 0; i < kCount; i++) {
+        timer_init(&timers[i]);
+        timer_set(&timers[i], base + (rand() % ZX_MSEC(20)), TIMER_SLACK_LATE, ZX_USEC(50),
+                  fire_timer_cb, &state);
+    }
+
+    while (state.fired.load() != kCount) {
+        thread_sleep_relative(ZX_MSEC(5));
+    }
+    EXPECT_EQ(0u, state.early.load(), "timers fired early");
+
+    // Wait for any callbacks still on their way out.
+    for (size_t i = 0; i < kCount; i++) {
+        EXPECT_FALSE(timer_cancel(&timers[i]), "");
+    }
+
+    END_TEST;
+}
+
+UNITTEST_START_TESTCASE(timer_tests)
+UNITTEST("set and cancel many", timer_set_cancel_many)
+UNITTEST("fire many", timer_fire_many)
+UNITTEST_END_TESTCASE(timer_tests, "timer", "Kernel timer tests");
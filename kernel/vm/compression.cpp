@@ -0,0 +1,140 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/compression.h>
+
+#include <assert.h>
+#include <fbl/alloc_checker.h>
+#include <fbl/atomic.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lk/init.h>
+#include <lz4/lz4.h>
+#include <platform.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/physmap.h>
+#include <vm/vm.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+namespace {
+
+// Pages that compress to more than this are left alone, since what little
+// they would save is eaten up by the heap's overhead and the time it takes
+// to decompress them again.
+constexpr int kMaxCompressedSize = PAGE_SIZE * 3 / 4;
+
+// Set once at init.
+bool compression_enabled;
+
+// Compression is done by the reclamation thread, one page at a time, so a
+// single set of scratch buffers will do.
+fbl::Mutex compress_lock;
+LZ4_stream_t compress_state TA_GUARDED(compress_lock);
+char compress_buf[kMaxCompressedSize] TA_GUARDED(compress_lock);
+
+fbl::atomic<uint64_t> stored_pages;
+fbl::atomic<uint64_t> compressed_bytes;
+fbl::atomic<uint64_t> compressions;
+fbl::atomic<uint64_t> failed_compressions;
+fbl::atomic<uint64_t> decompressions;
+fbl::atomic<uint64_t> decompress_latency[VM_COMPRESSION_LATENCY_BUCKETS];
+
+void RecordDecompressLatency(zx_duration_t duration) {
+    const uint64_t usec = duration / ZX_USEC(1);
+    uint bucket = usec == 0 ? 0 : 64 - __builtin_clzll(usec);
+    if (bucket >= VM_COMPRESSION_LATENCY_BUCKETS)
+        bucket = VM_COMPRESSION_LATENCY_BUCKETS - 1;
+    decompress_latency[bucket].fetch_add(1, fbl::memory_order_relaxed);
+}
+
+void compression_init(uint level) {
+    // Be sure to update kernel_cmdline.md if the default changes.
+    compression_enabled = cmdline_get_bool("kernel.vm.compression.enable", true);
+}
+
+} // namespace
+
+LK_INIT_HOOK(vm_compression, &compression_init, LK_INIT_LEVEL_VM);
+
+bool vm_compression_enabled() {
+    return compression_enabled;
+}
+
+fbl::unique_ptr<VmCompressedPage> VmCompressedPage::Create(uint64_t offset, paddr_t pa) {
+    if (!compression_enabled)
+        return nullptr;
+
+    const char* src = static_cast<const char*>(paddr_to_physmap(pa));
+    DEBUG_ASSERT(src);
+
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> data;
+    {
+        fbl::AutoLock a(&compress_lock);
+
+        int size = LZ4_compress_fast_extState(&compress_state, src, compress_buf,
+                                              PAGE_SIZE, kMaxCompressedSize, 1);
+        if (size <= 0) {
+            failed_compressions.fetch_add(1, fbl::memory_order_relaxed);
+            return nullptr;
+        }
+
+        uint8_t* buf = new (&ac) uint8_t[size];
+        if (!ac.check())
+            return nullptr;
+        memcpy(buf, compress_buf, size);
+        data.reset(buf, size);
+    }
+
+    const size_t size = data.size();
+    fbl::unique_ptr<VmCompressedPage> page(new (&ac) VmCompressedPage(offset, fbl::move(data)));
+    if (!ac.check())
+        return nullptr;
+
+    LTRACEF("offset %#" PRIx64 " compressed to %zu bytes\n", offset, size);
+    compressions.fetch_add(1, fbl::memory_order_relaxed);
+    stored_pages.fetch_add(1, fbl::memory_order_relaxed);
+    compressed_bytes.fetch_add(size, fbl::memory_order_relaxed);
+    return page;
+}
+
+VmCompressedPage::VmCompressedPage(uint64_t offset, fbl::Array<uint8_t> data)
+    : offset_(offset), data_(fbl::move(data)) {}
+
+VmCompressedPage::~VmCompressedPage() {
+    stored_pages.fetch_sub(1, fbl::memory_order_relaxed);
+    compressed_bytes.fetch_sub(data_.size(), fbl::memory_order_relaxed);
+}
+
+void VmCompressedPage::Decompress(paddr_t pa) const {
+    char* dst = static_cast<char*>(paddr_to_physmap(pa));
+    DEBUG_ASSERT(dst);
+
+    const zx_time_t start = current_time();
+    int size = LZ4_decompress_safe(reinterpret_cast<const char*>(data_.get()), dst,
+                                   static_cast<int>(data_.size()), PAGE_SIZE);
+    // We made the data ourselves, so anything else means it was overwritten.
+    ASSERT(size == PAGE_SIZE);
+    RecordDecompressLatency(current_time() - start);
+
+    decompressions.fetch_add(1, fbl::memory_order_relaxed);
+}
+
+void vm_compression_get_stats(vm_compression_stats* stats) {
+    stats->stored_pages = stored_pages.load(fbl::memory_order_relaxed);
+    stats->compressed_bytes = compressed_bytes.load(fbl::memory_order_relaxed);
+    stats->compressions = compressions.load(fbl::memory_order_relaxed);
+    stats->failed_compressions = failed_compressions.load(fbl::memory_order_relaxed);
+    stats->decompressions = decompressions.load(fbl::memory_order_relaxed);
+    for (uint i = 0; i < VM_COMPRESSION_LATENCY_BUCKETS; i++)
+        stats->decompress_latency[i] = decompress_latency[i].load(fbl::memory_order_relaxed);
+}
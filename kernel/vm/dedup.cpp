@@ -0,0 +1,117 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#include "vm_priv.h"
+
+using fbl::AutoLock;
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+// Zero page deduplication.
+//
+// A low priority kernel thread periodically looks through the committed pages
+// of VMOs for ones that are all zeros, and frees them. Reads of those offsets
+// then map the shared zero page, and writes allocate a fresh page, just as if
+// the pages had never been committed.
+//
+// By default only VMOs that user space opted in with ZX_VMO_OP_MERGEABLE are
+// scanned.
+
+KCOUNTER(dedup_scan_count, "kernel.vm.dedup.scans");
+KCOUNTER(dedup_reclaimed_bytes, "kernel.vm.dedup.reclaimed_bytes");
+
+namespace {
+
+// Set once at init.
+bool all_vmos;
+zx_duration_t scan_period;
+
+// Serializes scans.
+fbl::Mutex dedup_lock;
+
+uint64_t ScanLocked() TA_REQ(dedup_lock) {
+    uint64_t freed = 0;
+    VmObject::ForEachUnlocked([&freed](VmObject& vmo) {
+        freed += vmo.DedupZeroPages(all_vmos);
+        return ZX_OK;
+    });
+
+    kcounter_add(dedup_scan_count, 1);
+    kcounter_add(dedup_reclaimed_bytes, static_cast<int64_t>(freed * PAGE_SIZE));
+    LTRACEF("freed %" PRIu64 " zero pages\n", freed);
+    return freed;
+}
+
+int dedup_loop(void* arg) {
+    for (;;) {
+        thread_sleep_relative(scan_period);
+
+        AutoLock a(&dedup_lock);
+        ScanLocked();
+    }
+    return 0;
+}
+
+void dedup_init(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    all_vmos = cmdline_get_bool("kernel.vm.dedup.all-vmos", false);
+    scan_period = ZX_SEC(cmdline_get_uint64("kernel.vm.dedup.scan-period-sec", 30));
+
+    if (!cmdline_get_bool("kernel.vm.dedup.enable", true)) {
+        printf("dedup: thread disabled\n");
+        return;
+    }
+
+    thread_t* t = thread_create("vm-dedup", &dedup_loop, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("dedup: failed to create thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+LK_INIT_HOOK(vm_dedup, &dedup_init, LK_INIT_LEVEL_THREADING);
+
+static int cmd_dedup(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+        printf("Not enough arguments:\n");
+    usage:
+        printf("dedup scan          : free zero pages of the scanned vmos now\n");
+        return -1;
+    }
+
+    if (!strcmp(argv[1].str, "scan")) {
+        AutoLock a(&dedup_lock);
+        printf("freed %" PRIu64 " zero pages%s\n", ScanLocked(),
+               all_vmos ? "" : " of mergeable vmos");
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+    return 0;
+}
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("dedup", "zero page deduplication", &cmd_dedup)
+#endif
+STATIC_COMMAND_END(dedup);
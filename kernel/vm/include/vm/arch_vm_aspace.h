@@ -29,6 +29,9 @@ const uint ARCH_MMU_FLAG_INVALID = (1u << 7); // Indicates that flags are not sp
 const uint ARCH_ASPACE_FLAG_KERNEL = (1u << 0);
 const uint ARCH_ASPACE_FLAG_GUEST = (1u << 1);
 
+// Called by HarvestAccessed() for each accessed page.
+typedef void (*harvest_accessed_fn_t)(void* context, vaddr_t vaddr, paddr_t paddr);
+
 // per arch base class api to encapsulate the mmu routines on an aspace
 class ArchVmAspaceInterface {
 public:
@@ -58,6 +61,13 @@ public:
 
     virtual zx_status_t Query(vaddr_t vaddr, paddr_t* paddr, uint* mmu_flags) = 0;
 
+    // Call |accessed_fn| for each page in the given virtual address range that
+    // has been accessed since the last call, and clear its accessed state.
+    // Returns ZX_ERR_NOT_SUPPORTED if the hardware accessed state is not
+    // tracked, in which case every mapped page has to be assumed accessed.
+    virtual zx_status_t HarvestAccessed(vaddr_t vaddr, size_t count,
+                                        harvest_accessed_fn_t accessed_fn, void* context) = 0;
+
     virtual vaddr_t PickSpot(vaddr_t base, uint prev_region_mmu_flags,
                              vaddr_t end, uint next_region_mmu_flags,
                              vaddr_t align, size_t size, uint mmu_flags) = 0;
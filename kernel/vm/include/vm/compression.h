@@ -0,0 +1,72 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/array.h>
+#include <fbl/intrusive_wavl_tree.h>
+#include <fbl/macros.h>
+#include <fbl/unique_ptr.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <zircon/types.h>
+
+// Compressed pages.
+//
+// Rather than freeing only the inactive anonymous pages that are all zeros,
+// reclamation can compress the others with LZ4 into the kernel heap and free
+// the pages. A VMO keeps the compressed copies next to its page list, and
+// decompresses one into a new page when the offset is looked up again.
+
+// The number of buckets in the decompression latency histogram. Bucket 0
+// counts decompressions that took less than a microsecond, bucket i those
+// that took [2^(i-1), 2^i) microseconds, and the last bucket all the rest.
+#define VM_COMPRESSION_LATENCY_BUCKETS 16u
+
+class VmCompressedPage final
+    : public fbl::WAVLTreeContainable<fbl::unique_ptr<VmCompressedPage>> {
+public:
+    // Compresses the page at |pa|, which is to be found at |offset| of its
+    // VMO. Returns null if compression is disabled, if the page doesn't
+    // compress well enough to be worth keeping that way, or if there is no
+    // memory for the compressed copy.
+    static fbl::unique_ptr<VmCompressedPage> Create(uint64_t offset, paddr_t pa);
+
+    ~VmCompressedPage();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(VmCompressedPage);
+
+    uint64_t offset() const { return offset_; }
+    uint64_t GetKey() const { return offset_; }
+
+    // Decompresses into the page at |pa|.
+    void Decompress(paddr_t pa) const;
+
+private:
+    VmCompressedPage(uint64_t offset, fbl::Array<uint8_t> data);
+
+    const uint64_t offset_;
+    const fbl::Array<uint8_t> data_;
+};
+
+// Whether reclamation compresses pages, set from kernel.vm.compression.enable.
+bool vm_compression_enabled();
+
+using VmCompressedPageTree = fbl::WAVLTree<uint64_t, fbl::unique_ptr<VmCompressedPage>>;
+
+struct vm_compression_stats {
+    // pages currently held compressed, and the bytes they take up
+    uint64_t stored_pages;
+    uint64_t compressed_bytes;
+
+    // totals since boot
+    uint64_t compressions;
+    uint64_t failed_compressions;
+    uint64_t decompressions;
+    uint64_t decompress_latency[VM_COMPRESSION_LATENCY_BUCKETS];
+};
+
+void vm_compression_get_stats(vm_compression_stats* stats);
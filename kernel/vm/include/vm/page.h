@@ -28,6 +28,11 @@ enum vm_page_state {
 #define VM_PAGE_STATE_BITS 3
 static_assert((1u << VM_PAGE_STATE_BITS) >= VM_PAGE_STATE_COUNT_, "");
 
+// page flags
+#define VM_PAGE_FLAG_ZEROED (1u << 0)   // free page known to be zero filled
+#define VM_PAGE_FLAG_MODIFIED (1u << 1) // object page that may have been written to
+#define VM_PAGE_FLAG_CACHED (1u << 2)   // free page held by a per cpu cache, not the free lists
+
 // core per page structure allocated at pmm arena creation time
 typedef struct vm_page {
     struct list_node queue_node;
@@ -46,6 +51,12 @@ typedef struct vm_page {
 #define VM_PAGE_OBJECT_MAX_PIN_COUNT ((1ul << VM_PAGE_OBJECT_PIN_COUNT_BITS) - 1)
 
             uint8_t pin_count : VM_PAGE_OBJECT_PIN_COUNT_BITS;
+
+            // number of reclaim scans since the page was last accessed
+#define VM_PAGE_OBJECT_AGE_BITS 3
+#define VM_PAGE_OBJECT_MAX_AGE ((1u << VM_PAGE_OBJECT_AGE_BITS) - 1)
+
+            uint8_t age : VM_PAGE_OBJECT_AGE_BITS;
         } object; // attached to a vm object
     };
 
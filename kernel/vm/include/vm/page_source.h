@@ -0,0 +1,92 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <fbl/canary.h>
+#include <fbl/intrusive_double_list.h>
+#include <fbl/macros.h>
+#include <fbl/mutex.h>
+#include <fbl/ref_counted.h>
+#include <fbl/ref_ptr.h>
+#include <kernel/event.h>
+#include <zircon/thread_annotations.h>
+#include <zircon/types.h>
+
+class PageSource;
+
+// A request for a page that a VMO does not have yet and has to get from its
+// PageSource.  It lives on the stack of the thread that needs the page: the
+// VMO queues it with the VMO lock held, and the thread waits on it once it
+// has dropped all of its locks, then retries the operation.  A request can
+// be reused once Wait() returns.
+class PageRequest : public fbl::DoublyLinkedListable<PageRequest*> {
+public:
+    PageRequest() = default;
+    ~PageRequest();
+
+    // Waits until the page has been supplied, returning ZX_OK, or until the
+    // source fails to supply it or the thread is killed.  Suspending the
+    // thread does not interrupt the wait.
+    zx_status_t Wait();
+
+    DISALLOW_COPY_ASSIGN_AND_MOVE(PageRequest);
+
+private:
+    friend PageSource;
+
+    // The source this request is queued on, if any.
+    fbl::RefPtr<PageSource> src_;
+    uint64_t offset_ = 0;
+    // The result of the request, set by the source before it signals event_.
+    zx_status_t status_ = ZX_OK;
+    event_t event_ = EVENT_INITIAL_VALUE(event_, false, 0);
+};
+
+// Supplies the pages of a VMO that it does not have yet, e.g. on behalf of
+// a user-space pager.  This class keeps track of the outstanding requests,
+// while subclasses pass them on to whatever provides the pages.
+class PageSource : public fbl::RefCounted<PageSource> {
+public:
+    // Queues |request| for the page at |offset|, asking for the page unless
+    // it has already been asked for.  Called with the VMO's lock held.
+    // Returns ZX_ERR_SHOULD_WAIT if the caller should drop its locks and
+    // wait on |request|, or an error if the page cannot be supplied.
+    zx_status_t GetPage(uint64_t offset, PageRequest* request);
+
+    // Completes the requests for pages in [offset, offset + len), once the
+    // VMO has them or with |error| if they cannot be supplied.
+    void OnPagesSupplied(uint64_t offset, uint64_t len);
+    void OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error);
+
+    // Fails all outstanding and future requests.  Called when the VMO goes
+    // away or whatever provides the pages does.
+    void Close();
+
+protected:
+    PageSource() = default;
+    virtual ~PageSource();
+    friend fbl::RefPtr<PageSource>;
+
+    // Asks for the pages [offset, offset + len).  Called with the source's
+    // lock held, so implementations must not call back into the source.
+    virtual zx_status_t SendRequest(uint64_t offset, uint64_t len) = 0;
+
+    // Called once, the first time Close() is called.
+    virtual void OnClose() = 0;
+
+private:
+    friend PageRequest;
+
+    void CompleteRequestsLocked(uint64_t offset, uint64_t len, zx_status_t status) TA_REQ(lock_);
+    void CancelRequest(PageRequest* request);
+
+    fbl::Canary<fbl::magic("PSRC")> canary_;
+
+    fbl::Mutex lock_;
+    fbl::DoublyLinkedList<PageRequest*> requests_ TA_GUARDED(lock_);
+    bool closed_ TA_GUARDED(lock_) = false;
+};
@@ -32,6 +32,7 @@ zx_status_t pmm_add_arena(const pmm_arena_info_t* arena);
 // flags for allocation routines below
 #define PMM_ALLOC_FLAG_ANY (0x0)    // no restrictions on which arena to allocate from
 #define PMM_ALLOC_FLAG_LO_MEM (0x1) // allocate only from arenas marked LO_MEM
+#define PMM_ALLOC_FLAG_ZEROED (0x2) // return zero filled pages, preferring ones zeroed in the background
 
 // Allocate count pages of physical memory, adding to the tail of the passed list.
 // The list must be initialized.
@@ -0,0 +1,61 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <zircon/compiler.h>
+
+// Page reclamation.
+//
+// A kernel thread periodically ages the pages of every VMO: a page gets one
+// scan older each time it is found not to have been accessed through the page
+// tables or looked up by the kernel since the previous scan. Pages that are
+// at least VM_RECLAIM_INACTIVE_AGE scans old are inactive, the rest active.
+//
+// When free memory runs low, inactive pages that can be brought back without
+// loss are freed, oldest first: unmodified pages of pager-backed VMOs, which
+// the pager can supply again, anonymous pages that are all zeros, which
+// fault back in as zero pages, and other anonymous pages once they have been
+// compressed (see vm/compression.h).
+
+// The age at which pages become inactive, and candidates for eviction.
+#define VM_RECLAIM_INACTIVE_AGE 3u
+
+enum class MemoryPressure {
+    Normal,
+    Warning,
+    Critical,
+};
+
+// Called whenever the memory pressure level changes.
+typedef void (*reclaim_pressure_callback_t)(MemoryPressure level);
+
+// Sets the function to call when the memory pressure level changes, and calls
+// it right away with the current level.
+void reclaim_set_pressure_callback(reclaim_pressure_callback_t callback);
+
+// Returns the current memory pressure level.
+MemoryPressure reclaim_get_pressure();
+
+// Evicts up to |target_pages| inactive pages, oldest first, and returns the
+// number of pages it freed.
+uint64_t reclaim_evict_pages(uint64_t target_pages);
+
+struct reclaim_stats {
+    // page counts as of the last scan
+    uint64_t active_pages;
+    uint64_t inactive_pages;
+
+    // totals since boot
+    uint64_t evicted_pages;
+    uint64_t scans;
+
+    MemoryPressure pressure;
+};
+
+void reclaim_get_stats(reclaim_stats* stats);
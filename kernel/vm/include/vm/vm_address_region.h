@@ -114,8 +114,10 @@ public:
     fbl::RefPtr<VmMapping> as_vm_mapping();
 
     // Page fault in an address within the region.  Recursively traverses
-    // the regions to find the target mapping, if it exists.
-    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags) = 0;
+    // the regions to find the target mapping, if it exists.  Returns
+    // ZX_ERR_SHOULD_WAIT if the page has to come from a page source, after
+    // queueing |page_request| on it.
+    virtual zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) = 0;
 
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
@@ -235,7 +237,7 @@ public:
     bool is_mapping() const override { return false; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
 
 protected:
     // constructor for use in creating a VmAddressRegionDummy
@@ -368,7 +370,7 @@ public:
         return;
     }
 
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override {
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override {
         // We should never be trying to page fault on this...
         ASSERT(false);
         return ZX_ERR_BAD_STATE;
@@ -432,7 +434,14 @@ public:
     bool is_mapping() const override { return true; }
 
     void Dump(uint depth, bool verbose) const override;
-    zx_status_t PageFault(vaddr_t va, uint pf_flags) override;
+    zx_status_t PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) override;
+
+    // Calls |accessed_fn| for each page of the mapping that has been accessed
+    // since the last call, and clears its accessed state. Must be called with
+    // the object's lock held. Returns ZX_ERR_NOT_SUPPORTED if the
+    // architecture can't tell, in which case every mapped page should be
+    // assumed to have been accessed.
+    zx_status_t HarvestAccessedLocked(harvest_accessed_fn_t accessed_fn, void* context) const;
 
 protected:
     ~VmMapping() override;
@@ -477,6 +486,17 @@ private:
     // in Clang around capability aliasing, we need to relax the analysis.
     void ActivateLocked();
 
+    // Map in already resident pages of the object around a faulting address.
+    // Must be called with object_->lock() held, see ActivateLocked() for why
+    // it is not annotated.
+    void FaultAroundLocked(vaddr_t va, uint pf_flags) TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    // Replace the small pages mapped around a faulting address with a large
+    // page if the object has a suitable run of pages there. Same locking
+    // requirements as FaultAroundLocked().
+    bool PromoteLargePageLocked(vaddr_t va, paddr_t pa, uint pf_flags)
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
     // pointer and region of the object we are mapping
     fbl::RefPtr<VmObject> object_;
     uint64_t object_offset_ = 0;
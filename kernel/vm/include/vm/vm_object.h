@@ -24,6 +24,8 @@
 #include <zircon/thread_annotations.h>
 #include <zircon/types.h>
 
+class PageRequest;
+class PageSource;
 class VmMapping;
 
 typedef zx_status_t (*vmo_lookup_fn_t)(void* context, size_t offset, size_t index, paddr_t pa);
@@ -80,6 +82,12 @@ public:
         return ZX_ERR_NOT_SUPPORTED;
     }
 
+    // Commit and pin the given range of the vmo in one step, so that no
+    // pages can be reclaimed in between.
+    virtual zx_status_t CommitRangePinned(uint64_t offset, uint64_t len) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
     // Unpin the given range of the vmo.  This asserts if it tries to unpin a
     // page that is already not pinned (do not expose this function to
     // usermode).
@@ -172,11 +180,47 @@ public:
     // TODO: If more types of clones appear, replace this with a method that
     // returns an enum rather than adding a new method for each clone type.
     bool is_cow_clone() const;
+    bool is_cow_clone_locked() const TA_REQ(lock_) { return parent_ != nullptr; }
+
+    // Returns true if the pages of this VMO, or of the VMO it is a clone of,
+    // come from a PageSource.
+    virtual bool is_pager_backed_locked() const TA_REQ(lock_) { return false; }
+
+    // Returns true if looking up the page at |offset| would decompress it, in
+    // this VMO or the one it is a clone of.  Lookups that are only speculative
+    // skip such pages, so as not to undo the compression.
+    virtual bool IsPageCompressedLocked(uint64_t offset) TA_REQ(lock_) { return false; }
+
+    // The PageSource this VMO's pages come from, if any.  Only used to check
+    // that a VMO belongs to a particular pager.
+    virtual const PageSource* page_source() const { return nullptr; }
+
+    // Moves the pages in [offset, offset + len) out of this VMO and onto
+    // |pages|, in order, committing any that are missing.  The range must be
+    // page aligned.
+    virtual zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+
+    // Gives the pages on |pages| to this VMO at [offset, offset + len), and
+    // completes the page requests waiting for them.  Offsets that already
+    // have a page keep it; the supplied page is left on |pages|, as are the
+    // pages for offsets past the end if the VMO has shrunk.  Only fails if
+    // the VMO has no page source.
+    virtual zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+        return ZX_ERR_NOT_SUPPORTED;
+    }
 
     // get a pointer to the page structure and/or physical address at the specified offset.
     // valid flags are VMM_PF_FLAG_*
+    //
+    // If the page has to come from a PageSource, |page_request| is queued on
+    // it and ZX_ERR_SHOULD_WAIT is returned, after which the caller should
+    // drop its locks, wait on the request and try again.  Callers that
+    // cannot wait pass nullptr, and get ZX_ERR_NOT_FOUND instead.
     virtual zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                                      vm_page_t** page, paddr_t* pa) TA_REQ(lock_) {
+                                      PageRequest* page_request, vm_page_t** page,
+                                      paddr_t* pa) TA_REQ(lock_) {
         return ZX_ERR_NOT_SUPPORTED;
     }
 
@@ -214,6 +258,58 @@ public:
         return ZX_OK;
     }
 
+    // Like ForEach(), but calls |func(VmObject&)| without the global VMO lock
+    // held, with a reference held on the VMO, so that |func| may take the
+    // VMO's own lock and block.  VMOs that are being destroyed are skipped.
+    template <typename T>
+    static zx_status_t ForEachUnlocked(T func) {
+        fbl::RefPtr<VmObject> vmo;
+        for (;;) {
+            fbl::RefPtr<VmObject> prev = fbl::move(vmo);
+            {
+                fbl::AutoLock a(&all_vmos_lock_);
+                // |prev| is still in the list, since we hold a reference.
+                auto iter = prev ? ++all_vmos_.make_iterator(*prev) : all_vmos_.begin();
+                for (; iter != all_vmos_.end(); ++iter) {
+                    vmo = fbl::internal::MakeRefPtrUpgradeFromRaw(&*iter, all_vmos_lock_);
+                    if (vmo)
+                        break;
+                }
+            }
+            // Drop the previous reference outside of the lock, since it may
+            // be the last one.
+            prev.reset();
+            if (!vmo)
+                return ZX_OK;
+            zx_status_t s = func(*vmo);
+            if (s != ZX_OK)
+                return s;
+        }
+    }
+
+    // Adds the VMO to the global VMO list.  Called by the Create() functions
+    // once the VMO has been adopted, so that walkers of the list never see a
+    // VMO that is still being constructed.
+    void AddToGlobalList();
+
+    // Ages the pages of this VMO for page reclamation, counting how many of
+    // them are in use and how many have not been accessed recently.
+    virtual void AgePages(uint64_t* active, uint64_t* inactive) {}
+
+    // Frees up to |max_pages| pages of this VMO that are at least |min_age|
+    // scans old and can be brought back without loss, returning how many it
+    // freed.
+    virtual uint64_t EvictPages(uint min_age, uint64_t max_pages) { return 0; }
+
+    // Opts this VMO in or out of zero page deduplication, for when the
+    // scanner is limited to the VMOs that asked for it.
+    virtual zx_status_t SetMergeable(bool mergeable) { return ZX_ERR_NOT_SUPPORTED; }
+
+    // Frees the pages of this VMO that are all zeros, which fault back in as
+    // the shared zero page, returning how many it freed. Unless |all_vmos|,
+    // only does so if the VMO is mergeable.
+    virtual uint64_t DedupZeroPages(bool all_vmos) { return 0; }
+
 protected:
     // private constructor (use Create())
     explicit VmObject(fbl::RefPtr<VmObject> parent);
@@ -17,6 +17,8 @@
 #include <lib/user_copy/user_ptr.h>
 #include <list.h>
 #include <stdint.h>
+#include <vm/compression.h>
+#include <vm/page_source.h>
 #include <vm/pmm.h>
 #include <vm/vm.h>
 #include <vm/vm_aspace.h>
@@ -38,6 +40,11 @@ public:
 
     static zx_status_t CreateFromROData(const void* data, size_t size, fbl::RefPtr<VmObject>* vmo);
 
+    // Create a VMO whose pages are supplied by |src| the first time they are
+    // needed, rather than being zero filled.
+    static zx_status_t CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                      fbl::RefPtr<VmObject>* vmo);
+
     zx_status_t Resize(uint64_t size) override;
     zx_status_t ResizeLocked(uint64_t size) override TA_REQ(lock_);
     uint64_t size() const override
@@ -53,6 +60,7 @@ public:
     zx_status_t DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) override;
 
     zx_status_t Pin(uint64_t offset, uint64_t len) override;
+    zx_status_t CommitRangePinned(uint64_t offset, uint64_t len) override;
     void Unpin(uint64_t offset, uint64_t len) override;
 
     zx_status_t Read(void* ptr, uint64_t offset, size_t len) override;
@@ -74,9 +82,26 @@ public:
     zx_status_t SyncCache(const uint64_t offset, const uint64_t len) override;
 
     zx_status_t GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                              vm_page_t**, paddr_t*) override
+                              PageRequest* page_request, vm_page_t**, paddr_t*) override
+        // Calls a Locked method of the parent, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+
+    bool is_pager_backed_locked() const override
         // Calls a Locked method of the parent, which confuses analysis.
         TA_NO_THREAD_SAFETY_ANALYSIS;
+    bool IsPageCompressedLocked(uint64_t offset) override
+        // Calls a Locked method of the parent, which confuses analysis.
+        TA_NO_THREAD_SAFETY_ANALYSIS;
+    const PageSource* page_source() const override { return page_source_.get(); }
+
+    zx_status_t TakePages(uint64_t offset, uint64_t len, list_node* pages) override;
+    zx_status_t SupplyPages(uint64_t offset, uint64_t len, list_node* pages) override;
+
+    void AgePages(uint64_t* active, uint64_t* inactive) override;
+    uint64_t EvictPages(uint min_age, uint64_t max_pages) override;
+
+    zx_status_t SetMergeable(bool mergeable) override;
+    uint64_t DedupZeroPages(bool all_vmos) override;
 
     zx_status_t CloneCOW(uint64_t offset, uint64_t size, bool copy_name,
                          fbl::RefPtr<VmObject>* clone_vmo) override
@@ -118,12 +143,22 @@ private:
     // internal page list routine
     void AddPageToArray(size_t index, vm_page_t* p);
 
+    // back the empty large page sized chunks of [offset, end) with physically
+    // contiguous runs of pages, as part of committing the range, and return
+    // the number of pages committed
+    size_t CommitLargePagesLocked(uint64_t offset, uint64_t end) TA_REQ(lock_);
+
+    zx_status_t CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed)
+        TA_REQ(lock_);
     zx_status_t PinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
     void UnpinLocked(uint64_t offset, uint64_t len) TA_REQ(lock_);
 
     // internal check if any pages in a range are pinned
     bool AnyPagesPinnedLocked(uint64_t offset, size_t len) TA_REQ(lock_);
 
+    // drop the compressed copies of pages in [start, end)
+    void FreeCompressedPagesLocked(uint64_t start, uint64_t end) TA_REQ(lock_);
+
     // internal read/write routine that takes a templated copy function to help share some code
     template <typename T>
     zx_status_t ReadWriteInternal(uint64_t offset, size_t len, bool write, T copyfunc);
@@ -138,6 +173,17 @@ private:
     uint32_t cache_policy_ TA_GUARDED(lock_) = ARCH_MMU_FLAG_CACHED;
     const bool is_contiguous_;
 
+    // whether user space opted in to zero page deduplication
+    bool mergeable_ TA_GUARDED(lock_) = false;
+
+    // where the pages come from when they are not in page_list_, if not
+    // zero fill; only set before the vmo is shared
+    fbl::RefPtr<PageSource> page_source_;
+
     // a tree of pages
     VmPageList page_list_ TA_GUARDED(lock_);
+
+    // compressed copies of pages that reclamation took out of page_list_,
+    // which are decompressed when looked up again
+    VmCompressedPageTree compressed_pages_ TA_GUARDED(lock_);
 };
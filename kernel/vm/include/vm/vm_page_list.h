@@ -189,6 +189,8 @@ public:
 
     zx_status_t AddPage(vm_page*, uint64_t offset);
     vm_page* GetPage(uint64_t offset);
+    // Removes the page at |offset| from the list and returns it, if there is one.
+    vm_page* RemovePage(uint64_t offset);
     zx_status_t FreePage(uint64_t offset);
     size_t FreeAllPages();
     bool IsEmpty();
@@ -0,0 +1,135 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/page_source.h>
+
+#include <fbl/auto_lock.h>
+#include <inttypes.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
+#include <trace.h>
+#include <vm/vm.h>
+
+#include "vm_priv.h"
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(page_source_requests, "kernel.vm.page_source.requests");
+KCOUNTER(page_source_waits, "kernel.vm.page_source.waits");
+
+PageRequest::~PageRequest() {
+    if (src_) {
+        src_->CancelRequest(this);
+    }
+    event_destroy(&event_);
+}
+
+zx_status_t PageRequest::Wait() {
+    DEBUG_ASSERT(src_);
+
+    // A thread that is suspended in the middle of a page fault can only stop
+    // once the fault is over, so only let killing the thread cut this short.
+    zx_status_t status = event_wait_with_mask(&event_, THREAD_SIGNAL_SUSPEND);
+    if (status == ZX_OK) {
+        status = status_;
+    } else {
+        // Nobody completes a request after it has been cancelled.
+        src_->CancelRequest(this);
+    }
+    src_.reset();
+    return status;
+}
+
+PageSource::~PageSource() {
+    DEBUG_ASSERT(closed_);
+    DEBUG_ASSERT(requests_.is_empty());
+}
+
+zx_status_t PageSource::GetPage(uint64_t offset, PageRequest* request) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(!request->src_);
+
+    fbl::AutoLock guard(&lock_);
+    if (closed_) {
+        return ZX_ERR_BAD_STATE;
+    }
+
+    // Only ask for the page if no other thread is waiting for it already.
+    bool outstanding = false;
+    for (const auto& r : requests_) {
+        if (r.offset_ == offset) {
+            outstanding = true;
+            break;
+        }
+    }
+    if (!outstanding) {
+        LTRACEF("source %p offset %#" PRIx64 "\n", this, offset);
+        zx_status_t status = SendRequest(offset, PAGE_SIZE);
+        if (status != ZX_OK) {
+            return status;
+        }
+        kcounter_add(page_source_requests, 1);
+    }
+
+    request->src_ = fbl::WrapRefPtr(this);
+    request->offset_ = offset;
+    request->status_ = ZX_OK;
+    event_unsignal(&request->event_);
+    requests_.push_back(request);
+    kcounter_add(page_source_waits, 1);
+    return ZX_ERR_SHOULD_WAIT;
+}
+
+void PageSource::OnPagesSupplied(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+
+    fbl::AutoLock guard(&lock_);
+    CompleteRequestsLocked(offset, len, ZX_OK);
+}
+
+void PageSource::OnPagesFailed(uint64_t offset, uint64_t len, zx_status_t error) {
+    canary_.Assert();
+    DEBUG_ASSERT(error != ZX_OK);
+
+    fbl::AutoLock guard(&lock_);
+    CompleteRequestsLocked(offset, len, error);
+}
+
+void PageSource::Close() {
+    canary_.Assert();
+
+    {
+        fbl::AutoLock guard(&lock_);
+        if (closed_) {
+            return;
+        }
+        closed_ = true;
+        CompleteRequestsLocked(0, UINT64_MAX, ZX_ERR_BAD_STATE);
+    }
+
+    OnClose();
+}
+
+void PageSource::CompleteRequestsLocked(uint64_t offset, uint64_t len, zx_status_t status) {
+    for (auto iter = requests_.begin(); iter != requests_.end();) {
+        PageRequest* request = &*iter++;
+        if (request->offset_ >= offset && request->offset_ - offset < len) {
+            requests_.erase(*request);
+            // Signalled under the lock, so that a waiter that was killed in
+            // the meantime cannot destroy the request before this is done.
+            request->status_ = status;
+            event_signal(&request->event_, false);
+        }
+    }
+}
+
+void PageSource::CancelRequest(PageRequest* request) {
+    fbl::AutoLock guard(&lock_);
+    if (request->InContainer()) {
+        requests_.erase(*request);
+    }
+}
@@ -48,6 +48,11 @@ static void pmm_enforce_fill(uint level) {
 LK_INIT_HOOK(pmm_fill, &pmm_enforce_fill, LK_INIT_LEVEL_VM);
 #endif
 
+static void pmm_start_zeroing(uint level) {
+    pmm_node.StartZeroingThread();
+}
+LK_INIT_HOOK(pmm_zeroing, &pmm_start_zeroing, LK_INIT_LEVEL_THREADING);
+
 vm_page_t* paddr_to_vm_page(paddr_t addr) {
     return pmm_node.PaddrToPage(addr);
 }
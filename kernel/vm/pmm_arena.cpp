@@ -113,7 +113,9 @@ retry:
     while ((start < size() / PAGE_SIZE) && ((start + count) <= size() / PAGE_SIZE)) {
         vm_page_t* p = &page_array_[start];
         for (uint i = 0; i < count; i++) {
-            if (!p->is_free()) {
+            // pages held by the per cpu caches can be taken by other cpus at
+            // any time, so they don't count as free here
+            if (!p->is_free() || (p->flags & VM_PAGE_FLAG_CACHED)) {
                 // this run is broken, break out of the inner loop.
                 // start over at the next alignment boundary
                 start = ROUNDUP(start - aligned_offset + i + 1, 1UL << (alignment_log2 - PAGE_SIZE_SHIFT)) +
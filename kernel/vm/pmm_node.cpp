@@ -6,7 +6,11 @@
 #include "pmm_node.h"
 
 #include <inttypes.h>
+#include <kernel/atomic.h>
+#include <kernel/auto_lock.h>
 #include <kernel/mp.h>
+#include <kernel/thread.h>
+#include <lib/counters.h>
 #include <trace.h>
 #include <vm/bootalloc.h>
 #include <vm/physmap.h>
@@ -18,6 +22,14 @@
 
 using fbl::AutoLock;
 
+KCOUNTER(pmm_cache_hits, "kernel.pmm.cache.hits");
+KCOUNTER(pmm_cache_misses, "kernel.pmm.cache.misses");
+KCOUNTER(pmm_cache_refills, "kernel.pmm.cache.refills");
+KCOUNTER(pmm_cache_drains, "kernel.pmm.cache.drains");
+KCOUNTER(pmm_zeroed_hits, "kernel.pmm.zeroed.hits");
+KCOUNTER(pmm_zeroed_misses, "kernel.pmm.zeroed.misses");
+KCOUNTER(pmm_zeroed_pages, "kernel.pmm.zeroed.pages");
+
 namespace {
 
 void set_state_alloc(vm_page* page) {
@@ -93,30 +105,258 @@ void PmmNode::AddFreePages(list_node* list) TA_NO_THREAD_SAFETY_ANALYSIS {
     LTRACEF("free count now %" PRIu64 "\n", free_count_);
 }
 
-vm_page_t* PmmNode::AllocPage(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(&lock_);
+// move up to |count| pages from the head of the free list to the tail of |list|,
+// dipping into the zeroed pages only once the free list runs out
+size_t PmmNode::TakeFreePagesLocked(size_t count, list_node* list) {
+    size_t taken = 0;
+    while (taken < count) {
+        vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
+        if (!page)
+            break;
 
-    vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
-    if (!page)
-        return nullptr;
+        DEBUG_ASSERT(free_count_ > 0);
+        free_count_--;
 
-    DEBUG_ASSERT(free_count_ > 0);
+        page->flags |= VM_PAGE_FLAG_CACHED;
+        list_add_tail(list, &page->queue_node);
+        taken++;
+    }
+    return taken + TakeZeroedPagesLocked(count - taken, list);
+}
+
+// move up to |count| pages from the head of the zeroed list to the tail of |list|
+size_t PmmNode::TakeZeroedPagesLocked(size_t count, list_node* list) {
+    size_t taken = 0;
+    while (taken < count) {
+        vm_page* page = list_remove_head_type(&zeroed_list_, vm_page, queue_node);
+        if (!page)
+            break;
+
+        DEBUG_ASSERT(page->flags & VM_PAGE_FLAG_ZEROED);
+        DEBUG_ASSERT(zeroed_count_ > 0 && free_count_ > 0);
+        zeroed_count_--;
+        free_count_--;
+
+        page->flags |= VM_PAGE_FLAG_CACHED;
+        list_add_tail(list, &page->queue_node);
+        taken++;
+    }
+    MaybeStartZeroingLocked();
+    return taken;
+}
+
+// put a list of free pages back at the head of the free or zeroed list
+void PmmNode::ReturnFreePagesLocked(list_node* list) {
+    vm_page* page;
+    while ((page = list_remove_tail_type(list, vm_page, queue_node))) {
+        DEBUG_ASSERT(page->is_free());
+        page->flags &= ~VM_PAGE_FLAG_CACHED;
+        if (page->flags & VM_PAGE_FLAG_ZEROED) {
+            list_add_head(&zeroed_list_, &page->queue_node);
+            zeroed_count_++;
+        } else {
+            list_add_head(&free_list_, &page->queue_node);
+        }
+        free_count_++;
+    }
+}
 
+// pull a specific free page off whichever node list it is on
+void PmmNode::RemoveFreePageLocked(vm_page* page) {
+    DEBUG_ASSERT(page->is_free());
+    DEBUG_ASSERT(!(page->flags & VM_PAGE_FLAG_CACHED));
+    DEBUG_ASSERT(list_in_list(&page->queue_node));
+
+    list_delete(&page->queue_node);
+    if (page->flags & VM_PAGE_FLAG_ZEROED) {
+        DEBUG_ASSERT(zeroed_count_ > 0);
+        zeroed_count_--;
+        page->flags &= ~VM_PAGE_FLAG_ZEROED;
+    }
+
+    DEBUG_ASSERT(free_count_ > 0);
     free_count_--;
+}
+
+// return the pages held by every cpu's cache to the free lists, so that the
+// allocation paths that look for pages by address can see most of them. the
+// caches may be refilled right away; pages in them are flagged
+// VM_PAGE_FLAG_CACHED, and those paths leave them alone.
+void PmmNode::DrainCachesLocked() {
+    for (auto& cache : caches_) {
+        AutoSpinLock guard(&cache.lock);
+        if (cache.count == 0 && cache.zeroed_count == 0)
+            continue;
+
+        ReturnFreePagesLocked(&cache.pages);
+        ReturnFreePagesLocked(&cache.zeroed_pages);
+        cache.count = 0;
+        cache.zeroed_count = 0;
+        kcounter_add(pmm_cache_drains, 1);
+    }
+}
 
+// pop a free page off the current cpu's cache, refilling the cache from the
+// free lists if it is empty. if |zeroed| is set, already zeroed pages are
+// preferred, otherwise they are only handed out as a last resort.
+vm_page* PmmNode::CacheAlloc(bool zeroed) {
+    {
+        // it does not matter if the thread migrates after picking the cache,
+        // the lock keeps it consistent either way
+        PageCache& cache = caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+
+        vm_page* page = nullptr;
+        if (zeroed) {
+            page = list_remove_head_type(&cache.zeroed_pages, vm_page, queue_node);
+            if (page)
+                cache.zeroed_count--;
+        }
+        if (!page) {
+            page = list_remove_head_type(&cache.pages, vm_page, queue_node);
+            if (page)
+                cache.count--;
+        }
+        if (page) {
+            kcounter_add(pmm_cache_hits, 1);
+            return page;
+        }
+    }
+    kcounter_add(pmm_cache_misses, 1);
+
+    list_node batch = LIST_INITIAL_VALUE(batch);
+    size_t count;
+    {
+        AutoLock al(&lock_);
+        count = zeroed ? TakeZeroedPagesLocked(kPageCacheBatch, &batch) : 0;
+        if (count == 0)
+            count = TakeFreePagesLocked(kPageCacheBatch, &batch);
+        if (count == 0) {
+            // the free list is dry, but other cpus may still be sitting on free pages
+            DrainCachesLocked();
+            count = TakeFreePagesLocked(kPageCacheBatch, &batch);
+            if (count == 0)
+                return nullptr;
+        }
+    }
+    kcounter_add(pmm_cache_refills, 1);
+
+    // keep one page for the caller and hand the rest to the cache
+    vm_page* page = list_remove_head_type(&batch, vm_page, queue_node);
+    if (count > 1) {
+        PageCache& cache = caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+
+        vm_page* p;
+        while ((p = list_remove_head_type(&batch, vm_page, queue_node))) {
+            if (p->flags & VM_PAGE_FLAG_ZEROED) {
+                list_add_tail(&cache.zeroed_pages, &p->queue_node);
+                cache.zeroed_count++;
+            } else {
+                list_add_tail(&cache.pages, &p->queue_node);
+                cache.count++;
+            }
+        }
+    }
+    return page;
+}
+
+// add a list of |count| freed pages to the current cpu's cache, returning
+// anything beyond what the cache may hold to the free list
+void PmmNode::CacheFree(list_node* list, size_t count) {
+    // bulk frees would only flush the cache, skip it
+    if (count > kPageCacheMax) {
+        AutoLock al(&lock_);
+        ReturnFreePagesLocked(list);
+        return;
+    }
+
+    list_node overflow = LIST_INITIAL_VALUE(overflow);
+    {
+        PageCache& cache = caches_[arch_curr_cpu_num()];
+        AutoSpinLock guard(&cache.lock);
+
+        vm_page* page;
+        while ((page = list_remove_tail_type(list, vm_page, queue_node))) {
+            list_add_head(&cache.pages, &page->queue_node);
+        }
+        cache.count += count;
+
+        // trim the cache back down to a batch, leaving the most recently freed
+        // (and so most likely cache hot) pages in it
+        if (cache.count > kPageCacheMax) {
+            while (cache.count > kPageCacheBatch) {
+                page = list_remove_tail_type(&cache.pages, vm_page, queue_node);
+                list_add_head(&overflow, &page->queue_node);
+                cache.count--;
+            }
+        }
+    }
+
+    if (list_is_empty(&overflow))
+        return;
+
+    kcounter_add(pmm_cache_drains, 1);
+    AutoLock al(&lock_);
+    ReturnFreePagesLocked(&overflow);
+    MaybeStartZeroingLocked();
+}
+
+void PmmNode::PrepareAllocatedPage(vm_page* page, bool zero) {
     DEBUG_ASSERT(page->is_free());
 
+    DEBUG_ASSERT(page->flags & VM_PAGE_FLAG_CACHED);
+
+    bool zeroed = page->flags & VM_PAGE_FLAG_ZEROED;
+    page->flags &= ~(VM_PAGE_FLAG_ZEROED | VM_PAGE_FLAG_CACHED);
+
     set_state_alloc(page);
 
 #if PMM_ENABLE_FREE_FILL
-    CheckFreeFill(page);
+    if (!zeroed)
+        CheckFreeFill(page);
 #endif
 
-    if (pa) {
-        *pa = page->paddr();
+    if (zero) {
+        if (zeroed) {
+            kcounter_add(pmm_zeroed_hits, 1);
+        } else {
+            arch_zero_page(paddr_to_physmap(page->paddr()));
+            kcounter_add(pmm_zeroed_misses, 1);
+        }
     }
 
     LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page->paddr());
+}
+
+void PmmNode::PrepareFreedPage(vm_page* page) {
+    LTRACEF("page %p state %u\n", page, page->state);
+    DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
+    DEBUG_ASSERT(!page->is_free());
+
+#if PMM_ENABLE_FREE_FILL
+    FreeFill(page);
+#endif
+
+    // mark it free, but not on the free lists. AllocRange and AllocContiguous
+    // read the state and flags without the cache locks, so the flag has to be
+    // in place before the page looks free.
+    page->flags = (page->flags & ~VM_PAGE_FLAG_ZEROED) | VM_PAGE_FLAG_CACHED;
+    atomic_signal_fence();
+    page->state = VM_PAGE_STATE_FREE;
+}
+
+vm_page_t* PmmNode::AllocPage(uint alloc_flags, paddr_t* pa) {
+    bool zero = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
+    vm_page* page = CacheAlloc(zero);
+    if (!page)
+        return nullptr;
+
+    PrepareAllocatedPage(page, zero);
+
+    if (pa) {
+        *pa = page->paddr();
+    }
 
     return page;
 }
@@ -130,29 +370,40 @@ size_t PmmNode::AllocPages(size_t count, uint alloc_flags, list_node* list) {
     if (count == 0)
         return 0;
 
-    AutoLock al(&lock_);
-
+    bool zero = alloc_flags & PMM_ALLOC_FLAG_ZEROED;
     size_t allocated = 0;
-    while (allocated < count) {
-        vm_page* page = list_remove_head_type(&free_list_, vm_page, queue_node);
-        if (!page)
-            return allocated;
 
-        LTRACEF("allocating page %p, pa %#" PRIxPTR "\n", page, page->paddr());
+    // small requests are served out of the per cpu cache
+    if (count <= kPageCacheBatch) {
+        while (allocated < count) {
+            vm_page* page = CacheAlloc(zero);
+            if (!page)
+                break;
 
-        DEBUG_ASSERT(free_count_ > 0);
+            PrepareAllocatedPage(page, zero);
+            list_add_tail(list, &page->queue_node);
+            allocated++;
+        }
+        return allocated;
+    }
 
-        free_count_--;
+    // large ones go straight to the free lists
+    list_node pages = LIST_INITIAL_VALUE(pages);
+    {
+        AutoLock al(&lock_);
 
-        DEBUG_ASSERT(page->is_free());
-#if PMM_ENABLE_FREE_FILL
-        CheckFreeFill(page);
-#endif
+        allocated = zero ? TakeZeroedPagesLocked(count, &pages) : 0;
+        allocated += TakeFreePagesLocked(count - allocated, &pages);
+        if (allocated < count) {
+            DrainCachesLocked();
+            allocated += TakeFreePagesLocked(count - allocated, &pages);
+        }
+    }
 
-        page->state = VM_PAGE_STATE_ALLOC;
+    vm_page* page;
+    while ((page = list_remove_head_type(&pages, vm_page, queue_node))) {
+        PrepareAllocatedPage(page, zero);
         list_add_tail(list, &page->queue_node);
-
-        allocated++;
     }
 
     return allocated;
@@ -169,6 +420,10 @@ size_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list) {
 
     AutoLock al(&lock_);
 
+    // pages sitting in the per cpu caches are free but not on the free list,
+    // give back as many of them as we can
+    DrainCachesLocked();
+
     // walk through the arenas, looking to see if the physical page belongs to it
     for (auto& a : arena_list_) {
         while (allocated < count && a.address_in_arena(address)) {
@@ -176,10 +431,11 @@ size_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list) {
             if (!page)
                 break;
 
-            if (!page->is_free())
+            // pages in the per cpu caches may be handed out without lock_
+            if (!page->is_free() || (page->flags & VM_PAGE_FLAG_CACHED))
                 break;
 
-            list_delete(&page->queue_node);
+            RemoveFreePageLocked(page);
 
             page->state = VM_PAGE_STATE_ALLOC;
 
@@ -188,7 +444,6 @@ size_t PmmNode::AllocRange(paddr_t address, size_t count, list_node* list) {
 
             allocated++;
             address += PAGE_SIZE;
-            free_count_--;
         }
 
         if (allocated == count)
@@ -211,6 +466,10 @@ size_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8_t al
 
     AutoLock al(&lock_);
 
+    // pages sitting in the per cpu caches are free but not on the free list,
+    // give back as many of them as we can
+    DrainCachesLocked();
+
     for (auto& a : arena_list_) {
         vm_page_t* p = a.FindFreeContiguous(count, alignment_log2);
         if (!p)
@@ -221,18 +480,19 @@ size_t PmmNode::AllocContiguous(const size_t count, uint alloc_flags, uint8_t al
 
         // remove the pages from the run out of the free list
         for (size_t i = 0; i < count; i++, p++) {
-            DEBUG_ASSERT_MSG(p->is_free(), "p %p state %u\n", p, p->state);
-            DEBUG_ASSERT(list_in_list(&p->queue_node));
+            DEBUG_ASSERT_MSG(p->is_free() && !(p->flags & VM_PAGE_FLAG_CACHED),
+                             "p %p state %u flags %#x\n", p, p->state, p->flags);
 
-            list_delete(&p->queue_node);
-            p->state = VM_PAGE_STATE_ALLOC;
-
-            DEBUG_ASSERT(free_count_ > 0);
+#if PMM_ENABLE_FREE_FILL
+            bool zeroed = p->flags & VM_PAGE_FLAG_ZEROED;
+#endif
 
-            free_count_--;
+            RemoveFreePageLocked(p);
+            p->state = VM_PAGE_STATE_ALLOC;
 
 #if PMM_ENABLE_FREE_FILL
-            CheckFreeFill(p);
+            if (!zeroed)
+                CheckFreeFill(p);
 #endif
 
             if (list)
@@ -251,35 +511,19 @@ size_t PmmNode::Free(list_node* list) {
 
     DEBUG_ASSERT(list);
 
-    AutoLock al(&lock_);
-
-    uint count = 0;
-    while (!list_is_empty(list)) {
-        vm_page* page = list_remove_head_type(list, vm_page, queue_node);
-
-        LTRACEF("page %p state %u\n", page, page->state);
-        DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
-        DEBUG_ASSERT(!page->is_free());
-
-#if PMM_ENABLE_FREE_FILL
-        FreeFill(page);
-#endif
-
-        // remove it from its old queue
-        if (list_in_list(&page->queue_node))
-            list_delete(&page->queue_node);
-
-        // mark it free
-        page->state = VM_PAGE_STATE_FREE;
-
-        // add it to the free queue
-        list_add_head(&free_list_, &page->queue_node);
-
-        free_count_++;
+    list_node freed = LIST_INITIAL_VALUE(freed);
+    size_t count = 0;
+    vm_page* page;
+    while ((page = list_remove_head_type(list, vm_page, queue_node))) {
+        PrepareFreedPage(page);
+        list_add_tail(&freed, &page->queue_node);
         count++;
     }
 
-    LTRACEF("returning count %u\n", count);
+    if (count > 0)
+        CacheFree(&freed, count);
+
+    LTRACEF("returning count %zu\n", count);
 
     return count;
 }
@@ -287,31 +531,24 @@ size_t PmmNode::Free(list_node* list) {
 void PmmNode::Free(vm_page* page) {
     LTRACEF("page %p, pa %#" PRIxPTR "\n", page, page->paddr());
 
-    AutoLock al(&lock_);
-
-    DEBUG_ASSERT(page->state != VM_PAGE_STATE_OBJECT || page->object.pin_count == 0);
-    DEBUG_ASSERT(!page->is_free());
-
-#if PMM_ENABLE_FREE_FILL
-    FreeFill(page);
-#endif
+    PrepareFreedPage(page);
 
     // remove it from its old queue
     if (list_in_list(&page->queue_node))
         list_delete(&page->queue_node);
 
-    // mark it free
-    page->state = VM_PAGE_STATE_FREE;
-
-    // add it to the free queue
-    list_add_head(&free_list_, &page->queue_node);
-
-    free_count_++;
+    list_node freed = LIST_INITIAL_VALUE(freed);
+    list_add_tail(&freed, &page->queue_node);
+    CacheFree(&freed, 1);
 }
 
 // okay if accessed outside of a lock
 uint64_t PmmNode::CountFreePages() const TA_NO_THREAD_SAFETY_ANALYSIS {
-    return free_count_;
+    uint64_t count = free_count_;
+    for (auto& cache : caches_) {
+        count += cache.count + cache.zeroed_count;
+    }
+    return count;
 }
 
 uint64_t PmmNode::CountTotalBytes() const TA_NO_THREAD_SAFETY_ANALYSIS {
@@ -337,8 +574,10 @@ void PmmNode::Dump(bool is_panic) const TA_NO_THREAD_SAFETY_ANALYSIS {
     if (!is_panic) {
         lock_.Acquire();
     }
-    printf("pmm node %p: free_count %zu (%zu bytes), total size %zu\n",
-           this, free_count_, free_count_ * PAGE_SIZE, arena_cumulative_size_);
+    uint64_t cached_count = CountFreePages() - free_count_;
+    printf("pmm node %p: free_count %zu (%zu bytes), zeroed %zu, cached %zu, total size %zu\n",
+           this, free_count_, free_count_ * PAGE_SIZE, zeroed_count_, cached_count,
+           arena_cumulative_size_);
     for (auto& a : arena_list_) {
         a.Dump(false, false);
     }
@@ -347,6 +586,90 @@ void PmmNode::Dump(bool is_panic) const TA_NO_THREAD_SAFETY_ANALYSIS {
     }
 }
 
+// wake the zeroing thread if the pool of zeroed pages is running low and
+// there are free pages left to zero
+void PmmNode::MaybeStartZeroingLocked() {
+    if (!zeroing_enabled_ || zeroing_)
+        return;
+    if (zeroed_count_ >= kZeroedPoolLow || free_count_ == zeroed_count_)
+        return;
+
+    zeroing_ = true;
+    event_signal(&zeroing_event_, false);
+}
+
+void PmmNode::StartZeroingThread() {
+    event_init(&zeroing_event_, false, EVENT_FLAG_AUTOUNSIGNAL);
+
+    thread_t* t = thread_create("pmm-zeroer", &PmmNode::ZeroingThread, this,
+                                LOWEST_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("PMM: failed to create the page zeroing thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+
+    AutoLock al(&lock_);
+    zeroing_enabled_ = true;
+    MaybeStartZeroingLocked();
+}
+
+int PmmNode::ZeroingThread(void* arg) {
+    static_cast<PmmNode*>(arg)->ZeroPagesLoop();
+    return 0;
+}
+
+// zero free pages in small batches at the lowest priority, so that the work
+// only soaks up otherwise idle cpu time. pages being zeroed are marked
+// allocated while they are off the free list and the lock is dropped.
+void PmmNode::ZeroPagesLoop() {
+    for (;;) {
+        event_wait(&zeroing_event_);
+
+        for (;;) {
+            list_node batch = LIST_INITIAL_VALUE(batch);
+            size_t count = 0;
+            {
+                AutoLock al(&lock_);
+                while (count < kZeroBatch && zeroed_count_ + count < kZeroedPoolTarget) {
+                    // take the least recently freed pages, which are the least
+                    // likely to still be in the cache
+                    vm_page* page = list_remove_tail_type(&free_list_, vm_page, queue_node);
+                    if (!page)
+                        break;
+
+                    DEBUG_ASSERT(free_count_ > 0);
+                    free_count_--;
+                    set_state_alloc(page);
+                    list_add_tail(&batch, &page->queue_node);
+                    count++;
+                }
+                if (count == 0) {
+                    zeroing_ = false;
+                    break;
+                }
+            }
+
+            vm_page* page;
+            list_for_every_entry (&batch, page, vm_page, queue_node) {
+                arch_zero_page(paddr_to_physmap(page->paddr()));
+            }
+
+            {
+                AutoLock al(&lock_);
+                while ((page = list_remove_head_type(&batch, vm_page, queue_node))) {
+                    page->state = VM_PAGE_STATE_FREE;
+                    page->flags |= VM_PAGE_FLAG_ZEROED;
+                    list_add_tail(&zeroed_list_, &page->queue_node);
+                    zeroed_count_++;
+                    free_count_++;
+                }
+            }
+            kcounter_add(pmm_zeroed_pages, count);
+        }
+    }
+}
+
 #if PMM_ENABLE_FREE_FILL
 void PmmNode::EnforceFill() {
     DEBUG_ASSERT(!enforce_fill_);
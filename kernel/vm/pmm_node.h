@@ -8,7 +8,10 @@
 #include <fbl/canary.h>
 #include <fbl/intrusive_double_list.h>
 
+#include <kernel/align.h>
+#include <kernel/event.h>
 #include <kernel/mutex.h>
+#include <kernel/spinlock.h>
 #include <vm/pmm.h>
 
 #include "pmm_arena.h"
@@ -54,23 +57,73 @@ public:
     // add new pages to the free queue. used when boostrapping a PmmArena
     void AddFreePages(list_node *list);
 
+    // start the background thread that keeps a pool of zeroed free pages
+    void StartZeroingThread();
+
 private:
+    // per cpu caches of free pages. most single page allocations and frees only
+    // touch the cache of the current cpu, which is refilled from and drained to
+    // free_list_ in batches of kPageCacheBatch pages.
+    static constexpr size_t kPageCacheBatch = 32;
+    static constexpr size_t kPageCacheMax = 2 * kPageCacheBatch;
+
+    // zeroed pages are cached separately, so that allocations which need a
+    // zero page don't have to dig for one
+    struct PageCache {
+        SpinLock lock;
+        list_node pages TA_GUARDED(lock) = LIST_INITIAL_VALUE(pages);
+        size_t count TA_GUARDED(lock) = 0;
+        list_node zeroed_pages TA_GUARDED(lock) = LIST_INITIAL_VALUE(zeroed_pages);
+        size_t zeroed_count TA_GUARDED(lock) = 0;
+    } __CPU_ALIGN;
+
+    // the zeroing thread tops zeroed_list_ back up to kZeroedPoolTarget pages
+    // whenever it drops below kZeroedPoolLow, kZeroBatch pages at a time.
+    static constexpr uint64_t kZeroedPoolTarget = 4096;
+    static constexpr uint64_t kZeroedPoolLow = kZeroedPoolTarget / 2;
+    static constexpr size_t kZeroBatch = 16;
+
+    vm_page* CacheAlloc(bool zeroed);
+    void CacheFree(list_node* list, size_t count);
+    void DrainCachesLocked() TA_REQ(lock_);
+
+    size_t TakeFreePagesLocked(size_t count, list_node* list) TA_REQ(lock_);
+    size_t TakeZeroedPagesLocked(size_t count, list_node* list) TA_REQ(lock_);
+    void ReturnFreePagesLocked(list_node* list) TA_REQ(lock_);
+    void RemoveFreePageLocked(vm_page* page) TA_REQ(lock_);
+    void PrepareAllocatedPage(vm_page* page, bool zero);
+    void PrepareFreedPage(vm_page* page);
+
+    void MaybeStartZeroingLocked() TA_REQ(lock_);
+    static int ZeroingThread(void* arg);
+    void ZeroPagesLoop();
+
     fbl::Canary<fbl::magic("PNOD")> canary_;
 
     mutable fbl::Mutex lock_;
 
     uint64_t arena_cumulative_size_ TA_GUARDED(lock_) = 0;
+    // free_count_ counts the pages on both free_list_ and zeroed_list_
     uint64_t free_count_ TA_GUARDED(lock_) = 0;
+    uint64_t zeroed_count_ TA_GUARDED(lock_) = 0;
 
     fbl::DoublyLinkedList<PmmArena*> arena_list_ TA_GUARDED(lock_);
 
     // page queues
     list_node free_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(free_list_);
+    list_node zeroed_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(zeroed_list_);
     list_node inactive_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(inactive_list_);
     list_node active_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(active_list_);
     list_node modified_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(modified_list_);
     list_node wired_list_ TA_GUARDED(lock_) = LIST_INITIAL_VALUE(wired_list_);
 
+    PageCache caches_[SMP_MAX_CPUS];
+
+    // set once the zeroing thread exists, and while it is busy refilling the pool
+    bool zeroing_enabled_ TA_GUARDED(lock_) = false;
+    bool zeroing_ TA_GUARDED(lock_) = false;
+    event_t zeroing_event_;
+
 #if PMM_ENABLE_FREE_FILL
     void FreeFill(vm_page_t* page);
     void CheckFreeFill(vm_page_t* page);
@@ -0,0 +1,281 @@
+// Copyright 2018 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <vm/reclaim.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/auto_lock.h>
+#include <fbl/mutex.h>
+#include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <kernel/thread.h>
+#include <lib/console.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <string.h>
+#include <trace.h>
+#include <vm/compression.h>
+#include <vm/pmm.h>
+#include <vm/vm_object.h>
+#include <zircon/types.h>
+
+#include "vm_priv.h"
+
+using fbl::AutoLock;
+
+#define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
+
+KCOUNTER(reclaim_scan_count, "kernel.vm.reclaim.scans");
+KCOUNTER(reclaim_evict_count, "kernel.vm.reclaim.evict_passes");
+
+namespace {
+
+// How often the thread checks the free memory.
+constexpr zx_duration_t kCheckPeriod = ZX_SEC(1);
+
+// How far free memory has to climb back above a pressure threshold before
+// the level drops again, so that it doesn't flap around the threshold.
+constexpr uint64_t kHysteresisPages = 16 * MB / PAGE_SIZE;
+
+// Set once at init.
+uint64_t warning_pages;
+uint64_t critical_pages;
+zx_duration_t scan_period;
+
+// Serializes scans and evictions, and guards the statistics.
+fbl::Mutex reclaim_lock;
+uint64_t active_pages TA_GUARDED(reclaim_lock);
+uint64_t inactive_pages TA_GUARDED(reclaim_lock);
+uint64_t evicted_pages TA_GUARDED(reclaim_lock);
+uint64_t scans TA_GUARDED(reclaim_lock);
+
+fbl::Mutex pressure_lock;
+MemoryPressure pressure TA_GUARDED(pressure_lock) = MemoryPressure::Normal;
+reclaim_pressure_callback_t pressure_callback TA_GUARDED(pressure_lock);
+
+void ScanLocked() TA_REQ(reclaim_lock) {
+    uint64_t active = 0;
+    uint64_t inactive = 0;
+    VmObject::ForEachUnlocked([&active, &inactive](VmObject& vmo) {
+        vmo.AgePages(&active, &inactive);
+        return ZX_OK;
+    });
+
+    active_pages = active;
+    inactive_pages = inactive;
+    scans++;
+    kcounter_add(reclaim_scan_count, 1);
+    LTRACEF("%" PRIu64 " active, %" PRIu64 " inactive pages\n", active, inactive);
+}
+
+uint64_t EvictLocked(uint64_t target_pages) TA_REQ(reclaim_lock) {
+    kcounter_add(reclaim_evict_count, 1);
+
+    // Oldest first, so each pass walks all of the vmos again.
+    uint64_t evicted = 0;
+    for (uint age = VM_PAGE_OBJECT_MAX_AGE;
+         age >= VM_RECLAIM_INACTIVE_AGE && evicted < target_pages; age--) {
+        VmObject::ForEachUnlocked([age, target_pages, &evicted](VmObject& vmo) {
+            evicted += vmo.EvictPages(age, target_pages - evicted);
+            return evicted < target_pages ? ZX_OK : ZX_ERR_STOP;
+        });
+    }
+
+    evicted_pages += evicted;
+    inactive_pages -= fbl::min(inactive_pages, evicted);
+    LTRACEF("evicted %" PRIu64 " of %" PRIu64 " pages\n", evicted, target_pages);
+    return evicted;
+}
+
+MemoryPressure PressureFor(uint64_t free_pages, MemoryPressure current) {
+    if (free_pages < critical_pages)
+        return MemoryPressure::Critical;
+    if (current == MemoryPressure::Critical && free_pages < critical_pages + kHysteresisPages)
+        return MemoryPressure::Critical;
+    if (free_pages < warning_pages)
+        return MemoryPressure::Warning;
+    if (current != MemoryPressure::Normal && free_pages < warning_pages + kHysteresisPages)
+        return MemoryPressure::Warning;
+    return MemoryPressure::Normal;
+}
+
+MemoryPressure UpdatePressure() {
+    const uint64_t free_pages = pmm_count_free_pages();
+
+    AutoLock a(&pressure_lock);
+    const MemoryPressure level = PressureFor(free_pages, pressure);
+    if (level != pressure) {
+        LTRACEF("pressure %d -> %d, %" PRIu64 " free pages\n",
+                static_cast<int>(pressure), static_cast<int>(level), free_pages);
+        pressure = level;
+        if (pressure_callback)
+            pressure_callback(level);
+    }
+    return level;
+}
+
+int reclaim_loop(void* arg) {
+    zx_time_t next_scan = 0;
+    for (;;) {
+        const MemoryPressure level = UpdatePressure();
+        {
+            AutoLock a(&reclaim_lock);
+
+            // Under pressure pages need to age quickly enough to be evicted
+            // before the OOM thread starts killing processes.
+            const zx_time_t now = current_time();
+            if (level != MemoryPressure::Normal || now >= next_scan) {
+                ScanLocked();
+                next_scan = now + scan_period;
+            }
+
+            // Aim for just enough to clear the warning level.
+            const uint64_t free_pages = pmm_count_free_pages();
+            const uint64_t goal = warning_pages + kHysteresisPages;
+            if (level != MemoryPressure::Normal && free_pages < goal)
+                EvictLocked(goal - free_pages);
+        }
+        if (level != MemoryPressure::Normal)
+            UpdatePressure();
+
+        thread_sleep_relative(kCheckPeriod);
+    }
+    return 0;
+}
+
+void reclaim_init(uint level) {
+    // Be sure to update kernel_cmdline.md if any of these defaults change.
+    warning_pages = cmdline_get_uint64("kernel.vm.reclaim.warning-mb", 150) * MB / PAGE_SIZE;
+    critical_pages = cmdline_get_uint64("kernel.vm.reclaim.critical-mb", 100) * MB / PAGE_SIZE;
+    scan_period = ZX_SEC(cmdline_get_uint64("kernel.vm.reclaim.scan-period-sec", 10));
+
+    if (!cmdline_get_bool("kernel.vm.reclaim.enable", true)) {
+        printf("reclaim: thread disabled\n");
+        return;
+    }
+
+    thread_t* t = thread_create("vm-reclaim", &reclaim_loop, nullptr,
+                                LOW_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        printf("reclaim: failed to create thread\n");
+        return;
+    }
+    thread_detach_and_resume(t);
+}
+
+} // namespace
+
+LK_INIT_HOOK(vm_reclaim, &reclaim_init, LK_INIT_LEVEL_THREADING);
+
+void reclaim_set_pressure_callback(reclaim_pressure_callback_t callback) {
+    AutoLock a(&pressure_lock);
+    pressure_callback = callback;
+    if (pressure_callback)
+        pressure_callback(pressure);
+}
+
+MemoryPressure reclaim_get_pressure() {
+    AutoLock a(&pressure_lock);
+    return pressure;
+}
+
+uint64_t reclaim_evict_pages(uint64_t target_pages) {
+    uint64_t evicted;
+    {
+        AutoLock a(&reclaim_lock);
+        evicted = EvictLocked(target_pages);
+    }
+    if (evicted > 0)
+        UpdatePressure();
+    return evicted;
+}
+
+void reclaim_get_stats(reclaim_stats* stats) {
+    {
+        AutoLock a(&reclaim_lock);
+        stats->active_pages = active_pages;
+        stats->inactive_pages = inactive_pages;
+        stats->evicted_pages = evicted_pages;
+        stats->scans = scans;
+    }
+    stats->pressure = reclaim_get_pressure();
+}
+
+static const char* pressure_to_string(MemoryPressure level) {
+    switch (level) {
+    case MemoryPressure::Normal:
+        return "normal";
+    case MemoryPressure::Warning:
+        return "warning";
+    case MemoryPressure::Critical:
+        return "critical";
+    }
+    return "unknown";
+}
+
+static int cmd_reclaim(int argc, const cmd_args* argv, uint32_t flags) {
+    if (argc < 2) {
+        printf("Not enough arguments:\n");
+    usage:
+        printf("reclaim info        : dump page ages and reclaim state\n");
+        printf("reclaim scan        : age all pages now\n");
+        printf("reclaim evict <num> : evict up to <num> inactive pages\n");
+        return -1;
+    }
+
+    if (!strcmp(argv[1].str, "info")) {
+        reclaim_stats stats;
+        reclaim_get_stats(&stats);
+        printf("reclaim info:\n");
+        printf("  pressure: %s\n", pressure_to_string(stats.pressure));
+        printf("  active pages: %" PRIu64 "\n", stats.active_pages);
+        printf("  inactive pages: %" PRIu64 "\n", stats.inactive_pages);
+        printf("  evicted pages: %" PRIu64 "\n", stats.evicted_pages);
+        printf("  scans: %" PRIu64 "\n", stats.scans);
+        printf("  free pages: %" PRIu64 " (warning %" PRIu64 ", critical %" PRIu64 ")\n",
+               pmm_count_free_pages(), warning_pages, critical_pages);
+
+        vm_compression_stats cstats;
+        vm_compression_get_stats(&cstats);
+        printf("compression%s:\n", vm_compression_enabled() ? "" : " (disabled)");
+        printf("  stored pages: %" PRIu64 " in %" PRIu64 " bytes\n",
+               cstats.stored_pages, cstats.compressed_bytes);
+        printf("  compressions: %" PRIu64 " (%" PRIu64 " failed)\n",
+               cstats.compressions, cstats.failed_compressions);
+        printf("  decompressions: %" PRIu64 "\n", cstats.decompressions);
+        for (uint i = 0; i < VM_COMPRESSION_LATENCY_BUCKETS; i++) {
+            if (cstats.decompress_latency[i] == 0)
+                continue;
+            if (i == 0) {
+                printf("    < 1us: %" PRIu64 "\n", cstats.decompress_latency[i]);
+            } else if (i == VM_COMPRESSION_LATENCY_BUCKETS - 1) {
+                printf("    >= %" PRIu64 "us: %" PRIu64 "\n", 1ull << (i - 1),
+                       cstats.decompress_latency[i]);
+            } else {
+                printf("    < %" PRIu64 "us: %" PRIu64 "\n", 1ull << i,
+                       cstats.decompress_latency[i]);
+            }
+        }
+    } else if (!strcmp(argv[1].str, "scan")) {
+        AutoLock a(&reclaim_lock);
+        ScanLocked();
+    } else if (!strcmp(argv[1].str, "evict")) {
+        if (argc < 3)
+            goto usage;
+        printf("evicted %" PRIu64 " pages\n", reclaim_evict_pages(argv[2].u));
+    } else {
+        printf("unknown command\n");
+        goto usage;
+    }
+    return 0;
+}
+
+STATIC_COMMAND_START
+#if LK_DEBUGLEVEL > 0
+STATIC_COMMAND("reclaim", "page aging and reclamation", &cmd_reclaim)
+#endif
+STATIC_COMMAND_END(reclaim);
@@ -10,19 +10,25 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULE := $(LOCAL_DIR)
 
 MODULE_DEPS += \
+    kernel/lib/counters \
     kernel/lib/fbl \
     kernel/lib/pretty \
     kernel/lib/user_copy \
-    third_party/lib/cryptolib
+    third_party/lib/cryptolib \
+    third_party/lib/lz4
 
 MODULE_SRCS += \
     $(LOCAL_DIR)/bootalloc.cpp \
     $(LOCAL_DIR)/bootreserve.cpp \
+    $(LOCAL_DIR)/compression.cpp \
+    $(LOCAL_DIR)/dedup.cpp \
     $(LOCAL_DIR)/kstack.cpp \
     $(LOCAL_DIR)/page.cpp \
+    $(LOCAL_DIR)/page_source.cpp \
     $(LOCAL_DIR)/pmm.cpp \
     $(LOCAL_DIR)/pmm_arena.cpp \
     $(LOCAL_DIR)/pmm_node.cpp \
+    $(LOCAL_DIR)/reclaim.cpp \
     $(LOCAL_DIR)/vm.cpp \
     $(LOCAL_DIR)/vm_address_region.cpp \
     $(LOCAL_DIR)/vm_address_region_or_mapping.cpp \
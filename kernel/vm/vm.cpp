@@ -12,6 +12,7 @@
 #include <err.h>
 #include <fbl/algorithm.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
 #include <kernel/thread.h>
 #include <lib/console.h>
 #include <lib/crypto/global_prng.h>
@@ -34,6 +35,8 @@ paddr_t zero_page_paddr;
 // set early in arch code to record the start address of the kernel
 paddr_t kernel_base_phys;
 
+bool vm_large_pages_enabled = true;
+
 namespace {
 
 // mark a range of physical pages as WIRED
@@ -113,6 +116,8 @@ void vm_init_preheap() {
 void vm_init() {
     LTRACE_ENTRY;
 
+    vm_large_pages_enabled = cmdline_get_bool("kernel.vm.large-pages", true);
+
     VmAspace* aspace = VmAspace::kernel_aspace();
 
     // we expect the kernel to be in a temporary mapping, define permanent
@@ -154,7 +154,16 @@ zx_status_t VmAddressRegion::CreateSubVmarInternal(size_t offset, size_t size, u
         }
     } else {
         // If we're not mapping to a specific place, search for an opening.
-        zx_status_t status = AllocSpotLocked(size, align_pow2, arch_mmu_flags, &new_base);
+        // Big paged vmos get a large page aligned spot if there is one, so
+        // that the pages they are backed with can be mapped as large pages.
+        zx_status_t status = ZX_ERR_NO_MEMORY;
+        if (vm_large_pages_enabled && vmo && vmo->is_paged() && size >= VM_LARGE_PAGE_SIZE &&
+            align_pow2 < VM_LARGE_PAGE_SHIFT && IS_ALIGNED(vmo_offset, VM_LARGE_PAGE_SIZE)) {
+            status = AllocSpotLocked(size, VM_LARGE_PAGE_SHIFT, arch_mmu_flags, &new_base);
+        }
+        if (status != ZX_OK) {
+            status = AllocSpotLocked(size, align_pow2, arch_mmu_flags, &new_base);
+        }
         if (status != ZX_OK) {
             return status;
         }
@@ -310,6 +319,15 @@ zx_status_t VmAddressRegion::DestroyLocked() {
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
     LTRACEF("%p '%s'\n", this, name_);
 
+    // Tear down the whole range in one go, so that the mappings destroyed
+    // below find nothing left to unmap and do not cost a TLB shootdown each.
+    if (!subregions_.is_empty()) {
+        zx_status_t status = aspace_->arch_aspace().Unmap(base_, size_ / PAGE_SIZE, nullptr);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
     // The cur reference prevents regions from being destructed after dropping
     // the last reference to them when removing from their parent.
     fbl::RefPtr<VmAddressRegion> cur(this);
@@ -392,7 +410,7 @@ size_t VmAddressRegion::AllocatedPagesLocked() const {
     return sum;
 }
 
-zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
+zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -400,7 +418,7 @@ zx_status_t VmAddressRegion::PageFault(vaddr_t va, uint pf_flags) {
          auto next = vmar->FindRegionLocked(va);
          vmar = next->as_vm_address_region()) {
         if (next->is_mapping())
-            return next->PageFault(va, pf_flags);
+            return next->PageFault(va, pf_flags, page_request);
     }
 
     return ZX_ERR_NOT_FOUND;
@@ -644,6 +662,17 @@ zx_status_t VmAddressRegion::UnmapInternalLocked(vaddr_t base, size_t size, bool
         }
     }
 
+    // If several regions are affected, unmap the range in one go so that they
+    // do not cost a TLB shootdown each.  Only a single mapping can fail to be
+    // unmapped below, so this never needs to be rolled back.
+    auto second = begin;
+    if (begin != end && ++second != end) {
+        zx_status_t status = aspace_->arch_aspace().Unmap(base, size / PAGE_SIZE, nullptr);
+        if (status != ZX_OK) {
+            return status;
+        }
+    }
+
     for (auto itr = begin; itr != end;) {
         // Create a copy of the iterator, in case we destroy this element
         auto curr = itr++;
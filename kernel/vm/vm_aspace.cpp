@@ -24,6 +24,7 @@
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
+#include <vm/page_source.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <vm/vm_object.h>
@@ -532,12 +533,29 @@ zx_status_t VmAspace::PageFault(vaddr_t va, uint flags) {
         flags |= VMM_PF_FLAG_GUEST;
     }
 
-    // for now, hold the aspace lock across the page fault operation,
-    // which stops any other operations on the address space from moving
-    // the region out from underneath it
-    AutoLock a(&lock_);
+    zx_status_t status;
+    PageRequest page_request;
+    do {
+        {
+            // for now, hold the aspace lock across the page fault operation,
+            // which stops any other operations on the address space from moving
+            // the region out from underneath it
+            AutoLock a(&lock_);
+
+            status = root_vmar_->PageFault(va, flags, &page_request);
+        }
+
+        // the page has to be read in by a page source; wait for it with no
+        // locks held and then fault again, since the mapping may have changed
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            zx_status_t wait_status = page_request.Wait();
+            if (wait_status != ZX_OK) {
+                status = wait_status;
+            }
+        }
+    } while (status == ZX_ERR_SHOULD_WAIT);
 
-    return root_vmar_->PageFault(va, flags);
+    return status;
 }
 
 void VmAspace::Dump(bool verbose) const {
@@ -13,6 +13,10 @@
 #include <fbl/auto_call.h>
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
+#include <kernel/cmdline.h>
+#include <lib/counters.h>
+#include <lk/init.h>
+#include <pow2.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/vm.h>
@@ -24,6 +28,28 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_fault_around_faults, "kernel.vm.fault_around.faults");
+KCOUNTER(vm_fault_around_pages, "kernel.vm.fault_around.pages");
+KCOUNTER(vm_large_page_promotions, "kernel.vm.large_page.promotions");
+
+namespace {
+
+// Size of the naturally aligned window of pages around a faulting address
+// that PageFault() maps in when the vmo already has them. 0 or 1 disables
+// fault-around.
+constexpr uint32_t kMaxFaultAroundPages = 64;
+uint32_t fault_around_pages = 16;
+
+void fault_around_init(uint level) {
+    uint32_t pages = cmdline_get_uint32("kernel.vm.fault-around-pages", fault_around_pages);
+    pages = MIN(pages, kMaxFaultAroundPages);
+    fault_around_pages = pages ? (1u << log2_uint_floor(pages)) : 0;
+}
+
+} // namespace
+
+LK_INIT_HOOK(vm_fault_around, &fault_around_init, LK_INIT_LEVEL_VM);
+
 VmMapping::VmMapping(VmAddressRegion& parent, vaddr_t base, size_t size, uint32_t vmar_flags,
                      fbl::RefPtr<VmObject> vmo, uint64_t vmo_offset, uint arch_mmu_flags)
     : VmAddressRegionOrMapping(base, size, vmar_flags,
@@ -386,6 +412,18 @@ zx_status_t VmMapping::UnmapVmoRangeLocked(uint64_t offset, uint64_t len) const
     return ZX_OK;
 }
 
+zx_status_t VmMapping::HarvestAccessedLocked(harvest_accessed_fn_t accessed_fn,
+                                             void* context) const {
+    canary_.Assert();
+
+    // Like UnmapVmoRangeLocked(), this only needs the vmo lock, which keeps
+    // us in the vmo's mapping list and so alive.
+    DEBUG_ASSERT(state_ == LifeCycleState::ALIVE);
+    DEBUG_ASSERT(object_->lock()->IsHeld());
+
+    return aspace_->arch_aspace().HarvestAccessed(base_, size_ / PAGE_SIZE, accessed_fn, context);
+}
+
 namespace {
 
 class VmMappingCoalescer {
@@ -397,14 +435,27 @@ public:
     // no longer valid.
     zx_status_t Append(vaddr_t vaddr, paddr_t paddr) {
         DEBUG_ASSERT(!aborted_);
+        bool next_vaddr = count_ > 0 && vaddr == base_ + count_ * PAGE_SIZE;
+
+        // A run that is physically contiguous as well can grow past the end of
+        // phys_, since only its first address is needed to map it.
+        if (next_vaddr && contiguous_ && paddr == phys_[0] + count_ * PAGE_SIZE) {
+            if (count_ < fbl::count_of(phys_)) {
+                phys_[count_] = paddr;
+            }
+            ++count_;
+            return ZX_OK;
+        }
+
         // If this isn't the expected vaddr, flush the run we have first.
-        if (count_ >= fbl::count_of(phys_) || vaddr != base_ + count_ * PAGE_SIZE) {
+        if (count_ >= fbl::count_of(phys_) || !next_vaddr) {
             zx_status_t status = Flush();
             if (status != ZX_OK) {
                 return status;
             }
             base_ = vaddr;
         }
+        contiguous_ = count_ == 0;
         phys_[count_] = paddr;
         ++count_;
         return ZX_OK;
@@ -427,11 +478,13 @@ private:
     vaddr_t base_;
     paddr_t phys_[16];
     size_t count_;
+    // true while every page in the run follows the previous one physically
+    bool contiguous_;
     bool aborted_;
 };
 
 VmMappingCoalescer::VmMappingCoalescer(VmMapping* mapping, vaddr_t base)
-    : mapping_(mapping), base_(base), count_(0), aborted_(false) {}
+    : mapping_(mapping), base_(base), count_(0), contiguous_(true), aborted_(false) {}
 
 VmMappingCoalescer::~VmMappingCoalescer() {
     // Make sure we've flushed or aborted
@@ -445,9 +498,16 @@ zx_status_t VmMappingCoalescer::Flush() {
 
     uint flags = mapping_->arch_mmu_flags();
     if (flags & ARCH_MMU_FLAG_PERM_RWX_MASK) {
+        // physically contiguous runs are handed over as such, which lets the
+        // arch code use large pages for the aligned parts of them
         size_t mapped;
-        zx_status_t ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags,
-                                                                &mapped);
+        zx_status_t ret;
+        if (contiguous_ && count_ > 1) {
+            ret = mapping_->aspace()->arch_aspace().MapContiguous(base_, phys_[0], count_, flags,
+                                                                  &mapped);
+        } else {
+            ret = mapping_->aspace()->arch_aspace().Map(base_, phys_, count_, flags, &mapped);
+        }
         if (ret != ZX_OK) {
             TRACEF("error %d mapping %zu pages starting at va %#" PRIxPTR "\n", ret, count_, base_);
             aborted_ = true;
@@ -505,7 +565,7 @@ zx_status_t VmMapping::MapRange(size_t offset, size_t len, bool commit) {
 
         zx_status_t status;
         paddr_t pa;
-        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, &pa);
+        status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, nullptr, nullptr, &pa);
         if (status < 0) {
             // no page to map
             if (commit) {
@@ -596,7 +656,7 @@ zx_status_t VmMapping::DestroyLocked() {
     return ZX_OK;
 }
 
-zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
+zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags, PageRequest* page_request) {
     canary_.Assert();
     DEBUG_ASSERT(is_mutex_held(aspace_->lock()));
 
@@ -646,7 +706,12 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
     // fault in or grab an existing page
     paddr_t new_pa;
     vm_page_t* page;
-    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, &page, &new_pa);
+    zx_status_t status = object_->GetPageLocked(vmo_offset, pf_flags, nullptr, page_request,
+                                                &page, &new_pa);
+    if (status == ZX_ERR_SHOULD_WAIT) {
+        // the caller waits for the page with our locks dropped and retries
+        return status;
+    }
     if (status < 0) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         TRACEF("%p vmo_offset %#" PRIx64 ", pf_flags %#x\n", this, vmo_offset, pf_flags);
@@ -737,9 +802,143 @@ zx_status_t VmMapping::PageFault(vaddr_t va, const uint pf_flags) {
         arch_sync_cache_range(va, PAGE_SIZE);
     }
 #endif
+
+    if (!PromoteLargePageLocked(va, new_pa, pf_flags))
+        FaultAroundLocked(va, pf_flags);
     return ZX_OK;
 }
 
+// If the vmo backs the whole large page sized block around a just resolved
+// fault at |va| with a single aligned run of its own pages, replace whatever
+// small pages are mapped in the block with one large page. Returns true if it
+// did. Protect and unmap split the large page again if they only cover part
+// of it.
+bool VmMapping::PromoteLargePageLocked(vaddr_t va, paddr_t pa, uint pf_flags) {
+    if (!vm_large_pages_enabled || !object_->is_paged() || object_->is_cow_clone_locked())
+        return false;
+
+    // pager pages have to take a write fault before they are written, so
+    // that the reclaimer knows which ones it can no longer evict
+    if (object_->is_pager_backed_locked())
+        return false;
+
+    // the block must lie within the mapping and line up with the physical run
+    const vaddr_t block = ROUNDDOWN(va, VM_LARGE_PAGE_SIZE);
+    if (block < base_ || size_ - (block - base_) < VM_LARGE_PAGE_SIZE)
+        return false;
+    if (pa < va - block || !IS_ALIGNED(pa - (va - block), VM_LARGE_PAGE_SIZE))
+        return false;
+
+    const paddr_t block_pa = pa - (va - block);
+    const uint64_t block_offset = block - base_ + object_offset_;
+    for (size_t o = 0; o < VM_LARGE_PAGE_SIZE; o += PAGE_SIZE) {
+        // a compressed page would be decompressed just to be looked at
+        paddr_t page_pa;
+        if (object_->IsPageCompressedLocked(block_offset + o) ||
+            object_->GetPageLocked(block_offset + o, 0, nullptr, nullptr, nullptr, &page_pa) != ZX_OK ||
+            page_pa != block_pa + o) {
+            return false;
+        }
+    }
+
+    const size_t count = VM_LARGE_PAGE_SIZE / PAGE_SIZE;
+    zx_status_t status = aspace_->arch_aspace().Unmap(block, count, nullptr);
+    if (status != ZX_OK)
+        return false;
+
+    // the pages all belong to the vmo, so there is no copy-on-write to
+    // catch and the block can be mapped with the full permissions
+    size_t mapped;
+    status = aspace_->arch_aspace().MapContiguous(block, block_pa, count, arch_mmu_flags_, &mapped);
+    if (status != ZX_OK) {
+        // leave the block to be faulted back in a page at a time
+        TRACEF("failed to map large page at va %#" PRIxPTR "\n", block);
+        return true;
+    }
+    DEBUG_ASSERT(mapped == count);
+
+#if ARCH_ARM64
+    if (!(pf_flags & VMM_PF_FLAG_GUEST) && (arch_mmu_flags_ & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+        arch_sync_cache_range(block, VM_LARGE_PAGE_SIZE);
+    }
+#endif
+
+    LTRACEF("%p promoted va %#" PRIxPTR " to a large page at pa %#" PRIxPTR "\n",
+            this, block, block_pa);
+    kcounter_add(vm_large_page_promotions, 1);
+    return true;
+}
+
+// Map in the pages surrounding a just resolved fault at |va| that the vmo
+// already has, so that touching them later does not trap. Nothing is faulted
+// in or allocated, and everything is mapped read only so that writes still go
+// through PageFault() for copy-on-write and permission upgrades.
+void VmMapping::FaultAroundLocked(vaddr_t va, uint pf_flags) {
+    if (fault_around_pages <= 1)
+        return;
+
+    // clip the aligned window to the mapping
+    const vaddr_t window_base = ROUNDDOWN(va, fault_around_pages * PAGE_SIZE);
+    const vaddr_t start = MAX(window_base, base_);
+    const size_t count = MIN(fault_around_pages - (start - window_base) / PAGE_SIZE,
+                             (size_ - (start - base_)) / PAGE_SIZE);
+
+    const uint mmu_flags = arch_mmu_flags_ & ~ARCH_MMU_FLAG_PERM_WRITE;
+    paddr_t run[kMaxFaultAroundPages];
+    vaddr_t run_base = 0;
+    size_t run_len = 0;
+    size_t total = 0;
+
+    auto map_run = [&]() {
+        if (run_len == 0)
+            return;
+
+        size_t mapped;
+        zx_status_t status = aspace_->arch_aspace().Map(run_base, run, run_len, mmu_flags, &mapped);
+        if (status == ZX_OK) {
+            DEBUG_ASSERT(mapped == run_len);
+            total += mapped;
+#if ARCH_ARM64
+            if (!(pf_flags & VMM_PF_FLAG_GUEST) && (mmu_flags & ARCH_MMU_FLAG_PERM_EXECUTE)) {
+                arch_sync_cache_range(run_base, run_len * PAGE_SIZE);
+            }
+#endif
+        }
+        run_len = 0;
+    };
+
+    for (size_t i = 0; i < count; i++) {
+        vaddr_t addr = start + i * PAGE_SIZE;
+        if (addr == va) {
+            map_run();
+            continue;
+        }
+
+        // only take pages that are resident and not mapped yet. compressed
+        // pages have gone cold, so leave them be until they are touched.
+        const uint64_t vmo_offset = addr - base_ + object_offset_;
+        paddr_t pa;
+        uint page_flags;
+        if (aspace_->arch_aspace().Query(addr, &pa, &page_flags) == ZX_OK ||
+            object_->IsPageCompressedLocked(vmo_offset) ||
+            object_->GetPageLocked(vmo_offset, 0, nullptr, nullptr, nullptr, &pa) != ZX_OK) {
+            map_run();
+            continue;
+        }
+
+        if (run_len == 0)
+            run_base = addr;
+        run[run_len++] = pa;
+    }
+    map_run();
+
+    if (total > 0) {
+        LTRACEF("%p va %#" PRIxPTR " mapped %zu pages around the fault\n", this, va, total);
+        kcounter_add(vm_fault_around_faults, 1);
+        kcounter_add(vm_fault_around_pages, total);
+    }
+}
+
 // We disable thread safety analysis here because one of the common uses of this
 // function is for splitting one mapping object into several that will be backed
 // by the same VmObject.  In that case, object_->lock() gets aliased across all
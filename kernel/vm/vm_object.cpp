@@ -35,12 +35,6 @@ VmObject::VmObject(fbl::RefPtr<VmObject> parent)
     : lock_(parent ? parent->lock_ref() : local_lock_),
       parent_(fbl::move(parent)) {
     LTRACEF("%p\n", this);
-
-    // Add ourself to the global VMO list, newer VMOs at the end.
-    {
-        AutoLock a(&all_vmos_lock_);
-        all_vmos_.push_back(this);
-    }
 }
 
 VmObject::~VmObject() {
@@ -65,14 +59,22 @@ VmObject::~VmObject() {
     DEBUG_ASSERT(mapping_list_.is_empty());
     DEBUG_ASSERT(children_list_.is_empty());
 
-    // Remove ourself from the global VMO list.
+    // Remove ourself from the global VMO list, unless we failed to be
+    // created.
     {
         AutoLock a(&all_vmos_lock_);
-        DEBUG_ASSERT(global_list_state_.InContainer() == true);
-        all_vmos_.erase(*this);
+        if (global_list_state_.InContainer())
+            all_vmos_.erase(*this);
     }
 }
 
+void VmObject::AddToGlobalList() {
+    // Add ourself to the global VMO list, newer VMOs at the end.
+    AutoLock a(&all_vmos_lock_);
+    DEBUG_ASSERT(!global_list_state_.InContainer());
+    all_vmos_.push_back(this);
+}
+
 void VmObject::get_name(char* out_name, size_t len) const {
     canary_.Assert();
     name_.get(len, out_name);
@@ -16,11 +16,13 @@
 #include <fbl/auto_lock.h>
 #include <inttypes.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
 #include <vm/physmap.h>
+#include <vm/reclaim.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
 #include <zircon/types.h>
@@ -29,6 +31,12 @@ using fbl::AutoLock;
 
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 
+KCOUNTER(vm_large_page_chunks, "kernel.vm.large_page.chunks");
+KCOUNTER(vm_large_page_chunk_failures, "kernel.vm.large_page.chunk_failures");
+KCOUNTER(vm_reclaim_evicted_pager, "kernel.vm.reclaim.evicted.pager");
+KCOUNTER(vm_reclaim_evicted_zero, "kernel.vm.reclaim.evicted.zero");
+KCOUNTER(vm_reclaim_compressed, "kernel.vm.reclaim.compressed");
+
 namespace {
 
 void ZeroPage(paddr_t pa) {
@@ -43,10 +51,23 @@ void ZeroPage(vm_page_t* p) {
     ZeroPage(pa);
 }
 
+bool IsZeroPage(vm_page_t* p) {
+    const uint64_t* ptr = static_cast<const uint64_t*>(paddr_to_physmap(p->paddr()));
+    DEBUG_ASSERT(ptr);
+
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (ptr[i] != 0)
+            return false;
+    }
+    return true;
+}
+
 void InitializeVmPage(vm_page_t* p) {
     DEBUG_ASSERT(p->state == VM_PAGE_STATE_ALLOC);
     p->state = VM_PAGE_STATE_OBJECT;
+    p->flags &= ~VM_PAGE_FLAG_MODIFIED;
     p->object.pin_count = 0;
+    p->object.age = 0;
 }
 
 // round up the size to the next page size boundary and make sure we dont wrap
@@ -89,6 +110,11 @@ VmObjectPaged::~VmObjectPaged() {
 
     // free all of the pages attached to us
     page_list_.FreeAllPages();
+
+    // fail any faults still waiting on pages and let the source know that
+    // nobody will ask it for any more
+    if (page_source_)
+        page_source_->Close();
 }
 
 zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::RefPtr<VmObject>* obj) {
@@ -103,6 +129,8 @@ zx_status_t VmObjectPaged::Create(uint32_t pmm_alloc_flags, uint64_t size, fbl::
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    vmo->AddToGlobalList();
+
     *obj = fbl::move(vmo);
 
     return ZX_OK;
@@ -125,6 +153,7 @@ zx_status_t VmObjectPaged::CreateContiguous(uint32_t pmm_alloc_flags, uint64_t s
     }
 
     if (size == 0) {
+        vmo->AddToGlobalList();
         *obj = fbl::move(vmo);
         return ZX_OK;
     }
@@ -172,7 +201,31 @@ zx_status_t VmObjectPaged::CreateContiguous(uint32_t pmm_alloc_flags, uint64_t s
     }
 
     cleanup_phys_pages.cancel();
+    vmo->AddToGlobalList();
+    *obj = fbl::move(vmo);
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::CreateExternal(fbl::RefPtr<PageSource> src, uint64_t size,
+                                          fbl::RefPtr<VmObject>* obj) {
+    // make sure size is page aligned
+    zx_status_t status = RoundSize(size, &size);
+    if (status != ZX_OK)
+        return status;
+
+    fbl::AllocChecker ac;
+    auto vmo = fbl::AdoptRef<VmObjectPaged>(new (&ac) VmObjectPaged(PMM_ALLOC_FLAG_ANY, size, nullptr,
+                                                                    false /* is_contiguous */));
+    if (!ac.check())
+        return ZX_ERR_NO_MEMORY;
+
+    // this VMO has not been shared anywhere yet
+    vmo->page_source_ = fbl::move(src);
+
+    vmo->AddToGlobalList();
+
     *obj = fbl::move(vmo);
+
     return ZX_OK;
 }
 
@@ -193,6 +246,9 @@ zx_status_t VmObjectPaged::CloneCOW(uint64_t offset, uint64_t size, bool copy_na
     if (!ac.check())
         return ZX_ERR_NO_MEMORY;
 
+    // This takes the global VMO lock, which is ordered before ours.
+    vmo->AddToGlobalList();
+
     AutoLock a(&lock_);
 
     // add the new VMO as a child before we do anything, since its
@@ -235,8 +291,8 @@ void VmObjectPaged::Dump(uint depth, bool verbose) {
         printf("  ");
     }
     printf("vmo %p/k%" PRIu64 " size %#" PRIx64
-           " pages %zu ref %d parent k%" PRIu64 "\n",
-           this, user_id_, size_, count, ref_count_debug(), parent_id);
+           " pages %zu compressed %zu ref %d parent k%" PRIu64 "\n",
+           this, user_id_, size_, count, compressed_pages_.size(), ref_count_debug(), parent_id);
 
     if (verbose) {
         auto f = [depth](const auto p, uint64_t offset) {
@@ -350,10 +406,12 @@ zx_status_t VmObjectPaged::CreateFromROData(const void* data, size_t size, fbl::
 // this VMO has a parent and the requested page isn't found, the parent will be searched.
 //
 // |free_list|, if not NULL, is a list of allocated but unused vm_page_t that
-// this function may allocate from.  This function will need at most one entry,
-// and will not fail if |free_list| is a non-empty list, faulting in was requested,
-// and offset is in range.
+// this function may allocate from.  The pages must already be zero filled.
+// This function will need at most one entry, plus one more if an ancestor has
+// to decompress the page, and will not fail if |free_list| holds that many,
+// faulting in was requested, and offset is in range.
 zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
+                                         PageRequest* page_request,
                                          vm_page_t** const page_out, paddr_t* const pa_out) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -367,6 +425,14 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     // see if we already have a page at that offset
     p = page_list_.GetPage(offset);
     if (p) {
+        // the page is in use again, which is news to the reclaimer. lookups
+        // that aren't faults, such as fault-around and large page promotion
+        // probing for pages, don't count as a use.
+        if (pf_flags & VMM_PF_FLAG_FAULT_MASK)
+            p->object.age = 0;
+        if (pf_flags & VMM_PF_FLAG_WRITE)
+            p->flags |= VM_PAGE_FLAG_MODIFIED;
+
         if (page_out)
             *page_out = p;
         if (pa_out)
@@ -374,6 +440,46 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         return ZX_OK;
     }
 
+    // a page that was compressed comes back as it was, whether or not
+    // faulting in was requested, since it's as good as committed
+    if (!compressed_pages_.is_empty()) {
+        auto compressed = compressed_pages_.find(offset);
+        if (compressed.IsValid()) {
+            if (free_list) {
+                p = list_remove_head_type(free_list, vm_page, queue_node);
+                if (p) {
+                    pa = p->paddr();
+                }
+            }
+            if (!p) {
+                p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+            }
+            if (!p) {
+                return ZX_ERR_NO_MEMORY;
+            }
+
+            InitializeVmPage(p);
+            compressed->Decompress(pa);
+            compressed_pages_.erase(compressed);
+            if (pf_flags & VMM_PF_FLAG_WRITE)
+                p->flags |= VM_PAGE_FLAG_MODIFIED;
+
+            // the page was unmapped everywhere when it was compressed, and
+            // every lookup since has come through here, so there is nothing
+            // stale to unmap
+            zx_status_t status = AddPageLocked(p, offset);
+            DEBUG_ASSERT(status == ZX_OK);
+
+            LTRACEF("decompressed page %p, pa %#" PRIxPTR "\n", p, pa);
+
+            if (page_out)
+                *page_out = p;
+            if (pa_out)
+                *pa_out = pa;
+            return ZX_OK;
+        }
+    }
+
     __UNUSED char pf_string[5];
     LTRACEF("vmo %p, offset %#" PRIx64 ", pf_flags %#x (%s)\n", this, offset, pf_flags,
             vmm_pf_flags_to_string(pf_flags, pf_string));
@@ -384,11 +490,24 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
         ASSERT(!overflowed);
 
-        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist
+        // make sure we don't cause the parent to fault in new pages, just ask for any that already exist,
+        // unless the parent's pages come from a page source, in which case a missing page has to be
+        // read in before we can either map it or copy it
         uint parent_pf_flags = pf_flags & ~(VMM_PF_FLAG_FAULT_MASK);
+        const bool parent_pager_backed = parent_->is_pager_backed_locked();
+        if (parent_pager_backed)
+            parent_pf_flags = pf_flags & ~VMM_PF_FLAG_WRITE;
 
+        // the parent may need a page from |free_list| to decompress into
         zx_status_t status = parent_->GetPageLocked(parent_offset, parent_pf_flags,
-                                                    nullptr, &p, &pa);
+                                                    free_list, page_request, &p, &pa);
+        // a page the parent doesn't have reads as zeros, unless it has to come
+        // from a page source. any other failure, such as running out of memory
+        // to decompress the parent's page into, must not be papered over with
+        // a zero page.
+        if (status != ZX_OK && status != ZX_ERR_OUT_OF_RANGE &&
+            (status != ZX_ERR_NOT_FOUND || parent_pager_backed))
+            return status;
         if (status == ZX_OK) {
             // we have a page from them. if we're read-only faulting, return that page so they can map
             // or read from it directly
@@ -449,6 +568,14 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
     if ((pf_flags & VMM_PF_FLAG_FAULT_MASK) == 0)
         return ZX_ERR_NOT_FOUND;
 
+    // pages that come from a page source have to be asked for, and only
+    // callers that can drop their locks and wait can do that
+    if (page_source_) {
+        if (!page_request)
+            return ZX_ERR_NOT_FOUND;
+        return page_source_->GetPage(offset, page_request);
+    }
+
     // if we're read faulting, we don't already have a page, and the parent doesn't have it,
     // return the single global zero page
     if ((pf_flags & VMM_PF_FLAG_WRITE) == 0) {
@@ -468,7 +595,7 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
         }
     }
     if (!p) {
-        p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+        p = pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &pa);
     }
     if (!p) {
         return ZX_ERR_NO_MEMORY;
@@ -476,9 +603,6 @@ zx_status_t VmObjectPaged::GetPageLocked(uint64_t offset, uint pf_flags, list_no
 
     InitializeVmPage(p);
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
-
 // if ARM and not fully cached, clean/invalidate the page after zeroing it
 #if ARCH_ARM64
     if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
@@ -506,10 +630,32 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
 
+    AutoLock a(&lock_);
+    return CommitRangeLocked(offset, len, committed);
+}
+
+zx_status_t VmObjectPaged::CommitRangePinned(uint64_t offset, uint64_t len) {
+    canary_.Assert();
+    LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
+
+    // with the lock held throughout, nothing can take the pages back before
+    // they are pinned
+    AutoLock a(&lock_);
+    zx_status_t status = CommitRangeLocked(offset, len, nullptr);
+    if (status != ZX_OK)
+        return status;
+    return PinLocked(offset, len);
+}
+
+zx_status_t VmObjectPaged::CommitRangeLocked(uint64_t offset, uint64_t len, uint64_t* committed) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
     if (committed)
         *committed = 0;
 
-    AutoLock a(&lock_);
+    // the pages of pager backed vmos can only be read in by faulting on them
+    if (is_pager_backed_locked())
+        return ZX_ERR_NOT_SUPPORTED;
 
     // trim the size
     uint64_t new_len;
@@ -525,6 +671,14 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(end > offset);
     offset = ROUNDDOWN(offset, PAGE_SIZE);
 
+    // clones copy their pages out of the parent one at a time, so only
+    // objects with no parent are worth backing with large pages
+    size_t large_count = 0;
+    if (vm_large_pages_enabled && !parent_)
+        large_count = CommitLargePagesLocked(offset, end);
+    if (committed)
+        *committed = large_count * PAGE_SIZE;
+
     // make a pass through the list, counting the number of pages we need to allocate
     size_t count = 0;
     uint64_t expected_next_off = offset;
@@ -544,13 +698,25 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     if (count == 0)
         return ZX_OK;
 
+    // the missing pages that an ancestor holds compressed need a second page,
+    // for the ancestor to decompress its copy into
+    size_t ancestor_count = 0;
+    if (parent_) {
+        for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+            if (IsPageCompressedLocked(o) &&
+                (compressed_pages_.is_empty() || !compressed_pages_.find(o).IsValid()))
+                ancestor_count++;
+        }
+    }
+
     // allocate count number of pages
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
-    if (allocated < count) {
-        LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
+    const size_t total = count + ancestor_count;
+    size_t allocated = pmm_alloc_pages(total, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED, &page_list);
+    if (allocated < total) {
+        LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", total, allocated);
         pmm_free(&page_list);
         return ZX_ERR_NO_MEMORY;
     }
@@ -571,7 +737,7 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
         const uint flags = VMM_PF_FLAG_SW_FAULT | VMM_PF_FLAG_WRITE;
         // Should not be able to fail, since we're providing it memory and the
         // range should be valid.
-        zx_status_t status = GetPageLocked(o, flags, &page_list, &p, &pa);
+        zx_status_t status = GetPageLocked(o, flags, &page_list, nullptr, &p, &pa);
         ASSERT(status == ZX_OK);
 
         if (committed)
@@ -581,11 +747,69 @@ zx_status_t VmObjectPaged::CommitRange(uint64_t offset, uint64_t len, uint64_t*
     DEBUG_ASSERT(list_is_empty(&page_list));
 
     // for now we only support committing as much as we were asked for
-    DEBUG_ASSERT(!committed || *committed == count * PAGE_SIZE);
+    DEBUG_ASSERT(!committed || *committed == (large_count + count) * PAGE_SIZE);
 
     return ZX_OK;
 }
 
+size_t VmObjectPaged::CommitLargePagesLocked(uint64_t offset, uint64_t end) {
+    const size_t pages_per_chunk = VM_LARGE_PAGE_SIZE / PAGE_SIZE;
+    size_t committed = 0;
+
+    for (uint64_t chunk = ROUNDUP(offset, VM_LARGE_PAGE_SIZE);
+         chunk < end && end - chunk >= VM_LARGE_PAGE_SIZE; chunk += VM_LARGE_PAGE_SIZE) {
+        // only fill chunks that have no pages yet
+        bool empty = true;
+        page_list_.ForEveryPageInRange(
+            [&empty](const auto p, uint64_t off) {
+                empty = false;
+                return ZX_ERR_STOP;
+            },
+            chunk, chunk + VM_LARGE_PAGE_SIZE);
+        auto compressed = compressed_pages_.lower_bound(chunk);
+        if (compressed.IsValid() && compressed->offset() < chunk + VM_LARGE_PAGE_SIZE)
+            empty = false;
+        if (!empty)
+            continue;
+
+        list_node page_list = LIST_INITIAL_VALUE(page_list);
+        paddr_t pa;
+        size_t allocated = pmm_alloc_contiguous(pages_per_chunk, pmm_alloc_flags_,
+                                                VM_LARGE_PAGE_SHIFT, &pa, &page_list);
+        if (allocated != pages_per_chunk) {
+            // physical memory is too fragmented, leave the rest to the regular path
+            kcounter_add(vm_large_page_chunk_failures, 1);
+            pmm_free(&page_list);
+            return committed;
+        }
+        kcounter_add(vm_large_page_chunks, 1);
+
+        LTRACEF("vmo %p, offset %#" PRIx64 " backed by large page at pa %#" PRIxPTR "\n",
+                this, chunk, pa);
+
+        uint64_t off = chunk;
+        vm_page_t* p;
+        while ((p = list_remove_head_type(&page_list, vm_page_t, queue_node))) {
+            InitializeVmPage(p);
+            ZeroPage(p);
+#if ARCH_ARM64
+            if (cache_policy_ != ARCH_MMU_FLAG_CACHED) {
+                arch_clean_invalidate_cache_range((addr_t)paddr_to_physmap(p->paddr()), PAGE_SIZE);
+            }
+#endif
+
+            zx_status_t status = page_list_.AddPage(p, off);
+            DEBUG_ASSERT(status == ZX_OK);
+            off += PAGE_SIZE;
+        }
+
+        // other mappings may have covered this range with the zero page
+        RangeChangeUpdateLocked(chunk, VM_LARGE_PAGE_SIZE);
+        committed += pages_per_chunk;
+    }
+    return committed;
+}
+
 zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t* decommitted) {
     canary_.Assert();
     LTRACEF("offset %#" PRIx64 ", len %#" PRIx64 "\n", offset, len);
@@ -630,6 +854,7 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
 
     // iterate through the pages, freeing them
     // TODO: use page_list iterator, move pages to list, free at once
+    FreeCompressedPagesLocked(start, end);
     while (start < end) {
         auto status = page_list_.FreePage(start);
         if (status == ZX_OK && decommitted) {
@@ -641,6 +866,319 @@ zx_status_t VmObjectPaged::DecommitRange(uint64_t offset, uint64_t len, uint64_t
     return ZX_OK;
 }
 
+zx_status_t VmObjectPaged::TakePages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(len));
+
+    AutoLock a(&lock_);
+
+    // only plain vmos own all of their pages outright
+    if (parent_ || page_source_ || is_contiguous_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    if (!InRange(offset, len, size_))
+        return ZX_ERR_OUT_OF_RANGE;
+
+    if (AnyPagesPinnedLocked(offset, len))
+        return ZX_ERR_BAD_STATE;
+
+    // allocate the pages we don't have up front, so that we can't fail
+    // halfway through
+    size_t count = 0;
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        if (!page_list_.GetPage(o))
+            count++;
+    }
+    list_node new_pages;
+    list_initialize(&new_pages);
+    if (count > 0) {
+        size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZEROED,
+                                           &new_pages);
+        if (allocated < count) {
+            pmm_free(&new_pages);
+            return ZX_ERR_NO_MEMORY;
+        }
+    }
+
+    // unmap all of the pages in this range on all the mapping regions
+    RangeChangeUpdateLocked(offset, len);
+
+    for (uint64_t o = offset; o < offset + len; o += PAGE_SIZE) {
+        vm_page_t* p = page_list_.RemovePage(o);
+        if (!p) {
+            p = list_remove_head_type(&new_pages, vm_page_t, queue_node);
+            DEBUG_ASSERT(p);
+            InitializeVmPage(p);
+
+            auto compressed = compressed_pages_.find(o);
+            if (compressed.IsValid()) {
+                compressed->Decompress(p->paddr());
+                compressed_pages_.erase(compressed);
+            }
+        }
+        list_add_tail(pages, &p->queue_node);
+    }
+    DEBUG_ASSERT(list_is_empty(&new_pages));
+
+    return ZX_OK;
+}
+
+zx_status_t VmObjectPaged::SupplyPages(uint64_t offset, uint64_t len, list_node* pages) {
+    canary_.Assert();
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(len));
+
+    AutoLock a(&lock_);
+
+    if (!page_source_)
+        return ZX_ERR_NOT_SUPPORTED;
+
+    // the caller has checked the range, but we may have shrunk since then,
+    // and nobody can want the pages past our end anymore
+    uint64_t end = offset + len;
+    if (end > size_)
+        end = MAX(offset, size_);
+
+    // nothing can have been mapped at offsets we don't have a page for yet,
+    // so there is nothing to unmap
+    list_node unused;
+    list_initialize(&unused);
+    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+        vm_page_t* p = list_remove_head_type(pages, vm_page_t, queue_node);
+        DEBUG_ASSERT(p);
+        DEBUG_ASSERT(p->state == VM_PAGE_STATE_OBJECT && p->object.pin_count == 0);
+        if (page_list_.AddPage(p, o) != ZX_OK) {
+            // keep the page we already have, which may be mapped
+            list_add_tail(&unused, &p->queue_node);
+            continue;
+        }
+        // the page holds what the pager has, so it can be evicted again
+        p->flags &= ~VM_PAGE_FLAG_MODIFIED;
+        p->object.age = 0;
+    }
+    // hand back the pages past our end along with the unused ones
+    vm_page_t* p;
+    while ((p = list_remove_head_type(pages, vm_page_t, queue_node)))
+        list_add_tail(&unused, &p->queue_node);
+    list_move(&unused, pages);
+
+    if (end > offset)
+        page_source_->OnPagesSupplied(offset, end - offset);
+
+    return ZX_OK;
+}
+
+void VmObjectPaged::AgePages(uint64_t* active, uint64_t* inactive) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+
+    page_list_.ForEveryPage([](const auto p, uint64_t) {
+        if (p->object.age < VM_PAGE_OBJECT_MAX_AGE)
+            p->object.age++;
+        return ZX_ERR_NEXT;
+    });
+
+    // Pages accessed through our mappings since the last scan are young
+    // again. These may be our parent's pages, which share our lock.
+    for (const auto& m : mapping_list_) {
+        zx_status_t status = m.HarvestAccessedLocked(
+            [](void* context, vaddr_t vaddr, paddr_t pa) {
+                vm_page_t* p = paddr_to_vm_page(pa);
+                if (p && p->state == VM_PAGE_STATE_OBJECT)
+                    p->object.age = 0;
+            },
+            nullptr);
+        if (status == ZX_ERR_NOT_SUPPORTED) {
+            // all we know is that the pages are mapped
+            page_list_.ForEveryPageInRange(
+                [](const auto p, uint64_t) {
+                    p->object.age = 0;
+                    return ZX_ERR_NEXT;
+                },
+                m.object_offset(), m.object_offset() + m.size());
+        }
+    }
+
+    page_list_.ForEveryPage([active, inactive](const auto p, uint64_t) {
+        if (p->object.age >= VM_RECLAIM_INACTIVE_AGE && p->object.pin_count == 0) {
+            (*inactive)++;
+        } else {
+            (*active)++;
+        }
+        return ZX_ERR_NEXT;
+    });
+}
+
+uint64_t VmObjectPaged::EvictPages(uint min_age, uint64_t max_pages) {
+    canary_.Assert();
+    DEBUG_ASSERT(min_age > 0);
+
+    if (is_contiguous_)
+        return 0;
+
+    AutoLock a(&lock_);
+
+    // Only evict from vmos that user space has handles to and that only user
+    // space maps, since the kernel can't take a fault on just any access.
+    // The pages of a clone may hide its parent's, so they can't go either.
+    if (user_id_ == 0 || parent_)
+        return 0;
+    for (const auto& m : mapping_list_) {
+        if (!m.aspace()->is_user())
+            return 0;
+    }
+
+    // Without a page source, a page can only be brought back as it was if it
+    // is all zeros, or from a compressed copy. With one, it can be if it
+    // hasn't been written. Compression reads the page through the physmap,
+    // which only agrees with what the mappings see if they are cached.
+    const bool pager_backed = page_source_ != nullptr;
+    const bool compressible = !pager_backed && cache_policy_ == ARCH_MMU_FLAG_CACHED &&
+                              vm_compression_enabled();
+    auto evictable = [pager_backed, compressible](vm_page_t* p) {
+        if (pager_backed)
+            return !(p->flags & VM_PAGE_FLAG_MODIFIED);
+        return compressible || IsZeroPage(p);
+    };
+
+    uint64_t evicted = 0;
+    uint64_t compressed_count = 0;
+    uint64_t start = 0;
+    while (evicted < max_pages) {
+        // find a batch of candidates
+        constexpr size_t kBatch = 64;
+        uint64_t offsets[kBatch];
+        size_t count = 0;
+        page_list_.ForEveryPageInRange(
+            [&](const auto p, uint64_t off) {
+                if (count == kBatch || evicted + count == max_pages)
+                    return ZX_ERR_STOP;
+                start = off + PAGE_SIZE;
+                if (p->object.age >= min_age && p->object.pin_count == 0 && evictable(p))
+                    offsets[count++] = off;
+                return ZX_ERR_NEXT;
+            },
+            start, size_);
+        if (count == 0)
+            break;
+
+        for (size_t i = 0; i < count; i++) {
+            // Once unmapped, the page can't change without a fault, which
+            // needs our lock, so check it one last time.
+            RangeChangeUpdateLocked(offsets[i], PAGE_SIZE);
+            vm_page_t* p = page_list_.GetPage(offsets[i]);
+            if (!evictable(p))
+                continue;
+
+            if (!pager_backed && !IsZeroPage(p)) {
+                fbl::unique_ptr<VmCompressedPage> compressed =
+                    VmCompressedPage::Create(offsets[i], p->paddr());
+                if (!compressed) {
+                    // don't try again until it has gone unused for as long
+                    p->object.age = 0;
+                    continue;
+                }
+                compressed_pages_.insert(fbl::move(compressed));
+                compressed_count++;
+            }
+
+            p = page_list_.RemovePage(offsets[i]);
+            pmm_free_page(p);
+            evicted++;
+        }
+    }
+
+    // the compressed copies take up some memory, but much less than a page
+    if (evicted > compressed_count) {
+        kcounter_add(pager_backed ? vm_reclaim_evicted_pager : vm_reclaim_evicted_zero,
+                     static_cast<int64_t>(evicted - compressed_count));
+    }
+    if (compressed_count > 0)
+        kcounter_add(vm_reclaim_compressed, static_cast<int64_t>(compressed_count));
+    return evicted;
+}
+
+zx_status_t VmObjectPaged::SetMergeable(bool mergeable) {
+    canary_.Assert();
+
+    AutoLock a(&lock_);
+    mergeable_ = mergeable;
+    return ZX_OK;
+}
+
+uint64_t VmObjectPaged::DedupZeroPages(bool all_vmos) {
+    canary_.Assert();
+
+    if (is_contiguous_)
+        return 0;
+
+    uint64_t freed = 0;
+    uint64_t start = 0;
+    for (;;) {
+        // Reading through a big vmo takes a while, and faults on it have to
+        // wait for the lock, so it is dropped between batches. Anything can
+        // have changed by the next one.
+        AutoLock a(&lock_);
+
+        if (!mergeable_ && !all_vmos)
+            break;
+
+        // The same vmos as eviction, and for the same reasons. Pages that
+        // come from a page source would be asked for again rather than
+        // fault back in as zeros, and the physmap may not see what the
+        // mappings of an uncached vmo do.
+        if (user_id_ == 0 || parent_ || page_source_ || cache_policy_ != ARCH_MMU_FLAG_CACHED)
+            break;
+        bool user_only = true;
+        for (const auto& m : mapping_list_) {
+            user_only = user_only && m.aspace()->is_user();
+        }
+        if (!user_only || start >= size_)
+            break;
+
+        constexpr size_t kBatch = 64;
+        uint64_t offsets[kBatch];
+        size_t examined = 0;
+        size_t count = 0;
+        bool done = true;
+        page_list_.ForEveryPageInRange(
+            [&](const auto p, uint64_t off) {
+                if (examined == kBatch) {
+                    done = false;
+                    return ZX_ERR_STOP;
+                }
+                examined++;
+                start = off + PAGE_SIZE;
+                // a page accessed since the last harvest is likely to be
+                // written to again soon, so don't bother reading it
+                if (p->object.pin_count == 0 && p->object.age > 0 && IsZeroPage(p))
+                    offsets[count++] = off;
+                return ZX_ERR_NEXT;
+            },
+            start, size_);
+
+        for (size_t i = 0; i < count; i++) {
+            // Once unmapped, the page can't change without a fault, which
+            // needs our lock, so check it one last time.
+            RangeChangeUpdateLocked(offsets[i], PAGE_SIZE);
+            vm_page_t* p = page_list_.GetPage(offsets[i]);
+            if (p->object.pin_count > 0 || !IsZeroPage(p))
+                continue;
+
+            p = page_list_.RemovePage(offsets[i]);
+            pmm_free_page(p);
+            freed++;
+        }
+
+        if (done)
+            break;
+    }
+
+    return freed;
+}
+
 zx_status_t VmObjectPaged::Pin(uint64_t offset, uint64_t len) {
     canary_.Assert();
 
@@ -751,6 +1289,16 @@ bool VmObjectPaged::AnyPagesPinnedLocked(uint64_t offset, size_t len) {
     return found_pinned;
 }
 
+void VmObjectPaged::FreeCompressedPagesLocked(uint64_t start, uint64_t end) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    auto iter = compressed_pages_.lower_bound(start);
+    while (iter.IsValid() && iter->offset() < end) {
+        auto cur = iter++;
+        compressed_pages_.erase(cur);
+    }
+}
+
 zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
     canary_.Assert();
     DEBUG_ASSERT(lock_.IsHeld());
@@ -781,6 +1329,13 @@ zx_status_t VmObjectPaged::ResizeLocked(uint64_t s) {
         // unmap all of the pages in this range on all the mapping regions
         RangeChangeUpdateLocked(start, len);
 
+        // threads waiting for pages that are now past the end will find
+        // that out when they retry
+        if (page_source_)
+            page_source_->OnPagesFailed(start, len, ZX_ERR_OUT_OF_RANGE);
+
+        FreeCompressedPagesLocked(start, end);
+
         // iterate through the pages, freeing them
         // TODO: use page_list iterator, move pages to list, free at once
         while (start < end) {
@@ -836,6 +1391,7 @@ template <typename T>
 zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool write, T copyfunc) {
     canary_.Assert();
 
+    PageRequest page_request;
     AutoLock a(&lock_);
 
     // are we uncached? abort in this case
@@ -859,7 +1415,21 @@ zx_status_t VmObjectPaged::ReadWriteInternal(uint64_t offset, size_t len, bool w
         paddr_t pa;
         auto status = GetPageLocked(src_offset,
                                     VMM_PF_FLAG_SW_FAULT | (write ? VMM_PF_FLAG_WRITE : 0),
-                                    nullptr, nullptr, &pa);
+                                    nullptr, &page_request, nullptr, &pa);
+        if (status == ZX_ERR_SHOULD_WAIT) {
+            // drop the lock while the page source supplies the page, then
+            // pick up where we left off
+            lock_.Release();
+            status = page_request.Wait();
+            lock_.Acquire();
+            if (status != ZX_OK)
+                return status;
+
+            // the vmo may have been resized in the meantime
+            if (end_offset > size_)
+                return ZX_ERR_OUT_OF_RANGE;
+            continue;
+        }
         if (status < 0)
             return status;
 
@@ -942,7 +1512,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
 
                 paddr_t pa;
                 zx_status_t status = this->GetPageLocked(missing_off, pf_flags, nullptr,
-                                                         nullptr, &pa);
+                                                         nullptr, nullptr, &pa);
                 if (status != ZX_OK) {
                     return ZX_ERR_NO_MEMORY;
                 }
@@ -956,6 +1526,10 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
                 }
             }
 
+            // the caller may write to the page, e.g. by DMA, behind our back
+            if (pf_flags & VMM_PF_FLAG_WRITE)
+                p->flags |= VM_PAGE_FLAG_MODIFIED;
+
             const size_t index = (off - start_page_offset) / PAGE_SIZE;
             paddr_t pa = p->paddr();
             zx_status_t status = lookup_fn(context, off, index, pa);
@@ -977,7 +1551,7 @@ zx_status_t VmObjectPaged::Lookup(uint64_t offset, uint64_t len, uint pf_flags,
     // If expected_next_off isn't at the end, there's a gap to process
     for (uint64_t off = expected_next_off; off < end_page_offset; off += PAGE_SIZE) {
         paddr_t pa;
-        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, &pa);
+        zx_status_t status = GetPageLocked(off, pf_flags, nullptr, nullptr, nullptr, &pa);
         if (status != ZX_OK) {
             return ZX_ERR_NO_MEMORY;
         }
@@ -1077,7 +1651,7 @@ zx_status_t VmObjectPaged::CacheOp(const uint64_t start_offset, const uint64_t l
 
         // lookup the physical address of the page, careful not to fault in a new one
         paddr_t pa;
-        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, &pa);
+        auto status = GetPageLocked(op_start_offset, 0, nullptr, nullptr, nullptr, &pa);
 
         if (likely(status == ZX_OK)) {
             // Convert the page address to a Kernel virtual address.
@@ -1130,7 +1704,7 @@ zx_status_t VmObjectPaged::SetMappingCachePolicy(const uint32_t cache_policy) {
     // 2) vmo has no mappings
     // 3) vmo has no clones
     // 4) vmo is not a clone
-    if (!page_list_.IsEmpty()) {
+    if (!page_list_.IsEmpty() || !compressed_pages_.is_empty()) {
         return ZX_ERR_BAD_STATE;
     }
     if (!mapping_list_.is_empty()) {
@@ -1148,6 +1722,27 @@ zx_status_t VmObjectPaged::SetMappingCachePolicy(const uint32_t cache_policy) {
     return ZX_OK;
 }
 
+bool VmObjectPaged::is_pager_backed_locked() const {
+    DEBUG_ASSERT(lock_.IsHeld());
+    return page_source_ || (parent_ && parent_->is_pager_backed_locked());
+}
+
+bool VmObjectPaged::IsPageCompressedLocked(uint64_t offset) {
+    DEBUG_ASSERT(lock_.IsHeld());
+
+    if (offset >= size_ || page_list_.GetPage(offset))
+        return false;
+    if (!compressed_pages_.is_empty() && compressed_pages_.find(offset).IsValid())
+        return true;
+    if (!parent_)
+        return false;
+
+    uint64_t parent_offset;
+    bool overflowed = add_overflow(parent_offset_, offset, &parent_offset);
+    ASSERT(!overflowed);
+    return parent_->IsPageCompressedLocked(parent_offset);
+}
+
 void VmObjectPaged::RangeChangeUpdateFromParentLocked(const uint64_t offset, const uint64_t len) {
     canary_.Assert();
 
@@ -54,6 +54,8 @@ zx_status_t VmObjectPhysical::Create(paddr_t base, uint64_t size, fbl::RefPtr<Vm
     // Physical VMOs should default to uncached access.
     vmo->SetMappingCachePolicy(ARCH_MMU_FLAG_UNCACHED);
 
+    vmo->AddToGlobalList();
+
     *obj = fbl::move(vmo);
 
     return ZX_OK;
@@ -71,7 +73,8 @@ void VmObjectPhysical::Dump(uint depth, bool verbose) {
 
 // get the physical address of a page at offset
 zx_status_t VmObjectPhysical::GetPageLocked(uint64_t offset, uint pf_flags, list_node* free_list,
-                                            vm_page_t** _page, paddr_t* _pa) {
+                                            PageRequest* page_request, vm_page_t** _page,
+                                            paddr_t* _pa) {
     canary_.Assert();
 
     if (_page)
@@ -141,6 +141,26 @@ zx_status_t VmPageList::FreePage(uint64_t offset) {
     return ZX_OK;
 }
 
+vm_page* VmPageList::RemovePage(uint64_t offset) {
+    uint64_t node_offset = ROUNDDOWN(offset, PAGE_SIZE * VmPageListNode::kPageFanOut);
+    size_t index = (offset >> PAGE_SIZE_SHIFT) % VmPageListNode::kPageFanOut;
+
+    LTRACEF_LEVEL(2, "%p offset %#" PRIx64 " node_offset %#" PRIx64 " index %zu\n", this, offset, node_offset,
+                  index);
+
+    auto pln = list_.find(node_offset);
+    if (!pln.IsValid()) {
+        return nullptr;
+    }
+
+    auto page = pln->RemovePage(index);
+    if (page && pln->IsEmpty()) {
+        list_.erase(*pln);
+    }
+
+    return page;
+}
+
 size_t VmPageList::FreeAllPages() {
     LTRACEF("%p\n", this);
 
@@ -16,6 +16,13 @@
 
 #define VM_GLOBAL_TRACE 0
 
+// size of the large pages big paged vmos are backed and mapped with when possible
+#define VM_LARGE_PAGE_SHIFT 21
+#define VM_LARGE_PAGE_SIZE (1UL << VM_LARGE_PAGE_SHIFT)
+
+// whether paged vmos use large pages at all, set from kernel.vm.large-pages
+extern bool vm_large_pages_enabled;
+
 // return a pointer to the zero page
 static inline vm_page_t* vm_get_zero_page(void) {
     extern vm_page_t* zero_page;
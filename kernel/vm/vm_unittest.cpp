@@ -9,6 +9,8 @@
 #include <fbl/alloc_checker.h>
 #include <fbl/array.h>
 #include <lib/unittest/unittest.h>
+#include <string.h>
+#include <vm/compression.h>
 #include <vm/physmap.h>
 #include <vm/vm.h>
 #include <vm/vm_address_region.h>
@@ -89,6 +91,55 @@ static bool pmm_alloc_contiguous_one_test() {
     END_TEST;
 }
 
+// Frees a page into the per cpu page cache and makes sure it can still be
+// allocated by address.
+static bool pmm_cached_alloc_range_test() {
+    BEGIN_TEST;
+    paddr_t pa;
+
+    vm_page_t* page = pmm_alloc_page(0, &pa);
+    ASSERT_NE(nullptr, page, "pmm_alloc single page");
+    uint64_t free_count = pmm_count_free_pages();
+
+    ASSERT_EQ(1u, pmm_free_page(page), "pmm_free_page on single page");
+    EXPECT_EQ(free_count + 1, pmm_count_free_pages(), "cached page counted as free");
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    ASSERT_EQ(1u, pmm_alloc_range(pa, 1, &list), "pmm_alloc_range on cached page");
+    EXPECT_EQ(page, list_peek_head_type(&list, vm_page_t, queue_node), "");
+
+    ASSERT_EQ(1u, pmm_free(&list), "pmm_free on single page");
+    END_TEST;
+}
+
+// Dirties a page, frees it and makes sure zeroed allocations never hand back
+// stale contents, whether or not they come out of the pre-zeroed pool.
+static bool pmm_alloc_zeroed_test() {
+    BEGIN_TEST;
+    static const size_t alloc_count = 8;
+
+    list_node list = LIST_INITIAL_VALUE(list);
+    ASSERT_EQ(alloc_count, pmm_alloc_pages(alloc_count, 0, &list), "pmm_alloc_pages");
+    vm_page_t* page;
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        memset(paddr_to_physmap(page->paddr()), 0xa5, PAGE_SIZE);
+    }
+    ASSERT_EQ(alloc_count, pmm_free(&list), "pmm_free");
+
+    ASSERT_EQ(alloc_count, pmm_alloc_pages(alloc_count, PMM_ALLOC_FLAG_ZEROED, &list),
+              "pmm_alloc_pages zeroed");
+    list_for_every_entry (&list, page, vm_page_t, queue_node) {
+        auto ptr = static_cast<const uint8_t*>(paddr_to_physmap(page->paddr()));
+        bool zero = true;
+        for (size_t i = 0; i < PAGE_SIZE; i++) {
+            zero = zero && ptr[i] == 0;
+        }
+        EXPECT_TRUE(zero, "zeroed page has stale contents");
+    }
+    ASSERT_EQ(alloc_count, pmm_free(&list), "pmm_free");
+    END_TEST;
+}
+
 static uint32_t test_rand(uint32_t seed) {
     return (seed = seed * 1664525 + 1013904223);
 }
@@ -952,6 +1003,90 @@ static bool vmo_lookup_test() {
     END_TEST;
 }
 
+static bool vmo_compressed_page_test() {
+    BEGIN_TEST;
+
+    if (!vm_compression_enabled()) {
+        unittest_printf("compression disabled, skipping\n");
+        END_TEST;
+    }
+
+    paddr_t src_pa, dst_pa;
+    vm_page_t* src = pmm_alloc_page(0, &src_pa);
+    ASSERT_NONNULL(src, "pmm_alloc_page");
+    vm_page_t* dst = pmm_alloc_page(0, &dst_pa);
+    ASSERT_NONNULL(dst, "pmm_alloc_page");
+    auto src_ptr = static_cast<uint32_t*>(paddr_to_physmap(src_pa));
+    auto dst_ptr = static_cast<uint32_t*>(paddr_to_physmap(dst_pa));
+
+    // a repeating pattern compresses and comes back as it was
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        src_ptr[i] = i % 16;
+    }
+    const uint64_t offset = PAGE_SIZE;
+    fbl::unique_ptr<VmCompressedPage> compressed = VmCompressedPage::Create(offset, src_pa);
+    ASSERT_NONNULL(compressed.get(), "compressing a page of a pattern");
+    EXPECT_EQ(offset, compressed->offset(), "offset of compressed page");
+    memset(dst_ptr, 0xa5, PAGE_SIZE);
+    compressed->Decompress(dst_pa);
+    EXPECT_EQ(0, memcmp(src_ptr, dst_ptr, PAGE_SIZE), "decompressed page contents");
+    compressed.reset();
+
+    // random data doesn't compress
+    uint32_t val = 1;
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint32_t); i++) {
+        src_ptr[i] = val = test_rand(val);
+    }
+    compressed = VmCompressedPage::Create(0, src_pa);
+    EXPECT_NULL(compressed.get(), "compressing a page of random data");
+
+    pmm_free_page(src);
+    pmm_free_page(dst);
+    END_TEST;
+}
+
+// Dedup frees the zero pages of a mergeable vmo and leaves the others alone.
+static bool vmo_dedup_zero_pages_test() {
+    BEGIN_TEST;
+    static const size_t alloc_size = PAGE_SIZE * 4;
+
+    fbl::RefPtr<VmObject> vmo;
+    zx_status_t status = VmObjectPaged::Create(PMM_ALLOC_FLAG_ANY, alloc_size, &vmo);
+    ASSERT_EQ(status, ZX_OK, "vmobject creation\n");
+    ASSERT_TRUE(vmo, "vmobject creation\n");
+
+    // only vmos that belong to user space are deduplicated
+    vmo->set_user_id(1);
+
+    status = vmo->CommitRange(0, alloc_size, nullptr);
+    ASSERT_EQ(ZX_OK, status, "committing vm object\n");
+    const uint8_t byte = 0x5a;
+    status = vmo->Write(&byte, PAGE_SIZE + 10, sizeof(byte));
+    ASSERT_EQ(ZX_OK, status, "writing to object\n");
+
+    EXPECT_EQ(0u, vmo->DedupZeroPages(false), "dedup of an unmergeable vmo\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE, vmo->AllocatedPages(), "pages kept\n");
+
+    ASSERT_EQ(ZX_OK, vmo->SetMergeable(true), "making the vmo mergeable\n");
+    EXPECT_EQ(alloc_size / PAGE_SIZE - 1, vmo->DedupZeroPages(false), "zero pages freed\n");
+    EXPECT_EQ(1u, vmo->AllocatedPages(), "written page kept\n");
+
+    // the freed pages read back as zeros and the written one is unchanged
+    fbl::AllocChecker ac;
+    fbl::Array<uint8_t> buf(new (&ac) uint8_t[PAGE_SIZE], PAGE_SIZE);
+    ASSERT_TRUE(ac.check(), "");
+    for (size_t off = 0; off < alloc_size; off += PAGE_SIZE) {
+        status = vmo->Read(buf.get(), off, PAGE_SIZE);
+        ASSERT_EQ(ZX_OK, status, "reading from object\n");
+        for (size_t i = 0; i < PAGE_SIZE; i++) {
+            const uint8_t expected = (off + i == PAGE_SIZE + 10) ? byte : 0;
+            ASSERT_EQ(expected, buf[i], "contents after dedup\n");
+        }
+    }
+
+    END_TEST;
+}
+
 // TODO(ZX-1431): The ARM code's error codes are always ZX_ERR_INTERNAL, so
 // special case that.
 #if ARCH_ARM64
@@ -1038,6 +1173,8 @@ VM_UNITTEST(pmm_smoke_test)
 //VM_UNITTEST(pmm_large_alloc_test)
 //VM_UNITTEST(pmm_oversized_alloc_test)
 VM_UNITTEST(pmm_alloc_contiguous_one_test)
+VM_UNITTEST(pmm_cached_alloc_range_test)
+VM_UNITTEST(pmm_alloc_zeroed_test)
 VM_UNITTEST(vmm_alloc_smoke_test)
 VM_UNITTEST(vmm_alloc_contiguous_smoke_test)
 VM_UNITTEST(multiple_regions_test)
@@ -1063,6 +1200,8 @@ VM_UNITTEST(vmo_double_remap_test)
 VM_UNITTEST(vmo_read_write_smoke_test)
 VM_UNITTEST(vmo_cache_test)
 VM_UNITTEST(vmo_lookup_test)
+VM_UNITTEST(vmo_compressed_page_test)
+VM_UNITTEST(vmo_dedup_zero_pages_test)
 VM_UNITTEST(arch_noncontiguous_map)
 // Uncomment for debugging
 // VM_UNITTEST(dump_all_aspaces)  // Run last
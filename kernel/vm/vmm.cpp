@@ -12,8 +12,10 @@
 #include <kernel/auto_lock.h>
 #include <kernel/mutex.h>
 #include <lib/console.h>
+#include <lib/counters.h>
 #include <lib/ktrace.h>
 #include <object/diagnostics.h>
+#include <platform.h>
 #include <string.h>
 #include <trace.h>
 #include <vm/fault.h>
@@ -26,6 +28,8 @@
 #define LOCAL_TRACE MAX(VM_GLOBAL_TRACE, 0)
 #define TRACE_PAGE_FAULT 0
 
+KCOUNTER_HISTOGRAM(page_fault_latency, "kernel.vm.page_fault.latency_ns");
+
 // This file mostly contains C wrappers around the underlying C++ objects, conforming to
 // the older api.
 
@@ -58,7 +62,9 @@ zx_status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
         return ZX_ERR_NOT_FOUND;
 
     // page fault it
+    const zx_time_t start = current_time();
     zx_status_t status = aspace->PageFault(addr, flags);
+    kcounter_histogram_add(page_fault_latency, current_time() - start);
 
     // If it's a user fault, dump info about process memory usage.
     // If it's a kernel fault, the kernel could possibly already
@@ -34,7 +34,7 @@ __BEGIN_CDECLS
 #define KTRACE_NAMESIZE           (12)
 #define KTRACE_NAMEOFF            (8)
 
-#define KTRACE_VERSION            (0x00020000)
+#define KTRACE_VERSION            (0x00030000)
 
 // Filter Groups
 #define KTRACE_GRP_ALL            0xFFF
@@ -83,10 +83,73 @@ enum {
 #define TAG_PROBE_16(n) KTRACE_TAG(((n)|0x800),KTRACE_GRP_PROBE,16)
 #define TAG_PROBE_24(n) KTRACE_TAG(((n)|0x800),KTRACE_GRP_PROBE,24)
 
+// Fills |n| bytes (a multiple of 8, at most 120) that hold no record.
+// Only the tag is meaningful.
+#define TAG_PAD(n) KTRACE_TAG(0x003,KTRACE_GRP_META,(n))
+
 // Actions for ktrace control
-#define KTRACE_ACTION_START     1 // options = grpmask, 0 = all
-#define KTRACE_ACTION_STOP      2 // options ignored
-#define KTRACE_ACTION_REWIND    3 // options ignored
-#define KTRACE_ACTION_NEW_PROBE 4 // options ignored, ptr = name
+#define KTRACE_ACTION_START          1 // options = grpmask, 0 = all
+#define KTRACE_ACTION_STOP           2 // options ignored
+#define KTRACE_ACTION_REWIND         3 // options ignored
+#define KTRACE_ACTION_NEW_PROBE      4 // options ignored, ptr = name
+#define KTRACE_ACTION_START_CIRCULAR 5 // options = grpmask, 0 = all
+#define KTRACE_ACTION_CONSUME        6 // options = count, ptr = uint64_t[count]
+
+// Layout of the trace data read with zx_ktrace_read():
+//
+// The TAG_VERSION and TAG_TICKS_PER_MS records come first, followed by the
+// name records.  Each CPU's records come next, as one block per CPU that
+// starts with a TAG_CPU_BUFFER record.  Records within a block are in the
+// order that CPU wrote them, so a reader wanting a single timeline needs to
+// merge the blocks by timestamp.  Blocks can contain TAG_PAD records.
+//
+// KTRACE_ACTION_START stops tracing when any CPU's buffer fills up, and
+// KTRACE_ACTION_START_CIRCULAR overwrites each CPU's oldest records instead.
+
+// Streaming mode, started with zx_ktrace_stream(), hands out a VMO that
+// holds the trace buffers themselves.  It starts with a
+// ktrace_stream_header_t, followed by a ktrace_buffer_info_t for each of
+// its |num_buffers| buffers.  The first holds the name records, and the
+// one at index 1 + n holds the records of CPU n.
+typedef struct ktrace_buffer_info {
+    // Where the buffer is, relative to the start of the VMO.
+    uint64_t offset;
+    uint64_t size;
+
+    // Positions in the buffer's stream of records, counted in bytes since
+    // tracing started.  The records between |tail| and |head| are valid,
+    // at offset + (position % size).  Records never wrap around the end of
+    // a buffer.  The reader reports how far it has got with
+    // KTRACE_ACTION_CONSUME, which moves |tail| up.
+    uint64_t head;
+    uint64_t tail;
+
+    // Number of records dropped because the buffer was full.
+    uint64_t dropped;
+
+    uint64_t reserved[3];
+} ktrace_buffer_info_t;
+
+typedef struct ktrace_stream_header {
+    uint32_t version; // KTRACE_VERSION
+    uint32_t num_buffers;
+    uint64_t ticks_per_ms;
+
+    // Nonzero once tracing has stopped.  The reader should drain the
+    // buffers one last time.
+    uint32_t stopped;
+
+    uint32_t reserved0;
+    uint64_t reserved[5];
+} ktrace_stream_header_t;
+
+static_assert(sizeof(ktrace_stream_header_t) == 64,
+              "ktrace_stream_header_t is not 64 bytes");
+static_assert(sizeof(ktrace_buffer_info_t) == 64,
+              "ktrace_buffer_info_t is not 64 bytes");
+
+// The event from zx_ktrace_stream() is signaled while any buffer is at
+// least this full, or once tracing has stopped.
+#define KTRACE_STREAM_WATERMARK_PERCENT 50
 
 __END_CDECLS
@@ -95,3 +95,6 @@
 
 #define ZX_DEFAULT_SUSPEND_TOKEN_RIGHTS \
     (ZX_RIGHT_TRANSFER)
+
+#define ZX_DEFAULT_PAGER_RIGHTS \
+    (ZX_RIGHT_INSPECT | ZX_RIGHT_DUPLICATE | ZX_RIGHT_TRANSFER | ZX_RIGHT_READ | ZX_RIGHT_WRITE)
@@ -0,0 +1,49 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <zircon/types.h>
+
+// ask clang format not to mess up the indentation:
+// clang-format off
+
+__BEGIN_CDECLS
+
+// Layout of the VMO returned by zx_kcounter_snapshot(): a
+// zx_kcounter_snapshot_header_t, then |counter_count| zx_kcounter_t, then
+// |histogram_count| zx_kcounter_histogram_t, each sorted by name.  The values
+// are summed over all the cpus, and since they are read while other cpus may
+// be updating them, they need not be consistent with each other.
+
+#define ZX_KCOUNTER_SNAPSHOT_MAGIC      0x544e434bu // "KCNT"
+#define ZX_KCOUNTER_SNAPSHOT_VERSION    1u
+
+#define ZX_KCOUNTER_NAME_LEN            56u
+
+// Entry 0 of a histogram counts values below 1, entry i values of at least
+// 2^(i-1) and less than 2^i, and the last entry all the larger values.
+#define ZX_KCOUNTER_HISTOGRAM_BUCKETS   32u
+
+typedef struct zx_kcounter_snapshot_header {
+    uint32_t magic;             // ZX_KCOUNTER_SNAPSHOT_MAGIC
+    uint32_t version;           // ZX_KCOUNTER_SNAPSHOT_VERSION
+    zx_time_t timestamp;        // ZX_CLOCK_MONOTONIC when the snapshot was taken
+    uint32_t counter_count;
+    uint32_t histogram_count;
+    uint32_t histogram_buckets; // ZX_KCOUNTER_HISTOGRAM_BUCKETS
+    uint32_t reserved;
+} zx_kcounter_snapshot_header_t;
+
+typedef struct zx_kcounter {
+    char name[ZX_KCOUNTER_NAME_LEN]; // null terminated
+    int64_t value;
+} zx_kcounter_t;
+
+typedef struct zx_kcounter_histogram {
+    char name[ZX_KCOUNTER_NAME_LEN]; // null terminated
+    int64_t buckets[ZX_KCOUNTER_HISTOGRAM_BUCKETS];
+} zx_kcounter_histogram_t;
+
+__END_CDECLS
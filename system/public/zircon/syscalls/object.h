@@ -33,6 +33,9 @@ typedef enum {
     ZX_INFO_HANDLE_COUNT               = 19, // zx_info_handle_count_t[1]
     ZX_INFO_BTI                        = 20, // zx_info_bti_t[1]
     ZX_INFO_PROCESS_HANDLE_STATS       = 21, // zx_info_process_handle_stats_t[1]
+    ZX_INFO_KMEM_RECLAIM_STATS         = 22, // zx_info_kmem_reclaim_stats_t[1]
+    ZX_INFO_KMEM_COMPRESSION_STATS     = 23, // zx_info_kmem_compression_stats_t[1]
+    ZX_INFO_CPU_SCHED_STATS            = 24, // zx_info_cpu_sched_stats_t[n]
     ZX_INFO_LAST
 } zx_object_info_topic_t;
 
@@ -303,6 +306,40 @@ typedef struct zx_info_cpu_stats {
     uint64_t generic_ipis;
 } zx_info_cpu_stats_t;
 
+#define ZX_INFO_CPU_SCHED_STATS_BUCKETS 16u
+
+// Scheduler statistics per cpu, kept since boot.  Entry 0 of each histogram
+// counts values below 1, entry i values of at least 2^(i-1) and less than
+// 2^i, and the last entry all the rest.
+typedef struct zx_info_cpu_sched_stats {
+    uint32_t cpu_number;
+    uint32_t flags;         // ZX_INFO_CPU_STATS_FLAG_* values
+
+    // How long threads waited to run after being woken up, in
+    // microseconds.
+    uint64_t wakeup_latency[ZX_INFO_CPU_SCHED_STATS_BUCKETS];
+
+    // How long threads ran before being switched out, in microseconds.
+    uint64_t run_time[ZX_INFO_CPU_SCHED_STATS_BUCKETS];
+
+    // How many threads were already queued when another was added to the
+    // run queue.
+    uint64_t queue_len[ZX_INFO_CPU_SCHED_STATS_BUCKETS];
+
+    // The number of threads in the run queue right now.
+    uint32_t run_queue_len;
+    uint32_t reserved;
+
+    // Switches away from a thread that was preempted, rather than one that
+    // blocked or yielded.
+    uint64_t involuntary_switches;
+
+    // Switches to a thread that last ran on another cpu, and those of them
+    // where the other cpu doesn't share this one's last level cache.
+    uint64_t migrations;
+    uint64_t migrations_cross_llc;
+} zx_info_cpu_sched_stats_t;
+
 // Information about kernel memory usage.
 // Can be expensive to gather.
 typedef struct zx_info_kmem_stats {
@@ -340,6 +377,50 @@ typedef struct zx_info_kmem_stats {
     uint64_t other_bytes;
 } zx_info_kmem_stats_t;
 
+// Information about the aging and reclamation of pages under memory pressure.
+typedef struct zx_info_kmem_reclaim_stats {
+    // The amount of VMO memory accessed recently, as of the last scan.
+    uint64_t active_bytes;
+
+    // The amount of VMO memory not accessed for a while, as of the last
+    // scan, which is where memory is reclaimed from.
+    uint64_t inactive_bytes;
+
+    // The total amount of memory reclaimed since boot.
+    uint64_t evicted_bytes;
+
+    // The number of times all pages have been aged.
+    uint64_t scans;
+
+    // The current memory pressure level, one of the
+    // ZX_SYSTEM_EVENT_MEMORY_PRESSURE_* values.
+    uint32_t pressure_level;
+} zx_info_kmem_reclaim_stats_t;
+
+#define ZX_INFO_KMEM_COMPRESSION_LATENCY_BUCKETS 16u
+
+// Information about the pages that reclamation has compressed.
+typedef struct zx_info_kmem_compression_stats {
+    // The amount of memory held compressed, and the amount it would take
+    // up uncompressed.  Their ratio is the compression ratio.
+    uint64_t compressed_bytes;
+    uint64_t uncompressed_bytes;
+
+    // The number of pages compressed since boot, and the number that didn't
+    // compress well enough to be kept that way.
+    uint64_t compressions;
+    uint64_t failed_compressions;
+
+    // The number of pages decompressed since boot.
+    uint64_t decompressions;
+
+    // A histogram of how long decompressions took.  Entry 0 counts those
+    // that took less than a microsecond, entry i those that took at least
+    // 2^(i-1) and less than 2^i microseconds, and the last entry all the
+    // rest.
+    uint64_t decompress_latency[ZX_INFO_KMEM_COMPRESSION_LATENCY_BUCKETS];
+} zx_info_kmem_compression_stats_t;
+
 typedef struct zx_info_resource {
     // The resource kind, one of:
     // {ZX_RSRC_KIND_ROOT, ZX_RSRC_KIND_MMIO, ZX_RSRC_KIND_IOPORT, ZX_RSRC_KIND_IRQ,
@@ -14,6 +14,9 @@ __BEGIN_CDECLS
 #define ZX_WAIT_ASYNC_ONCE          0u
 #define ZX_WAIT_ASYNC_REPEATING     1u
 
+// The most packets zx_port_wait_many() dequeues in one call.
+#define ZX_PORT_WAIT_MANY_MAX_PACKETS 16u
+
 // packet types.
 #define ZX_PKT_TYPE_USER            0x00u
 #define ZX_PKT_TYPE_SIGNAL_ONE      0x01u
@@ -24,6 +27,7 @@ __BEGIN_CDECLS
 #define ZX_PKT_TYPE_GUEST_VCPU      0x06u
 #define ZX_PKT_TYPE_INTERRUPT       0x07u
 #define ZX_PKT_TYPE_EXCEPTION(n)    (0x08u | (((n) & 0xFFu) << 8))
+#define ZX_PKT_TYPE_PAGE_REQUEST    0x09u
 
 
 #define ZX_PKT_TYPE_MASK            0xFFu
@@ -37,9 +41,14 @@ __BEGIN_CDECLS
 #define ZX_PKT_IS_GUEST_VCPU(type)  ((type) == ZX_PKT_TYPE_GUEST_VCPU)
 #define ZX_PKT_IS_INTERRUPT(type)   ((type) == ZX_PKT_TYPE_INTERRUPT)
 #define ZX_PKT_IS_EXCEPTION(type)   (((type) & ZX_PKT_TYPE_MASK) == ZX_PKT_TYPE_EXCEPTION(0))
+#define ZX_PKT_IS_PAGE_REQUEST(type) ((type) == ZX_PKT_TYPE_PAGE_REQUEST)
 
 #define ZX_PKT_GUEST_VCPU_INTERRUPT  0
 #define ZX_PKT_GUEST_VCPU_STARTUP    1
+
+// zx_packet_page_request_t::command
+#define ZX_PAGER_VMO_READ           0
+#define ZX_PAGER_VMO_COMPLETE       1
 // clang-format on
 
 // port_packet_t::type ZX_PKT_TYPE_USER.
@@ -126,6 +135,20 @@ typedef struct zx_packet_interrupt {
     zx_time_t timestamp;
 } zx_packet_interrupt_t;
 
+// port_packet_t::type ZX_PKT_TYPE_PAGE_REQUEST.
+//
+// ZX_PAGER_VMO_READ asks the pager to supply [offset, offset + length) of the
+// vmo.  ZX_PAGER_VMO_COMPLETE is the last packet for a vmo, sent once the vmo
+// has been destroyed.
+typedef struct zx_packet_page_request {
+    uint16_t command;
+    uint16_t flags;
+    uint32_t reserved0;
+    uint64_t offset;
+    uint64_t length;
+    uint64_t reserved1;
+} zx_packet_page_request_t;
+
 typedef struct zx_port_packet {
     uint64_t key;
     uint32_t type;
@@ -139,6 +162,7 @@ typedef struct zx_port_packet {
         zx_packet_guest_io_t guest_io;
         zx_packet_guest_vcpu_t guest_vcpu;
         zx_packet_interrupt_t interrupt;
+        zx_packet_page_request_t page_request;
     };
 } zx_port_packet_t;
 
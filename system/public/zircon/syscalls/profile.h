@@ -12,6 +12,8 @@ __BEGIN_CDECLS
 // clang-format off
 
 #define ZX_PROFILE_INFO_SCHEDULER   1
+#define ZX_PROFILE_INFO_DEADLINE    2
+#define ZX_PROFILE_INFO_FAIR        3
 
 typedef struct zx_profile_scheduler {
     int32_t priority;
@@ -26,10 +28,26 @@ typedef struct zx_profile_scheduler {
 #define ZX_PRIORITY_HIGH                24
 #define ZX_PRIORITY_HIGHEST             31
 
+// Reserve |capacity| of cpu time in every |period|. The period may be at
+// most one second.
+typedef struct zx_profile_deadline {
+    zx_duration_t capacity;
+    zx_duration_t period;
+} zx_profile_deadline_t;
+
+// Share cpu time with other fair threads in proportion to |weight|.
+typedef struct zx_profile_fair {
+    uint32_t weight;
+} zx_profile_fair_t;
+
+#define ZX_FAIR_WEIGHT_DEFAULT          1024
+
 typedef struct zx_profile_info {
     uint32_t type;                  // one of ZX_PROFILE_INFO_
     union {
         zx_profile_scheduler_t scheduler;
+        zx_profile_deadline_t deadline;
+        zx_profile_fair_t fair;
     };
 } zx_profile_info_t;
 
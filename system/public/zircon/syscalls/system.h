@@ -18,6 +18,12 @@ __BEGIN_CDECLS
 #define ZX_SYSTEM_POWERCTL_REBOOT_RECOVERY              7u
 #define ZX_SYSTEM_POWERCTL_SHUTDOWN                     8u
 
+// Kinds of events returned by zx_system_get_event(). Exactly one of the
+// memory pressure events is signaled at any time.
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL          1u
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING         2u
+#define ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL        3u
+
 typedef struct zx_system_powerctl_arg {
     union {
         struct {
@@ -241,6 +241,8 @@ typedef uint32_t zx_rights_t;
 #define ZX_VMO_OP_CACHE_INVALIDATE       7u
 #define ZX_VMO_OP_CACHE_CLEAN            8u
 #define ZX_VMO_OP_CACHE_CLEAN_INVALIDATE 9u
+#define ZX_VMO_OP_MERGEABLE              10u
+#define ZX_VMO_OP_UNMERGEABLE            11u
 
 // VM Object clone flags
 #define ZX_VMO_CLONE_COPY_ON_WRITE       1u
@@ -368,7 +370,8 @@ typedef uint32_t zx_obj_type_t;
 #define ZX_OBJ_TYPE_PROFILE         ((zx_obj_type_t)25u)
 #define ZX_OBJ_TYPE_PMT             ((zx_obj_type_t)26u)
 #define ZX_OBJ_TYPE_SUSPEND_TOKEN   ((zx_obj_type_t)27u)
-#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_PAGER           ((zx_obj_type_t)28u)
+#define ZX_OBJ_TYPE_LAST            ((zx_obj_type_t)29u)
 
 typedef struct {
     zx_handle_t handle;
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <threads.h>
 
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
@@ -34,10 +35,20 @@ struct TestArgs {
     uint32_t queue;
 };
 
-void do_test(uint32_t duration, const TestArgs& test_args) {
-    __UNUSED zx_status_t status;
+// Runs the write/read loop on its own channel for |duration_ns|.
+struct TestThread {
+    const TestArgs* test_args;
+    uint64_t duration_ns;
+
+    thrd_t thread;
+    uint64_t iterations;
+    zx_duration_t elapsed_ns;
+};
 
-    uint64_t duration_ns = duration * 1000000000ull;
+int test_thread(void* arg) {
+    TestThread* t = static_cast<TestThread*>(arg);
+    const TestArgs& test_args = *t->test_args;
+    __UNUSED zx_status_t status;
 
     // We'll write to mp[0] (and read from mp[1]).
     zx_handle_t mp[2] = {ZX_HANDLE_INVALID, ZX_HANDLE_INVALID};
@@ -93,7 +104,7 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
 
         status = zx_clock_get_new(ZX_CLOCK_MONOTONIC, &end_ns);
         assert(status == ZX_OK);
-        if ((end_ns - start_ns) >= duration_ns)
+        if (static_cast<uint64_t>(end_ns - start_ns) >= t->duration_ns)
             break;
     }
 
@@ -108,11 +119,36 @@ void do_test(uint32_t duration, const TestArgs& test_args) {
     status = zx_handle_close(mp[1]);
     assert(status == ZX_OK);
 
-    double real_duration = static_cast<double>(end_ns - start_ns) / 1000000000.0;
-    double its_per_second = static_cast<double>(big_its) * big_it_size / real_duration;
-    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued): "
-               "%.0f iterations/second\n",
-           test_args.size, test_args.handles, test_args.queue, its_per_second);
+    t->iterations = big_its * big_it_size;
+    t->elapsed_ns = end_ns - start_ns;
+    return 0;
+}
+
+// Runs the test on |threads| threads at once, each with its own channel, and
+// prints the combined rate.
+void do_test(uint32_t duration, uint32_t threads, const TestArgs& test_args) {
+    fbl::unique_ptr<TestThread[]> t(new TestThread[threads]);
+    for (uint32_t i = 0; i < threads; i++) {
+        t[i].test_args = &test_args;
+        t[i].duration_ns = duration * 1000000000ull;
+        __UNUSED int ret = thrd_create_with_name(&t[i].thread, test_thread, &t[i],
+                                                  "channel-perf");
+        assert(ret == thrd_success);
+    }
+
+    double its_per_second = 0.0;
+    for (uint32_t i = 0; i < threads; i++) {
+        __UNUSED int ret = thrd_join(t[i].thread, nullptr);
+        assert(ret == thrd_success);
+        double real_duration = static_cast<double>(t[i].elapsed_ns) / 1000000000.0;
+        its_per_second += static_cast<double>(t[i].iterations) / real_duration;
+    }
+
+    printf("write/read %" PRIu32 " bytes, %" PRIu32 " handles (%" PRIu32 " pre-queued)",
+           test_args.size, test_args.handles, test_args.queue);
+    if (threads > 1u)
+        printf(", %" PRIu32 " threads", threads);
+    printf(": %.0f iterations/second\n", its_per_second);
 }
 
 }  // namespace
@@ -127,6 +163,8 @@ int main(int argc, char** argv) {
         "  -s    run suite (ignores -S/-H/-Q)\n"
         "  -n N  set test repetition count to N (default: 1)\n"
         "  -d N  set test duration to N seconds (default: 5)\n"
+        "  -t N  run the test on N threads at once, each with its own channel\n"
+        "        (default: 1)\n"
         "  -S N  set message size to N bytes (default: 10)\n"
         "  -H N  set message handle count to N handles (default: 0)\n"
         "  -Q N  set message pre-queue count to N messages (default: 0)\n";
@@ -134,6 +172,7 @@ int main(int argc, char** argv) {
     bool run_suite = false;  // -o/-s
     uint32_t duration = 5;   // -d
     uint32_t repeats = 1;    // -n
+    uint32_t threads = 1;    // -t
     // Ignored when running a suite:
     TestArgs test_args = {
         10,                  // -S (size)
@@ -142,7 +181,7 @@ int main(int argc, char** argv) {
     };
 
     int opt;
-    while ((opt = getopt(argc, argv, "+hosn:d:S:H:Q:")) != -1) {
+    while ((opt = getopt(argc, argv, "+hosn:d:t:S:H:Q:")) != -1) {
         // Our option values are always unsigned numbers.
         uint32_t value = 0;
         if (optarg) {
@@ -172,6 +211,12 @@ int main(int argc, char** argv) {
                 assert(optarg);
                 duration = value;
                 break;
+            case 't':
+                assert(optarg);
+                if (value == 0u)
+                    argument_error(argv[0], "thread count must be at least 1");
+                threads = value;
+                break;
             case 'S':
                 assert(optarg);
                 test_args.size = value;
@@ -205,6 +250,8 @@ int main(int argc, char** argv) {
                 {10, 0, 0},
                 {100, 0, 0},
                 {1000, 0, 0},
+                {4000, 0, 0},
+                {16000, 0, 0},
                 {10, 1, 0},
                 {100, 1, 0},
                 {1000, 1, 0},
@@ -219,9 +266,9 @@ int main(int argc, char** argv) {
                 {1000, 0, 1},
             };
             for (size_t i = 0; i < fbl::count_of(suite); i++)
-                do_test(duration, suite[i]);
+                do_test(duration, threads, suite[i]);
         } else {
-            do_test(duration, test_args);
+            do_test(duration, threads, test_args);
         }
     }
 
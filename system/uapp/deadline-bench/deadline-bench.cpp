@@ -0,0 +1,212 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how often a periodic job misses its deadline while every cpu is
+// kept busy by cpu hogs, first with the job at the default priority and then
+// with the job in the deadline scheduling class.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <threads.h>
+#include <unistd.h>
+
+#include <fbl/vector.h>
+#include <lib/zx/handle.h>
+#include <lib/zx/resource.h>
+#include <zircon/device/sysinfo.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/profile.h>
+
+static constexpr uint32_t kDefaultPeriodMsec = 10;
+static constexpr uint32_t kDefaultWorkMsec = 2;
+static constexpr uint32_t kDefaultDurationSec = 5;
+
+static volatile bool quit_hogs;
+
+static zx_status_t get_root_resource(zx::resource* root_resource) {
+    int fd = open("/dev/misc/sysinfo", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: Cannot open sysinfo: %s (%d)\n",
+                strerror(errno), errno);
+        return ZX_ERR_NOT_FOUND;
+    }
+
+    zx_handle_t h;
+    ssize_t n = ioctl_sysinfo_get_root_resource(fd, &h);
+    close(fd);
+
+    if (n != sizeof(*root_resource)) {
+        fprintf(stderr, "ERROR: Cannot obtain root resource (%zd)\n", n);
+        return n < 0 ? static_cast<zx_status_t>(n) : ZX_ERR_NOT_FOUND;
+    }
+
+    root_resource->reset(h);
+    return ZX_OK;
+}
+
+static int hog_thread(void*) {
+    while (!quit_hogs) {
+    }
+    return 0;
+}
+
+// Spin until the calling thread has consumed |duration| of cpu time.
+static void do_work(zx_duration_t duration) {
+    zx_time_t end = zx_clock_get(ZX_CLOCK_THREAD) + duration;
+    while (zx_clock_get(ZX_CLOCK_THREAD) < end) {
+    }
+}
+
+struct JobResult {
+    uint32_t jobs;
+    uint32_t misses;
+    zx_duration_t worst_lateness;
+};
+
+struct JobArgs {
+    zx_handle_t profile;
+    zx_duration_t period;
+    zx_duration_t work;
+    zx_duration_t duration;
+    JobResult result;
+};
+
+// Release a job every period and check that it completes before the next one.
+static int job_thread(void* arg) {
+    auto* args = static_cast<JobArgs*>(arg);
+    args->result = {};
+
+    if (args->profile != ZX_HANDLE_INVALID) {
+        zx_status_t status = zx_object_set_profile(zx_thread_self(), args->profile, 0);
+        if (status != ZX_OK) {
+            fprintf(stderr, "ERROR: Cannot apply profile: %s\n", zx_status_get_string(status));
+            return -1;
+        }
+    }
+
+    zx_time_t release = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    zx_time_t end = release + args->duration;
+    while (release < end) {
+        do_work(args->work);
+
+        zx_time_t deadline = release + args->period;
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        args->result.jobs++;
+        if (now > deadline) {
+            args->result.misses++;
+            if (now - deadline > args->result.worst_lateness)
+                args->result.worst_lateness = now - deadline;
+
+            // skip the releases that were missed entirely
+            while (deadline < now)
+                deadline += args->period;
+        }
+
+        release = deadline;
+        zx_nanosleep(release);
+    }
+    return 0;
+}
+
+static bool run(const char* name, zx_handle_t profile, JobArgs* args, uint32_t num_hogs) {
+    quit_hogs = false;
+    fbl::Vector<thrd_t> hogs;
+    for (uint32_t i = 0; i < num_hogs; i++) {
+        thrd_t t;
+        if (thrd_create(&t, hog_thread, nullptr) != thrd_success) {
+            fprintf(stderr, "ERROR: Cannot create hog thread\n");
+            break;
+        }
+        hogs.push_back(t);
+    }
+
+    args->profile = profile;
+    thrd_t job;
+    int ret = -1;
+    if (thrd_create(&job, job_thread, args) == thrd_success)
+        thrd_join(job, &ret);
+
+    quit_hogs = true;
+    for (auto& t : hogs)
+        thrd_join(t, nullptr);
+
+    if (ret != 0)
+        return false;
+
+    printf("%-10s: %u jobs, %u missed (%.2f%%), worst lateness %.3f msec\n",
+           name, args->result.jobs, args->result.misses,
+           args->result.jobs ? 100.0 * args->result.misses / args->result.jobs : 0.0,
+           static_cast<double>(args->result.worst_lateness) / ZX_MSEC(1));
+    return true;
+}
+
+static void usage(const char* program_name) {
+    printf("usage: %s [period work] [duration]\n"
+           "  All arguments are positional and optional.\n"
+           "  period   : Period of the job in msec.  Default %u\n"
+           "  work     : Cpu time used by each job in msec.  Default %u\n"
+           "  duration : Seconds to run each configuration for.  Default %u\n",
+           program_name, kDefaultPeriodMsec, kDefaultWorkMsec, kDefaultDurationSec);
+}
+
+int main(int argc, char** argv) {
+    uint32_t period_msec = kDefaultPeriodMsec;
+    uint32_t work_msec = kDefaultWorkMsec;
+    uint32_t duration_sec = kDefaultDurationSec;
+
+    if (argc != 1 && argc != 3 && argc != 4) {
+        usage(argv[0]);
+        return -1;
+    }
+    if (argc >= 3) {
+        period_msec = static_cast<uint32_t>(atoi(argv[1]));
+        work_msec = static_cast<uint32_t>(atoi(argv[2]));
+    }
+    if (argc >= 4)
+        duration_sec = static_cast<uint32_t>(atoi(argv[3]));
+    if (work_msec == 0 || work_msec > period_msec || period_msec > 1000 || duration_sec == 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    zx::resource root_resource;
+    if (get_root_resource(&root_resource) != ZX_OK)
+        return -1;
+
+    JobArgs args = {};
+    args.period = ZX_MSEC(period_msec);
+    args.work = ZX_MSEC(work_msec);
+    args.duration = ZX_SEC(duration_sec);
+
+    // reserve a little more than the job needs to cover the loop itself
+    zx_profile_info_t info = {};
+    info.type = ZX_PROFILE_INFO_DEADLINE;
+    info.deadline.period = args.period;
+    info.deadline.capacity = args.work + args.work / 4;
+    if (info.deadline.capacity > info.deadline.period)
+        info.deadline.capacity = info.deadline.period;
+
+    zx::handle deadline;
+    zx_status_t status = zx_profile_create(root_resource.get(), &info,
+                                           deadline.reset_and_get_address());
+    if (status != ZX_OK) {
+        fprintf(stderr, "ERROR: Cannot create deadline profile: %s\n",
+                zx_status_get_string(status));
+        return -1;
+    }
+
+    uint32_t num_hogs = zx_system_get_num_cpus() * 2;
+    printf("period %u msec, work %u msec, %u cpu hogs, %u sec per run\n",
+           period_msec, work_msec, num_hogs, duration_sec);
+
+    if (!run("priority", ZX_HANDLE_INVALID, &args, num_hogs))
+        return -1;
+    if (!run("deadline", deadline.get(), &args, num_hogs))
+        return -1;
+    return 0;
+}
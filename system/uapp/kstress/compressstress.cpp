@@ -0,0 +1,278 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/unique_ptr.h>
+#include <fbl/vector.h>
+#include <lib/zx/event.h>
+#include <lib/zx/resource.h>
+#include <lib/zx/vmar.h>
+#include <lib/zx/vmo.h>
+#include <zircon/status.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/syscalls/system.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <threads.h>
+
+#include "stress_test.h"
+
+class CompressStressTest : public StressTest {
+public:
+    CompressStressTest() = default;
+    virtual ~CompressStressTest() = default;
+
+    virtual zx_status_t Start();
+    virtual zx_status_t Stop();
+
+private:
+    // A mapped vmo full of pages that compress well, along with the tag each
+    // page was last filled in with.
+    struct Region {
+        zx::vmo vmo;
+        uintptr_t addr;
+        fbl::unique_ptr<uint64_t[]> tags;
+    };
+
+    static constexpr size_t kRegionPages = 256;
+    static constexpr size_t kRegionSize = kRegionPages * PAGE_SIZE;
+
+    int stress_thread();
+    int status_thread();
+
+    zx_status_t AddRegion(fbl::Vector<Region>* regions);
+    void RemoveRegion(fbl::Vector<Region>* regions);
+
+    bool Signaled(const zx::event& event) const;
+
+    thrd_t threads_[8]{};
+    size_t num_threads_{};
+    thrd_t status_thread_{};
+
+    zx::resource root_resource_{};
+    zx::event warning_event_{};
+    zx::event critical_event_{};
+
+    // used by the worker threads at runtime
+    fbl::atomic<bool> shutdown_{false};
+    fbl::atomic<uint64_t> verified_pages_{0};
+};
+
+fbl::unique_ptr<StressTest> CreateCompressStressTest() {
+    return fbl::unique_ptr<StressTest>{new CompressStressTest()};
+}
+
+namespace {
+
+// Fill a page with a pattern that LZ4 squeezes down to a small fraction of
+// a page, but that is different for every tag, so that a page that comes
+// back wrong is caught.
+void FillPage(uint64_t* page, uint64_t tag) {
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        page[i] = (i % 8 == 0) ? tag : i % 61;
+    }
+}
+
+bool CheckPage(const uint64_t* page, uint64_t tag) {
+    for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+        if (page[i] != ((i % 8 == 0) ? tag : i % 61)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t RandomTag() {
+    // never zero, so that no page is all zeros
+    return (static_cast<uint64_t>(rand()) << 32 | rand()) | 1;
+}
+
+} // namespace
+
+// Compression Stresser
+//
+// Each worker thread keeps growing a set of mapped vmos full of compressible
+// data until the system reaches the warning memory pressure level, and gives
+// some back when it reaches the critical level. Meanwhile the threads read and
+// rewrite random pages, most of which have gone cold and been compressed by the
+// kernel, and check that every page holds what was last written to it.
+//
+// The amount of memory the kernel is holding compressed, and how long the
+// decompressions took, is printed every few seconds.
+
+zx_status_t CompressStressTest::AddRegion(fbl::Vector<Region>* regions) {
+    Region region;
+    zx_status_t status = zx::vmo::create(kRegionSize, 0, &region.vmo);
+    if (status != ZX_OK) {
+        return status;
+    }
+    status = zx::vmar::root_self().map(0, region.vmo, 0, kRegionSize,
+                                       ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE,
+                                       &region.addr);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    region.tags.reset(new uint64_t[kRegionPages]);
+    for (size_t i = 0; i < kRegionPages; i++) {
+        region.tags[i] = RandomTag();
+        FillPage(reinterpret_cast<uint64_t*>(region.addr + i * PAGE_SIZE), region.tags[i]);
+    }
+
+    regions->push_back(fbl::move(region));
+    return ZX_OK;
+}
+
+void CompressStressTest::RemoveRegion(fbl::Vector<Region>* regions) {
+    Region region = regions->erase(rand() % regions->size());
+    zx::vmar::root_self().unmap(region.addr, kRegionSize);
+}
+
+bool CompressStressTest::Signaled(const zx::event& event) const {
+    return event.wait_one(ZX_EVENT_SIGNALED, zx::time(), nullptr) == ZX_OK;
+}
+
+int CompressStressTest::stress_thread() {
+    fbl::Vector<Region> regions;
+
+    while (!shutdown_.load()) {
+        if (Signaled(critical_event_)) {
+            // back off before the OOM thread starts killing processes
+            if (!regions.is_empty()) {
+                Printf("-");
+                RemoveRegion(&regions);
+            }
+        } else if (!Signaled(warning_event_)) {
+            Printf("+");
+            zx_status_t status = AddRegion(&regions);
+            if (status != ZX_OK) {
+                fprintf(stderr, "failed to add region, error %d (%s)\n",
+                        status, zx_status_get_string(status));
+            }
+        }
+
+        // touch a few random pages, leaving the rest to go cold
+        for (int i = 0; i < 16 && !regions.is_empty(); i++) {
+            Region& region = regions[rand() % regions.size()];
+            size_t page = rand() % kRegionPages;
+            auto ptr = reinterpret_cast<uint64_t*>(region.addr + page * PAGE_SIZE);
+
+            if (!CheckPage(ptr, region.tags[page])) {
+                PrintfAlways("page %zu of vmo at %#" PRIxPTR " is corrupt\n", page, region.addr);
+                abort();
+            }
+            verified_pages_.fetch_add(1);
+
+            if (rand() % 10 == 0) {
+                region.tags[page] = RandomTag();
+                FillPage(ptr, region.tags[page]);
+            }
+        }
+
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+    }
+
+    while (!regions.is_empty()) {
+        RemoveRegion(&regions);
+    }
+
+    return 0;
+}
+
+int CompressStressTest::status_thread() {
+    while (!shutdown_.load()) {
+        zx_nanosleep(zx_deadline_after(ZX_SEC(5)));
+
+        zx_info_kmem_compression_stats_t stats;
+        zx_status_t status = root_resource_.get_info(ZX_INFO_KMEM_COMPRESSION_STATS, &stats,
+                                                     sizeof(stats), nullptr, nullptr);
+        if (status != ZX_OK) {
+            fprintf(stderr, "ZX_INFO_KMEM_COMPRESSION_STATS returns %d (%s)\n",
+                    status, zx_status_get_string(status));
+            return 0;
+        }
+
+        const char* level = Signaled(critical_event_) ? "critical"
+                            : Signaled(warning_event_) ? "warning" : "normal";
+        PrintfAlways("\ncompress stress: pressure %s, %" PRIu64 " pages verified\n",
+                     level, verified_pages_.load());
+        PrintfAlways("  %" PRIu64 "MB compressed into %" PRIu64 "KB, %" PRIu64
+                     " compressions (%" PRIu64 " failed), %" PRIu64 " decompressions\n",
+                     stats.uncompressed_bytes / (1024 * 1024), stats.compressed_bytes / 1024,
+                     stats.compressions, stats.failed_compressions, stats.decompressions);
+        PrintfAlways("  decompress latency:");
+        for (uint32_t i = 0; i < ZX_INFO_KMEM_COMPRESSION_LATENCY_BUCKETS; i++) {
+            if (stats.decompress_latency[i] == 0) {
+                continue;
+            }
+            if (i == ZX_INFO_KMEM_COMPRESSION_LATENCY_BUCKETS - 1) {
+                PrintfAlways(" >=%" PRIu64 "us:%" PRIu64, uint64_t{1} << (i - 1),
+                             stats.decompress_latency[i]);
+            } else {
+                PrintfAlways(" <%" PRIu64 "us:%" PRIu64, uint64_t{1} << i,
+                             stats.decompress_latency[i]);
+            }
+        }
+        PrintfAlways("\n");
+    }
+
+    return 0;
+}
+
+zx_status_t CompressStressTest::Start() {
+    zx_status_t status = get_root_resource(&root_resource_);
+    if (status != ZX_OK) {
+        return status;
+    }
+
+    zx_handle_t h;
+    status = zx_system_get_event(root_resource_.get(),
+                                 ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING, &h);
+    if (status != ZX_OK) {
+        return status;
+    }
+    warning_event_.reset(h);
+    status = zx_system_get_event(root_resource_.get(),
+                                 ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL, &h);
+    if (status != ZX_OK) {
+        return status;
+    }
+    critical_event_.reset(h);
+
+    PrintfAlways("compression stress test: filling memory up to the warning level\n");
+
+    auto worker = [](void* arg) -> int {
+        CompressStressTest* test = static_cast<CompressStressTest*>(arg);
+
+        return test->stress_thread();
+    };
+    num_threads_ = fbl::min<size_t>(num_cpus_, fbl::count_of(threads_));
+    for (size_t i = 0; i < num_threads_; i++) {
+        thrd_create_with_name(&threads_[i], worker, this, "compressstress_worker");
+    }
+
+    auto status_worker = [](void* arg) -> int {
+        CompressStressTest* test = static_cast<CompressStressTest*>(arg);
+
+        return test->status_thread();
+    };
+    thrd_create_with_name(&status_thread_, status_worker, this, "compressstress_status");
+
+    return ZX_OK;
+}
+
+zx_status_t CompressStressTest::Stop() {
+    shutdown_.store(true);
+
+    for (size_t i = 0; i < num_threads_; i++) {
+        thrd_join(threads_[i], nullptr);
+    }
+    thrd_join(status_thread_, nullptr);
+
+    return ZX_OK;
+}
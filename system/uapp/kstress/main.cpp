@@ -22,8 +22,6 @@
 
 #include "stress_test.h"
 
-namespace {
-
 zx_status_t get_root_resource(zx::resource* root_resource) {
     int fd = open("/dev/misc/sysinfo", O_RDWR);
     if (fd < 0) {
@@ -53,6 +51,8 @@ zx_status_t get_root_resource(zx::resource* root_resource) {
     return ZX_OK;
 }
 
+namespace {
+
 zx_status_t get_kmem_stats(zx_info_kmem_stats_t* kmem_stats) {
     zx::resource root_resource;
     zx_status_t ret = get_root_resource(&root_resource);
@@ -73,9 +73,11 @@ zx_status_t get_kmem_stats(zx_info_kmem_stats_t* kmem_stats) {
 
 void print_help(char** argv, FILE* f) {
     fprintf(f, "Usage: %s [options]\n", argv[0]);
-    fprintf(f, "No options currently defined\n");
     fprintf(f, "options:\n");
     fprintf(f, "\t-h:           This help\n");
+    fprintf(f, "\t-t <test>:    test to run, one of:\n");
+    fprintf(f, "\t              vm: random operations on a single vmo (default)\n");
+    fprintf(f, "\t              compress: memory pressure and page compression\n");
     fprintf(f, "\t-v:           verbose, status output\n");
 }
 
@@ -85,13 +87,17 @@ int main(int argc, char** argv) {
     zx_status_t status;
 
     bool verbose = false;
+    const char* test_name = "vm";
 
     int c;
-    while ((c = getopt(argc, argv, "hv")) > 0) {
+    while ((c = getopt(argc, argv, "ht:v")) > 0) {
         switch (c) {
         case 'h':
             print_help(argv, stdout);
             return 0;
+        case 't':
+            test_name = optarg;
+            break;
         case 'v':
             verbose = true;
             break;
@@ -116,7 +122,16 @@ int main(int argc, char** argv) {
     //
     // TODO: allow selecting more than one test and the timeout
     {
-        auto test = CreateVmStressTest();
+        fbl::unique_ptr<StressTest> test;
+        if (!strcmp(test_name, "vm")) {
+            test = CreateVmStressTest();
+        } else if (!strcmp(test_name, "compress")) {
+            test = CreateCompressStressTest();
+        } else {
+            fprintf(stderr, "Unknown test %s\n", test_name);
+            print_help(argv, stderr);
+            return 1;
+        }
         if (!test) {
             fprintf(stderr, "error creating test\n");
             return 1;
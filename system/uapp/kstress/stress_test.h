@@ -9,6 +9,7 @@
 #include <fbl/intrusive_single_list.h>
 #include <fbl/macros.h>
 #include <fbl/unique_ptr.h>
+#include <lib/zx/resource.h>
 #include <zircon/status.h>
 #include <zircon/syscalls/object.h>
 
@@ -68,5 +69,9 @@ protected:
     uint32_t num_cpus_{};
 };
 
+// fetches the root resource, for tests that need it
+zx_status_t get_root_resource(zx::resource* root_resource);
+
 // factories for local tests
 fbl::unique_ptr<StressTest> CreateVmStressTest();
+fbl::unique_ptr<StressTest> CreateCompressStressTest();
@@ -0,0 +1,437 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <zircon/device/ktrace.h>
+#include <zircon/ktrace.h>
+#include <zircon/syscalls.h>
+
+// The kernel keeps a trace buffer per CPU, so a trace comes out as one
+// block of records per CPU.  This tool merges the blocks back into a single
+// timeline, in the version 2 layout that trace viewers read.
+
+// A run of records.
+typedef struct block {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} block_t;
+
+static int usage(const char* cmd) {
+    fprintf(stderr,
+            "Control kernel tracing:\n"
+            "   %s start [-c] [<grpmask>]               Start tracing, overwriting\n"
+            "                                           the oldest records with -c\n"
+            "   %s stop                                 Stop tracing\n"
+            "   %s save <file>                          Save the trace\n"
+            "   %s stream [-t <secs>] [<grpmask>] <file>\n"
+            "                                           Trace until stopped, or for\n"
+            "                                           <secs> seconds, draining the\n"
+            "                                           buffers as they fill up\n",
+            cmd, cmd, cmd, cmd);
+    return -1;
+}
+
+static zx_handle_t get_root_resource(void) {
+    int fd = open("/dev/misc/ktrace", O_RDWR);
+    if (fd < 0) {
+        fprintf(stderr, "cannot open trace device\n");
+        return ZX_HANDLE_INVALID;
+    }
+    zx_handle_t root;
+    ssize_t n = ioctl_ktrace_get_handle(fd, &root);
+    close(fd);
+    if (n < 0) {
+        fprintf(stderr, "cannot get ktrace handle\n");
+        return ZX_HANDLE_INVALID;
+    }
+    return root;
+}
+
+static uint32_t parse_grpmask(const char* arg) {
+    return arg ? (uint32_t)strtoul(arg, NULL, 0) : KTRACE_GRP_ALL;
+}
+
+static bool block_append(block_t* b, const void* data, size_t size) {
+    if (b->size + size > b->capacity) {
+        size_t capacity = b->capacity ? b->capacity : 65536;
+        while (capacity < b->size + size) {
+            capacity *= 2;
+        }
+        uint8_t* p = realloc(b->data, capacity);
+        if (p == NULL) {
+            return false;
+        }
+        b->data = p;
+        b->capacity = capacity;
+    }
+    memcpy(b->data + b->size, data, size);
+    b->size += size;
+    return true;
+}
+
+static bool is_pad(uint32_t tag) {
+    return (tag & ~0xFu) == (TAG_PAD(8) & ~0xFu);
+}
+
+// Returns the length of the record at |pos|, or 0 if there isn't a whole
+// one.
+static size_t record_len(const block_t* b, size_t pos) {
+    if (b->size - pos < sizeof(uint32_t)) {
+        return 0;
+    }
+    uint32_t tag;
+    memcpy(&tag, b->data + pos, sizeof(tag));
+    size_t len = KTRACE_LEN(tag);
+    return (len == 0 || len > b->size - pos) ? 0 : len;
+}
+
+static size_t skip_pads(const block_t* b, size_t pos) {
+    size_t len;
+    while ((len = record_len(b, pos)) != 0 && is_pad(*(const uint32_t*)(b->data + pos))) {
+        pos += len;
+    }
+    return pos;
+}
+
+// Writes the version and ticks records that a trace starts with.
+static void write_preamble(FILE* f, uint64_t ticks_per_ms) {
+    ktrace_rec_32b_t recs[2] = {};
+    recs[0].tag = TAG_VERSION;
+    recs[0].a = 0x00020000;
+    recs[1].tag = TAG_TICKS_PER_MS;
+    recs[1].a = (uint32_t)ticks_per_ms;
+    recs[1].b = (uint32_t)(ticks_per_ms >> 32);
+    fwrite(recs, sizeof(recs), 1, f);
+}
+
+// Writes the names in |meta|.
+static void write_names(FILE* f, const block_t* meta) {
+    size_t len;
+    for (size_t pos = 0; (len = record_len(meta, pos)) != 0; pos += len) {
+        if (!is_pad(*(const uint32_t*)(meta->data + pos))) {
+            fwrite(meta->data + pos, len, 1, f);
+        }
+    }
+}
+
+// Writes the records of the |num_cpus| blocks in |cpus| that come before
+// |limit|, in timestamp order, starting at and advancing |pos|.
+static void write_records(FILE* f, const block_t* cpus, size_t* pos, size_t num_cpus,
+                          uint64_t limit) {
+    for (;;) {
+        size_t next = num_cpus;
+        uint64_t next_ts = limit;
+        for (size_t i = 0; i < num_cpus; i++) {
+            pos[i] = skip_pads(&cpus[i], pos[i]);
+            if (record_len(&cpus[i], pos[i]) < sizeof(ktrace_header_t)) {
+                continue;
+            }
+            const ktrace_header_t* hdr = (const ktrace_header_t*)(cpus[i].data + pos[i]);
+            if (hdr->ts < next_ts) {
+                next = i;
+                next_ts = hdr->ts;
+            }
+        }
+        if (next == num_cpus) {
+            break;
+        }
+        size_t len = record_len(&cpus[next], pos[next]);
+        fwrite(cpus[next].data + pos[next], len, 1, f);
+        pos[next] += len;
+    }
+}
+
+// Writes the names from |meta| and the records of the |num_cpus| blocks in
+// |cpus|, in timestamp order.
+static int write_trace(FILE* f, uint64_t ticks_per_ms, const block_t* meta,
+                       const block_t* cpus, size_t num_cpus) {
+    write_preamble(f, ticks_per_ms);
+    write_names(f, meta);
+
+    size_t* pos = calloc(num_cpus, sizeof(size_t));
+    if (pos == NULL && num_cpus > 0) {
+        return -1;
+    }
+    write_records(f, cpus, pos, num_cpus, UINT64_MAX);
+    free(pos);
+    return ferror(f) ? -1 : 0;
+}
+
+// Returns the timestamp of the last record in |b|, or 0 if it has none.
+static uint64_t last_ts(const block_t* b) {
+    uint64_t ts = 0;
+    size_t len;
+    for (size_t pos = 0; (len = record_len(b, pos)) != 0; pos += len) {
+        if (!is_pad(*(const uint32_t*)(b->data + pos)) && len >= sizeof(ktrace_header_t)) {
+            ts = ((const ktrace_header_t*)(b->data + pos))->ts;
+        }
+    }
+    return ts;
+}
+
+// Drops the first |pos| bytes of |b|.
+static void block_consume(block_t* b, size_t pos) {
+    memmove(b->data, b->data + pos, b->size - pos);
+    b->size -= pos;
+}
+
+static int save(zx_handle_t root, const char* path) {
+    size_t size;
+    zx_status_t status = zx_ktrace_read(root, NULL, 0, 0, &size);
+    if (status != ZX_OK) {
+        fprintf(stderr, "cannot read trace: %d\n", status);
+        return -1;
+    }
+
+    block_t all = {};
+    if (size > 0 && (all.data = malloc(size)) == NULL) {
+        fprintf(stderr, "out of memory\n");
+        return -1;
+    }
+    while (all.size < size) {
+        size_t actual;
+        status = zx_ktrace_read(root, all.data + all.size, (uint32_t)all.size,
+                                size - all.size, &actual);
+        if (status != ZX_OK || actual == 0) {
+            break;
+        }
+        all.size += actual;
+    }
+
+    // The version and ticks records, the names, and then each CPU's block.
+    uint64_t ticks_per_ms = 0;
+    block_t meta = {};
+    block_t* cpus = NULL;
+    size_t num_cpus = 0;
+    size_t len;
+    for (size_t pos = 0; (len = record_len(&all, pos)) != 0; pos += len) {
+        const ktrace_rec_32b_t* rec = (const ktrace_rec_32b_t*)(all.data + pos);
+        if (rec->tag == TAG_TICKS_PER_MS) {
+            ticks_per_ms = rec->a | ((uint64_t)rec->b << 32);
+        } else if (rec->tag == TAG_CPU_BUFFER) {
+            block_t* p;
+            if (rec->b > all.size - pos - len ||
+                (p = realloc(cpus, (num_cpus + 1) * sizeof(block_t))) == NULL) {
+                break;
+            }
+            cpus = p;
+            cpus[num_cpus].data = all.data + pos + len;
+            cpus[num_cpus].size = rec->b;
+            num_cpus++;
+            if (rec->c) {
+                printf("cpu %u dropped %u records\n", rec->a, rec->c);
+            }
+            pos += rec->b;
+        } else if (rec->tag != TAG_VERSION) {
+            if (meta.data == NULL) {
+                meta.data = all.data + pos;
+            }
+            meta.size = all.data + pos + len - meta.data;
+        }
+    }
+
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        free(cpus);
+        free(all.data);
+        return -1;
+    }
+    int r = write_trace(f, ticks_per_ms, &meta, cpus, num_cpus);
+    fclose(f);
+    free(cpus);
+    free(all.data);
+    return r;
+}
+
+static int stream(zx_handle_t root, uint32_t grpmask, zx_duration_t duration, const char* path) {
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return -1;
+    }
+
+    zx_handle_t vmo, event;
+    zx_status_t status = zx_ktrace_stream(root, grpmask, &vmo, &event);
+    if (status != ZX_OK) {
+        fprintf(stderr, "cannot start streaming: %d\n", status);
+        fclose(f);
+        return -1;
+    }
+    uint64_t size;
+    uintptr_t addr;
+    if ((status = zx_vmo_get_size(vmo, &size)) != ZX_OK ||
+        (status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, size,
+                              ZX_VM_FLAG_PERM_READ, &addr)) != ZX_OK) {
+        fprintf(stderr, "cannot map trace buffers: %d\n", status);
+        zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+        fclose(f);
+        return -1;
+    }
+
+    const volatile ktrace_stream_header_t* header = (const volatile ktrace_stream_header_t*)addr;
+    ktrace_buffer_info_t* info = (ktrace_buffer_info_t*)(header + 1);
+    const uint32_t num_buffers = header->num_buffers;
+    const uint32_t num_cpus = num_buffers - 1;
+    block_t* blocks = calloc(num_buffers, sizeof(block_t));
+    uint64_t* consumed = calloc(num_buffers, sizeof(uint64_t));
+    uint64_t* latest = calloc(num_cpus, sizeof(uint64_t));
+    size_t* pos = calloc(num_cpus, sizeof(size_t));
+    if (blocks == NULL || consumed == NULL || latest == NULL || pos == NULL) {
+        fprintf(stderr, "out of memory\n");
+        zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+        fclose(f);
+        return -1;
+    }
+    write_preamble(f, header->ticks_per_ms);
+
+    // Each CPU's records are in timestamp order, so once a record from every
+    // CPU has been seen, everything older than the oldest of those can be
+    // merged and written out.  A CPU that had nothing new to drain can't add
+    // anything from before the previous drain either, since its records
+    // become visible as soon as they are written.
+    zx_ticks_t last_drain = zx_ticks_get();
+
+    printf("streaming to %s, stop with: ktrace stop\n", path);
+    zx_time_t deadline = duration ? zx_deadline_after(duration) : ZX_TIME_INFINITE;
+    for (bool done = false; !done;) {
+        status = zx_object_wait_one(event, ZX_EVENT_SIGNALED, deadline, NULL);
+        if (status == ZX_ERR_TIMED_OUT) {
+            zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+        } else if (status != ZX_OK) {
+            fprintf(stderr, "cannot wait for the trace: %d\n", status);
+            zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+        }
+        // Whatever was written before tracing stopped is drained below.
+        done = header->stopped != 0;
+
+        for (uint32_t i = 0; i < num_buffers; i++) {
+            const uint8_t* data = (const uint8_t*)addr + info[i].offset;
+            uint64_t head = __atomic_load_n(&info[i].head, __ATOMIC_ACQUIRE);
+            const uint64_t start = consumed[i];
+            while (consumed[i] < head) {
+                uint64_t offset = consumed[i] % info[i].size;
+                uint64_t n = head - consumed[i];
+                if (n > info[i].size - offset) {
+                    n = info[i].size - offset;
+                }
+                if (!block_append(&blocks[i], data + offset, n)) {
+                    fprintf(stderr, "out of memory\n");
+                    zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+                    done = true;
+                    break;
+                }
+                consumed[i] += n;
+            }
+            if (i > 0) {
+                uint64_t ts = consumed[i] != start ? last_ts(&blocks[i]) : (uint64_t)last_drain;
+                if (ts > latest[i - 1]) {
+                    latest[i - 1] = ts;
+                }
+            }
+        }
+        zx_ktrace_control(root, KTRACE_ACTION_CONSUME, num_buffers, consumed);
+
+        write_names(f, &blocks[0]);
+        blocks[0].size = 0;
+
+        // Once tracing has stopped, everything that is left goes out.
+        uint64_t limit = UINT64_MAX;
+        if (!done) {
+            for (uint32_t i = 0; i < num_cpus; i++) {
+                if (latest[i] < limit) {
+                    limit = latest[i];
+                }
+            }
+        }
+        write_records(f, blocks + 1, pos, num_cpus, limit);
+        for (uint32_t i = 0; i < num_cpus; i++) {
+            block_consume(&blocks[i + 1], pos[i]);
+            pos[i] = 0;
+        }
+        if (ferror(f)) {
+            fprintf(stderr, "cannot write %s\n", path);
+            zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL);
+            done = true;
+        }
+        last_drain = zx_ticks_get();
+    }
+
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        if (info[i].dropped) {
+            printf("%s %u dropped %" PRIu64 " records\n", i ? "cpu" : "names",
+                   i ? i - 1 : 0, info[i].dropped);
+        }
+    }
+    int r = ferror(f) ? -1 : 0;
+    fclose(f);
+    for (uint32_t i = 0; i < num_buffers; i++) {
+        free(blocks[i].data);
+    }
+    free(blocks);
+    free(consumed);
+    free(latest);
+    free(pos);
+    zx_vmar_unmap(zx_vmar_root_self(), addr, size);
+    zx_handle_close(vmo);
+    zx_handle_close(event);
+    return r;
+}
+
+int main(int argc, char** argv) {
+    const char* cmd = argv[0];
+    if (argc < 2) {
+        return usage(cmd);
+    }
+
+    zx_handle_t root = get_root_resource();
+    if (root == ZX_HANDLE_INVALID) {
+        return -1;
+    }
+
+    zx_status_t status;
+    if (!strcmp(argv[1], "start")) {
+        uint32_t action = KTRACE_ACTION_START;
+        int i = 2;
+        if (i < argc && !strcmp(argv[i], "-c")) {
+            action = KTRACE_ACTION_START_CIRCULAR;
+            i++;
+        }
+        if ((status = zx_ktrace_control(root, action, parse_grpmask(i < argc ? argv[i] : NULL),
+                                        NULL)) != ZX_OK) {
+            fprintf(stderr, "cannot start tracing: %d\n", status);
+            return -1;
+        }
+        return 0;
+    } else if (!strcmp(argv[1], "stop")) {
+        if ((status = zx_ktrace_control(root, KTRACE_ACTION_STOP, 0, NULL)) != ZX_OK) {
+            fprintf(stderr, "cannot stop tracing: %d\n", status);
+            return -1;
+        }
+        return 0;
+    } else if (!strcmp(argv[1], "save") && argc == 3) {
+        return save(root, argv[2]);
+    } else if (!strcmp(argv[1], "stream")) {
+        zx_duration_t duration = 0;
+        int i = 2;
+        if (i + 1 < argc && !strcmp(argv[i], "-t")) {
+            duration = ZX_SEC(strtoul(argv[i + 1], NULL, 0));
+            i += 2;
+        }
+        if (argc - i == 1) {
+            return stream(root, KTRACE_GRP_ALL, duration, argv[i]);
+        } else if (argc - i == 2) {
+            return stream(root, parse_grpmask(argv[i]), duration, argv[i + 1]);
+        }
+    }
+    return usage(cmd);
+}
@@ -6,6 +6,7 @@
 #include <zircon/status.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/exception.h>
+#include <zircon/syscalls/kcounter.h>
 #include <zircon/syscalls/object.h>
 #include <pretty/sizes.h>
 
@@ -89,6 +90,161 @@ static zx_status_t cpustats(zx_handle_t root_resource, zx_time_t delay) {
     return ZX_OK;
 }
 
+// Returns the upper bound of the histogram bucket that the |pct| percentile
+// of the values counted in |hist| falls into, or 0 if nothing was counted.
+static uint64_t hist_percentile(const uint64_t* hist, uint64_t total, unsigned int pct) {
+    if (total == 0)
+        return 0;
+    uint64_t target = (total * pct + 99) / 100;
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < ZX_INFO_CPU_SCHED_STATS_BUCKETS - 1; i++) {
+        seen += hist[i];
+        if (seen >= target)
+            return UINT64_C(1) << i;
+    }
+    return UINT64_MAX;
+}
+
+static void print_percentile(uint64_t bound) {
+    if (bound == UINT64_MAX) {
+        printf("  >=%5" PRIu64,
+               UINT64_C(1) << (ZX_INFO_CPU_SCHED_STATS_BUCKETS - 2));
+    } else {
+        printf("  <%6" PRIu64, bound);
+    }
+}
+
+static zx_status_t schedstats(zx_handle_t root_resource) {
+    static zx_info_cpu_sched_stats_t old_stats[MAX_CPUS];
+    zx_info_cpu_sched_stats_t stats[MAX_CPUS];
+
+    size_t actual, avail;
+    zx_status_t err = zx_object_get_info(root_resource, ZX_INFO_CPU_SCHED_STATS,
+                                         &stats, sizeof(stats), &actual, &avail);
+    if (err != ZX_OK) {
+        fprintf(stderr, "ZX_INFO_CPU_SCHED_STATS returns %d (%s)\n",
+                err, zx_status_get_string(err));
+        return err;
+    }
+
+    if (actual < avail) {
+        fprintf(stderr, "WARNING: actual cpus reported %zu less than available cpus %zu\n",
+                actual, avail);
+    }
+
+    printf("cpu  rq"
+           "   invol  migr  xllc"
+           " wake (p50     p99)"
+           "  run (p50     p99)\n");
+    for (size_t i = 0; i < actual; i++) {
+        uint64_t wakeup[ZX_INFO_CPU_SCHED_STATS_BUCKETS];
+        uint64_t run[ZX_INFO_CPU_SCHED_STATS_BUCKETS];
+        uint64_t wakeups = 0, runs = 0;
+        for (uint32_t b = 0; b < ZX_INFO_CPU_SCHED_STATS_BUCKETS; b++) {
+            wakeup[b] = stats[i].wakeup_latency[b] - old_stats[i].wakeup_latency[b];
+            run[b] = stats[i].run_time[b] - old_stats[i].run_time[b];
+            wakeups += wakeup[b];
+            runs += run[b];
+        }
+
+        printf("%3zu %3u %7" PRIu64 " %5" PRIu64 " %5" PRIu64 "     ",
+               i, stats[i].run_queue_len,
+               stats[i].involuntary_switches - old_stats[i].involuntary_switches,
+               stats[i].migrations - old_stats[i].migrations,
+               stats[i].migrations_cross_llc - old_stats[i].migrations_cross_llc);
+        print_percentile(hist_percentile(wakeup, wakeups, 50));
+        print_percentile(hist_percentile(wakeup, wakeups, 99));
+        printf("     ");
+        print_percentile(hist_percentile(run, runs, 50));
+        print_percentile(hist_percentile(run, runs, 99));
+        printf("\n");
+
+        old_stats[i] = stats[i];
+    }
+
+    return ZX_OK;
+}
+
+// Prints what changed in the kernel counters and histograms since the last
+// call, or everything that is not zero on the first call.
+static zx_status_t kcounterstats(zx_handle_t root_resource) {
+    static void* old_snapshot;
+
+    zx_handle_t vmo;
+    zx_status_t err = zx_kcounter_snapshot(root_resource, 0, &vmo);
+    if (err != ZX_OK) {
+        fprintf(stderr, "zx_kcounter_snapshot returns %d (%s)\n",
+                err, zx_status_get_string(err));
+        return err;
+    }
+    uint64_t size;
+    err = zx_vmo_get_size(vmo, &size);
+    void* snapshot = err == ZX_OK ? malloc(size) : NULL;
+    if (snapshot == NULL) {
+        zx_handle_close(vmo);
+        return err != ZX_OK ? err : ZX_ERR_NO_MEMORY;
+    }
+    err = zx_vmo_read(vmo, snapshot, 0, size);
+    zx_handle_close(vmo);
+    if (err != ZX_OK) {
+        fprintf(stderr, "zx_vmo_read returns %d (%s)\n", err, zx_status_get_string(err));
+        free(snapshot);
+        return err;
+    }
+
+    const zx_kcounter_snapshot_header_t* header = snapshot;
+    if (header->magic != ZX_KCOUNTER_SNAPSHOT_MAGIC ||
+        header->version != ZX_KCOUNTER_SNAPSHOT_VERSION ||
+        header->histogram_buckets != ZX_KCOUNTER_HISTOGRAM_BUCKETS) {
+        fprintf(stderr, "unknown kcounter snapshot layout\n");
+        free(snapshot);
+        return ZX_ERR_NOT_SUPPORTED;
+    }
+    const zx_kcounter_t* counters = (const void*)(header + 1);
+    const zx_kcounter_histogram_t* histograms =
+        (const void*)(counters + header->counter_count);
+
+    // The set of counters is fixed when the kernel is built, so the entries
+    // of two snapshots line up.
+    const zx_kcounter_snapshot_header_t* old_header = old_snapshot;
+    const zx_kcounter_t* old_counters = NULL;
+    const zx_kcounter_histogram_t* old_histograms = NULL;
+    if (old_header != NULL) {
+        old_counters = (const void*)(old_header + 1);
+        old_histograms = (const void*)(old_counters + old_header->counter_count);
+    }
+
+    for (uint32_t i = 0; i < header->counter_count; i++) {
+        int64_t delta = counters[i].value - (old_counters ? old_counters[i].value : 0);
+        if (delta != 0)
+            printf("%-48s %12" PRId64 "\n", counters[i].name, delta);
+    }
+    for (uint32_t i = 0; i < header->histogram_count; i++) {
+        bool any = false;
+        for (uint32_t b = 0; b < ZX_KCOUNTER_HISTOGRAM_BUCKETS; b++) {
+            int64_t delta = histograms[i].buckets[b] -
+                            (old_histograms ? old_histograms[i].buckets[b] : 0);
+            if (delta == 0)
+                continue;
+            if (!any) {
+                printf("%s:", histograms[i].name);
+                any = true;
+            }
+            if (b == ZX_KCOUNTER_HISTOGRAM_BUCKETS - 1) {
+                printf(" >=%" PRIu64 ":%" PRId64, UINT64_C(1) << (b - 1), delta);
+            } else {
+                printf(" <%" PRIu64 ":%" PRId64, UINT64_C(1) << b, delta);
+            }
+        }
+        if (any)
+            printf("\n");
+    }
+
+    free(old_snapshot);
+    old_snapshot = snapshot;
+    return ZX_OK;
+}
+
 static void print_mem_stat(const char* label, size_t bytes) {
     char buf[MAX_FORMAT_SIZE_LEN];
     const char unit = 'M';
@@ -152,6 +308,8 @@ static void print_help(FILE* f) {
     fprintf(f, "Options:\n");
     fprintf(f, " -c              Print system CPU stats\n");
     fprintf(f, " -m              Print system memory stats\n");
+    fprintf(f, " -s              Print scheduler latency stats\n");
+    fprintf(f, " -k              Print changes in kernel counters and histograms\n");
     fprintf(f, " -d <delay>      Delay in seconds (default 1 second)\n");
     fprintf(f, " -n <times>      Run this many times and then exit\n");
     fprintf(f, " -t              Print timestamp for each report\n");
@@ -174,17 +332,27 @@ static void print_help(FILE* f) {
     fprintf(f, "\tipi (rs  gen): inter-processor-interrupts\n");
     fprintf(f, "\t\trs:     reschedule events\n");
     fprintf(f, "\t\tgen:    generic interprocessor interrupts\n");
+    fprintf(f, "\nScheduler stats columns:\n");
+    fprintf(f, "\tcpu:   cpu #\n");
+    fprintf(f, "\trq:    threads in the run queue now\n");
+    fprintf(f, "\tinvol: involuntary context switches\n");
+    fprintf(f, "\tmigr:  threads migrated to this cpu\n");
+    fprintf(f, "\txllc:  migrations from a cpu with another last level cache\n");
+    fprintf(f, "\twake (p50 p99): bounds in us of the time woken threads waited to run\n");
+    fprintf(f, "\trun (p50 p99):  bounds in us of the time threads ran before switching\n");
 }
 
 int main(int argc, char** argv) {
     bool cpu_stats = false;
     bool mem_stats = false;
+    bool sched_stats = false;
+    bool kcounter_stats = false;
     zx_time_t delay = ZX_SEC(1);
     int num_loops = -1;
     bool timestamp = false;
 
     int c;
-    while ((c = getopt(argc, argv, "cd:n:hmt")) > 0) {
+    while ((c = getopt(argc, argv, "cd:n:hkmst")) > 0) {
         switch (c) {
             case 'c':
                 cpu_stats = true;
@@ -208,9 +376,15 @@ int main(int argc, char** argv) {
             case 'h':
                 print_help(stdout);
                 return 0;
+            case 'k':
+                kcounter_stats = true;
+                break;
             case 'm':
                 mem_stats = true;
                 break;
+            case 's':
+                sched_stats = true;
+                break;
             case 't':
                 timestamp = true;
                 break;
@@ -221,7 +395,7 @@ int main(int argc, char** argv) {
         }
     }
 
-    if (!cpu_stats && !mem_stats) {
+    if (!cpu_stats && !mem_stats && !sched_stats && !kcounter_stats) {
         fprintf(stderr, "No statistics selected\n");
         print_help(stderr);
         return 1;
@@ -258,6 +432,12 @@ int main(int argc, char** argv) {
         if (mem_stats) {
             ret |= memstats(root_resource);
         }
+        if (sched_stats) {
+            ret |= schedstats(root_resource);
+        }
+        if (kcounter_stats) {
+            ret |= kcounterstats(root_resource);
+        }
 
         if (ret != ZX_OK)
             break;
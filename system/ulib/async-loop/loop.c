@@ -12,6 +12,7 @@
 #include <zircon/listnode.h>
 #include <zircon/syscalls.h>
 #include <zircon/syscalls/hypervisor.h>
+#include <zircon/syscalls/port.h>
 
 #include <lib/async/receiver.h>
 #include <lib/async/task.h>
@@ -51,6 +52,14 @@ typedef struct thread_record {
     thrd_t thread;
 } thread_record_t;
 
+// A wait whose packet has been read from the port by async_loop_run_once()
+// but not yet dispatched. Lives on the stack of the dispatching thread.
+typedef struct dequeued_wait {
+    list_node_t node;
+    async_wait_t* wait;
+    bool canceled; // set once the wait has been canceled; skip its packet
+} dequeued_wait_t;
+
 const async_loop_config_t kAsyncLoopConfigMakeDefault = {
     .make_default_for_current_thread = true};
 
@@ -69,9 +78,13 @@ typedef struct async_loop {
     list_node_t task_list; // pending tasks, earliest deadline first
     list_node_t due_list; // due tasks, earliest deadline first
     list_node_t thread_list; // earliest created thread first
+    list_node_t dequeued_list; // waits read from the port but not dispatched
 } async_loop_t;
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline);
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline, bool once);
+static bool async_loop_claim_wait(async_loop_t* loop, dequeued_wait_t* dequeued);
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet);
 static zx_status_t async_loop_dispatch_wait(async_loop_t* loop, async_wait_t* wait,
                                             zx_status_t status, const zx_packet_signal_t* signal);
 static zx_status_t async_loop_dispatch_tasks(async_loop_t* loop);
@@ -128,6 +141,7 @@ zx_status_t async_loop_create(const async_loop_config_t* config, async_loop_t**
     list_initialize(&loop->task_list);
     list_initialize(&loop->due_list);
     list_initialize(&loop->thread_list);
+    list_initialize(&loop->dequeued_list);
 
     zx_status_t status = zx_port_create(0u, &loop->port);
     if (status == ZX_OK)
@@ -173,6 +187,15 @@ void async_loop_shutdown(async_loop_t* loop) {
     async_loop_wake_threads(loop);
     async_loop_join_threads(loop);
 
+    // A handler may be shutting the loop down in the middle of a batch.
+    // The batch's waits are still pending, so they are canceled below and
+    // the batch must not dispatch them again.
+    mtx_lock(&loop->lock);
+    dequeued_wait_t* dequeued;
+    list_for_every_entry (&loop->dequeued_list, dequeued, dequeued_wait_t, node)
+        dequeued->canceled = true;
+    mtx_unlock(&loop->lock);
+
     list_node_t* node;
     while ((node = list_remove_head(&loop->wait_list))) {
         async_wait_t* wait = node_to_wait(node);
@@ -199,7 +222,7 @@ zx_status_t async_loop_run(async_loop_t* loop, zx_time_t deadline, bool once) {
     zx_status_t status;
     atomic_fetch_add_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     do {
-        status = async_loop_run_once(loop, deadline);
+        status = async_loop_run_once(loop, deadline, once);
     } while (status == ZX_OK && !once);
     atomic_fetch_sub_explicit(&loop->active_threads, 1u, memory_order_acq_rel);
     return status;
@@ -213,49 +236,127 @@ zx_status_t async_loop_run_until_idle(async_loop_t* loop) {
     return status;
 }
 
-static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline) {
+static inline bool is_wait_packet(const zx_port_packet_t* packet) {
+    return packet->key != KEY_CONTROL && packet->type == ZX_PKT_TYPE_SIGNAL_ONE;
+}
+
+// Unless |once| is set, dequeues all the packets that are ready, up to
+// ZX_PORT_WAIT_MANY_MAX_PACKETS, and dispatches them in order, which saves
+// a syscall per packet when the loop is busy.
+static zx_status_t async_loop_run_once(async_loop_t* loop, zx_time_t deadline, bool once) {
     async_loop_state_t state = atomic_load_explicit(&loop->state, memory_order_acquire);
     if (state == ASYNC_LOOP_SHUTDOWN)
         return ZX_ERR_BAD_STATE;
     if (state != ASYNC_LOOP_RUNNABLE)
         return ZX_ERR_CANCELED;
 
-    zx_port_packet_t packet;
-    zx_status_t status = zx_port_wait(loop->port, deadline, &packet);
+    zx_port_packet_t packets[ZX_PORT_WAIT_MANY_MAX_PACKETS];
+    size_t count;
+    zx_status_t status = zx_port_wait_many(loop->port, deadline, packets,
+                                           once ? 1u : ZX_PORT_WAIT_MANY_MAX_PACKETS,
+                                           &count);
     if (status != ZX_OK)
         return status;
 
-    if (packet.key == KEY_CONTROL) {
+    // Note the waits in the batch under a single acquisition of the lock.
+    // They stay on the pending list until just before each one is
+    // dispatched, so they can still be canceled in the meantime.
+    dequeued_wait_t dequeued[ZX_PORT_WAIT_MANY_MAX_PACKETS];
+    bool has_waits = false;
+    for (size_t i = 0; i < count && !has_waits; i++)
+        has_waits = is_wait_packet(&packets[i]);
+    if (has_waits) {
+        mtx_lock(&loop->lock);
+        for (size_t i = 0; i < count; i++) {
+            if (is_wait_packet(&packets[i])) {
+                dequeued[i].wait = (void*)(uintptr_t)packets[i].key;
+                dequeued[i].canceled = false;
+                list_add_tail(&loop->dequeued_list, &dequeued[i].node);
+            }
+        }
+        mtx_unlock(&loop->lock);
+    }
+
+    // The whole batch is dispatched even if a handler quits the loop, since
+    // the packets can't be put back. If the loop is shut down, the waits
+    // that are still ours are canceled the way the shutdown would have done
+    // and the rest of the packets are dropped.
+    size_t i = 0;
+    for (; i < count; i++) {
+        state = atomic_load_explicit(&loop->state, memory_order_acquire);
+        if (is_wait_packet(&packets[i])) {
+            if (!async_loop_claim_wait(loop, &dequeued[i]))
+                continue;
+            if (state == ASYNC_LOOP_SHUTDOWN) {
+                async_loop_dispatch_wait(loop, dequeued[i].wait, ZX_ERR_CANCELED, NULL);
+                continue;
+            }
+        } else if (state == ASYNC_LOOP_SHUTDOWN) {
+            continue;
+        }
+        status = async_loop_dispatch_port_packet(loop, &packets[i]);
+        if (status != ZX_OK)
+            break;
+    }
+
+    // On error the rest of the batch is dropped. Its waits are left pending
+    // so that they are canceled when the loop shuts down.
+    if (i < count && has_waits) {
+        mtx_lock(&loop->lock);
+        for (i++; i < count; i++) {
+            if (is_wait_packet(&packets[i]))
+                list_delete(&dequeued[i].node);
+        }
+        mtx_unlock(&loop->lock);
+    }
+    return status;
+}
+
+// Takes a dequeued wait off the pending list just before it is dispatched.
+// Returns false if the wait was canceled after its packet was read, in which
+// case the packet must be dropped without touching the wait, which may
+// already have been freed or reused.
+static bool async_loop_claim_wait(async_loop_t* loop, dequeued_wait_t* dequeued) {
+    mtx_lock(&loop->lock);
+    list_delete(&dequeued->node);
+    bool canceled = dequeued->canceled;
+    if (!canceled)
+        list_delete(wait_to_node(dequeued->wait));
+    mtx_unlock(&loop->lock);
+    return !canceled;
+}
+
+static zx_status_t async_loop_dispatch_port_packet(async_loop_t* loop,
+                                                   const zx_port_packet_t* packet) {
+    if (packet->key == KEY_CONTROL) {
         // Handle wake-up packets.
-        if (packet.type == ZX_PKT_TYPE_USER)
+        if (packet->type == ZX_PKT_TYPE_USER)
             return ZX_OK;
 
         // Handle task timer expirations.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_REP &&
-            packet.signal.observed & ZX_TIMER_SIGNALED) {
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_REP &&
+            packet->signal.observed & ZX_TIMER_SIGNALED) {
             return async_loop_dispatch_tasks(loop);
         }
     } else {
-        // Handle wait completion packets.
-        if (packet.type == ZX_PKT_TYPE_SIGNAL_ONE) {
-            async_wait_t* wait = (void*)(uintptr_t)packet.key;
-            mtx_lock(&loop->lock);
-            list_delete(wait_to_node(wait));
-            mtx_unlock(&loop->lock);
-            return async_loop_dispatch_wait(loop, wait, packet.status, &packet.signal);
+        // Handle wait completion packets. The wait was already taken off
+        // the pending list by async_loop_claim_wait().
+        if (packet->type == ZX_PKT_TYPE_SIGNAL_ONE) {
+            async_wait_t* wait = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_wait(loop, wait, packet->status, &packet->signal);
         }
 
         // Handle queued user packets.
-        if (packet.type == ZX_PKT_TYPE_USER) {
-            async_receiver_t* receiver = (void*)(uintptr_t)packet.key;
-            return async_loop_dispatch_packet(loop, receiver, packet.status, &packet.user);
+        if (packet->type == ZX_PKT_TYPE_USER) {
+            async_receiver_t* receiver = (void*)(uintptr_t)packet->key;
+            return async_loop_dispatch_packet(loop, receiver, packet->status, &packet->user);
         }
 
         // Handle guest bell trap packets.
-        if (packet.type == ZX_PKT_TYPE_GUEST_BELL) {
-            async_guest_bell_trap_t* trap = (void*)(uintptr_t)packet.key;
+        if (packet->type == ZX_PKT_TYPE_GUEST_BELL) {
+            async_guest_bell_trap_t* trap = (void*)(uintptr_t)packet->key;
             return async_loop_dispatch_guest_bell_trap(
-                loop, trap, packet.status, &packet.guest_bell);
+                loop, trap, packet->status, &packet->guest_bell);
         }
     }
 
@@ -458,11 +559,22 @@ static zx_status_t async_loop_cancel_wait(async_t* async, async_wait_t* wait) {
         return ZX_ERR_NOT_FOUND;
     }
 
-    // Next, cancel the wait.  This may be racing with another thread that
-    // has read the wait's packet but not yet dispatched it.  So if we fail
-    // to cancel then we assume we lost the race.
+    // Next, cancel the wait.  This may be racing with a thread that has
+    // read the wait's packet but not yet dispatched it.  If that thread has
+    // noted the packet in its batch, tell it to drop the packet; otherwise
+    // we assume we lost the race.
     zx_status_t status = zx_port_cancel(loop->port, wait->object,
                                         (uintptr_t)wait);
+    if (status == ZX_ERR_NOT_FOUND) {
+        dequeued_wait_t* dequeued;
+        list_for_every_entry (&loop->dequeued_list, dequeued, dequeued_wait_t, node) {
+            if (dequeued->wait == wait && !dequeued->canceled) {
+                dequeued->canceled = true;
+                status = ZX_OK;
+                break;
+            }
+        }
+    }
     if (status == ZX_OK) {
         list_delete(node);
     } else {
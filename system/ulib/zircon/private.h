@@ -7,11 +7,16 @@
 #include <zircon/compiler.h>
 #include <zircon/syscalls.h>
 
-// This defines the struct shared with the kernel.
+// These define the structs shared with the kernel.
+#include <lib/vdso-clock.h>
 #include <lib/vdso-constants.h>
 
 extern __LOCAL const struct vdso_constants DATA_CONSTANTS;
 
+// The kernel updates this behind our back, so every read must really
+// happen.  See the comment on struct vdso_clock.
+extern __LOCAL const volatile struct vdso_clock DATA_CLOCK;
+
 extern "C" {
 
 // This declares the VDSO_zx_* aliases for the vDSO entry points.
@@ -0,0 +1,62 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <lib/fixed_point.h>
+#include <zircon/syscalls.h>
+
+#include "private.h"
+
+namespace {
+
+// This must come out exactly as the kernel's current_time() would, since
+// user code compares the results against deadlines the kernel enforces.
+zx_time_t monotonic_time() {
+    const fp_32_64 ns_per_tick = {
+        DATA_CONSTANTS.ns_per_tick.l0,
+        DATA_CONSTANTS.ns_per_tick.l32,
+        DATA_CONSTANTS.ns_per_tick.l64,
+    };
+    return u64_mul_u64_fp32_64(VDSO_zx_ticks_get(), ns_per_tick);
+}
+
+int64_t utc_offset() {
+    for (;;) {
+        uint32_t generation = __atomic_load_n(&DATA_CLOCK.generation,
+                                              __ATOMIC_ACQUIRE);
+        int64_t offset = __atomic_load_n(&DATA_CLOCK.utc_offset,
+                                         __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (likely(!(generation & 1)) &&
+            likely(__atomic_load_n(&DATA_CLOCK.generation,
+                                   __ATOMIC_RELAXED) == generation))
+            return offset;
+    }
+}
+
+} // anonymous namespace
+
+zx_status_t _zx_clock_get_new(zx_clock_t clock_id, zx_time_t* out_time) {
+    if (likely(!DATA_CONSTANTS.clock_via_kernel)) {
+        switch (clock_id) {
+        case ZX_CLOCK_MONOTONIC:
+            *out_time = monotonic_time();
+            return ZX_OK;
+        case ZX_CLOCK_UTC:
+            *out_time = monotonic_time() + utc_offset();
+            return ZX_OK;
+        }
+    }
+    return SYSCALL_zx_clock_get_via_kernel(clock_id, out_time);
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get_new);
+
+zx_time_t _zx_clock_get(zx_clock_t clock_id) {
+    zx_time_t time;
+    if (VDSO_zx_clock_get_new(clock_id, &time) != ZX_OK)
+        return 0;
+    return time;
+}
+
+VDSO_INTERFACE_FUNCTION(zx_clock_get);
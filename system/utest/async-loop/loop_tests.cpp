@@ -104,6 +104,22 @@ protected:
     }
 };
 
+class OtherCancelingWait : public TestWait {
+public:
+    OtherCancelingWait(zx_handle_t object, zx_signals_t trigger)
+        : TestWait(object, trigger) {}
+
+    TestWait* other = nullptr;
+    zx_status_t cancel_result = ZX_ERR_INTERNAL;
+
+protected:
+    void Handle(async_t* async, zx_status_t status,
+                const zx_packet_signal_t* signal) override {
+        TestWait::Handle(async, status, signal);
+        cancel_result = other->Cancel(async);
+    }
+};
+
 class TestTask : public async_task_t {
 public:
     TestTask()
@@ -558,6 +574,36 @@ bool wait_shutdown_test() {
     END_TEST;
 }
 
+bool wait_cancel_dequeued_test() {
+    BEGIN_TEST;
+
+    async::Loop loop;
+    zx::event event;
+    EXPECT_EQ(ZX_OK, zx::event::create(0u, &event), "create event");
+
+    // Both waits complete at once, so their packets are read in the same
+    // batch. Whichever is dispatched first cancels the other one, which
+    // must succeed and keep the other handler from running.
+    OtherCancelingWait wait1(event.get(), ZX_USER_SIGNAL_0);
+    OtherCancelingWait wait2(event.get(), ZX_USER_SIGNAL_0);
+    wait1.other = &wait2;
+    wait2.other = &wait1;
+    EXPECT_EQ(ZX_OK, wait1.Begin(loop.async()), "begin 1");
+    EXPECT_EQ(ZX_OK, wait2.Begin(loop.async()), "begin 2");
+
+    EXPECT_EQ(ZX_OK, event.signal(0u, ZX_USER_SIGNAL_0), "signal");
+    EXPECT_EQ(ZX_OK, loop.RunUntilIdle(), "run loop");
+    EXPECT_EQ(1u, wait1.run_count + wait2.run_count, "run count");
+    OtherCancelingWait* ran = wait1.run_count ? &wait1 : &wait2;
+    EXPECT_EQ(ZX_OK, ran->cancel_result, "cancel result");
+
+    // The canceled wait is no longer pending.
+    loop.Shutdown();
+    EXPECT_EQ(1u, wait1.run_count + wait2.run_count, "run count");
+
+    END_TEST;
+}
+
 bool task_test() {
     BEGIN_TEST;
 
@@ -1019,6 +1065,7 @@ RUN_TEST(time_test)
 RUN_TEST(wait_test)
 RUN_TEST(wait_unwaitable_handle_test)
 RUN_TEST(wait_shutdown_test)
+RUN_TEST(wait_cancel_dequeued_test)
 RUN_TEST(task_test)
 RUN_TEST(task_shutdown_test)
 RUN_TEST(receiver_test)
@@ -4,9 +4,12 @@
 
 #include <inttypes.h>
 #include <limits.h>
+#include <zircon/process.h>
 #include <zircon/syscalls.h>
+#include <zircon/syscalls/profile.h>
 #include <zircon/threads.h>
 #include <unittest/unittest.h>
+#include <pthread.h>
 #include <sched.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -450,6 +453,194 @@ static bool test_futex_misaligned() {
     ASSERT_EQ(zx_futex_wait(futex, 0, ZX_TIME_INFINITE), ZX_ERR_INVALID_ARGS);
     ASSERT_EQ(zx_futex_wake(futex, 1), ZX_ERR_INVALID_ARGS);
     ASSERT_EQ(zx_futex_requeue(futex, 1, 0, futex_2, 1), ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(zx_futex_wait_owned(futex, 0, ZX_HANDLE_INVALID, ZX_TIME_INFINITE),
+              ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(zx_futex_wake_single_owner(futex), ZX_ERR_INVALID_ARGS);
+
+    END_TEST;
+}
+
+// Test the checks zx_futex_wait_owned() makes of the owner.
+static bool test_futex_wait_owned_bad_owner() {
+    BEGIN_TEST;
+    zx_futex_t futex = 0;
+
+    // A thread can't wait on a futex it holds itself.
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 0, zx_thread_self(), ZX_TIME_INFINITE),
+              ZX_ERR_INVALID_ARGS);
+
+    zx_handle_t event;
+    ASSERT_EQ(zx_event_create(0, &event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 0, event, ZX_TIME_INFINITE), ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_handle_close(event), ZX_OK);
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 0, event, ZX_TIME_INFINITE), ZX_ERR_BAD_HANDLE);
+
+    // Without an owner, it behaves just like zx_futex_wait().
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 1, ZX_HANDLE_INVALID, ZX_TIME_INFINITE),
+              ZX_ERR_BAD_STATE);
+    EXPECT_EQ(zx_futex_wait_owned(&futex, 0, ZX_HANDLE_INVALID, zx_deadline_after(ZX_MSEC(1))),
+              ZX_ERR_TIMED_OUT);
+
+    END_TEST;
+}
+
+// Test that zx_futex_wake_single_owner() wakes exactly one thread.
+static bool test_futex_wake_single_owner() {
+    BEGIN_TEST;
+    volatile int32_t futex_value = 1;
+    TestThread thread1(&futex_value);
+    TestThread thread2(&futex_value);
+
+    futex_value++;
+    ASSERT_EQ(zx_futex_wake_single_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    // The threads are woken in the order they started waiting.
+    thread1.assert_thread_woken();
+    thread2.assert_thread_not_woken();
+
+    ASSERT_EQ(zx_futex_wake_single_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+    thread2.assert_thread_woken();
+
+    // With nobody waiting, there is nobody to wake.
+    ASSERT_EQ(zx_futex_wake_single_owner(const_cast<int32_t*>(&futex_value)), ZX_OK);
+
+    END_TEST;
+}
+
+extern "C" zx_handle_t get_root_resource(void);
+
+// Priority inversion: a low priority thread holds a mutex that a high
+// priority thread wants, while enough medium priority threads to keep every
+// CPU busy spin for a while. Unless the low priority thread inherits the
+// high priority thread's priority, it doesn't get to run and release the
+// mutex until the medium priority threads are done.
+namespace {
+
+constexpr zx_duration_t kInversionHoldTime = ZX_MSEC(10);
+constexpr zx_duration_t kInversionSpinTime = ZX_SEC(2);
+constexpr size_t kInversionMaxSpinners = 64;
+
+struct InversionTest {
+    pthread_mutex_t mutex;
+    zx_handle_t low_profile = ZX_HANDLE_INVALID;
+    zx_handle_t medium_profile = ZX_HANDLE_INVALID;
+    zx_handle_t high_profile = ZX_HANDLE_INVALID;
+    volatile bool locked = false;
+    volatile bool stop = false;
+    zx_duration_t latency = 0;
+};
+
+void spin_until(zx_time_t deadline, volatile bool* stop) {
+    while ((!stop || !*stop) && zx_clock_get(ZX_CLOCK_MONOTONIC) < deadline) {
+    }
+}
+
+int inversion_low_thread(void* arg) {
+    auto test = static_cast<InversionTest*>(arg);
+    EXPECT_EQ(zx_object_set_profile(zx_thread_self(), test->low_profile, 0), ZX_OK);
+
+    EXPECT_EQ(pthread_mutex_lock(&test->mutex), 0);
+    test->locked = true;
+    spin_until(zx_deadline_after(kInversionHoldTime), nullptr);
+    EXPECT_EQ(pthread_mutex_unlock(&test->mutex), 0);
+    return 0;
+}
+
+int inversion_medium_thread(void* arg) {
+    auto test = static_cast<InversionTest*>(arg);
+    EXPECT_EQ(zx_object_set_profile(zx_thread_self(), test->medium_profile, 0), ZX_OK);
+
+    spin_until(zx_deadline_after(kInversionSpinTime), &test->stop);
+    return 0;
+}
+
+int inversion_high_thread(void* arg) {
+    auto test = static_cast<InversionTest*>(arg);
+    EXPECT_EQ(zx_object_set_profile(zx_thread_self(), test->high_profile, 0), ZX_OK);
+
+    zx_time_t start = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    EXPECT_EQ(pthread_mutex_lock(&test->mutex), 0);
+    test->latency = zx_clock_get(ZX_CLOCK_MONOTONIC) - start;
+    EXPECT_EQ(pthread_mutex_unlock(&test->mutex), 0);
+    return 0;
+}
+
+zx_status_t make_profile(uint32_t priority, zx_handle_t* profile) {
+    zx_profile_info_t info = {};
+    info.type = ZX_PROFILE_INFO_SCHEDULER;
+    info.scheduler.priority = priority;
+    return zx_profile_create(get_root_resource(), &info, profile);
+}
+
+} // namespace
+
+static bool test_pthread_mutex_priority_inversion() {
+    BEGIN_TEST;
+
+    if (get_root_resource() == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+        return true;
+    }
+
+    InversionTest test;
+    pthread_mutexattr_t attr;
+    ASSERT_EQ(pthread_mutexattr_init(&attr), 0);
+    ASSERT_EQ(pthread_mutexattr_setprotocol(&attr, PTHREAD_PRIO_INHERIT), 0);
+    int protocol;
+    ASSERT_EQ(pthread_mutexattr_getprotocol(&attr, &protocol), 0);
+    ASSERT_EQ(protocol, PTHREAD_PRIO_INHERIT);
+    ASSERT_EQ(pthread_mutex_init(&test.mutex, &attr), 0);
+    ASSERT_EQ(pthread_mutexattr_destroy(&attr), 0);
+
+    zx_handle_t default_profile, setup_profile;
+    ASSERT_EQ(make_profile(ZX_PRIORITY_LOW, &test.low_profile), ZX_OK);
+    ASSERT_EQ(make_profile(ZX_PRIORITY_HIGH, &test.medium_profile), ZX_OK);
+    ASSERT_EQ(make_profile(ZX_PRIORITY_HIGHEST, &test.high_profile), ZX_OK);
+    ASSERT_EQ(make_profile(ZX_PRIORITY_DEFAULT, &default_profile), ZX_OK);
+    ASSERT_EQ(make_profile(ZX_PRIORITY_HIGHEST, &setup_profile), ZX_OK);
+
+    // Stay ahead of the medium priority threads while setting things up.
+    ASSERT_EQ(zx_object_set_profile(zx_thread_self(), setup_profile, 0), ZX_OK);
+
+    thrd_t low;
+    ASSERT_EQ(thrd_create_with_name(&low, inversion_low_thread, &test, "pi-low"), thrd_success);
+    while (!test.locked) {
+        zx_nanosleep(zx_deadline_after(ZX_MSEC(1)));
+    }
+
+    thrd_t spinners[kInversionMaxSpinners];
+    size_t num_spinners = zx_system_get_num_cpus();
+    if (num_spinners > kInversionMaxSpinners)
+        num_spinners = kInversionMaxSpinners;
+    for (size_t i = 0; i < num_spinners; i++) {
+        ASSERT_EQ(thrd_create_with_name(&spinners[i], inversion_medium_thread, &test, "pi-medium"),
+                  thrd_success);
+    }
+    // Give the spinners time to take over every CPU.
+    zx_nanosleep(zx_deadline_after(ZX_MSEC(10)));
+
+    thrd_t high;
+    ASSERT_EQ(thrd_create_with_name(&high, inversion_high_thread, &test, "pi-high"),
+              thrd_success);
+    ASSERT_EQ(thrd_join(high, nullptr), thrd_success);
+
+    test.stop = true;
+    for (size_t i = 0; i < num_spinners; i++) {
+        ASSERT_EQ(thrd_join(spinners[i], nullptr), thrd_success);
+    }
+    ASSERT_EQ(thrd_join(low, nullptr), thrd_success);
+
+    ASSERT_EQ(zx_object_set_profile(zx_thread_self(), default_profile, 0), ZX_OK);
+    const zx_handle_t profiles[] = {test.low_profile, test.medium_profile, test.high_profile,
+                                    default_profile, setup_profile};
+    for (zx_handle_t profile : profiles) {
+        ASSERT_EQ(zx_handle_close(profile), ZX_OK);
+    }
+    ASSERT_EQ(pthread_mutex_destroy(&test.mutex), 0);
+
+    unittest_printf("high priority thread waited %" PRIu64 "us for the mutex\n",
+                    test.latency / ZX_USEC(1));
+    // Without inheritance the wait lasts as long as the spinners do.
+    EXPECT_LT(test.latency, kInversionSpinTime / 2);
 
     END_TEST;
 }
@@ -546,6 +737,9 @@ RUN_TEST(test_futex_requeue_unqueued_on_timeout);
 RUN_TEST(test_futex_thread_killed);
 RUN_TEST(test_futex_thread_suspended);
 RUN_TEST(test_futex_misaligned);
+RUN_TEST(test_futex_wait_owned_bad_owner);
+RUN_TEST(test_futex_wake_single_owner);
+RUN_TEST(test_pthread_mutex_priority_inversion);
 RUN_TEST(test_event_signaling);
 END_TEST_CASE(futex_tests)
 
@@ -0,0 +1,78 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <zircon/compiler.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+#include <zircon/syscalls/system.h>
+#include <zircon/types.h>
+#include <unittest/unittest.h>
+
+extern zx_handle_t get_root_resource(void);
+
+static const uint32_t kinds[] = {
+    ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL,
+    ZX_SYSTEM_EVENT_MEMORY_PRESSURE_WARNING,
+    ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL,
+};
+
+static bool one_level_signaled_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    ASSERT_NE(rrh, ZX_HANDLE_INVALID, "no root resource handle");
+
+    int signaled = 0;
+    for (size_t i = 0; i < countof(kinds); i++) {
+        zx_handle_t event;
+        ASSERT_EQ(zx_system_get_event(rrh, kinds[i], &event), ZX_OK, "");
+
+        zx_signals_t pending = 0;
+        zx_status_t status = zx_object_wait_one(event, ZX_EVENT_SIGNALED, 0, &pending);
+        if (status == ZX_OK) {
+            signaled++;
+        } else {
+            EXPECT_EQ(status, ZX_ERR_TIMED_OUT, "");
+        }
+
+        // only the kernel can change the level
+        EXPECT_EQ(zx_object_signal(event, 0, ZX_EVENT_SIGNALED), ZX_ERR_ACCESS_DENIED, "");
+
+        ASSERT_EQ(zx_handle_close(event), ZX_OK, "");
+    }
+    // the level may change between the waits, so allow for one move
+    EXPECT_GE(signaled, 1, "");
+    EXPECT_LE(signaled, 2, "");
+
+    zx_info_kmem_reclaim_stats_t stats;
+    ASSERT_EQ(zx_object_get_info(rrh, ZX_INFO_KMEM_RECLAIM_STATS, &stats, sizeof(stats),
+                                 NULL, NULL), ZX_OK, "");
+    EXPECT_GE(stats.pressure_level, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL, "");
+    EXPECT_LE(stats.pressure_level, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_CRITICAL, "");
+
+    END_TEST;
+}
+
+static bool bad_args_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t event;
+    EXPECT_EQ(zx_system_get_event(get_root_resource(), 0, &event), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_system_get_event(ZX_HANDLE_INVALID, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL,
+                                  &event), ZX_ERR_BAD_HANDLE, "");
+
+    // the root resource is required
+    zx_handle_t other;
+    ASSERT_EQ(zx_event_create(0, &other), ZX_OK, "");
+    EXPECT_EQ(zx_system_get_event(other, ZX_SYSTEM_EVENT_MEMORY_PRESSURE_NORMAL, &event),
+              ZX_ERR_WRONG_TYPE, "");
+    ASSERT_EQ(zx_handle_close(other), ZX_OK, "");
+
+    END_TEST;
+}
+
+BEGIN_TEST_CASE(memory_pressure_tests)
+RUN_TEST(one_level_signaled_test)
+RUN_TEST(bad_args_test)
+END_TEST_CASE(memory_pressure_tests)
@@ -0,0 +1,299 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+#include <threads.h>
+
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+#include <unittest/unittest.h>
+
+namespace {
+
+constexpr uint64_t kKey = 0x1234;
+
+// Reads the first byte of a page of a pager vmo on another thread, since the
+// read blocks until the page is supplied.
+struct Reader {
+    zx_handle_t vmo;
+    uint64_t offset;
+    // Read through a mapping rather than with zx_vmo_read().
+    uintptr_t addr;
+
+    zx_status_t status;
+    uint8_t value;
+    thrd_t thread;
+};
+
+int reader_thread(void* arg) {
+    auto* reader = static_cast<Reader*>(arg);
+    if (reader->addr) {
+        reader->value = *reinterpret_cast<volatile uint8_t*>(reader->addr + reader->offset);
+        reader->status = ZX_OK;
+    } else {
+        reader->status = zx_vmo_read(reader->vmo, &reader->value, reader->offset, 1);
+    }
+    return 0;
+}
+
+bool start_reader(Reader* reader) {
+    return thrd_create(&reader->thread, reader_thread, reader) == thrd_success;
+}
+
+bool join_reader(Reader* reader) {
+    return thrd_join(reader->thread, nullptr) == thrd_success;
+}
+
+// Waits for a page request packet on |port| and checks its contents.
+bool expect_request(zx_handle_t port, uint16_t command, uint64_t offset, uint64_t length) {
+    BEGIN_HELPER;
+    zx_port_packet_t packet;
+    ASSERT_EQ(zx_port_wait(port, ZX_TIME_INFINITE, &packet), ZX_OK);
+    EXPECT_EQ(packet.key, kKey);
+    EXPECT_EQ(packet.type, ZX_PKT_TYPE_PAGE_REQUEST);
+    EXPECT_EQ(packet.page_request.command, command);
+    EXPECT_EQ(packet.page_request.offset, offset);
+    EXPECT_EQ(packet.page_request.length, length);
+    END_HELPER;
+}
+
+// Supplies [offset, offset + length) of |vmo|, with each byte set to |value|.
+bool supply(zx_handle_t pager, zx_handle_t vmo, uint64_t offset, uint64_t length,
+            uint8_t value) {
+    BEGIN_HELPER;
+    zx_handle_t aux;
+    ASSERT_EQ(zx_vmo_create(length, 0, &aux), ZX_OK);
+    uint8_t buf[PAGE_SIZE];
+    memset(buf, value, sizeof(buf));
+    for (uint64_t off = 0; off < length; off += PAGE_SIZE) {
+        ASSERT_EQ(zx_vmo_write(aux, buf, off, sizeof(buf)), ZX_OK);
+    }
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, offset, length, aux, 0), ZX_OK);
+    // The pages were moved out of the aux vmo rather than copied.
+    uint8_t aux_value;
+    ASSERT_EQ(zx_vmo_read(aux, &aux_value, 0, 1), ZX_OK);
+    EXPECT_EQ(aux_value, 0u);
+    ASSERT_EQ(zx_handle_close(aux), ZX_OK);
+    END_HELPER;
+}
+
+bool create_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager;
+    EXPECT_EQ(zx_pager_create(1, &pager), ZX_ERR_INVALID_ARGS);
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+
+    zx_handle_t vmo;
+    EXPECT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 1, &vmo), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_create_vmo(port, port, kKey, PAGE_SIZE, 0, &vmo), ZX_ERR_WRONG_TYPE);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    // Pages can only be read in by faulting on them.
+    EXPECT_EQ(zx_vmo_op_range(vmo, ZX_VMO_OP_COMMIT, 0, PAGE_SIZE, nullptr, 0),
+              ZX_ERR_NOT_SUPPORTED);
+
+    // Closing the vmo tells the pager that it is done with it.
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    EXPECT_TRUE(expect_request(port, ZX_PAGER_VMO_COMPLETE, 0, 0));
+
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool vmo_read_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, 2 * PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, PAGE_SIZE, 0, ZX_ERR_INTERNAL, 0, {}};
+    ASSERT_TRUE(start_reader(&reader));
+    ASSERT_TRUE(expect_request(port, ZX_PAGER_VMO_READ, PAGE_SIZE, PAGE_SIZE));
+    ASSERT_TRUE(supply(pager, vmo, PAGE_SIZE, PAGE_SIZE, 0x5a));
+    ASSERT_TRUE(join_reader(&reader));
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.value, 0x5a);
+
+    // The page stays supplied, so reading it again does not ask for it.
+    uint8_t value;
+    EXPECT_EQ(zx_vmo_read(vmo, &value, PAGE_SIZE + 1, 1), ZX_OK);
+    EXPECT_EQ(value, 0x5a);
+    zx_port_packet_t packet;
+    EXPECT_EQ(zx_port_wait(port, 0, &packet), ZX_ERR_TIMED_OUT);
+
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool mapping_fault_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    uintptr_t addr;
+    ASSERT_EQ(zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &addr),
+              ZX_OK);
+
+    Reader reader = {vmo, 0, addr, ZX_ERR_INTERNAL, 0, {}};
+    ASSERT_TRUE(start_reader(&reader));
+    ASSERT_TRUE(expect_request(port, ZX_PAGER_VMO_READ, 0, PAGE_SIZE));
+    ASSERT_TRUE(supply(pager, vmo, 0, PAGE_SIZE, 0xa5));
+    ASSERT_TRUE(join_reader(&reader));
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.value, 0xa5);
+
+    ASSERT_EQ(zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool clone_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo, clone;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_clone(vmo, ZX_VMO_CLONE_COPY_ON_WRITE, 0, PAGE_SIZE, &clone), ZX_OK);
+
+    // Pages the clone doesn't have come from the pager.
+    Reader reader = {clone, 0, 0, ZX_ERR_INTERNAL, 0, {}};
+    ASSERT_TRUE(start_reader(&reader));
+    ASSERT_TRUE(expect_request(port, ZX_PAGER_VMO_READ, 0, PAGE_SIZE));
+    ASSERT_TRUE(supply(pager, vmo, 0, PAGE_SIZE, 0x11));
+    ASSERT_TRUE(join_reader(&reader));
+    EXPECT_EQ(reader.status, ZX_OK);
+    EXPECT_EQ(reader.value, 0x11);
+
+    uint8_t value = 0x22;
+    EXPECT_EQ(zx_vmo_write(clone, &value, 0, 1), ZX_OK);
+    EXPECT_EQ(zx_vmo_read(vmo, &value, 0, 1), ZX_OK);
+    EXPECT_EQ(value, 0x11);
+
+    ASSERT_EQ(zx_handle_close(clone), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool fail_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, PAGE_SIZE, ZX_OK), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, PAGE_SIZE, ZX_ERR_INTERNAL), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, 2 * PAGE_SIZE, ZX_ERR_IO), ZX_ERR_OUT_OF_RANGE);
+
+    Reader reader = {vmo, 0, 0, ZX_OK, 0, {}};
+    ASSERT_TRUE(start_reader(&reader));
+    ASSERT_TRUE(expect_request(port, ZX_PAGER_VMO_READ, 0, PAGE_SIZE));
+    EXPECT_EQ(zx_pager_fail_pages(pager, vmo, 0, PAGE_SIZE, ZX_ERR_IO), ZX_OK);
+    ASSERT_TRUE(join_reader(&reader));
+    EXPECT_EQ(reader.status, ZX_ERR_IO);
+
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool close_pager_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, port, vmo;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+
+    Reader reader = {vmo, 0, 0, ZX_OK, 0, {}};
+    ASSERT_TRUE(start_reader(&reader));
+    ASSERT_TRUE(expect_request(port, ZX_PAGER_VMO_READ, 0, PAGE_SIZE));
+
+    // Without a pager, outstanding and future reads fail.
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    EXPECT_TRUE(expect_request(port, ZX_PAGER_VMO_COMPLETE, 0, 0));
+    ASSERT_TRUE(join_reader(&reader));
+    EXPECT_EQ(reader.status, ZX_ERR_BAD_STATE);
+
+    uint8_t value;
+    EXPECT_EQ(zx_vmo_read(vmo, &value, 0, 1), ZX_ERR_BAD_STATE);
+
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+bool supply_invalid_test() {
+    BEGIN_TEST;
+
+    zx_handle_t pager, other_pager, port, vmo, aux;
+    ASSERT_EQ(zx_pager_create(0, &pager), ZX_OK);
+    ASSERT_EQ(zx_pager_create(0, &other_pager), ZX_OK);
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo), ZX_OK);
+    ASSERT_EQ(zx_vmo_create(2 * PAGE_SIZE, 0, &aux), ZX_OK);
+
+    // The vmo has to belong to the pager.
+    EXPECT_EQ(zx_pager_supply_pages(other_pager, vmo, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, aux, 0, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+
+    // Ranges have to be page aligned and within both vmos.
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 1, PAGE_SIZE, aux, 0), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, 1), ZX_ERR_INVALID_ARGS);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, 2 * PAGE_SIZE, aux, 0), ZX_ERR_OUT_OF_RANGE);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, aux, 2 * PAGE_SIZE),
+              ZX_ERR_OUT_OF_RANGE);
+
+    // Pager vmos can't supply pages themselves.
+    zx_handle_t vmo2;
+    ASSERT_EQ(zx_pager_create_vmo(pager, port, kKey, PAGE_SIZE, 0, &vmo2), ZX_OK);
+    EXPECT_EQ(zx_pager_supply_pages(pager, vmo, 0, PAGE_SIZE, vmo2, 0), ZX_ERR_NOT_SUPPORTED);
+
+    ASSERT_EQ(zx_handle_close(vmo2), ZX_OK);
+    ASSERT_EQ(zx_handle_close(aux), ZX_OK);
+    ASSERT_EQ(zx_handle_close(vmo), ZX_OK);
+    ASSERT_EQ(zx_handle_close(other_pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(pager), ZX_OK);
+    ASSERT_EQ(zx_handle_close(port), ZX_OK);
+    END_TEST;
+}
+
+} // namespace
+
+BEGIN_TEST_CASE(pager_tests)
+RUN_TEST(create_test)
+RUN_TEST(vmo_read_test)
+RUN_TEST(mapping_fault_test)
+RUN_TEST(clone_test)
+RUN_TEST(fail_test)
+RUN_TEST(close_pager_test)
+RUN_TEST(supply_invalid_test)
+END_TEST_CASE(pager_tests)
+
+#ifndef BUILD_COMBINED_TESTS
+int main(int argc, char** argv) {
+    return unittest_run_all_tests(argc, argv) ? 0 : -1;
+}
+#endif
@@ -49,6 +49,47 @@ static bool basic_test(void) {
     END_TEST;
 }
 
+static bool wait_many_test(void) {
+    BEGIN_TEST;
+
+    zx_handle_t port;
+    ASSERT_EQ(zx_port_create(0, &port), ZX_OK);
+
+    constexpr uint32_t kNumPackets = ZX_PORT_WAIT_MANY_MAX_PACKETS + 4;
+    for (uint32_t i = 0; i < kNumPackets; ++i) {
+        zx_port_packet_t in = {};
+        in.key = i;
+        ASSERT_EQ(zx_port_queue(port, &in), ZX_OK);
+    }
+
+    zx_port_packet_t out[ZX_PORT_WAIT_MANY_MAX_PACKETS * 2];
+    size_t actual = 0;
+    EXPECT_EQ(zx_port_wait_many(port, 0, out, 0, &actual), ZX_ERR_INVALID_ARGS);
+
+    // No more than the maximum are dequeued at once, in FIFO order.
+    ASSERT_EQ(zx_port_wait_many(port, 0, out, fbl::count_of(out), &actual), ZX_OK);
+    ASSERT_EQ(actual, ZX_PORT_WAIT_MANY_MAX_PACKETS);
+    for (size_t i = 0; i < actual; ++i) {
+        EXPECT_EQ(out[i].key, i);
+        EXPECT_EQ(out[i].type, ZX_PKT_TYPE_USER);
+    }
+
+    // Only what is there is returned, without waiting for more.
+    ASSERT_EQ(zx_port_wait_many(port, ZX_TIME_INFINITE, out, fbl::count_of(out), &actual),
+              ZX_OK);
+    ASSERT_EQ(actual, 4u);
+    for (size_t i = 0; i < actual; ++i) {
+        EXPECT_EQ(out[i].key, ZX_PORT_WAIT_MANY_MAX_PACKETS + i);
+    }
+
+    EXPECT_EQ(zx_port_wait_many(port, zx_deadline_after(ZX_USEC(1)), out, fbl::count_of(out),
+                                &actual), ZX_ERR_TIMED_OUT);
+
+    EXPECT_EQ(zx_handle_close(port), ZX_OK);
+
+    END_TEST;
+}
+
 static bool queue_and_close_test(void) {
     BEGIN_TEST;
     zx_status_t status;
@@ -679,6 +720,7 @@ static bool cancel_stress() {
 
 BEGIN_TEST_CASE(port_tests)
 RUN_TEST(basic_test)
+RUN_TEST(wait_many_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(queue_too_many)
 RUN_TEST(async_wait_channel_test)
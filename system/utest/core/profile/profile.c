@@ -27,6 +27,22 @@ static bool make_profile_fails(void) {
         profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
         profile_info.scheduler.priority = ZX_PRIORITY_HIGHEST + 1;
         ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = 0;
+        profile_info.deadline.period = ZX_MSEC(10);
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.deadline.capacity = ZX_MSEC(20);
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.deadline.capacity = ZX_MSEC(1);
+        profile_info.deadline.period = ZX_SEC(2);
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
+
+        profile_info.type = ZX_PROFILE_INFO_FAIR;
+        profile_info.fair.weight = 0;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_ERR_INVALID_ARGS, "");
     }
 
     END_TEST;
@@ -61,7 +77,75 @@ static bool change_priority_via_profile(void) {
     END_TEST;
 }
 
+static bool change_class_via_profile(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        zx_profile_info_t profile_info = { 0 };
+
+        zx_handle_t deadline;
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = ZX_MSEC(1);
+        profile_info.deadline.period = ZX_MSEC(10);
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &deadline), ZX_OK, "");
+
+        zx_handle_t fair;
+        profile_info.type = ZX_PROFILE_INFO_FAIR;
+        profile_info.fair.weight = ZX_FAIR_WEIGHT_DEFAULT * 2;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &fair), ZX_OK, "");
+
+        zx_handle_t priority;
+        profile_info.type = ZX_PROFILE_INFO_SCHEDULER;
+        profile_info.scheduler.priority = ZX_PRIORITY_DEFAULT;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &priority), ZX_OK, "");
+
+        // run for a few periods so the thread gets throttled at least once
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), deadline, 0), ZX_OK, "");
+        zx_time_t end = zx_clock_get(ZX_CLOCK_MONOTONIC) + ZX_MSEC(50);
+        while (zx_clock_get(ZX_CLOCK_MONOTONIC) < end) {
+        }
+        zx_nanosleep(ZX_USEC(100));
+
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), fair, 0), ZX_OK, "");
+        zx_nanosleep(ZX_USEC(100));
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), priority, 0), ZX_OK, "");
+
+        ASSERT_EQ(zx_handle_close(deadline), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(fair), ZX_OK, "");
+        ASSERT_EQ(zx_handle_close(priority), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
+static bool deadline_admission_control(void) {
+    BEGIN_TEST;
+
+    zx_handle_t rrh = get_root_resource();
+    if (rrh == ZX_HANDLE_INVALID) {
+        unittest_printf("no root resource. skipping test\n");
+    } else {
+        // no thread may reserve all of a cpu
+        zx_profile_info_t profile_info = { 0 };
+        profile_info.type = ZX_PROFILE_INFO_DEADLINE;
+        profile_info.deadline.capacity = ZX_MSEC(10);
+        profile_info.deadline.period = ZX_MSEC(10);
+
+        zx_handle_t profile;
+        ASSERT_EQ(zx_profile_create(rrh, &profile_info, &profile), ZX_OK, "");
+        ASSERT_EQ(zx_object_set_profile(zx_thread_self(), profile, 0), ZX_ERR_NO_RESOURCES, "");
+        ASSERT_EQ(zx_handle_close(profile), ZX_OK, "");
+    }
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(profile_tests)
 RUN_TEST(make_profile_fails)
 RUN_TEST(change_priority_via_profile)
+RUN_TEST(change_class_via_profile)
+RUN_TEST(deadline_admission_control)
 END_TEST_CASE(profile_tests)
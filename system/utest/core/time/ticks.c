@@ -25,8 +25,45 @@ static bool elapsed_time_using_ticks(void) {
     END_TEST;
 }
 
+// The vDSO computes the monotonic clock itself, so check it against a
+// deadline the kernel enforced.
+static bool monotonic_clock_matches_kernel(void) {
+    BEGIN_TEST;
+
+    zx_time_t last = zx_clock_get(ZX_CLOCK_MONOTONIC);
+    for (int i = 0; i < 1000; i++) {
+        zx_time_t now = zx_clock_get(ZX_CLOCK_MONOTONIC);
+        ASSERT_GE(now, last, "Monotonic clock went backwards");
+        last = now;
+    }
+
+    zx_time_t deadline = zx_deadline_after(ZX_MSEC(1));
+    ASSERT_EQ(zx_nanosleep(deadline), ZX_OK, "");
+    ASSERT_GE(zx_clock_get(ZX_CLOCK_MONOTONIC), deadline, "Woke up before the deadline");
+
+    END_TEST;
+}
+
+static bool clock_get_new_ids(void) {
+    BEGIN_TEST;
+
+    zx_time_t time = 0;
+    ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_MONOTONIC, &time), ZX_OK, "");
+    EXPECT_GT(time, 0u, "");
+    ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_UTC, &time), ZX_OK, "");
+    ASSERT_EQ(zx_clock_get_new(ZX_CLOCK_THREAD, &time), ZX_OK, "");
+    EXPECT_GT(time, 0u, "");
+
+    EXPECT_EQ(zx_clock_get_new(1234, &time), ZX_ERR_INVALID_ARGS, "");
+    EXPECT_EQ(zx_clock_get(1234), 0u, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(ticks_tests)
 RUN_TEST(elapsed_time_using_ticks)
+RUN_TEST(monotonic_clock_matches_kernel)
+RUN_TEST(clock_get_new_ids)
 END_TEST_CASE(ticks_tests)
 
 #ifndef BUILD_COMBINED_TESTS
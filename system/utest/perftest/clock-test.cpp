@@ -3,14 +3,16 @@
 // found in the LICENSE file.
 
 #include <perftest/perftest.h>
+#include <zircon/assert.h>
 #include <zircon/syscalls.h>
 
 namespace {
 
 // Performance test for zx_clock_get(ZX_CLOCK_MONOTONIC).  This is worth
-// testing because it is a very commonly called syscall.  The kernel's
-// implementation of the syscall is non-trivial and can be rather slow on
-// some machines/VMs.
+// testing because it is a very commonly called syscall.  The vDSO normally
+// computes it without entering the kernel; booting with
+// vdso.clock_get_via_kernel=true makes it take the kernel path instead, so
+// the two can be compared.
 bool ClockGetMonotonicTest() {
     zx_clock_get(ZX_CLOCK_MONOTONIC);
     return true;
@@ -21,11 +23,31 @@ bool ClockGetUtcTest() {
     return true;
 }
 
+// This one always enters the kernel, so it gives the cost of the kernel
+// path alongside the tests above in any one run.
 bool ClockGetThreadTest() {
     zx_clock_get(ZX_CLOCK_THREAD);
     return true;
 }
 
+bool ClockGetNewMonotonicTest() {
+    zx_time_t time;
+    ZX_ASSERT(zx_clock_get_new(ZX_CLOCK_MONOTONIC, &time) == ZX_OK);
+    return true;
+}
+
+bool ClockGetNewUtcTest() {
+    zx_time_t time;
+    ZX_ASSERT(zx_clock_get_new(ZX_CLOCK_UTC, &time) == ZX_OK);
+    return true;
+}
+
+bool ClockGetNewThreadTest() {
+    zx_time_t time;
+    ZX_ASSERT(zx_clock_get_new(ZX_CLOCK_THREAD, &time) == ZX_OK);
+    return true;
+}
+
 bool TicksGetTest() {
     zx_ticks_get();
     return true;
@@ -35,6 +57,9 @@ void RegisterTests() {
     perftest::RegisterSimpleTest<ClockGetMonotonicTest>("ClockGetMonotonic");
     perftest::RegisterSimpleTest<ClockGetUtcTest>("ClockGetUtc");
     perftest::RegisterSimpleTest<ClockGetThreadTest>("ClockGetThread");
+    perftest::RegisterSimpleTest<ClockGetNewMonotonicTest>("ClockGetNew/Monotonic");
+    perftest::RegisterSimpleTest<ClockGetNewUtcTest>("ClockGetNew/Utc");
+    perftest::RegisterSimpleTest<ClockGetNewThreadTest>("ClockGetNew/Thread");
     perftest::RegisterSimpleTest<TicksGetTest>("TicksGet");
 }
 PERFTEST_CTOR(RegisterTests);
@@ -0,0 +1,180 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/algorithm.h>
+#include <fbl/atomic.h>
+#include <fbl/string_printf.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/object.h>
+
+namespace {
+
+constexpr uint32_t kMaxThreads = 64;
+
+// Each futex gets a cache line of its own, so that the threads only share
+// what the kernel makes them share.
+struct alignas(64) PaddedFutex {
+    zx_futex_t value;
+};
+
+struct WakeThreadArgs {
+    zx_futex_t* futex;
+    fbl::atomic<bool>* stop;
+};
+
+// Wake a futex nobody is waiting on over and over, until told to stop.
+int WakeThread(void* arg) {
+    auto args = static_cast<WakeThreadArgs*>(arg);
+    while (!args->stop->load(fbl::memory_order_relaxed)) {
+        ZX_ASSERT(zx_futex_wake(args->futex, 1) == ZX_OK);
+    }
+    return 0;
+}
+
+// Measure the time taken by a zx_futex_wake() call that finds no waiters,
+// which is mostly the cost of looking the futex up.
+bool FutexWakeUncontendedTest(perftest::RepeatState* state) {
+    zx_futex_t futex = 0;
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_futex_wake(&futex, 1) == ZX_OK);
+    }
+    return true;
+}
+
+// Measure the same while |thread_count| - 1 other threads of the process
+// are doing so too, each on an address of its own. Since none of the
+// threads share a futex, the time should stay roughly flat as the thread
+// count grows towards the number of CPUs, unless they contend on a lock
+// inside the kernel.
+bool FutexWakeContendedTest(perftest::RepeatState* state, uint32_t thread_count) {
+    PaddedFutex futexes[kMaxThreads] = {};
+    WakeThreadArgs args[kMaxThreads];
+    thrd_t threads[kMaxThreads];
+    fbl::atomic<bool> stop(false);
+
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        args[i] = {&futexes[i].value, &stop};
+        ZX_ASSERT(thrd_create(&threads[i], WakeThread, &args[i]) == thrd_success);
+    }
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_futex_wake(&futexes[0].value, 1) == ZX_OK);
+    }
+
+    stop.store(true);
+    for (uint32_t i = 1; i < thread_count; ++i) {
+        ZX_ASSERT(thrd_join(threads[i], nullptr) == thrd_success);
+    }
+    return true;
+}
+
+struct WaitThreadArgs {
+    zx_futex_t* futex;
+    uint32_t index;
+    zx_handle_t* thread;
+    fbl::atomic<uint32_t>* ready;
+    fbl::atomic<uint32_t>* woken;
+    fbl::atomic<bool>* stop;
+};
+
+// Block on a futex over and over, reporting each wakeup, until told to stop.
+int WaitThread(void* arg) {
+    auto args = static_cast<WaitThreadArgs*>(arg);
+    ZX_ASSERT(zx_handle_duplicate(zx_thread_self(), ZX_RIGHT_SAME_RIGHTS,
+                                  args->thread) == ZX_OK);
+    args->ready->fetch_add(1);
+    for (;;) {
+        ZX_ASSERT(zx_futex_wait(args->futex, 0, ZX_TIME_INFINITE) == ZX_OK);
+        if (args->stop->load())
+            return 0;
+        args->woken->store(args->index + 1);
+    }
+}
+
+// Wait until |thread| is blocked on a futex.
+void WaitUntilBlocked(zx_handle_t thread) {
+    for (;;) {
+        zx_info_thread_t info;
+        ZX_ASSERT(zx_object_get_info(thread, ZX_INFO_THREAD, &info, sizeof(info),
+                                     nullptr, nullptr) == ZX_OK);
+        if (info.state == ZX_THREAD_STATE_BLOCKED_FUTEX)
+            return;
+        zx_nanosleep(0);
+    }
+}
+
+// Measure the time taken by a zx_futex_wake() call that does wake a thread,
+// with |thread_count| threads blocked on each of |futex_count| futexes.
+// After each wakeup, the woken thread is allowed to block again before the
+// next one, so that every timed call finds the same number of waiters.
+bool FutexWakeWaitersTest(perftest::RepeatState* state, uint32_t futex_count,
+                          uint32_t thread_count) {
+    state->DeclareStep("wake");
+    state->DeclareStep("rewait");
+
+    PaddedFutex futexes[kMaxThreads] = {};
+    WaitThreadArgs args[kMaxThreads];
+    thrd_t threads[kMaxThreads];
+    zx_handle_t handles[kMaxThreads];
+    fbl::atomic<uint32_t> ready(0);
+    fbl::atomic<uint32_t> woken(0);
+    fbl::atomic<bool> stop(false);
+
+    const uint32_t total = futex_count * thread_count;
+    for (uint32_t i = 0; i < total; ++i) {
+        args[i] = {&futexes[i % futex_count].value, i, &handles[i], &ready, &woken, &stop};
+        ZX_ASSERT(thrd_create(&threads[i], WaitThread, &args[i]) == thrd_success);
+    }
+    while (ready.load() < total)
+        zx_nanosleep(0);
+    for (uint32_t i = 0; i < total; ++i)
+        WaitUntilBlocked(handles[i]);
+
+    uint32_t next = 0;
+    while (state->KeepRunning()) {
+        ZX_ASSERT(zx_futex_wake(&futexes[next].value, 1) == ZX_OK);
+        state->NextStep();
+
+        uint32_t index;
+        while ((index = woken.exchange(0)) == 0)
+            zx_nanosleep(0);
+        WaitUntilBlocked(handles[index - 1]);
+        next = (next + 1) % futex_count;
+    }
+
+    stop.store(true);
+    for (uint32_t i = 0; i < futex_count; ++i) {
+        ZX_ASSERT(zx_futex_wake(&futexes[i].value, UINT32_MAX) == ZX_OK);
+    }
+    for (uint32_t i = 0; i < total; ++i) {
+        ZX_ASSERT(thrd_join(threads[i], nullptr) == thrd_success);
+        zx_handle_close(handles[i]);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("FutexWake/Uncontended", FutexWakeUncontendedTest);
+
+    uint32_t max_threads = fbl::min(zx_system_get_num_cpus(), kMaxThreads);
+    for (uint32_t threads = 2; threads <= max_threads; threads *= 2) {
+        auto name = fbl::StringPrintf("FutexWake/Contended/%uthreads", threads);
+        perftest::RegisterTest(name.c_str(), FutexWakeContendedTest, threads);
+    }
+
+    for (uint32_t futexes = 1; futexes <= 4; futexes *= 2) {
+        for (uint32_t threads = 1; threads * futexes <= kMaxThreads; threads *= 4) {
+            auto name = fbl::StringPrintf("FutexWake/Waiters/%ufutexes/%uthreads",
+                                          futexes, threads);
+            perftest::RegisterTest(name.c_str(), FutexWakeWaitersTest, futexes, threads);
+        }
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
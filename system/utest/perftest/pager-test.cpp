@@ -0,0 +1,121 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+#include <threads.h>
+
+#include <lib/zx/port.h>
+#include <lib/zx/vmo.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/process.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+// A user-space pager that answers every page request with a page of data,
+// until its vmo goes away.
+struct Pager {
+    zx_handle_t pager;
+    zx_handle_t vmo;
+    zx::port port;
+    thrd_t thread;
+};
+
+int PagerThread(void* arg) {
+    auto* pager = static_cast<Pager*>(arg);
+    zx::vmo aux;
+    ZX_ASSERT(zx::vmo::create(PAGE_SIZE, 0, &aux) == ZX_OK);
+    uint8_t data[PAGE_SIZE];
+    memset(data, 0x5a, sizeof(data));
+
+    for (;;) {
+        zx_port_packet_t packet;
+        ZX_ASSERT(pager->port.wait(zx::time::infinite(), &packet) == ZX_OK);
+        ZX_ASSERT(packet.type == ZX_PKT_TYPE_PAGE_REQUEST);
+        if (packet.page_request.command == ZX_PAGER_VMO_COMPLETE) {
+            return 0;
+        }
+        ZX_ASSERT(packet.page_request.length == PAGE_SIZE);
+
+        // Supplying the page takes it out of |aux|, so this is the cost of
+        // reading in a page of data.
+        ZX_ASSERT(aux.write(data, 0, sizeof(data)) == ZX_OK);
+        ZX_ASSERT(zx_pager_supply_pages(pager->pager, pager->vmo, packet.page_request.offset,
+                                        PAGE_SIZE, aux.get(), 0) == ZX_OK);
+    }
+}
+
+void StartPager(Pager* pager) {
+    ZX_ASSERT(zx_pager_create(0, &pager->pager) == ZX_OK);
+    ZX_ASSERT(zx::port::create(0, &pager->port) == ZX_OK);
+    ZX_ASSERT(zx_pager_create_vmo(pager->pager, pager->port.get(), 0, PAGE_SIZE, 0,
+                                  &pager->vmo) == ZX_OK);
+    ZX_ASSERT(thrd_create(&pager->thread, PagerThread, pager) == thrd_success);
+}
+
+void StopPager(Pager* pager) {
+    ZX_ASSERT(zx_handle_close(pager->vmo) == ZX_OK);
+    ZX_ASSERT(thrd_join(pager->thread, nullptr) == thrd_success);
+    ZX_ASSERT(zx_handle_close(pager->pager) == ZX_OK);
+}
+
+// Measure the time from a page fault on a pager vmo to the faulting thread
+// running again, which includes a round trip to the pager thread through a
+// port and supplying the page.  The page is decommitted after each fault so
+// that the next one goes to the pager again.
+bool FaultTest(perftest::RepeatState* state) {
+    state->DeclareStep("fault");
+    state->DeclareStep("decommit");
+
+    Pager pager;
+    StartPager(&pager);
+
+    uintptr_t addr;
+    ZX_ASSERT(zx_vmar_map(zx_vmar_root_self(), 0, pager.vmo, 0, PAGE_SIZE,
+                          ZX_VM_FLAG_PERM_READ, &addr) == ZX_OK);
+    auto ptr = reinterpret_cast<volatile uint8_t*>(addr);
+
+    while (state->KeepRunning()) {
+        ZX_ASSERT(*ptr == 0x5a);
+        state->NextStep();
+        ZX_ASSERT(zx_vmo_op_range(pager.vmo, ZX_VMO_OP_DECOMMIT, 0, PAGE_SIZE,
+                                  nullptr, 0) == ZX_OK);
+    }
+
+    ZX_ASSERT(zx_vmar_unmap(zx_vmar_root_self(), addr, PAGE_SIZE) == ZX_OK);
+    StopPager(&pager);
+    return true;
+}
+
+// The same as FaultTest, but with the page read in by zx_vmo_read(), which
+// waits for the page inside the kernel without taking a fault.
+bool VmoReadTest(perftest::RepeatState* state) {
+    state->DeclareStep("read");
+    state->DeclareStep("decommit");
+
+    Pager pager;
+    StartPager(&pager);
+
+    while (state->KeepRunning()) {
+        uint8_t value;
+        ZX_ASSERT(zx_vmo_read(pager.vmo, &value, 0, 1) == ZX_OK);
+        ZX_ASSERT(value == 0x5a);
+        state->NextStep();
+        ZX_ASSERT(zx_vmo_op_range(pager.vmo, ZX_VMO_OP_DECOMMIT, 0, PAGE_SIZE,
+                                  nullptr, 0) == ZX_OK);
+    }
+
+    StopPager(&pager);
+    return true;
+}
+
+void RegisterTests() {
+    perftest::RegisterTest("Pager/Fault", FaultTest);
+    perftest::RegisterTest("Pager/VmoRead", VmoReadTest);
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
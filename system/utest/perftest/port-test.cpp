@@ -0,0 +1,107 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <fbl/string_printf.h>
+#include <lib/async-loop/cpp/loop.h>
+#include <lib/async/receiver.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+#include <zircon/syscalls/port.h>
+
+namespace {
+
+void QueuePackets(zx_handle_t port, uint32_t count) {
+    zx_port_packet_t packet = {};
+    for (uint32_t i = 0; i < count; ++i) {
+        packet.key = i;
+        ZX_ASSERT(zx_port_queue(port, &packet) == ZX_OK);
+    }
+}
+
+// Measure the time taken to queue |count| packets on a port and then read
+// them back one at a time with zx_port_wait().
+bool PortWaitTest(perftest::RepeatState* state, uint32_t count) {
+    zx_handle_t port;
+    ZX_ASSERT(zx_port_create(0, &port) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        QueuePackets(port, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            zx_port_packet_t packet;
+            ZX_ASSERT(zx_port_wait(port, 0, &packet) == ZX_OK);
+        }
+    }
+
+    ZX_ASSERT(zx_handle_close(port) == ZX_OK);
+    return true;
+}
+
+// Same as above, but reading the packets back in batches with
+// zx_port_wait_many().
+bool PortWaitManyTest(perftest::RepeatState* state, uint32_t count) {
+    zx_handle_t port;
+    ZX_ASSERT(zx_port_create(0, &port) == ZX_OK);
+
+    while (state->KeepRunning()) {
+        QueuePackets(port, count);
+        for (uint32_t received = 0; received < count;) {
+            zx_port_packet_t packets[ZX_PORT_WAIT_MANY_MAX_PACKETS];
+            size_t actual;
+            ZX_ASSERT(zx_port_wait_many(port, 0, packets, ZX_PORT_WAIT_MANY_MAX_PACKETS,
+                                        &actual) == ZX_OK);
+            received += static_cast<uint32_t>(actual);
+        }
+    }
+
+    ZX_ASSERT(zx_handle_close(port) == ZX_OK);
+    return true;
+}
+
+struct CountingReceiver : async_receiver_t {
+    uint32_t received = 0;
+};
+
+void OnPacket(async_t* async, async_receiver_t* receiver, zx_status_t status,
+              const zx_packet_user_t* data) {
+    ZX_ASSERT(status == ZX_OK);
+    static_cast<CountingReceiver*>(receiver)->received++;
+}
+
+// Measure the time taken to queue |count| packets on an async loop and have
+// the loop dispatch them, which shows the benefit of the loop reading the
+// packets from its port in batches.
+bool AsyncLoopPacketsTest(perftest::RepeatState* state, uint32_t count) {
+    async::Loop loop;
+    CountingReceiver receiver;
+    receiver.state = ASYNC_STATE_INIT;
+    receiver.handler = OnPacket;
+
+    while (state->KeepRunning()) {
+        receiver.received = 0;
+        for (uint32_t i = 0; i < count; ++i) {
+            ZX_ASSERT(async_queue_packet(loop.async(), &receiver, nullptr) == ZX_OK);
+        }
+        ZX_ASSERT(loop.RunUntilIdle() == ZX_OK);
+        ZX_ASSERT(receiver.received == count);
+    }
+    return true;
+}
+
+void RegisterTests() {
+    static const uint32_t kPacketCounts[] = {1, 4, 16, 64};
+    for (auto count : kPacketCounts) {
+        auto wait_name = fbl::StringPrintf("Port/Wait/%upackets", count);
+        perftest::RegisterTest(wait_name.c_str(), PortWaitTest, count);
+
+        auto wait_many_name = fbl::StringPrintf("Port/WaitMany/%upackets", count);
+        perftest::RegisterTest(wait_many_name.c_str(), PortWaitManyTest, count);
+
+        auto loop_name = fbl::StringPrintf("AsyncLoop/Packets/%upackets", count);
+        perftest::RegisterTest(loop_name.c_str(), AsyncLoopPacketsTest, count);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
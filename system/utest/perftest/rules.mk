@@ -9,16 +9,21 @@ MODULE := $(LOCAL_DIR)
 MODULE_TYPE := usertest
 
 MODULE_SRCS += \
+    $(LOCAL_DIR)/channel-test.cpp \
     $(LOCAL_DIR)/clock-test.cpp \
+    $(LOCAL_DIR)/futex-test.cpp \
     $(LOCAL_DIR)/handle-creation-test.cpp \
     $(LOCAL_DIR)/malloc-test.cpp \
     $(LOCAL_DIR)/mutex-test.cpp \
     $(LOCAL_DIR)/null-test.cpp \
+    $(LOCAL_DIR)/pager-test.cpp \
+    $(LOCAL_DIR)/port-test.cpp \
     $(LOCAL_DIR)/process-test.cpp \
     $(LOCAL_DIR)/results-test.cpp \
     $(LOCAL_DIR)/runner-test.cpp \
     $(LOCAL_DIR)/sleep-test.cpp \
     $(LOCAL_DIR)/syscalls-test.cpp \
+    $(LOCAL_DIR)/wakeup-test.cpp \
 
 MODULE_NAME := perf-test
 
@@ -39,6 +44,7 @@ MODULE_LIBS := \
     system/ulib/c \
     system/ulib/fdio \
     system/ulib/launchpad \
+    system/ulib/mini-process \
     system/ulib/trace-engine \
     system/ulib/unittest \
     system/ulib/zircon \
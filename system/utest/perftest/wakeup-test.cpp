@@ -0,0 +1,120 @@
+// Copyright 2018 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <threads.h>
+
+#include <fbl/string_printf.h>
+#include <fbl/vector.h>
+#include <lib/zx/eventpair.h>
+#include <perftest/perftest.h>
+#include <zircon/assert.h>
+#include <zircon/syscalls.h>
+
+namespace {
+
+constexpr zx_signals_t kPing = ZX_USER_SIGNAL_0;
+constexpr zx_signals_t kStop = ZX_USER_SIGNAL_1;
+
+// Repeatedly wait for a ping on |arg|'s eventpair end and send one back to
+// the peer, until kStop is asserted on the end.
+int EchoThread(void* arg) {
+    zx_handle_t handle = *static_cast<zx_handle_t*>(arg);
+    for (;;) {
+        zx_signals_t observed;
+        ZX_ASSERT(zx_object_wait_one(handle, kPing | kStop, ZX_TIME_INFINITE,
+                                     &observed) == ZX_OK);
+        if (observed & kStop) {
+            return 0;
+        }
+        ZX_ASSERT(zx_object_signal(handle, kPing, 0) == ZX_OK);
+        ZX_ASSERT(zx_object_signal_peer(handle, 0, kPing) == ZX_OK);
+    }
+}
+
+// Two threads bouncing a signal back and forth through an eventpair.
+// This generates a steady stream of cross-thread wakeups.
+class PingPongPair {
+public:
+    PingPongPair() {
+        ZX_ASSERT(zx::eventpair::create(0, &ends_[0], &ends_[1]) == ZX_OK);
+        handles_[0] = ends_[0].get();
+        handles_[1] = ends_[1].get();
+    }
+
+    // Start one echo thread per end and kick off the ping-pong.
+    void StartBoth() {
+        Start(1);
+        Start(0);
+        ZX_ASSERT(ends_[0].signal_peer(0, kPing) == ZX_OK);
+    }
+
+    // Start an echo thread on the second end only, leaving the first end
+    // to be driven by the caller through RoundTrip().
+    void StartEcho() { Start(1); }
+
+    void RoundTrip() {
+        ZX_ASSERT(ends_[0].signal_peer(0, kPing) == ZX_OK);
+        ZX_ASSERT(ends_[0].wait_one(kPing, zx::time::infinite(), nullptr) == ZX_OK);
+        ZX_ASSERT(ends_[0].signal(kPing, 0) == ZX_OK);
+    }
+
+    void Stop() {
+        for (size_t i = 0; i < thread_count_; ++i) {
+            ZX_ASSERT(ends_[i ^ 1].signal(0, kStop) == ZX_OK);
+        }
+        for (size_t i = 0; i < thread_count_; ++i) {
+            ZX_ASSERT(thrd_join(threads_[i], nullptr) == thrd_success);
+        }
+        thread_count_ = 0;
+    }
+
+private:
+    void Start(size_t end) {
+        ZX_ASSERT(thrd_create(&threads_[thread_count_], EchoThread,
+                              &handles_[end]) == thrd_success);
+        ++thread_count_;
+    }
+
+    zx::eventpair ends_[2];
+    zx_handle_t handles_[2];
+    thrd_t threads_[2];
+    size_t thread_count_ = 0;
+};
+
+// Measure the round-trip wakeup latency between two threads while
+// |pair_count| - 1 other pairs of threads are waking each other up
+// concurrently.  With a scalable scheduler the latency should stay
+// roughly flat as the pair count grows towards the number of CPUs.
+bool WakeupLatencyTest(perftest::RepeatState* state, uint32_t pair_count) {
+    fbl::Vector<PingPongPair*> background;
+    for (uint32_t i = 1; i < pair_count; ++i) {
+        auto* pair = new PingPongPair();
+        pair->StartBoth();
+        background.push_back(pair);
+    }
+
+    PingPongPair measured;
+    measured.StartEcho();
+    while (state->KeepRunning()) {
+        measured.RoundTrip();
+    }
+    measured.Stop();
+
+    for (auto* pair : background) {
+        pair->Stop();
+        delete pair;
+    }
+    return true;
+}
+
+void RegisterTests() {
+    uint32_t num_cpus = zx_system_get_num_cpus();
+    for (uint32_t pairs = 1; pairs <= num_cpus; pairs *= 2) {
+        auto name = fbl::StringPrintf("WakeupLatency/%upairs", pairs);
+        perftest::RegisterTest(name.c_str(), WakeupLatencyTest, pairs);
+    }
+}
+PERFTEST_CTOR(RegisterTests);
+
+}  // namespace
@@ -1329,6 +1329,47 @@ bool vmo_decommit_misaligned_test() {
     END_TEST;
 }
 
+bool vmo_mergeable_test() {
+    BEGIN_TEST;
+
+    zx_handle_t vmo;
+    EXPECT_EQ(ZX_OK, zx_vmo_create(PAGE_SIZE * 2, 0, &vmo), "vm_object_create");
+
+    // the range doesn't matter
+    zx_status_t status = zx_vmo_op_range(vmo, ZX_VMO_OP_MERGEABLE, 0x10, 0x100, NULL, 0);
+    EXPECT_EQ(ZX_OK, status, "opting in to deduplication");
+
+    // a zero page that may be freed at any time reads and writes as usual
+    uintptr_t ptr;
+    status = zx_vmar_map(zx_vmar_root_self(), 0, vmo, 0, PAGE_SIZE * 2,
+                         ZX_VM_FLAG_PERM_READ | ZX_VM_FLAG_PERM_WRITE, &ptr);
+    EXPECT_EQ(ZX_OK, status, "map");
+    auto p = reinterpret_cast<volatile uint8_t*>(ptr);
+    p[0] = 0;
+    p[PAGE_SIZE] = 1;
+    EXPECT_EQ(0, p[0], "zero page contents");
+    p[0] = 2;
+    EXPECT_EQ(2, p[0], "written page contents");
+    EXPECT_EQ(1, p[PAGE_SIZE], "other page contents");
+    EXPECT_EQ(ZX_OK, zx_vmar_unmap(zx_vmar_root_self(), ptr, PAGE_SIZE * 2), "unmap");
+
+    status = zx_vmo_op_range(vmo, ZX_VMO_OP_UNMERGEABLE, 0, 0, NULL, 0);
+    EXPECT_EQ(ZX_OK, status, "opting out of deduplication");
+
+    // only a writer may opt in or out
+    zx_handle_t ro;
+    status = zx_handle_duplicate(vmo, ZX_DEFAULT_VMO_RIGHTS & ~ZX_RIGHT_WRITE, &ro);
+    EXPECT_EQ(ZX_OK, status, "duplicate without write");
+    status = zx_vmo_op_range(ro, ZX_VMO_OP_MERGEABLE, 0, 0, NULL, 0);
+    EXPECT_EQ(ZX_ERR_ACCESS_DENIED, status, "opting in without write");
+    status = zx_vmo_op_range(ro, ZX_VMO_OP_UNMERGEABLE, 0, 0, NULL, 0);
+    EXPECT_EQ(ZX_ERR_ACCESS_DENIED, status, "opting out without write");
+    EXPECT_EQ(ZX_OK, zx_handle_close(ro), "close handle");
+
+    EXPECT_EQ(ZX_OK, zx_handle_close(vmo), "close handle");
+    END_TEST;
+}
+
 // test set 4: deal with clones with nonzero offsets and offsets that extend beyond the original
 bool vmo_clone_test_4() {
     BEGIN_TEST;
@@ -1591,6 +1632,7 @@ RUN_TEST(vmo_clone_size_align_test);
 RUN_TEST(vmo_rights_test);
 RUN_TEST(vmo_commit_test);
 RUN_TEST(vmo_decommit_misaligned_test);
+RUN_TEST(vmo_mergeable_test);
 RUN_TEST(vmo_cache_test);
 RUN_TEST_PERFORMANCE(vmo_cache_map_test);
 RUN_TEST(vmo_cache_op_test);
@@ -14,7 +14,13 @@ int pthread_mutex_unlock(pthread_mutex_t* m) {
             return m->_m_count--, 0;
     }
     cont = atomic_exchange(&m->_m_lock, 0);
-    if (waiters || cont < 0)
-        __wake(&m->_m_lock, 1);
+    if (waiters || cont < 0) {
+        // Hand the kernel's notion of ownership to the thread being woken,
+        // which is the one most likely to take the mutex next.
+        if (m->_m_type & PTHREAD_MUTEX_PRIO_INHERIT_BIT)
+            _zx_futex_wake_single_owner(&m->_m_lock);
+        else
+            __wake(&m->_m_lock, 1);
+    }
     return 0;
 }
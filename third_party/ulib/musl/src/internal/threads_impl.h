@@ -125,6 +125,10 @@ static inline struct pthread* tp_to_pthread(void* tp) {
 // The bit used in the recursive and errorchecking cases, which track thread owners.
 #define PTHREAD_MUTEX_OWNED_LOCK_BIT 0x80000000
 #define PTHREAD_MUTEX_OWNED_LOCK_MASK 0x7fffffff
+// Set in the type of mutexes with the PTHREAD_PRIO_INHERIT protocol. These
+// track their owner too, whatever their type, and name it when waiting so
+// that the kernel can lend it the waiters' priority.
+#define PTHREAD_MUTEX_PRIO_INHERIT_BIT 0x4
 
 extern void* __pthread_tsd_main[];
 extern volatile size_t __pthread_tsd_size;
@@ -163,6 +167,10 @@ void __private_cond_signal(void* condvar, int n) ATTR_LIBC_VISIBILITY;
 int __timedwait(atomic_int*, int, clockid_t, const struct timespec*)
     ATTR_LIBC_VISIBILITY;
 
+// The same, for a futex held by the thread with the given handle.
+int __timedwait_owned(atomic_int*, int, zx_handle_t, clockid_t, const struct timespec*)
+    ATTR_LIBC_VISIBILITY;
+
 // Loading a library can introduce more thread_local variables. Thread
 // allocation bases bookkeeping decisions based on the current state
 // of thread_locals in the program, so thread creation needs to be
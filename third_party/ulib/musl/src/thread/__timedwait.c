@@ -4,20 +4,12 @@
 #include <zircon/syscalls.h>
 #include <time.h>
 
-int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
-    zx_time_t deadline = ZX_TIME_INFINITE;
-
-    if (at) {
-        int ret = __timespec_to_deadline(at, clk, &deadline);
-        if (ret)
-            return ret;
-    }
-
+static int futex_wait_result(zx_status_t status) {
     // zx_futex_wait will return ZX_ERR_BAD_STATE if someone modifying *addr
     // races with this call. But this is indistinguishable from
     // otherwise being woken up just before someone else changes the
     // value. Therefore this functions returns 0 in that case.
-    switch (_zx_futex_wait(futex, val, deadline)) {
+    switch (status) {
     case ZX_OK:
     case ZX_ERR_BAD_STATE:
         return 0;
@@ -28,3 +20,38 @@ int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec
         __builtin_trap();
     }
 }
+
+int __timedwait(atomic_int* futex, int val, clockid_t clk, const struct timespec* at) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+
+    if (at) {
+        int ret = __timespec_to_deadline(at, clk, &deadline);
+        if (ret)
+            return ret;
+    }
+
+    return futex_wait_result(_zx_futex_wait(futex, val, deadline));
+}
+
+int __timedwait_owned(atomic_int* futex, int val, zx_handle_t owner, clockid_t clk,
+                      const struct timespec* at) {
+    zx_time_t deadline = ZX_TIME_INFINITE;
+
+    if (at) {
+        int ret = __timespec_to_deadline(at, clk, &deadline);
+        if (ret)
+            return ret;
+    }
+
+    zx_status_t status = _zx_futex_wait_owned(futex, val, owner, deadline);
+    switch (status) {
+    case ZX_ERR_BAD_HANDLE:
+    case ZX_ERR_WRONG_TYPE:
+    case ZX_ERR_INVALID_ARGS:
+        // The owner read out of the futex may be stale, or the caller may
+        // be relocking a mutex it holds. Either way, wait without one.
+        status = _zx_futex_wait(futex, val, deadline);
+        break;
+    }
+    return futex_wait_result(status);
+}